@@ -0,0 +1,121 @@
+// Lexer and parser throughput over synthetic programs from pascal_generator.h, from 1 KB up to
+// 100 MB. The parser runs its semantic checks as it parses, so "parse" covers both; the lexing it
+// drives is measured separately and taken out.
+//
+// usage: compiler_bench [max_bytes] [output_file]
+// Prints one JSON object per line (size, phase, seconds, tokens/s, MB/s) to stdout, or to
+// output_file when given, so runs can be diffed.
+
+#include <chrono>
+#include <cstdio>
+
+#include "../src/lexer.h"
+#include "../src/parser.h"
+#include "pascal_generator.h"
+
+struct Measurement
+{
+	double seconds = 0;
+	long tokens = 0;
+	long errors = 0; // diagnostics other than listing lines, 0 for a valid program
+};
+
+double Seconds (std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+}
+
+Measurement Lex (std::string const &file_name)
+{
+	Logger logger ("bench_");
+	Lexer lexer (logger);
+	CompilationContext context;
+	CodeSource source (file_name);
+
+	auto start = std::chrono::steady_clock::now ();
+	auto tokens = lexer.GetTokens (source, context);
+	return Measurement{ Seconds (start), static_cast<long> (tokens.size ()) };
+}
+
+Measurement Parse (std::string const &file_name)
+{
+	Logger logger ("bench_");
+	Lexer lexer (logger);
+	CompilationContext context;
+	CodeSource source (file_name);
+
+	auto start = std::chrono::steady_clock::now ();
+	context.ast.Reserve (source.Size () / 4);
+	TokenStream ts (lexer, context, source);
+	ParserContext ct (context, ts, logger);
+	Parser::Parse (ct);
+	ts.Finish ();
+	double seconds = Seconds (start) - logger.stats.Seconds (Phase::lex);
+
+	Measurement m{ seconds, logger.stats.Get (Counter::tokens_lexed) };
+	for (auto &d : logger.diagnostics)
+		if (d.kind != DiagnosticKind::listing) m.errors++;
+	return m;
+}
+
+// Best of several runs, repeating small inputs until they have run for a while
+template <typename Run> Measurement Best (Run run)
+{
+	Measurement best = run ();
+	double total = best.seconds;
+	for (int i = 1; i < 50 && total < 0.5; i++)
+	{
+		auto m = run ();
+		total += m.seconds;
+		if (m.seconds < best.seconds) best = m;
+	}
+	return best;
+}
+
+void Report (FILE *out, char const *phase, size_t bytes, Measurement const &m)
+{
+	double mb = bytes / (1024.0 * 1024.0);
+	fmt::print (out,
+	"{{\"bytes\": {}, \"phase\": \"{}\", \"seconds\": {:.6f}, \"tokens\": {}, \"tokens_per_s\": {:.0f}, "
+	"\"mb_per_s\": {:.3f}, \"errors\": {}}}\n",
+	bytes,
+	phase,
+	m.seconds,
+	m.tokens,
+	m.tokens / m.seconds,
+	mb / m.seconds,
+	m.errors);
+	std::fflush (out);
+}
+
+int main (int argc, char *argv[])
+{
+	size_t max_bytes = argc >= 2 ? std::stoul (argv[1]) : 100 * 1024 * 1024;
+	FILE *out = argc >= 3 ? std::fopen (argv[2], "w") : stdout;
+	if (out == nullptr)
+	{
+		fmt::print ("Could not open {}\n", argv[2]);
+		return 1;
+	}
+	std::string file_name = "compiler_bench_input.txt";
+
+	for (size_t target = 1024; target <= max_bytes; target *= 10)
+	{
+		GeneratorOptions options;
+		options.target_bytes = target;
+		auto program = PascalGenerator (options).Generate ();
+		{
+			std::ofstream file (file_name, std::ios::out | std::ios::binary);
+			file << program;
+		}
+
+		Report (out, "lex", program.size (), Best ([&] { return Lex (file_name); }));
+		Report (out, "parse", program.size (), Best ([&] { return Parse (file_name); }));
+	}
+
+	std::remove (file_name.c_str ());
+	std::remove ("bench_listing_file.txt");
+	std::remove ("bench_token_file.txt");
+	if (out != stdout) std::fclose (out);
+	return 0;
+}
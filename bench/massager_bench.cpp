@@ -0,0 +1,148 @@
+// The grammar massager's transformations over generated grammars of growing size.
+//
+// epsilon: one rule of n terminals each followed by an optional piece, a variable with a terminal
+// or e production, so RemoveEProds permutes it into 2^n rules while
+// BetterRemoveEpsilonProductions adds a few productions per piece. Peak memory only ever grows
+// within the process, so every linear run goes before the first permuting one.
+//
+// factor: n productions over ten variables, each rule the base 4 digits of its number as terminals,
+// so the rules share prefixes as deep as a trie of them goes.
+//
+// recursion: n variables each left recursive on itself and starting with one shared earlier
+// variable, so RemoveLeftRecursion substitutes and adds a variable for every one of them.
+//
+// usage: massager_bench [stage[/method]] [max_permuted_pieces], everything and 18 by default. Running
+// one method per process gives it peak memory figures of its own.
+// Prints one JSON object per line (stage, method, size, seconds, productions, peak memory) to stdout.
+
+#include <chrono>
+#include <cstdio>
+
+#include "../src/grammar_massager.h"
+
+std::string const grammar_file = "massager_bench_grammar.txt";
+
+double Seconds (std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+}
+
+Grammar Read (std::string const &text)
+{
+	{
+		std::ofstream file (grammar_file, std::ios::out | std::ios::binary);
+		file << text;
+	}
+	std::ifstream in (grammar_file, std::ios::in);
+	return ReadGrammar (in);
+}
+
+// S -> t0 O1 t1 O2 .. On tn, with each Oi -> ti | e
+std::string OptionalPiecesGrammar (int pieces)
+{
+	std::string text = "TOKENS";
+	for (int i = 0; i <= pieces; i++)
+		text += fmt::format (" t{}", i);
+	text += "\n\nS ->\n\tt0";
+	for (int i = 1; i <= pieces; i++)
+		text += fmt::format (" O{} t{}", i, i);
+	text += "\n\n";
+	for (int i = 1; i <= pieces; i++)
+		text += fmt::format ("O{} ->\n\tt{}\n\te\n\n", i, i);
+	return text;
+}
+
+std::string only; // the stage/method prefix to run, empty for all
+
+bool Runs (std::string const &stage, std::string const &method)
+{
+	return (stage + "/" + method).compare (0, only.size (), only) == 0;
+}
+
+// F0 .. F9, each with n / 10 rules of the same length that differ only in where they end up
+std::string SharedPrefixGrammar (int productions)
+{
+	int per_variable = productions / 10;
+	int digits = 1;
+	for (int reach = 4; reach < per_variable; reach *= 4)
+		digits++;
+
+	std::string text = "TOKENS t0 t1 t2 t3\n\n";
+	for (int v = 0; v < 10; v++)
+	{
+		text += fmt::format ("F{} ->\n", v);
+		for (int i = 0; i < per_variable; i++)
+		{
+			text += "\t";
+			for (int d = digits - 1; d >= 0; d--)
+				text += fmt::format ("t{} ", i >> (2 * d) & 3);
+			text += "\n";
+		}
+		text += "\n";
+	}
+	return text;
+}
+
+// W -> t0 | t1, then V1 .. Vn with each Vi -> W ti | Vi ti | ti
+std::string LeftRecursiveGrammar (int variables)
+{
+	std::string text = "TOKENS";
+	for (int i = 0; i <= variables; i++)
+		text += fmt::format (" t{}", i);
+	text += "\n\nW ->\n\tt0\n\tt1\n\n";
+	for (int i = 1; i <= variables; i++)
+		text += fmt::format ("V{} ->\n\tW t{}\n\tV{} t{}\n\tt{}\n\n", i, i, i, i, i);
+	return text;
+}
+
+template <typename Transform> void Report (char const *stage, char const *method, int size, Grammar &grammar, Transform transform)
+{
+	size_t peak_before = PeakMemoryBytes ();
+	auto start = std::chrono::steady_clock::now ();
+	Grammar result = transform (grammar);
+	double seconds = Seconds (start);
+	fmt::print ("{{\"stage\": \"{}\", \"method\": \"{}\", \"size\": {}, \"seconds\": {:.6f}, \"productions_in\": {}, "
+	            "\"productions_out\": {}, \"peak_mb_before\": {:.1f}, \"peak_mb_after\": {:.1f}}}\n",
+	stage,
+	method,
+	size,
+	seconds,
+	grammar.Productions ().size (),
+	result.Productions ().size (),
+	peak_before / 1e6,
+	PeakMemoryBytes () / 1e6);
+	std::fflush (stdout);
+}
+
+int main (int argc, char *argv[])
+{
+	only = argc >= 2 ? argv[1] : "";
+	int max_permuted = argc >= 3 ? std::stoi (argv[2]) : 18;
+	massager_log = nullptr;
+
+	for (int pieces = 4; pieces <= 100000 && Runs ("epsilon", "linear"); pieces *= 4)
+	{
+		auto grammar = Read (OptionalPiecesGrammar (pieces));
+		Report ("epsilon", "linear", pieces, grammar, BetterRemoveEpsilonProductions);
+	}
+	for (int pieces = 2; pieces <= max_permuted && Runs ("epsilon", "permute"); pieces += 2)
+	{
+		auto grammar = Read (OptionalPiecesGrammar (pieces));
+		Report ("epsilon", "permute", pieces, grammar, RemoveEProds);
+	}
+	for (int productions : { 10000, 30000, 100000 })
+	{
+		if (!Runs ("factor", "trie")) break;
+		auto grammar = Read (SharedPrefixGrammar (productions));
+		Report ("factor", "trie", productions, grammar, RemoveXLeftFactoring);
+	}
+	for (int variables : { 1000, 3000, 10000, 30000 })
+	{
+		if (!Runs ("recursion", "worklist")) break;
+		auto grammar = Read (LeftRecursiveGrammar (variables));
+		Report ("recursion", "worklist", variables, grammar, RemoveLeftRecursion);
+	}
+
+	std::remove (grammar_file.c_str ());
+	return 0;
+}
@@ -0,0 +1,146 @@
+// The table driven parser against the hand-written one, over synthetic programs from
+// pascal_generator.h from 1 KB up to 10 MB, then over a parenthesized expression nested ever
+// deeper. The hand-written parser recurses a few calls per level, so it only takes the nesting up to
+// max_recursive_depth, past which it could overflow the stack; the table driven one takes any
+// depth. Lexing is measured and taken out as in compiler_bench.
+//
+// usage: parser_bench [max_bytes] [grammar_file], the table built into the compiler by default
+// Prints one JSON object per line (size, parser, seconds, tokens/s, MB/s, AST nodes) to stdout.
+
+#include <chrono>
+#include <cstdio>
+
+#include "../src/lexer.h"
+#include "../src/parser.h"
+#include "../src/table_parser.h"
+#include "pascal_generator.h"
+
+constexpr int max_recursive_depth = 1000;
+
+struct Measurement
+{
+	double seconds = 0;
+	long tokens = 0;
+	long errors = 0; // diagnostics other than listing lines, 0 for a valid program
+	size_t nodes = 0;
+};
+
+double Seconds (std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+}
+
+// Parses with table_parser, or with Parser::Parse when it is null
+Measurement Parse (std::string const &file_name, TableParser const *table_parser)
+{
+	Logger logger ("bench_");
+	Lexer lexer (logger);
+	CompilationContext context;
+	CodeSource source (file_name);
+
+	auto start = std::chrono::steady_clock::now ();
+	context.ast.Reserve (source.Size () / 4);
+	TokenStream ts (lexer, context, source);
+	ParserContext ct (context, ts, logger);
+	if (table_parser)
+		table_parser->Parse (ct);
+	else
+		Parser::Parse (ct);
+	ts.Finish ();
+	double seconds = Seconds (start) - logger.stats.Seconds (Phase::lex);
+
+	Measurement m{ seconds, logger.stats.Get (Counter::tokens_lexed) };
+	for (auto &d : logger.diagnostics)
+		if (d.kind != DiagnosticKind::listing) m.errors++;
+	m.nodes = context.ast.Size ();
+	return m;
+}
+
+// Best of several runs, repeating small inputs until they have run for a while
+template <typename Run> Measurement Best (Run run)
+{
+	Measurement best = run ();
+	double total = best.seconds;
+	for (int i = 1; i < 50 && total < 0.5; i++)
+	{
+		auto m = run ();
+		total += m.seconds;
+		if (m.seconds < best.seconds) best = m;
+	}
+	return best;
+}
+
+void Report (char const *input, size_t size, char const *parser, size_t bytes, Measurement const &m)
+{
+	double mb = bytes / (1024.0 * 1024.0);
+	fmt::print ("{{\"input\": \"{}\", \"size\": {}, \"parser\": \"{}\", \"seconds\": {:.6f}, \"tokens\": {}, "
+	            "\"tokens_per_s\": {:.0f}, \"mb_per_s\": {:.3f}, \"errors\": {}, \"ast_nodes\": {}}}\n",
+	input,
+	size,
+	parser,
+	m.seconds,
+	m.tokens,
+	m.tokens / m.seconds,
+	mb / m.seconds,
+	m.errors,
+	m.nodes);
+	std::fflush (stdout);
+}
+
+// A program assigning an expression in depth parentheses, broken over lines the lexer can take
+std::string NestedProgram (int depth)
+{
+	std::string text = "program nested(input, output);\nvar x: integer;\nbegin\nx :=\n";
+	for (int i = 0; i < depth; i++)
+		text += i % 32 == 31 ? "(\n" : "(";
+	text += "\n1\n";
+	for (int i = 0; i < depth; i++)
+		text += i % 32 == 31 ? ")\n" : ")";
+	text += "\nend.\n";
+	return text;
+}
+
+int main (int argc, char *argv[])
+{
+	size_t max_bytes = argc >= 2 ? std::stoul (argv[1]) : 10 * 1024 * 1024;
+	std::string error;
+	TableParser table_parser;
+	auto table = argc >= 3 ? LoadLL1Table (argv[2], error) : GeneratedLL1Table ();
+	if (!table || !table_parser.Bind (std::move (*table), error))
+	{
+		fmt::print ("{}\n", error);
+		return 1;
+	}
+
+	std::string file_name = "parser_bench_input.txt";
+	auto write = [&] (std::string const &program) {
+		std::ofstream file (file_name, std::ios::out | std::ios::binary);
+		file << program;
+	};
+
+	for (size_t target = 1024; target <= max_bytes; target *= 10)
+	{
+		GeneratorOptions options;
+		options.target_bytes = target;
+		auto program = PascalGenerator (options).Generate ();
+		write (program);
+
+		Report ("program", target, "recursive", program.size (), Best ([&] { return Parse (file_name, nullptr); }));
+		Report ("program", target, "table", program.size (), Best ([&] { return Parse (file_name, &table_parser); }));
+	}
+
+	for (int depth = 10; depth <= 1000000; depth *= 10)
+	{
+		auto program = NestedProgram (depth);
+		write (program);
+
+		if (depth <= max_recursive_depth)
+			Report ("nesting", depth, "recursive", program.size (), Best ([&] { return Parse (file_name, nullptr); }));
+		Report ("nesting", depth, "table", program.size (), Best ([&] { return Parse (file_name, &table_parser); }));
+	}
+
+	std::remove (file_name.c_str ());
+	std::remove ("bench_listing_file.txt");
+	std::remove ("bench_token_file.txt");
+	return 0;
+}
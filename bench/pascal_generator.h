@@ -0,0 +1,252 @@
+#pragma once
+
+// Writes synthetic programs in the dialect of grammars/grammar_shorthand.txt for the benchmarks.
+// Programs are semantically valid: every name is declared, operands are type correct and calls
+// match the callee's signature. Procedures nest up to nesting_depth with fanout children each,
+// and top level procedures are added until the program reaches target_bytes.
+//
+// The lexer can't take lines of line_buffer_length characters or more and identifiers longer
+// than identifier_length, so long expressions are broken over several lines and every name is a
+// letter and a short number.
+
+#include <random>
+#include <string>
+
+#include "../src/lexer.h"
+
+struct GeneratorOptions
+{
+	size_t target_bytes = 1024;
+	int nesting_depth = 3;   // procedures declared inside procedures
+	int fanout = 4;          // procedures declared in each procedure
+	int globals = 64;        // integer globals g0.., capped for small targets
+	int locals = 4;          // integer locals l0.. of each procedure
+	int arrays = 8;          // integer arrays a0.. and real arrays b0.. declared globally
+	int statements = 10;     // statements in each compound statement
+	int chain_length = 12;   // terms in a long expression chain
+	int max_procedures = 0;  // stop adding procedures at this many, 0 for no limit
+	uint32_t seed = 1;
+};
+
+class PascalGenerator
+{
+	public:
+	PascalGenerator (GeneratorOptions options) : options (options), rng (options.seed)
+	{
+		globals = std::max (4, std::min<int> (options.globals, options.target_bytes / 256));
+		arrays = std::max (1, std::min<int> (options.arrays, options.target_bytes / 1024));
+	}
+
+	std::string Generate ()
+	{
+		text.clear ();
+		procedure_count = 0;
+		text.reserve (options.target_bytes + 4096);
+
+		Line ("program bench(input, output);");
+		// decls -> decls var id : type ;
+		for (int i = 0; i < globals; i++)
+			Line (fmt::format ("var g{}: integer;", i));
+		for (int i = 0; i < real_globals; i++)
+			Line (fmt::format ("var r{}: real;", i));
+		for (int i = 0; i < arrays; i++)
+		{
+			Line (fmt::format ("var a{}: array [0 .. {}] of integer;", i, array_size - 1));
+			Line (fmt::format ("var b{}: array [1 .. {}] of real;", i, array_size));
+		}
+
+		// sp_decls -> sp_decls sp_decl ;
+		std::vector<std::string> top_level;
+		auto room = [&] { return text.size () + main_reserve < options.target_bytes && !ProcedureLimit (); };
+		while (room () || top_level.empty ())
+			top_level.push_back (Procedure (1));
+
+		Scope main_scope;
+		main_scope.callees = top_level;
+		CompoundStatement (main_scope, 0);
+		text.back () = '.';
+		text.push_back ('\n');
+		return text;
+	}
+
+	private:
+	struct Scope
+	{
+		bool in_procedure = false;
+		std::vector<std::string> callees; // procedures callable with (integer, real)
+	};
+
+	// sp_decl -> sp_head decls sp_decls comp_stmt, returns the procedure's name
+	std::string Procedure (int depth)
+	{
+		std::string name = fmt::format ("q{}", procedure_count++);
+		std::string indent (depth, '\t');
+		Line (indent + fmt::format ("procedure {}(x: integer; y: real);", name));
+		for (int i = 0; i < options.locals; i++)
+			Line (indent + fmt::format ("\tvar l{}: integer;", i));
+
+		Scope scope;
+		scope.in_procedure = true;
+		scope.callees.push_back (name); // a procedure can call itself
+		if (depth < options.nesting_depth)
+			for (int i = 0; i < options.fanout; i++)
+			{
+				if (text.size () >= options.target_bytes || ProcedureLimit ()) break;
+				auto child = Procedure (depth + 1);
+				scope.callees.push_back (child);
+			}
+
+		CompoundStatement (scope, depth);
+		text.insert (text.size () - 1, ";");
+		return name;
+	}
+
+	bool ProcedureLimit () const
+	{
+		return options.max_procedures > 0 && procedure_count >= options.max_procedures;
+	}
+
+	// comp_stmt -> begin opt_stmt end
+	void CompoundStatement (Scope const &scope, int depth)
+	{
+		std::string indent (depth, '\t');
+		Line (indent + "begin");
+		for (int i = 0; i < options.statements; i++)
+		{
+			Statement (scope, depth + 1, true);
+			if (i + 1 < options.statements) text.insert (text.size () - 1, ";");
+		}
+		Line (indent + "end");
+	}
+
+	void Statement (Scope const &scope, int depth, bool allow_compound)
+	{
+		std::string indent (depth, '\t');
+		switch (Pick (allow_compound ? 8 : 7))
+		{
+			case 0:
+			case 1: // variable assignop expr, with a long chain of integer terms
+			{
+				std::string start = indent + IntVariable (scope) + " := " + IntTerm (scope);
+				Chain (scope, start, indent + "\t", options.chain_length);
+				break;
+			}
+			case 2: // real assignment
+				Line (indent + RealVariable (scope) + " := " + RealVariable (scope) + " + " +
+				      RealLiteral () + " * " + RealVariable (scope));
+				break;
+			case 3: // id [ expr ] assignop expr
+				Line (indent + fmt::format ("a{}[{} mod {}] := a{}[{}] + {}",
+				                            Pick (arrays),
+				                            IntVariable (scope),
+				                            array_size,
+				                            Pick (arrays),
+				                            Pick (array_size),
+				                            IntTerm (scope)));
+				break;
+			case 4: // if expr then stmt else stmt
+				Line (indent + "if " + Relation (scope) + " then");
+				Line (indent + "\t" + IntVariable (scope) + " := " + IntTerm (scope) + " + 1");
+				Line (indent + "else " + IntVariable (scope) + " := " + IntTerm (scope) + " - 1");
+				break;
+			case 5: // while expr do stmt
+				Line (indent + "while " + Relation (scope) + " do");
+				Statement (scope, depth + 1, false);
+				break;
+			case 6: // call id ( expr_list )
+				Line (indent + fmt::format ("call {}({} + {}, {})",
+				                            scope.callees[Pick (scope.callees.size ())],
+				                            IntTerm (scope),
+				                            Pick (100),
+				                            RealVariable (scope)));
+				break;
+			case 7: // comp_stmt
+				Line (indent + "begin");
+				Statement (scope, depth + 1, false);
+				text.insert (text.size () - 1, ";");
+				Statement (scope, depth + 1, false);
+				Line (indent + "end");
+				break;
+		}
+	}
+
+	// Continues an integer expression with terms more terms, over as many lines as it needs
+	void Chain (Scope const &scope, std::string line, std::string const &indent, int terms)
+	{
+		static const char *ops[] = { "+", "-", "*", "div", "mod" };
+		for (int i = 0; i < terms; i++)
+		{
+			std::string term = std::string (" ") + ops[Pick (5)] + " " + IntTerm (scope);
+			if (line.size () + term.size () >= max_line) // lines stay well under line_buffer_length
+			{
+				Line (line);
+				line = indent;
+			}
+			line += term;
+		}
+		Line (line);
+	}
+
+	std::string Relation (Scope const &scope)
+	{
+		static const char *relops[] = { "=", "<>", "<", "<=", ">", ">=" };
+		return IntVariable (scope) + " " + relops[Pick (6)] + " " + IntTerm (scope);
+	}
+
+	// factor -> id | id [ expr ] | num | ( expr )
+	std::string IntTerm (Scope const &scope)
+	{
+		switch (Pick (5))
+		{
+			case 0: return std::to_string (Pick (1000));
+			case 1: return fmt::format ("a{}[{}]", Pick (arrays), Pick (array_size));
+			case 2: return "(" + IntVariable (scope) + " + " + std::to_string (Pick (10)) + ")";
+			default: return IntVariable (scope);
+		}
+	}
+
+	std::string IntVariable (Scope const &scope)
+	{
+		if (scope.in_procedure)
+		{
+			int pick = Pick (3);
+			if (pick == 0) return "x";
+			if (pick == 1) return fmt::format ("l{}", Pick (options.locals));
+		}
+		return fmt::format ("g{}", Pick (globals));
+	}
+
+	std::string RealVariable (Scope const &scope)
+	{
+		if (scope.in_procedure && Pick (3) == 0) return "y";
+		if (Pick (2) == 0) return fmt::format ("b{}[{}]", Pick (arrays), Pick (array_size) + 1);
+		return fmt::format ("r{}", Pick (real_globals));
+	}
+
+	std::string RealLiteral ()
+	{
+		// a real can't start with a 0 digit in this dialect
+		if (Pick (2) == 0) return fmt::format ("{}.{}", Pick (99) + 1, Pick (9) + 1);
+		return fmt::format ("{}.{}E{}", Pick (9) + 1, Pick (9) + 1, Pick (5));
+	}
+
+	void Line (std::string const &line)
+	{
+		text += line;
+		text.push_back ('\n');
+	}
+
+	int Pick (size_t n) { return std::uniform_int_distribution<int> (0, n - 1) (rng); }
+
+	static constexpr int real_globals = 8;
+	static constexpr int array_size = 100;
+	static constexpr size_t main_reserve = 2048; // roughly the size of the main program body
+	static constexpr size_t max_line = line_buffer_length - 12;
+
+	GeneratorOptions options;
+	std::mt19937 rng;
+	int globals;
+	int arrays;
+	int procedure_count = 0;
+	std::string text;
+};
@@ -0,0 +1,156 @@
+// Memory per procedure and scope walk cost of ParseTree's flat procedure table, against the
+// unordered_map of procedures each owning three vectors that it replaced. A generated program with
+// 10k nested procedures is parsed, then its procedures are rebuilt in each layout.
+//
+// usage: procedure_table_bench [procedures] [nesting_depth]
+
+#include <chrono>
+#include <unordered_map>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "../src/lexer.h"
+#include "../src/parser.h"
+#include "pascal_generator.h"
+
+// The layout ParseTree::procedures had before
+struct LegacyProcedure
+{
+	SymbolID name;
+	std::vector<std::pair<SymbolID, RetType>> params;
+	std::vector<std::pair<SymbolID, RetType>> locals;
+	std::vector<std::pair<SymbolID, ProcedureID>> sub_procs;
+	ProcedureID parent;
+};
+
+// Bytes currently allocated on the heap, -1 where that can't be asked for
+long HeapInUse ()
+{
+#ifdef __GLIBC__
+	return mallinfo2 ().uordblks;
+#else
+	return -1;
+#endif
+}
+
+double Seconds (std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+}
+
+// Adds a procedure and everything under it to tree the way the parser would
+void Replay (ParseTree &source, ParseTree &tree, ProcedureID id)
+{
+	for (auto [name, type] : source.Params (id))
+		tree.AddVariable (name, type, true);
+	for (auto [name, type] : source.Locals (id))
+		tree.AddVariable (name, type, false);
+	for (auto [name, sub_id] : source.SubProcedures (id))
+	{
+		tree.Push (tree.AddSubProcedure (name));
+		Replay (source, tree, sub_id);
+		tree.Pop ();
+	}
+}
+
+// From every procedure out to the program, adding up the size of the locals on the way, as the
+// semantic checks and ParserContext::Print walk scopes
+uint64_t WalkScopes (ParseTree &tree)
+{
+	uint64_t sum = 0;
+	for (ProcedureID id = 0; id < tree.ProcedureCount (); id++)
+		for (ProcedureID cur = id; cur != -1; cur = tree.GetProcedure (cur).parent)
+			for (auto &[name, type] : tree.Locals (cur))
+				sum += type.size ();
+	return sum;
+}
+
+uint64_t WalkScopes (std::unordered_map<ProcedureID, LegacyProcedure> &procedures)
+{
+	uint64_t sum = 0;
+	for (ProcedureID id = 0; id < procedures.size (); id++)
+		for (ProcedureID cur = id; cur != -1; cur = procedures.at (cur).parent)
+			for (auto &[name, type] : procedures.at (cur).locals)
+				sum += type.size ();
+	return sum;
+}
+
+template <typename Walk> void Report (char const *layout, long bytes, size_t count, long steps, Walk walk)
+{
+	const int rounds = 20;
+	uint64_t check = 0;
+	auto start = std::chrono::steady_clock::now ();
+	for (int i = 0; i < rounds; i++)
+		check += walk ();
+	double seconds = Seconds (start);
+	fmt::print ("{:<10}{:>16.1f}{:>16.2f}{:>14}\n",
+	layout,
+	static_cast<double> (bytes) / count,
+	seconds * 1e9 / (static_cast<double> (steps) * rounds),
+	check);
+}
+
+int main (int argc, char *argv[])
+{
+	GeneratorOptions options;
+	options.max_procedures = argc >= 2 ? std::stoi (argv[1]) : 10000;
+	options.nesting_depth = argc >= 3 ? std::stoi (argv[2]) : 6;
+	options.target_bytes = static_cast<size_t> (options.max_procedures) * 2048;
+	options.statements = 2;
+
+	std::string file_name = "procedure_table_bench_input.txt";
+	{
+		std::ofstream file (file_name, std::ios::out | std::ios::binary);
+		file << PascalGenerator (options).Generate ();
+	}
+
+	Logger logger ("bench_");
+	Lexer lexer (logger);
+	CompilationContext context;
+	CodeSource source (file_name);
+	TokenStream ts (lexer, context, source);
+	ParserContext ct (context, ts, logger);
+	Parser::Parse (ct);
+	ts.Finish ();
+	auto &parsed = ct.tree;
+
+	size_t count = parsed.ProcedureCount ();
+	long steps = 0; // procedures visited by one WalkScopes
+	for (ProcedureID id = 0; id < count; id++)
+		for (ProcedureID cur = id; cur != -1; cur = parsed.GetProcedure (cur).parent)
+			steps++;
+
+	long before = HeapInUse ();
+	std::unordered_map<ProcedureID, LegacyProcedure> legacy;
+	for (ProcedureID id = 0; id < count; id++)
+	{
+		auto &proc = parsed.GetProcedure (id);
+		auto &entry = legacy.emplace (id, LegacyProcedure{ proc.name, {}, {}, {}, proc.parent }).first->second;
+		for (auto &param : parsed.Params (id))
+			entry.params.push_back (param);
+		for (auto &local : parsed.Locals (id))
+			entry.locals.push_back (local);
+		for (auto &sub : parsed.SubProcedures (id))
+			entry.sub_procs.push_back (sub);
+	}
+	long legacy_bytes = HeapInUse () - before;
+
+	before = HeapInUse ();
+	ParseTree flat;
+	flat.Push (flat.SetStartProcedure (parsed.GetProcedure (0).name));
+	Replay (parsed, flat, 0);
+	flat.SubProcedures (0);
+	long flat_bytes = HeapInUse () - before;
+
+	fmt::print ("{} procedures, {} levels deep, {} scope steps per walk\n\n", count, options.nesting_depth, steps);
+	fmt::print ("{:<10}{:>16}{:>16}{:>14}\n", "layout", "bytes/proc", "ns/scope step", "check");
+	Report ("legacy", legacy_bytes, count, steps, [&] { return WalkScopes (legacy); });
+	Report ("flat", flat_bytes, count, steps, [&] { return WalkScopes (flat); });
+
+	std::remove (file_name.c_str ());
+	std::remove ("bench_listing_file.txt");
+	std::remove ("bench_token_file.txt");
+	return 0;
+}
@@ -0,0 +1,95 @@
+// Compares the old reserved word lookup (a string compare against every entry of an
+// unordered_set) with the perfect hash in reserved_word_table, over an identifier heavy corpus.
+
+#include <chrono>
+#include <random>
+
+#include "../src/lexer.h"
+
+// The lookup Lexer::CheckReseredWords used before reserved_word_table
+struct LinearReservedWords
+{
+	struct Hash
+	{
+		size_t operator() (const ReservedWord &w) const { return std::hash<std::string> () (w.word); }
+	};
+	std::unordered_set<ReservedWord, Hash> words;
+
+	LinearReservedWords ()
+	{
+		for (auto &entry : reserved_word_list)
+			words.insert (ReservedWord (std::string (entry.word), entry.GetToken ()));
+	}
+
+	std::optional<TokenInfo> Check (std::string_view s)
+	{
+		for (auto &item : words)
+		{
+			if (item == s) return item.GetToken ();
+		}
+		return {};
+	}
+};
+
+std::vector<std::string> MakeCorpus (int count)
+{
+	std::mt19937 rng (1234);
+	std::vector<std::string> corpus;
+	corpus.reserve (count);
+	for (int i = 0; i < count; i++)
+	{
+		// roughly a third reserved words, like statement heavy code
+		if (rng () % 3 == 0)
+		{
+			corpus.push_back (std::string (reserved_word_list[rng () % std::size (reserved_word_list)].word));
+		}
+		else
+		{
+			std::string id;
+			int len = 1 + rng () % identifier_length;
+			for (int j = 0; j < len; j++)
+				id.push_back (j == 0 ? 'a' + rng () % 26 : "abcdefghijklmnopqrstuvwxyz0123456789"[rng () % 36]);
+			corpus.push_back (id);
+		}
+	}
+	return corpus;
+}
+
+template <typename F> double TimeLookups (std::vector<std::string> const &corpus, int rounds, int &found, F &&lookup)
+{
+	found = 0;
+	auto start = std::chrono::high_resolution_clock::now ();
+	for (int r = 0; r < rounds; r++)
+		for (auto &id : corpus)
+			if (lookup (id).has_value ()) found++;
+	auto end = std::chrono::high_resolution_clock::now ();
+	return std::chrono::duration<double> (end - start).count ();
+}
+
+int main (int argc, char *argv[])
+{
+	int count = 1000000;
+	int rounds = 5;
+	if (argc >= 2) count = std::stoi (argv[1]);
+
+	auto corpus = MakeCorpus (count);
+	LinearReservedWords linear;
+
+	int linear_found = 0, hashed_found = 0;
+	double linear_time = TimeLookups (corpus, rounds, linear_found, [&] (std::string const &s) {
+		return linear.Check (s);
+	});
+	double hashed_time = TimeLookups (corpus, rounds, hashed_found, [&] (std::string const &s) {
+		auto entry = reserved_word_table.Find (s);
+		return entry != nullptr ? std::optional<TokenInfo> (entry->GetToken ()) : std::nullopt;
+	});
+
+	if (linear_found != hashed_found)
+		fmt::print ("Lookups disagree! linear found {}, hashed found {}\n", linear_found, hashed_found);
+
+	double lookups = static_cast<double> (count) * rounds;
+	fmt::print ("{:<10}{:>14}{:>16}\n", "lookup", "ns/lookup", "Mlookups/sec");
+	fmt::print ("{:<10}{:>14.2f}{:>16.2f}\n", "linear", linear_time * 1e9 / lookups, lookups / linear_time / 1e6);
+	fmt::print ("{:<10}{:>14.2f}{:>16.2f}\n", "hashed", hashed_time * 1e9 / lookups, lookups / hashed_time / 1e6);
+	return 0;
+}
@@ -0,0 +1,97 @@
+// Compares loading a source file the way FileReader used to (std::getline into a
+// vector<std::string>, which Lexer::GetTokens then copied again) against CodeSource, which maps
+// the file and hands out line views.
+
+#include <chrono>
+
+#include "../src/common.h"
+
+// Resident anonymous (heap) and file backed memory in kB, from /proc/self/status
+struct Rss
+{
+	long anon = -1;
+	long file = -1;
+};
+
+Rss ReadRss ()
+{
+	Rss rss;
+	std::ifstream status ("/proc/self/status");
+	std::string key;
+	long value;
+	while (status >> key)
+	{
+		if (key == "RssAnon:" && status >> value) rss.anon = value;
+		if (key == "RssFile:" && status >> value) rss.file = value;
+	}
+	return rss;
+}
+
+std::vector<std::string> GetlineLoad (std::string const &file_name)
+{
+	std::vector<std::string> lines;
+	std::fstream inFile (file_name, std::ios::in);
+	while (inFile.good ())
+	{
+		std::string line;
+		std::getline (inFile, line, '\n');
+		lines.push_back (line);
+	}
+	lines.back ().push_back ('$');
+	return lines;
+}
+
+void WriteInput (std::string const &file_name, size_t megabytes)
+{
+	std::ofstream out (file_name, std::ios::out | std::ios::binary);
+	std::string body = "\tx := x + 1 * (y - 12345) div 7;\n"
+	                   "\tif x > 100 then y := y - 1 else y := y + 1;\n"
+	                   "\tcall proc (a, b[3], 1.25E2);\n";
+	out << "program example(input, output);\nbegin\n";
+	for (size_t written = 0; written < megabytes * 1024 * 1024; written += body.size ())
+		out << body;
+	out << "\tx := 0\nend.\n";
+}
+
+double Seconds (std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double> (std::chrono::high_resolution_clock::now () - start).count ();
+}
+
+int main (int argc, char *argv[])
+{
+	size_t megabytes = argc >= 2 ? std::stoul (argv[1]) : 100;
+	std::string file_name = argc >= 3 ? argv[2] : "source_load_bench_input.txt";
+	WriteInput (file_name, megabytes);
+
+	fmt::print ("{:<10}{:>12}{:>12}{:>16}{:>16}\n", "loader", "lines", "seconds", "anon RSS (kB)", "file RSS (kB)");
+	{
+		auto before = ReadRss ();
+		auto start = std::chrono::high_resolution_clock::now ();
+		CodeSource source (file_name);
+		double time = Seconds (start);
+		auto after = ReadRss ();
+		fmt::print ("{:<10}{:>12}{:>12.3f}{:>16}{:>16}\n",
+		"mapped",
+		source.lines.size (),
+		time,
+		after.anon - before.anon,
+		after.file - before.file);
+	}
+	{
+		auto before = ReadRss ();
+		auto start = std::chrono::high_resolution_clock::now ();
+		auto lines = GetlineLoad (file_name);
+		auto lexer_copy = lines; // what GetTokens used to do with the source
+		double time = Seconds (start);
+		auto after = ReadRss ();
+		fmt::print ("{:<10}{:>12}{:>12.3f}{:>16}{:>16}\n",
+		"getline",
+		lexer_copy.size (),
+		time,
+		after.anon - before.anon,
+		after.file - before.file);
+	}
+	std::remove (file_name.c_str ());
+	return 0;
+}
@@ -0,0 +1,131 @@
+// Compares the packed 16 byte TokenInfo against the variant based token it replaced, which carried
+// a std::variant<..., LexerError> (and with it a std::string) in every token. Both are filled from
+// the same lexed input, then copied into a fresh vector and scanned the way the parser reads them.
+
+#include <chrono>
+
+#include "../src/lexer.h"
+
+using LegacyAttribute =
+std::variant<NoAttrib, AddOpEnum, MulOpEnum, SignOpEnum, RelOpEnum, StandardTypeEnum, NumType, SymbolType, StringLiteral, LexerError>;
+
+struct LegacyTokenInfo
+{
+	TT type;
+	LegacyAttribute attrib;
+	int line_location = -1;
+	int column_location = -1;
+};
+
+LegacyTokenInfo ToLegacy (TokenInfo const &t, std::vector<LexerError> const &lexerErrors)
+{
+	LegacyTokenInfo legacy{ t.type, NoAttrib (), t.line_location, t.column_location };
+	switch (t.kind)
+	{
+		case AttribKind::add_op: legacy.attrib = t.AddOp (); break;
+		case AttribKind::mul_op: legacy.attrib = t.MulOp (); break;
+		case AttribKind::sign_op: legacy.attrib = t.SignOp (); break;
+		case AttribKind::rel_op: legacy.attrib = t.RelOp (); break;
+		case AttribKind::standard_type: legacy.attrib = t.StandardType (); break;
+		case AttribKind::num:
+			legacy.attrib = t.IsReal () ? NumType (t.RealValue ()) : NumType (t.IntValue ());
+			break;
+		case AttribKind::symbol: legacy.attrib = SymbolType (t.value.i); break;
+		case AttribKind::string_literal: legacy.attrib = StringLiteral (t.value.i); break;
+		case AttribKind::lexer_error: legacy.attrib = lexerErrors.at (t.Error ().index); break;
+		default: break;
+	}
+	return legacy;
+}
+
+// What the parser pulls out of a token: its type, symbol index and integer value
+long Scan (std::vector<TokenInfo> const &tokens)
+{
+	long sum = 0;
+	for (auto &t : tokens)
+	{
+		sum += static_cast<int> (t.type);
+		if (t.HasSymbol ()) sum += t.Symbol ();
+		if (t.IsInt ()) sum += t.IntValue ();
+	}
+	return sum;
+}
+
+long Scan (std::vector<LegacyTokenInfo> const &tokens)
+{
+	long sum = 0;
+	for (auto &t : tokens)
+	{
+		sum += static_cast<int> (t.type);
+		if (auto symbol = std::get_if<SymbolType> (&t.attrib)) sum += symbol->loc;
+		if (auto num = std::get_if<NumType> (&t.attrib))
+			if (num->val.index () == 0) sum += std::get<int> (num->val);
+	}
+	return sum;
+}
+
+void WriteInput (std::string const &file_name, int statements)
+{
+	std::ofstream out (file_name, std::ios::out | std::ios::binary);
+	out << "program example(input, output);\nbegin\n";
+	for (int i = 0; i < statements; i++)
+	{
+		out << "\tx" << i % 97 << " := x + " << i << " * (y - 12345) div 7;\n";
+		out << "\tif x > 1.5E2 then y := y - 1 else y := y + 0.25;\n";
+	}
+	out << "\tx := 0\nend.\n";
+}
+
+double Seconds (std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double> (std::chrono::high_resolution_clock::now () - start).count ();
+}
+
+template <typename Token> void CopyAndScan (std::string const &name, std::vector<Token> const &source, int rounds)
+{
+	long check = 0;
+	double copy_time = 0, scan_time = 0;
+	for (int round = 0; round < rounds; round++)
+	{
+		auto start = std::chrono::high_resolution_clock::now ();
+		std::vector<Token> tokens;
+		for (auto &t : source)
+			tokens.push_back (t);
+		copy_time += Seconds (start);
+
+		start = std::chrono::high_resolution_clock::now ();
+		check += Scan (tokens);
+		scan_time += Seconds (start);
+	}
+	double count = static_cast<double> (source.size ()) * rounds;
+	fmt::print ("{:<10}{:>14}{:>18.0f}{:>18.0f}{:>14}\n", name, sizeof (Token), count / copy_time, count / scan_time, check);
+}
+
+int main (int argc, char *argv[])
+{
+	int statements = argc >= 2 ? std::stoi (argv[1]) : 200000;
+	int rounds = argc >= 3 ? std::stoi (argv[2]) : 5;
+	std::string file_name = "token_bench_input.txt";
+	WriteInput (file_name, statements);
+
+	Logger logger;
+	Lexer lexer (logger);
+	CompilationContext context;
+	CodeSource source (file_name);
+
+	auto start = std::chrono::high_resolution_clock::now ();
+	auto tokens = lexer.GetTokens (source, context);
+	double lex_time = Seconds (start);
+	fmt::print ("lexed {} tokens at {:.0f} tokens/s\n\n", tokens.size (), tokens.size () / lex_time);
+
+	std::vector<LegacyTokenInfo> legacy;
+	for (auto &t : tokens)
+		legacy.push_back (ToLegacy (t, context.lexerErrors));
+
+	fmt::print ("{:<10}{:>14}{:>18}{:>18}{:>14}\n", "token", "bytes/token", "copy tokens/s", "scan tokens/s", "check");
+	CopyAndScan ("legacy", legacy, rounds);
+	CopyAndScan ("packed", tokens, rounds);
+
+	std::remove (file_name.c_str ());
+	return 0;
+}
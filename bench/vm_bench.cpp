@@ -0,0 +1,282 @@
+// Bytecode VM throughput on small compute loops, each against the same loop in C++ compiled with
+// the bench. The programs are parsed and lowered once; only Run is timed.
+//
+// usage: vm_bench [scale]
+// scale multiplies the work in every program, 1 by default.
+
+#include <chrono>
+#include <cstdio>
+
+#include "../src/bytecode.h"
+#include "../src/lexer.h"
+#include "../src/parser.h"
+#include "../src/vm.h"
+
+double Seconds (std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+}
+
+// gcd of every pair up to n by recursive calls, as in the test programs
+constexpr const char *gcd_recursive = R"(program bench(input, output);
+	var r: integer;
+	var sum: integer;
+	var i: integer;
+	var j: integer;
+	procedure gcd(a: integer; b: integer);
+	begin
+		if b = 0 then r := a
+		else call gcd(b, a mod b)
+	end;
+begin
+	sum := 0;
+	i := 1;
+	while i <= {0} do
+	begin
+		j := 1;
+		while j <= {0} do
+		begin
+			call gcd(i, j);
+			sum := sum + r;
+			j := j + 1
+		end;
+		i := i + 1
+	end
+end.
+)";
+
+int64_t GcdRecursive (int a, int b) { return b == 0 ? a : GcdRecursive (b, a % b); }
+
+constexpr const char *gcd_loop = R"(program bench(input, output);
+	var sum: integer;
+	var i: integer;
+	var j: integer;
+	var a: integer;
+	var b: integer;
+	var t: integer;
+begin
+	sum := 0;
+	i := 1;
+	while i <= {0} do
+	begin
+		j := 1;
+		while j <= {0} do
+		begin
+			a := i;
+			b := j;
+			while b <> 0 do
+			begin
+				t := a mod b;
+				a := b;
+				b := t
+			end;
+			sum := sum + a;
+			j := j + 1
+		end;
+		i := i + 1
+	end
+end.
+)";
+
+constexpr const char *real_loop = R"(program bench(input, output);
+	var sum: real;
+	var x: real;
+	var i: integer;
+begin
+	sum := .0;
+	x := .0;
+	i := 0;
+	while i < {0} do
+	begin
+		sum := sum + x * x / (x + 1.0);
+		x := x + .001;
+		i := i + 1
+	end
+end.
+)";
+
+constexpr const char *sieve = R"(program bench(input, output);
+	var sum: integer;
+	var s: array [2 .. 60000] of integer;
+	var n: integer;
+	var i: integer;
+	var j: integer;
+	var k: integer;
+begin
+	sum := 0;
+	n := 60000;
+	k := 0;
+	while k < {0} do
+	begin
+		i := 2;
+		while i <= n do
+		begin
+			s[i] := 0;
+			i := i + 1
+		end;
+		i := 2;
+		while i <= n do
+		begin
+			if s[i] = 0 then
+			begin
+				sum := sum + 1;
+				j := i + i;
+				while j <= n do
+				begin
+					s[j] := 1;
+					j := j + i
+				end
+			end;
+			i := i + 1
+		end;
+		k := k + 1
+	end
+end.
+)";
+
+struct Workload
+{
+	char const *name;
+	char const *program;
+	int n;
+	double (*native) (int n);
+};
+
+double NativeGcdRecursive (int n)
+{
+	int32_t sum = 0;
+	for (int i = 1; i <= n; i++)
+		for (int j = 1; j <= n; j++)
+			sum += GcdRecursive (i, j);
+	return sum;
+}
+
+double NativeGcdLoop (int n)
+{
+	int32_t sum = 0;
+	for (int i = 1; i <= n; i++)
+		for (int j = 1; j <= n; j++)
+		{
+			int a = i, b = j;
+			while (b != 0)
+			{
+				int t = a % b;
+				a = b;
+				b = t;
+			}
+			sum += a;
+		}
+	return sum;
+}
+
+double NativeRealLoop (int n)
+{
+	double sum = 0, x = 0;
+	for (int i = 0; i < n; i++)
+	{
+		sum += x * x / (x + 1.0);
+		x += 0.001;
+	}
+	return sum;
+}
+
+double NativeSieve (int n)
+{
+	std::vector<int32_t> s (60001);
+	int32_t sum = 0;
+	for (int k = 0; k < n; k++)
+	{
+		std::fill (s.begin (), s.end (), 0);
+		for (int i = 2; i <= 60000; i++)
+			if (s[i] == 0)
+			{
+				sum++;
+				for (int j = i + i; j <= 60000; j += i)
+					s[j] = 1;
+			}
+	}
+	return sum;
+}
+
+// Best of a few runs of the program, with sum read back out of the VM
+double RunProgram (std::string const &text, double &sum)
+{
+	std::string file_name = "vm_bench_input.txt";
+	{
+		std::ofstream file (file_name, std::ios::out | std::ios::binary);
+		file << text;
+	}
+	Logger logger ("bench_");
+	Lexer lexer (logger);
+	CompilationContext context;
+	CodeSource source (file_name);
+	TokenStream ts (lexer, context, source);
+	ParserContext ct (context, ts, logger);
+	Parser::Parse (ct);
+	ts.Finish ();
+	std::remove (file_name.c_str ());
+
+	std::string error;
+	auto bytecode = CompileBytecode (context.ast, error);
+	if (logger.ErrorCount () > 0 || !bytecode)
+	{
+		fmt::print ("the program did not compile: {}\n", error);
+		std::exit (1);
+	}
+	VM vm (*bytecode);
+	double best = 1e9;
+	for (int round = 0; round < 3; round++)
+	{
+		auto start = std::chrono::steady_clock::now ();
+		RunStatus status = vm.Run ();
+		best = std::min (best, Seconds (start));
+		if (status != RunStatus::ok)
+		{
+			fmt::print ("line {}: {}\n", vm.ErrorLine (), run_status_messages[static_cast<size_t> (status)]);
+			std::exit (1);
+		}
+	}
+	for (auto &global : bytecode->globals)
+		if (context.symbolTable.SymbolView (global.name) == "sum")
+			sum = global.type == RT_real ? vm.Global (global.slot).r : vm.Global (global.slot).i;
+	return best;
+}
+
+int main (int argc, char *argv[])
+{
+	int scale = argc >= 2 ? std::stoi (argv[1]) : 1;
+	Workload workloads[] = {
+		{ "gcd_recursive", gcd_recursive, 600, NativeGcdRecursive },
+		{ "gcd_loop", gcd_loop, 600, NativeGcdLoop },
+		{ "real_loop", real_loop, 5000000, NativeRealLoop },
+		{ "sieve", sieve, 20, NativeSieve },
+	};
+
+	fmt::print ("{:<16}{:>12}{:>12}{:>10}{:>20}{:>20}\n", "program", "vm ms", "native ms", "ratio", "vm sum", "native sum");
+	for (auto &w : workloads)
+	{
+		int n = w.n * scale;
+		double vm_sum = 0;
+		double vm_seconds = RunProgram (fmt::format (w.program, n), vm_sum);
+
+		double native_sum = 0;
+		double native_seconds = 1e9;
+		for (int round = 0; round < 3; round++)
+		{
+			auto start = std::chrono::steady_clock::now ();
+			native_sum = w.native (n);
+			native_seconds = std::min (native_seconds, Seconds (start));
+		}
+		fmt::print ("{:<16}{:>12.2f}{:>12.2f}{:>10.1f}{:>20}{:>20}\n",
+		w.name,
+		vm_seconds * 1e3,
+		native_seconds * 1e3,
+		vm_seconds / native_seconds,
+		vm_sum,
+		native_sum);
+	}
+
+	std::remove ("bench_listing_file.txt");
+	std::remove ("bench_token_file.txt");
+	return 0;
+}
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct RetType
+{
+	RetType (const uint32_t cat, uint32_t size) { data = (size << 8) | (cat); }
+	RetType (const uint32_t t) { data = t; }
+
+	uint32_t data;
+	operator uint32_t () const { return data; }
+	std::string to_string () const
+	{
+		if (data == 0) return "error";
+		if (data == 1) return "none";
+		if (data == 2) return "bool";
+		if (data == 3) return "int";
+		if (data == 4) return "real";
+		if ((data & 255) == 5)
+		{
+			int size = data >> 8;
+			return "array of ints with size of " + std::to_string (size);
+		}
+		if ((data & 255) == 6)
+		{
+			int size = data >> 8;
+			return "array of reals with size of " + std::to_string (size);
+		}
+		return "NOT A TYPE!";
+	}
+	uint32_t size () const
+	{
+		if (data == 3) return 4;
+		if (data == 4) return 8;
+		if ((data & 255) == 5) { return 4 * (data >> 8); }
+		if ((data & 255) == 6) { return 8 * (data >> 8); }
+		return 0;
+	}
+};
+
+// using RetType = std::variant<Type_bool, Type_int, Type_real, Type_arr_int, Type_arr_real, Type_none, Type_err>;
+
+constexpr uint32_t RT_err = 0;
+constexpr uint32_t RT_none = 1;
+constexpr uint32_t RT_bool = 2;
+constexpr uint32_t RT_int = 3;
+constexpr uint32_t RT_real = 4;
+constexpr uint32_t RT_arr_int = 5;
+constexpr uint32_t RT_arr_real = 6;
+inline bool IsArrInt (RetType rt) { return (rt.data & 255) == RT_arr_int; }
+
+inline bool IsArrReal (RetType rt) { return (rt.data & 255) == RT_arr_real; }
+inline bool IsArrayType (RetType rt) { return IsArrInt (rt) || IsArrReal (rt); }
+inline uint32_t ArraySize (RetType rt) { return rt.data >> 8; }
+
+using ProcedureID = int;
+using SymbolID = int;
+
+// Where a run of entries sits in a pool
+struct PoolSpan
+{
+	uint32_t offset = 0;
+	uint32_t length = 0;
+};
+
+// Read only view of a PoolSpan
+template <typename T> class PoolView
+{
+	public:
+	PoolView (std::vector<T> const &pool, PoolSpan span)
+	: first (pool.data () + span.offset), last (pool.data () + span.offset + span.length)
+	{
+	}
+
+	T const *begin () const { return first; }
+	T const *end () const { return last; }
+	size_t size () const { return last - first; }
+	T const &operator[] (size_t i) const { return first[i]; }
+
+	private:
+	T const *first;
+	T const *last;
+};
+
+using NodeID = uint32_t;
+constexpr NodeID no_node = UINT32_MAX;
+
+// What each kind keeps in Ast::Symbol, Ast::Value and its children, in order
+enum class NodeKind : uint8_t
+{
+	program,      // symbol: name, value: ProcedureID; declarations, procedures, compound
+	procedure,    // symbol: name, value: ProcedureID or -1 if not unique; as program
+	declaration,  // symbol: name, value: array low bound, op: 1 for a param
+	compound,     // statements
+	assign,       // variable or index, expression
+	if_then,      // condition, then statement, else statement if there is one
+	while_do,     // condition, statement
+	call,         // symbol: callee, value: callee procedure node or no_node; arguments
+	variable,     // symbol: name, value: declaration node or no_node
+	index,        // variable, expression
+	int_literal,  // value
+	real_literal, // value: bits of the float
+	unary,        // op: UnaryOp; operand
+	binary,       // op: BinaryOp; left, right
+	error         // stands in for what a syntax error left out
+};
+
+enum class UnaryOp : uint8_t
+{
+	plus,
+	minus,
+	t_not
+};
+
+enum class BinaryOp : uint8_t
+{
+	add,
+	sub,
+	t_or,
+	mul,
+	div, // '/' and div, both truncate for ints
+	mod,
+	t_and,
+	equal,
+	not_equal,
+	less_than,
+	less_than_or_equal,
+	greater_than,
+	greater_than_or_equal
+};
+
+// The parsed program as pools of node fields indexed by NodeID, one entry per node in each. A
+// node's children are a run of NodeIDs in the children pool; the parser builds bottom up, so a
+// node's children are all added before it is given them.
+class Ast
+{
+	public:
+	NodeID Add (NodeKind kind, RetType type, SymbolID symbol, int32_t value, int line, uint8_t op = 0)
+	{
+		kinds.push_back (kind);
+		ops.push_back (op);
+		types.push_back (type);
+		symbols.push_back (symbol);
+		values.push_back (value);
+		lines.push_back (line);
+		child_spans.emplace_back ();
+		return static_cast<NodeID> (kinds.size () - 1);
+	}
+
+	// Room for nodes without growing, the parser makes about one node per four bytes of source
+	void Reserve (size_t nodes)
+	{
+		kinds.reserve (nodes);
+		ops.reserve (nodes);
+		types.reserve (nodes);
+		symbols.reserve (nodes);
+		values.reserve (nodes);
+		lines.reserve (nodes);
+		child_spans.reserve (nodes);
+		children.reserve (nodes);
+	}
+
+	void SetChildren (NodeID node, NodeID const *first, NodeID const *last)
+	{
+		child_spans[node] = PoolSpan{ static_cast<uint32_t> (children.size ()), static_cast<uint32_t> (last - first) };
+		children.insert (children.end (), first, last);
+	}
+
+	void SetRoot (NodeID node) { root = node; }
+	NodeID Root () const { return root; }
+	size_t Size () const { return kinds.size (); }
+
+	NodeKind Kind (NodeID n) const { return kinds[n]; }
+	RetType Type (NodeID n) const { return types[n]; }
+	SymbolID Symbol (NodeID n) const { return symbols[n]; }
+	int Line (NodeID n) const { return lines[n]; }
+	PoolView<NodeID> Children (NodeID n) const { return PoolView<NodeID> (children, child_spans[n]); }
+	NodeID Child (NodeID n, size_t i) const { return children[child_spans[n].offset + i]; }
+
+	UnaryOp UnaryOperator (NodeID n) const { return static_cast<UnaryOp> (ops[n]); }
+	BinaryOp BinaryOperator (NodeID n) const { return static_cast<BinaryOp> (ops[n]); }
+	bool IsParam (NodeID n) const { return ops[n] != 0; }
+
+	int32_t IntValue (NodeID n) const { return values[n]; }
+	float RealValue (NodeID n) const
+	{
+		float f;
+		std::memcpy (&f, &values[n], sizeof (f));
+		return f;
+	}
+	ProcedureID Procedure (NodeID n) const { return values[n]; }
+	int32_t LowBound (NodeID n) const { return values[n]; }
+	NodeID Declaration (NodeID n) const { return static_cast<NodeID> (values[n]); }
+	NodeID Callee (NodeID n) const { return static_cast<NodeID> (values[n]); }
+
+	// Calls visit on n and, while visit returns true, on its children, depth first in order
+	template <typename Visitor> void Walk (NodeID n, Visitor &&visit) const
+	{
+		if (!visit (n)) return;
+		for (NodeID child : Children (n))
+			Walk (child, visit);
+	}
+
+	// The first node, depth first, that a backend can't lower: an error node, a node the checker
+	// typed as an error, or a name that never resolved. no_node for a program that checked clean.
+	NodeID FindUnresolved () const
+	{
+		NodeID found = no_node;
+		if (root == no_node) return found;
+		Walk (root, [&] (NodeID n) {
+			if (found != no_node) return false;
+			bool unresolved = kinds[n] == NodeKind::error || types[n] == RT_err
+			                  || (kinds[n] == NodeKind::call && Callee (n) == no_node)
+			                  || (kinds[n] == NodeKind::variable && Declaration (n) == no_node);
+			if (unresolved) found = n;
+			return !unresolved;
+		});
+		return found;
+	}
+
+	static int32_t RealBits (float f)
+	{
+		int32_t bits;
+		std::memcpy (&bits, &f, sizeof (bits));
+		return bits;
+	}
+
+	private:
+	std::vector<NodeKind> kinds;
+	std::vector<uint8_t> ops;
+	std::vector<RetType> types;
+	std::vector<SymbolID> symbols;
+	std::vector<int32_t> values;
+	std::vector<int> lines;
+	std::vector<PoolSpan> child_spans;
+	std::vector<NodeID> children;
+	NodeID root = no_node;
+};
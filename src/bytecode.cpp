@@ -0,0 +1,451 @@
+#include "bytecode.h"
+
+#include <limits>
+
+namespace
+{
+
+constexpr uint32_t max_register = std::numeric_limits<uint16_t>::max ();
+
+// Where a declaration's value lives
+struct VariableSlot
+{
+	uint16_t level = 0;
+	uint16_t slot = 0;
+	uint32_t size = 0; // slots, 0 for the program's params which hold nothing
+	int32_t low = 0;
+	uint32_t array = no_array; // index into Bytecode::arrays once an array is used
+
+	static constexpr uint32_t no_array = UINT32_MAX;
+};
+
+class BytecodeCompiler
+{
+	public:
+	BytecodeCompiler (Ast const &ast, Bytecode &out)
+	: ast (ast), out (out), variables (ast.Size ()), procedure_index (ast.Size (), -1)
+	{
+	}
+
+	bool Compile (std::string &error_out)
+	{
+		NodeID root = ast.Root ();
+		if (root == no_node) Fail ("there is no program");
+		else if (NodeID bad = ast.FindUnresolved (); bad != no_node)
+			Fail (fmt::format ("line {}: the program has errors", ast.Line (bad)));
+		if (error.empty ()) Layout (root, 0);
+		if (error.empty ()) CompileProcedure (root);
+		if (error.empty ())
+			for (NodeID child : ast.Children (root))
+				if (ast.Kind (child) == NodeKind::declaration && variables[child].size > 0)
+				{
+					auto &v = variables[child];
+					out.globals.push_back (GlobalVariable{ ast.Symbol (child), ast.Type (child), v.slot, v.low });
+				}
+		error_out = error;
+		return error.empty ();
+	}
+
+	private:
+	void Fail (std::string message)
+	{
+		if (error.empty ()) error = std::move (message);
+	}
+
+	// Gives procedures their index and every declaration a slot in its procedure's frame, params
+	// first as the caller puts the arguments there
+	void Layout (NodeID proc, uint16_t level)
+	{
+		procedure_index[proc] = out.procedures.size ();
+		out.procedures.push_back (BytecodeProcedure{ ast.Symbol (proc), 0, level, 0, 0 });
+		auto index = out.procedures.size () - 1;
+
+		uint32_t next = 0;
+		for (NodeID child : ast.Children (proc))
+		{
+			if (ast.Kind (child) == NodeKind::declaration)
+			{
+				RetType type = ast.Type (child);
+				auto &v = variables[child];
+				v.level = level;
+				v.slot = next;
+				v.size = IsArrayType (type) ? ArraySize (type) : type == RT_none ? 0 : 1;
+				v.low = ast.LowBound (child);
+				next += v.size;
+				if (next > max_register) Fail (fmt::format ("line {}: the variables don't fit in a frame", ast.Line (child)));
+				if (ast.IsParam (child)) out.procedures[index].param_slots = next;
+			}
+			else if (ast.Kind (child) == NodeKind::procedure)
+				Layout (child, level + 1);
+		}
+		if (locals_end.size () <= index) locals_end.resize (index + 1);
+		locals_end[index] = next;
+	}
+
+	void CompileProcedure (NodeID proc)
+	{
+		int index = procedure_index[proc];
+		level = out.procedures[index].level;
+		temp_top = max_temp = locals_end[index];
+		out.procedures[index].entry = out.code.size ();
+
+		for (NodeID child : ast.Children (proc))
+			if (ast.Kind (child) == NodeKind::compound) Statement (child);
+		line = ast.Line (proc);
+		Emit (index == 0 ? Op::halt : Op::ret);
+		out.procedures[index].frame_size = max_temp;
+
+		for (NodeID child : ast.Children (proc))
+			if (ast.Kind (child) == NodeKind::procedure) CompileProcedure (child);
+	}
+
+	size_t Emit (Op op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0)
+	{
+		Instruction instruction{ op, static_cast<uint16_t> (a), static_cast<uint16_t> (b), static_cast<uint16_t> (c) };
+		out.code.push_back (instruction);
+		out.lines.push_back (line);
+		return out.code.size () - 1;
+	}
+
+	size_t EmitBC (Op op, uint32_t a, uint32_t bc)
+	{
+		size_t at = Emit (op, a);
+		out.code[at].SetBC (bc);
+		return at;
+	}
+
+	void PatchTarget (size_t jump, size_t target) { out.code[jump].SetBC (target); }
+
+	uint16_t NewTemp ()
+	{
+		if (temp_top >= max_register)
+		{
+			Fail (fmt::format ("line {}: the expression needs too many registers", line));
+			return 0;
+		}
+		max_temp = std::max (max_temp, ++temp_top);
+		return temp_top - 1;
+	}
+
+	uint32_t ArrayRefIndex (NodeID decl)
+	{
+		auto &v = variables[decl];
+		if (v.array == VariableSlot::no_array)
+		{
+			v.array = out.arrays.size ();
+			out.arrays.push_back (ArrayRef{ v.level, v.slot, v.low, v.size });
+			if (out.arrays.size () > max_register) Fail ("too many arrays");
+		}
+		return v.array;
+	}
+
+	// A current frame variable is its own register, everything else is evaluated into a temporary
+	uint16_t Operand (NodeID n)
+	{
+		if (ast.Kind (n) == NodeKind::variable)
+		{
+			auto &v = variables[ast.Declaration (n)];
+			if (v.level == level) return v.slot;
+		}
+		uint16_t temp = NewTemp ();
+		Into (n, temp);
+		return temp;
+	}
+
+	void Into (NodeID n, uint16_t dst)
+	{
+		line = ast.Line (n);
+		uint32_t mark = temp_top;
+		switch (ast.Kind (n))
+		{
+			case (NodeKind::int_literal):
+				EmitBC (Op::load_int, dst, static_cast<uint32_t> (ast.IntValue (n)));
+				break;
+			case (NodeKind::real_literal):
+				// the lexer keeps a float, its shortest spelling gives back the literal as written
+				out.reals.push_back (std::stod (fmt::format ("{}", ast.RealValue (n))));
+				EmitBC (Op::load_real, dst, out.reals.size () - 1);
+				break;
+			case (NodeKind::variable):
+			{
+				auto &v = variables[ast.Declaration (n)];
+				if (v.level == level)
+					Emit (Op::move, dst, v.slot);
+				else
+					Emit (Op::load_outer, dst, v.level, v.slot);
+				break;
+			}
+			case (NodeKind::index):
+			{
+				uint32_t array = ArrayRefIndex (ast.Declaration (ast.Child (n, 0)));
+				uint16_t index = Operand (ast.Child (n, 1));
+				Emit (Op::load_elem, dst, array, index);
+				break;
+			}
+			case (NodeKind::unary):
+			{
+				NodeID operand = ast.Child (n, 0);
+				if (ast.UnaryOperator (n) == UnaryOp::plus)
+					Into (operand, dst);
+				else if (ast.UnaryOperator (n) == UnaryOp::t_not)
+					Emit (Op::t_not, dst, Operand (operand));
+				else
+					Emit (ast.Type (n) == RT_real ? Op::neg_r : Op::neg_i, dst, Operand (operand));
+				break;
+			}
+			case (NodeKind::binary):
+			{
+				NodeID left = ast.Child (n, 0);
+				uint16_t l = Operand (left);
+				uint16_t r = Operand (ast.Child (n, 1));
+				line = ast.Line (n);
+				Emit (BinaryOpcode (ast.BinaryOperator (n), ast.Type (left) == RT_real), dst, l, r);
+				break;
+			}
+			default: Fail (fmt::format ("line {}: not an expression", ast.Line (n)));
+		}
+		temp_top = mark;
+	}
+
+	static Op BinaryOpcode (BinaryOp op, bool real)
+	{
+		switch (op)
+		{
+			case (BinaryOp::add): return real ? Op::add_r : Op::add_i;
+			case (BinaryOp::sub): return real ? Op::sub_r : Op::sub_i;
+			case (BinaryOp::mul): return real ? Op::mul_r : Op::mul_i;
+			case (BinaryOp::div): return real ? Op::div_r : Op::div_i;
+			case (BinaryOp::mod): return Op::mod_i;
+			case (BinaryOp::t_and): return Op::t_and;
+			case (BinaryOp::t_or): return Op::t_or;
+			case (BinaryOp::equal): return real ? Op::eq_r : Op::eq_i;
+			case (BinaryOp::not_equal): return real ? Op::ne_r : Op::ne_i;
+			case (BinaryOp::less_than): return real ? Op::lt_r : Op::lt_i;
+			case (BinaryOp::less_than_or_equal): return real ? Op::le_r : Op::le_i;
+			case (BinaryOp::greater_than): return real ? Op::gt_r : Op::gt_i;
+			default: return real ? Op::ge_r : Op::ge_i;
+		}
+	}
+
+	static bool IsComparison (BinaryOp op) { return op >= BinaryOp::equal; }
+
+	// Jumps back to target when cond holds. Int comparisons jump in the same instruction when
+	// the offset fits in c.
+	void JumpBackIf (NodeID cond, size_t target)
+	{
+		uint32_t mark = temp_top;
+		line = ast.Line (cond);
+		if (ast.Kind (cond) == NodeKind::binary && IsComparison (ast.BinaryOperator (cond))
+		    && ast.Type (ast.Child (cond, 0)) == RT_int)
+		{
+			uint16_t l = Operand (ast.Child (cond, 0));
+			uint16_t r = Operand (ast.Child (cond, 1));
+			int64_t offset = static_cast<int64_t> (target) - static_cast<int64_t> (out.code.size ());
+			if (offset >= std::numeric_limits<int16_t>::min ())
+			{
+				auto op = static_cast<uint8_t> (ast.BinaryOperator (cond)) - static_cast<uint8_t> (BinaryOp::equal);
+				Emit (static_cast<Op> (static_cast<uint8_t> (Op::jump_eq_i) + op), l, r, static_cast<uint16_t> (offset));
+			}
+			else
+			{
+				uint16_t t = NewTemp ();
+				Emit (BinaryOpcode (ast.BinaryOperator (cond), false), t, l, r);
+				EmitBC (Op::jump_if, t, target);
+			}
+		}
+		else
+			EmitBC (Op::jump_if, Operand (cond), target);
+		temp_top = mark;
+	}
+
+	void Statement (NodeID n)
+	{
+		line = ast.Line (n);
+		switch (ast.Kind (n))
+		{
+			case (NodeKind::compound):
+				for (NodeID child : ast.Children (n))
+					Statement (child);
+				break;
+			case (NodeKind::assign): Assign (ast.Child (n, 0), ast.Child (n, 1)); break;
+			case (NodeKind::if_then):
+			{
+				uint32_t mark = temp_top;
+				size_t skip_then = EmitBC (Op::jump_unless, Operand (ast.Child (n, 0)), 0);
+				temp_top = mark;
+				Statement (ast.Child (n, 1));
+				if (ast.Children (n).size () == 3)
+				{
+					size_t skip_else = EmitBC (Op::jump, 0, 0);
+					PatchTarget (skip_then, out.code.size ());
+					Statement (ast.Child (n, 2));
+					PatchTarget (skip_else, out.code.size ());
+				}
+				else
+					PatchTarget (skip_then, out.code.size ());
+				break;
+			}
+			case (NodeKind::while_do):
+			{
+				// the condition goes after the body so each iteration takes one jump
+				size_t to_condition = EmitBC (Op::jump, 0, 0);
+				size_t body = out.code.size ();
+				Statement (ast.Child (n, 1));
+				PatchTarget (to_condition, out.code.size ());
+				JumpBackIf (ast.Child (n, 0), body);
+				break;
+			}
+			case (NodeKind::call): Call (n); break;
+			default: Fail (fmt::format ("line {}: not a statement", ast.Line (n)));
+		}
+	}
+
+	void Assign (NodeID target, NodeID value)
+	{
+		uint32_t mark = temp_top;
+		if (ast.Kind (target) == NodeKind::index)
+		{
+			uint32_t array = ArrayRefIndex (ast.Declaration (ast.Child (target, 0)));
+			uint16_t index = Operand (ast.Child (target, 1));
+			uint16_t v = Operand (value);
+			line = ast.Line (target);
+			Emit (Op::store_elem, array, index, v);
+		}
+		else if (IsArrayType (ast.Type (target)))
+			Emit (Op::copy_array, ArrayRefIndex (ast.Declaration (target)), ArrayRefIndex (ast.Declaration (value)));
+		else
+		{
+			// only the last instruction of an expression writes its destination, so a variable
+			// of this frame can take the value directly
+			auto &v = variables[ast.Declaration (target)];
+			if (v.level == level)
+				Into (value, v.slot);
+			else
+			{
+				uint16_t t = Operand (value);
+				line = ast.Line (target);
+				Emit (Op::store_outer, v.level, v.slot, t);
+			}
+		}
+		temp_top = mark;
+	}
+
+	// The arguments are put where the callee's frame will start, the first free register, so the
+	// call itself copies nothing
+	void Call (NodeID n)
+	{
+		NodeID callee = ast.Callee (n);
+		auto &proc = out.procedures[procedure_index[callee]];
+		std::vector<NodeID> params;
+		for (NodeID child : ast.Children (callee))
+			if (ast.Kind (child) == NodeKind::declaration && ast.IsParam (child)) params.push_back (child);
+		if (params.size () != ast.Children (n).size ())
+		{
+			Fail (fmt::format ("line {}: wrong number of arguments", ast.Line (n)));
+			return;
+		}
+
+		uint32_t mark = temp_top;
+		uint32_t arg_base = temp_top;
+		if (arg_base + proc.param_slots >= max_register)
+		{
+			Fail (fmt::format ("line {}: the call needs too many registers", ast.Line (n)));
+			return;
+		}
+		temp_top += proc.param_slots;
+		max_temp = std::max (max_temp, temp_top);
+		for (size_t i = 0; i < params.size (); i++)
+		{
+			NodeID arg = ast.Child (n, i);
+			auto &param = variables[params[i]];
+			if (IsArrayType (ast.Type (arg)))
+			{
+				// arrays go by value, copied into the callee's slots through a ref of their own
+				out.arrays.push_back (ArrayRef{ level, static_cast<uint16_t> (arg_base + param.slot), param.low, param.size });
+				if (out.arrays.size () > max_register) Fail ("too many arrays");
+				line = ast.Line (arg);
+				Emit (Op::copy_array, out.arrays.size () - 1, ArrayRefIndex (ast.Declaration (arg)));
+			}
+			else
+				Into (arg, arg_base + param.slot);
+		}
+		line = ast.Line (n);
+		Emit (Op::call, procedure_index[callee], arg_base);
+		temp_top = mark;
+	}
+
+	Ast const &ast;
+	Bytecode &out;
+	std::vector<VariableSlot> variables; // by declaration node
+	std::vector<int> procedure_index;    // by procedure node
+	std::vector<uint32_t> locals_end;    // by procedure index, the first temporary
+	std::string error;
+
+	// the procedure being compiled
+	uint16_t level = 0;
+	uint32_t temp_top = 0;
+	uint32_t max_temp = 0;
+	int line = 0;
+};
+
+} // namespace
+
+std::optional<Bytecode> CompileBytecode (Ast const &ast, std::string &error)
+{
+	Bytecode bytecode;
+	BytecodeCompiler compiler (ast, bytecode);
+	if (!compiler.Compile (error)) return std::nullopt;
+	return bytecode;
+}
+
+void PrintBytecode (Bytecode const &bytecode, SymbolTable const &symbols, FILE *fp)
+{
+	for (size_t p = 0; p < bytecode.procedures.size (); p++)
+	{
+		auto &proc = bytecode.procedures[p];
+		uint32_t end = p + 1 < bytecode.procedures.size () ? bytecode.procedures[p + 1].entry : bytecode.code.size ();
+		if (p == 0)
+			fmt::print (fp, "program: frame of {}\n", proc.frame_size);
+		else
+			fmt::print (fp, "\nprocedure {}: level {}, {} param slots, frame of {}\n", symbols.SymbolView (proc.name), proc.level, proc.param_slots, proc.frame_size);
+		for (uint32_t i = proc.entry; i < end; i++)
+		{
+			auto &ins = bytecode.code[i];
+			fmt::print (fp, "{:>6} {:<12}", i, op_names[static_cast<size_t> (ins.op)]);
+			switch (ins.op)
+			{
+				case (Op::halt):
+				case (Op::ret): break;
+				case (Op::call):
+					fmt::print (fp, "{} r{}", symbols.SymbolView (bytecode.procedures[ins.a].name), ins.b);
+					break;
+				case (Op::load_int): fmt::print (fp, "r{} {}", ins.a, static_cast<int32_t> (ins.BC ())); break;
+				case (Op::load_real): fmt::print (fp, "r{} {}", ins.a, bytecode.reals[ins.BC ()]); break;
+				case (Op::jump): fmt::print (fp, "{}", ins.BC ()); break;
+				case (Op::jump_if):
+				case (Op::jump_unless): fmt::print (fp, "r{} {}", ins.a, ins.BC ()); break;
+				case (Op::load_outer): fmt::print (fp, "r{} {}:{}", ins.a, ins.b, ins.c); break;
+				case (Op::store_outer): fmt::print (fp, "{}:{} r{}", ins.a, ins.b, ins.c); break;
+				case (Op::load_elem): fmt::print (fp, "r{} @{} r{}", ins.a, ins.b, ins.c); break;
+				case (Op::store_elem): fmt::print (fp, "@{} r{} r{}", ins.a, ins.b, ins.c); break;
+				case (Op::copy_array): fmt::print (fp, "@{} @{}", ins.a, ins.b); break;
+				case (Op::move):
+				case (Op::neg_i):
+				case (Op::neg_r):
+				case (Op::t_not): fmt::print (fp, "r{} r{}", ins.a, ins.b); break;
+				default:
+					if (ins.op >= Op::jump_eq_i)
+						fmt::print (fp, "r{} r{} {}", ins.a, ins.b, static_cast<int64_t> (i) + static_cast<int16_t> (ins.c));
+					else
+						fmt::print (fp, "r{} r{} r{}", ins.a, ins.b, ins.c);
+			}
+			fmt::print (fp, "\n");
+		}
+	}
+	if (!bytecode.arrays.empty ()) fmt::print (fp, "\narrays (level:base, low, size)\n");
+	for (size_t i = 0; i < bytecode.arrays.size (); i++)
+	{
+		auto &array = bytecode.arrays[i];
+		fmt::print (fp, "{:>6} {}:{} {} {}\n", fmt::format ("@{}", i), array.level, array.base, array.low, array.size);
+	}
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "ast.h"
+#include "common.h"
+
+// Register bytecode for the VM in vm.h. Every procedure runs in a frame of 8 byte slots holding
+// its params, then its locals (arrays inline, one slot per element), then temporaries. An
+// instruction names slots of the running frame as registers, a, b and c below. Variables of
+// enclosing procedures are reached through the display, the frame of the innermost active
+// procedure at each nesting level. Types are resolved by the checker so slots are unboxed and
+// each operation comes in an int (_i) and a real (_r) version; bools are ints 0 and 1.
+enum class Op : uint8_t
+{
+	halt,
+	ret,
+	call,        // procedure a, its frame starts at register b where the arguments were put
+	move,        // a = b
+	load_int,    // a = bc
+	load_real,   // a = reals[bc]
+	load_outer,  // a = display[b][c]
+	store_outer, // display[a][b] = c
+	load_elem,   // a = arrays[b][c], checked against the bounds
+	store_elem,  // arrays[a][b] = c, as above
+	copy_array,  // arrays[a] = arrays[b], same size
+	add_i,       // a = b + c, wrapping
+	sub_i,
+	mul_i,
+	div_i, // truncates, a runtime error for a zero divisor
+	mod_i, // sign of the dividend, as above
+	neg_i, // a = -b
+	add_r,
+	sub_r,
+	mul_r,
+	div_r,
+	neg_r,
+	eq_i, // a = b == c
+	ne_i,
+	lt_i,
+	le_i,
+	gt_i,
+	ge_i,
+	eq_r,
+	ne_r,
+	lt_r,
+	le_r,
+	gt_r,
+	ge_r,
+	t_and, // a = b && c
+	t_or,
+	t_not,       // a = !b
+	jump,        // to bc
+	jump_if,     // to bc if a
+	jump_unless, // to bc if !a
+	jump_eq_i,   // by c, a signed offset from this instruction, if a == b
+	jump_ne_i,
+	jump_lt_i,
+	jump_le_i,
+	jump_gt_i,
+	jump_ge_i,
+	count
+};
+
+constexpr const char *op_names[] = { "halt", "ret", "call", "move", "load_int", "load_real",
+	"load_outer", "store_outer", "load_elem", "store_elem", "copy_array", "add_i", "sub_i", "mul_i",
+	"div_i", "mod_i", "neg_i", "add_r", "sub_r", "mul_r", "div_r", "neg_r", "eq_i", "ne_i", "lt_i",
+	"le_i", "gt_i", "ge_i", "eq_r", "ne_r", "lt_r", "le_r", "gt_r", "ge_r", "and", "or", "not", "jump",
+	"jump_if", "jump_unless", "jump_eq_i", "jump_ne_i", "jump_lt_i", "jump_le_i", "jump_gt_i",
+	"jump_ge_i" };
+static_assert (std::size (op_names) == static_cast<size_t> (Op::count), "an op is missing its name");
+
+// 8 bytes, b and c together make the 32 bit operand bc
+struct Instruction
+{
+	Op op;
+	uint16_t a = 0;
+	uint16_t b = 0;
+	uint16_t c = 0;
+
+	uint32_t BC () const { return b | (static_cast<uint32_t> (c) << 16); }
+	void SetBC (uint32_t bc)
+	{
+		b = bc & 0xFFFF;
+		c = bc >> 16;
+	}
+};
+static_assert (sizeof (Instruction) == 8, "Instruction should stay 8 bytes");
+
+union Value
+{
+	int32_t i;
+	double r;
+};
+
+// An array variable: display[level] + base holds its size elements, the first indexed by low
+struct ArrayRef
+{
+	uint16_t level;
+	uint16_t base;
+	int32_t low;
+	uint32_t size;
+};
+
+struct BytecodeProcedure
+{
+	SymbolID name;
+	uint32_t entry;       // first instruction
+	uint16_t level;       // 0 for the program
+	uint16_t param_slots; // the first slots of the frame, the rest start out zero
+	uint16_t frame_size;
+};
+
+// A variable of the program, to read the results out of the VM by
+struct GlobalVariable
+{
+	SymbolID name;
+	RetType type;
+	uint16_t slot;
+	int32_t low;
+};
+
+struct Bytecode
+{
+	std::vector<Instruction> code;
+	std::vector<int> lines; // source line of each instruction
+	std::vector<double> reals;
+	std::vector<ArrayRef> arrays;
+	std::vector<BytecodeProcedure> procedures; // the program first
+	std::vector<GlobalVariable> globals;
+};
+
+// Lowers a checked program, which must have no errors. Fails, saying why in error, for programs
+// with errors or beyond what the encoding can address.
+std::optional<Bytecode> CompileBytecode (Ast const &ast, std::string &error);
+
+void PrintBytecode (Bytecode const &bytecode, SymbolTable const &symbols, FILE *fp);
@@ -1,17 +1,32 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <fstream>
 #include <functional>
+#include <iterator>
 #include <map>
+#include <memory>
 #include <optional>
 #include <string_view>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
+#include <cstdint>
 #include <cstdio>
 #include <fmt/format.h>
 #include <fmt/ostream.h>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 class OutputFileHandle
 {
 	public:
@@ -29,30 +44,60 @@ class OutputFileHandle
 	FILE *fp = nullptr;
 };
 
-class SymbolTable
+// Append only storage for string data, views into it stay valid for the lifetime of the arena
+class StringArena
 {
 	public:
-	int AddSymbol (std::string_view symbol)
+	StringArena () = default;
+	StringArena (StringArena const &) = delete;
+	StringArena &operator= (StringArena const &) = delete;
+
+	std::string_view Store (std::string_view str)
 	{
-		int i = 0;
-		for (i = 0; i < symbols.size (); i++)
+		if (blocks.empty () || block_used + str.size () > block_capacity)
 		{
-			if (symbol == symbols[i]) return i;
+			block_capacity = std::max (default_block_size, str.size ());
+			blocks.push_back (std::make_unique<char[]> (block_capacity));
+			block_used = 0;
 		}
-		symbols.push_back (std::string (symbol));
-		return i;
+		char *dst = blocks.back ().get () + block_used;
+		std::copy (str.begin (), str.end (), dst);
+		block_used += str.size ();
+		return std::string_view (dst, str.size ());
 	}
 
-	int GetSymbolLocation (std::string_view symbol)
+	private:
+	static constexpr size_t default_block_size = 4096;
+	std::vector<std::unique_ptr<char[]>> blocks;
+	size_t block_used = 0;
+	size_t block_capacity = 0;
+};
+
+class SymbolTable
+{
+	public:
+	int AddSymbol (std::string_view symbol)
 	{
-		for (int i = 0; i < symbols.size (); i++)
-		{
-			if (symbol == symbols[i]) return i;
-		}
+		auto it = symbol_index.find (symbol);
+		if (it != std::end (symbol_index)) return it->second;
+
+		auto stored = arena.Store (symbol);
+		int loc = symbols.size ();
+		symbols.push_back (stored);
+		symbol_index.emplace (stored, loc);
+		return loc;
+	}
+
+	int GetSymbolLocation (std::string_view symbol) const
+	{
+		auto it = symbol_index.find (symbol);
+		if (it != std::end (symbol_index)) return it->second;
 		return -1;
 	}
 
-	std::string SymbolView (int loc)
+	int Size () const { return symbols.size (); }
+
+	std::string_view SymbolView (int loc) const
 	{
 		if (loc > 0 && loc < symbols.size ()) return symbols.at (loc);
 		return {};
@@ -70,62 +115,362 @@ class SymbolTable
 	}
 
 	private:
-	std::vector<std::string> symbols;
+	StringArena arena;
+	std::vector<std::string_view> symbols;
+	std::unordered_map<std::string_view, int> symbol_index;
+};
+
+
+enum class Phase : uint8_t
+{
+	read,
+	lex,
+	parse, // excluding the lexing it drives
+	print_symbols,
+	print_addresses,
+	log_errors,
+	bytecode, // lowering the AST for -run and -emit-bytecode
+	run,
+	assembly,
+	link, // cc assembling and linking program.s
+	llvm_ir,
+	ssa,      // lowering the AST to SSA
+	optimize, // the SSA passes, broken down by -time-passes
+	count
+};
+
+enum class Counter : uint8_t
+{
+	tokens_lexed,
+	machines_tried, // the table lexer counts as one machine per token
+	symbols_interned,
+	synch_tokens_skipped,
+	diagnostics,
+	ast_nodes,
+	count
+};
+
+constexpr const char *phase_names[] = { "read", "lex", "parse", "print_symbols", "print_addresses", "log_errors", "bytecode", "run", "assembly", "link", "llvm_ir", "ssa", "optimize" };
+constexpr const char *counter_names[] = {
+	"tokens_lexed", "machines_tried", "symbols_interned", "synch_tokens_skipped", "diagnostics", "ast_nodes"
+};
+
+// Time spent per compiler phase and event counts, dumped by the driver with -ftime-report
+class Stats
+{
+	public:
+	void Add (Counter counter, long amount = 1) { counters[static_cast<int> (counter)] += amount; }
+	void AddTime (Phase phase, double seconds) { seconds_in[static_cast<int> (phase)] += seconds; }
+
+	long Get (Counter counter) const { return counters[static_cast<int> (counter)]; }
+	double Seconds (Phase phase) const { return seconds_in[static_cast<int> (phase)]; }
+
+	void Merge (Stats const &other)
+	{
+		for (int i = 0; i < phase_count; i++)
+			seconds_in[i] += other.seconds_in[i];
+		for (int i = 0; i < counter_count; i++)
+			counters[i] += other.counters[i];
+	}
+
+	void PrintTable (FILE *fp) const
+	{
+		double total = 0;
+		for (auto s : seconds_in)
+			total += s;
+		fmt::print (fp, "{:<22}{:>12}{:>10}\n", "Phase", "Seconds", "Percent");
+		for (int i = 0; i < phase_count; i++)
+			fmt::print (fp,
+			"{:<22}{:>12.6f}{:>9.1f}%\n",
+			phase_names[i],
+			seconds_in[i],
+			total > 0 ? 100 * seconds_in[i] / total : 0.0);
+		fmt::print (fp, "{:<22}{:>12.6f}\n\n", "total", total);
+		fmt::print (fp, "{:<22}{:>12}\n", "Counter", "Value");
+		for (int i = 0; i < counter_count; i++)
+			fmt::print (fp, "{:<22}{:>12}\n", counter_names[i], counters[i]);
+	}
+
+	void PrintJson (FILE *fp) const
+	{
+		fmt::print (fp, "{{\"phases\": {{");
+		for (int i = 0; i < phase_count; i++)
+			fmt::print (fp, "{}\"{}\": {:.6f}", i ? ", " : "", phase_names[i], seconds_in[i]);
+		fmt::print (fp, "}}, \"counters\": {{");
+		for (int i = 0; i < counter_count; i++)
+			fmt::print (fp, "{}\"{}\": {}", i ? ", " : "", counter_names[i], counters[i]);
+		fmt::print (fp, "}}}}\n");
+	}
+
+	private:
+	static constexpr int phase_count = static_cast<int> (Phase::count);
+	static constexpr int counter_count = static_cast<int> (Counter::count);
+	std::array<double, phase_count> seconds_in = {};
+	std::array<long, counter_count> counters = {};
+};
+
+static_assert (std::size (phase_names) == static_cast<size_t> (Phase::count), "a phase is missing its name");
+static_assert (std::size (counter_names) == static_cast<size_t> (Counter::count), "a counter is missing its name");
+
+// Adds the time from construction to destruction to a phase
+class ScopedTimer
+{
+	public:
+	ScopedTimer (Stats &stats, Phase phase)
+	: stats (stats), phase (phase), start (std::chrono::steady_clock::now ())
+	{
+	}
+	~ScopedTimer ()
+	{
+		stats.AddTime (phase, std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ());
+	}
+
+	private:
+	Stats &stats;
+	Phase phase;
+	std::chrono::steady_clock::time_point start;
+};
+
+enum class DiagnosticKind : uint8_t
+{
+	listing, // a source line
+	lex_error,
+	syn_error,
+	sem_error
 };
 
+// One line of the listing file, the text lives in Logger::text at [offset, offset + length)
+struct Diagnostic
+{
+	int line;
+	int column;
+	DiagnosticKind kind;
+	int code; // LexerErrorEnum for lex errors, 0 otherwise
+	uint32_t offset;
+	uint32_t length;
+};
 
 class Logger
 {
 	public:
-	Logger () : listing_file ("listing_file.txt"), token_file ("token_file.txt")
+	// output_dir is prefixed to the file names as is, so it should be empty or end in a separator
+	Logger (std::string const &output_dir = "")
+	: listing_file (output_dir + "listing_file.txt"), token_file (output_dir + "token_file.txt")
 	{
 		fmt::print (token_file.FP (), "{:^14}{:<14}{:<16}{:<14}\n", "Line No.", "Lexeme", "TOKEN-TYPE", "ATTRIBUTE");
 	}
 
 	OutputFileHandle listing_file;
 	OutputFileHandle token_file;
+	Stats stats;
 
-	void AddListPrint (int index, std::function<void(FILE *fp)> func)
+	void AddListing (int line, std::string_view source_line)
 	{
-		listing[index].push_back (func);
+		Add (line, 0, DiagnosticKind::listing, 0, source_line);
 	}
-	void AddLexErrPrint (int index, std::function<void(FILE *fp)> func)
+	void AddLexError (int line, int column, int code, std::string_view message)
 	{
-		lex_errors[index].push_back (func);
+		Add (line, column, DiagnosticKind::lex_error, code, message);
 	}
-	void AddSynErrPrint (int index, std::function<void(FILE *fp)> func)
+	void AddSynError (int line, int column, std::string_view message)
 	{
-		syn_errors[index].push_back (func);
+		Add (line, column, DiagnosticKind::syn_error, 0, message);
 	}
-	void AddSemErrPrint (int index, std::function<void(FILE *fp)> func)
+	void AddSemError (int line, int column, std::string_view message)
 	{
-		sem_errors[index].push_back (func);
+		Add (line, column, DiagnosticKind::sem_error, 0, message);
 	}
 
+	size_t ErrorCount () const
+	{
+		return std::count_if (std::begin (diagnostics), std::end (diagnostics), [](auto &d) {
+			return d.kind != DiagnosticKind::listing;
+		});
+	}
+
+	// Writes the listing, each source line followed by its lex, syntax then semantic errors.
+	// Errors on lines that were never listed are dropped.
 	void LogErrors ()
 	{
-		for (auto [key, vec] : listing)
+		ScopedTimer timer (stats, Phase::log_errors);
+		stats.Add (Counter::diagnostics, ErrorCount ());
+
+		auto by_line = [](Diagnostic const &a, Diagnostic const &b) {
+			if (a.line != b.line) return a.line < b.line;
+			return a.kind < b.kind;
+		};
+		std::stable_sort (std::begin (diagnostics), std::end (diagnostics), by_line);
+
+		FILE *fp = listing_file.FP ();
+		bool line_listed = false;
+		for (size_t i = 0; i < diagnostics.size (); i++)
+		{
+			auto &d = diagnostics[i];
+			if (i == 0 || d.line != diagnostics[i - 1].line)
+				line_listed = d.kind == DiagnosticKind::listing;
+			if (!line_listed) continue;
+
+			std::string_view payload (text.data () + d.offset, d.length);
+			switch (d.kind)
+			{
+				case DiagnosticKind::listing: fmt::print (fp, "{:<8}{}\n", d.line, payload); break;
+				case DiagnosticKind::lex_error: fmt::print (fp, "{:<8}{}\n", "LEXERR:", payload); break;
+				case DiagnosticKind::syn_error: fmt::print (fp, "{}\n", payload); break;
+				case DiagnosticKind::sem_error: fmt::print (fp, "SEMERR: {}\n", payload); break;
+			}
+		}
+		diagnostics.clear ();
+		text.clear ();
+	}
+
+	std::vector<Diagnostic> diagnostics;
+
+	private:
+	void Add (int line, int column, DiagnosticKind kind, int code, std::string_view payload)
+	{
+		auto offset = static_cast<uint32_t> (text.size ());
+		diagnostics.push_back (
+		Diagnostic{ line, column, kind, code, offset, static_cast<uint32_t> (payload.size ()) });
+		text.append (payload);
+	}
+
+	std::string text;
+};
+
+// The most memory the process has had resident so far, 0 where the platform doesn't say
+inline size_t PeakMemoryBytes ()
+{
+#ifdef _WIN32
+	return 0;
+#else
+	struct rusage usage;
+	if (::getrusage (RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+	return usage.ru_maxrss;
+#else
+	return size_t (usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+// Read only view of a whole file, memory mapped where the platform allows
+class MappedFile
+{
+	public:
+	MappedFile (std::string const &file_name)
+	{
+#ifdef _WIN32
+		std::ifstream in (file_name, std::ios::in | std::ios::binary);
+		if (!in) return;
+		std::string text ((std::istreambuf_iterator<char> (in)), std::istreambuf_iterator<char> ());
+		fallback = std::make_unique<char[]> (text.size ());
+		std::copy (std::begin (text), std::end (text), fallback.get ());
+		data = fallback.get ();
+		size = text.size ();
+		is_open = true;
+#else
+		int fd = ::open (file_name.c_str (), O_RDONLY);
+		if (fd == -1) return;
+		struct stat st;
+		if (::fstat (fd, &st) == 0)
 		{
-			for (auto &func : vec)
-				func (listing_file.FP ());
-			if (lex_errors.count (key))
-				for (auto &func : lex_errors.at (key))
-					func (listing_file.FP ());
-			if (syn_errors.count (key))
-				for (auto &func : syn_errors.at (key))
-					func (listing_file.FP ());
-			if (sem_errors.count (key))
-				for (auto &func : sem_errors.at (key))
-					func (listing_file.FP ());
+			size = st.st_size;
+			if (size == 0)
+			{
+				is_open = true;
+			}
+			else
+			{
+				void *mapping = ::mmap (nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (mapping != MAP_FAILED)
+				{
+					data = static_cast<const char *> (mapping);
+					is_open = true;
+				}
+			}
 		}
+		::close (fd);
+#endif
+	}
+
+	~MappedFile ()
+	{
+#ifndef _WIN32
+		if (data != nullptr) ::munmap (const_cast<char *> (data), size);
+#endif
+	}
+
+	MappedFile (MappedFile const &) = delete;
+	MappedFile &operator= (MappedFile const &) = delete;
+	MappedFile (MappedFile &&other) noexcept
+	: data (other.data), size (other.size), is_open (other.is_open)
+#ifdef _WIN32
+	  ,
+	  fallback (std::move (other.fallback))
+#endif
+	{
+		other.data = nullptr;
+		other.size = 0;
+		other.is_open = false;
+	}
+	MappedFile &operator= (MappedFile &&other) noexcept
+	{
+		std::swap (data, other.data);
+		std::swap (size, other.size);
+		std::swap (is_open, other.is_open);
+#ifdef _WIN32
+		std::swap (fallback, other.fallback);
+#endif
+		return *this;
 	}
-	std::map<int, std::vector<std::function<void(FILE *fp)>>> listing;
-	std::map<int, std::vector<std::function<void(FILE *fp)>>> lex_errors;
-	std::map<int, std::vector<std::function<void(FILE *fp)>>> syn_errors;
-	std::map<int, std::vector<std::function<void(FILE *fp)>>> sem_errors;
+
+	bool IsOpen () const { return is_open; }
+	std::string_view View () const { return data == nullptr ? std::string_view () : std::string_view (data, size); }
+
+	private:
+	const char *data = nullptr;
+	size_t size = 0;
+	bool is_open = false;
+#ifdef _WIN32
+	std::unique_ptr<char[]> fallback; // no mmap, so the file is read into here instead
+#endif
 };
 
-using CodeSource = std::vector<std::string>;
+// The lines of a source file as views into its mapping. The final line is the only copy made, to
+// append the '$' EOF marker the lexer expects without writing to the mapping.
+class CodeSource
+{
+	public:
+	CodeSource (std::string const &file_name) : file (file_name)
+	{
+		if (!file.IsOpen ()) return;
+
+		std::string_view text = file.View ();
+		size_t start = 0;
+		size_t end = text.find ('\n', start);
+		while (end != std::string_view::npos)
+		{
+			lines.push_back (text.substr (start, end - start));
+			start = end + 1;
+			end = text.find ('\n', start);
+		}
+
+		auto last = text.substr (start);
+		last_line = std::make_unique<char[]> (last.size () + 1);
+		std::copy (std::begin (last), std::end (last), last_line.get ());
+		last_line[last.size ()] = '$';
+		lines.push_back (std::string_view (last_line.get (), last.size () + 1));
+	}
+
+	bool IsOpen () const { return file.IsOpen (); }
+	size_t Size () const { return file.View ().size (); }
+
+	std::vector<std::string_view> lines;
+
+	private:
+	MappedFile file;
+	std::unique_ptr<char[]> last_line;
+};
 
 class FileReader
 {
@@ -140,28 +485,9 @@ class FileReader
 				return {
 
 				};
-			CodeSource lines;
-			std::fstream inFile (file_list.at (index++), std::ios::in);
-			if (inFile)
-			{
-				int cur_line_number = 1;
-				while (inFile.good ())
-				{
-					std::string line;
-
-					std::getline (inFile, line, '\n');
-					// if (line.size () > 0) line.pop_back ();
-					lines.push_back (line);
-
-					cur_line_number++;
-				}
-				lines.back ().push_back ('$');
-			}
-			else
-			{
-				fmt::print ("File not read, was there an error?");
-			}
-			return lines;
+			CodeSource source (file_list.at (index++));
+			if (!source.IsOpen ()) { fmt::print ("File not read, was there an error?"); }
+			return source;
 		}
 		catch (const std::exception &e)
 		{
@@ -174,10 +500,3 @@ class FileReader
 	int index = 0;
 	std::vector<std::string> file_list;
 };
-
-class CompilationContext
-{
-	public:
-	SymbolTable symbolTable;
-	SymbolTable literalTable;
-};
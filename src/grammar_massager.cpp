@@ -1,102 +1,169 @@
 #include "grammar_massager.h"
 
+FILE *massager_log = stdout;
+FILE *massager_progress = nullptr;
+
+size_t ProductionHash::operator() (Production const &p) const
+{
+	size_t hash = std::hash<int>{}(p.var);
+	for (auto &token : p.rule)
+		hash ^= std::hash<int>{}(token.index) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	return hash;
+}
+
+int Grammar::AddTerminal (std::string const &name)
+{
+	int key = index++;
+	terminals[key] = name;
+	terminal_keys[name] = key;
+	if (name == "e") epsilon_terminal = key;
+	if (name == "$") eof = key;
+	return key;
+}
+
+int Grammar::AddVariable (std::string const &name)
+{
+	int key = index++;
+	variables[key] = name;
+	variable_keys[name] = key;
+	if (name == "e") epsilon = key;
+	return key;
+}
+
+int Grammar::FindTerminal (std::string const &name) const
+{
+	auto it = terminal_keys.find (name);
+	return it != std::end (terminal_keys) ? it->second : -1;
+}
+
+int Grammar::FindVariable (std::string const &name) const
+{
+	auto it = variable_keys.find (name);
+	return it != std::end (variable_keys) ? it->second : -1;
+}
+
+int Grammar::FindSlot (Production const &p) const
+{
+	int slot = -1;
+	auto [begin, end] = slots_by_hash.equal_range (ProductionHash{}(p));
+	for (auto it = begin; it != end; ++it)
+		if ((slot == -1 || it->second < slot) && productions[it->second] == p) slot = it->second;
+	return slot;
+}
+
 void Grammar::AddProduction (Production p)
 {
-	auto it = std::find (std::begin (productions), std::end (productions), p);
 	// if not found, add it
-	if (it == std::end (productions)) { productions.push_back (p); }
+	if (FindSlot (p) == -1) AppendProduction (std::move (p));
 }
-void Grammar::EraseProduction (Production &p)
+
+void Grammar::AppendProduction (Production p)
 {
-	auto it = std::find (std::begin (productions), std::end (productions), p);
-	if (it != std::end (productions)) productions.erase (it);
+	int slot = productions.size ();
+	if (p.var >= buckets.size ()) buckets.resize (p.var + 1);
+	buckets[p.var].push_back (slot);
+	slots_by_hash.emplace (ProductionHash{}(p), slot);
+	productions.push_back (std::move (p));
+	erased.push_back (false);
+}
+
+void Grammar::EraseProduction (Production const &p)
+{
+	int slot = FindSlot (p);
+	if (slot == -1) return;
+	auto [begin, end] = slots_by_hash.equal_range (ProductionHash{}(p));
+	for (auto it = begin; it != end; ++it)
+		if (it->second == slot)
+		{
+			slots_by_hash.erase (it);
+			break;
+		}
+	erased[slot] = true;
+	// pack once most slots are dead so the buckets don't fill up with them
+	if (++erased_count > productions.size () / 2) Compact ();
+}
+
+void Grammar::Compact ()
+{
+	if (erased_count == 0) return;
+	auto old_prods = std::move (productions);
+	auto old_erased = std::move (erased);
+	ClearProductions ();
+	for (int i = 0; i < old_prods.size (); i++)
+		if (!old_erased[i]) AppendProduction (std::move (old_prods[i]));
+}
+
+void Grammar::ClearProductions ()
+{
+	productions.clear ();
+	erased.clear ();
+	erased_count = 0;
+	slots_by_hash.clear ();
+	for (auto &bucket : buckets)
+		bucket.clear ();
+}
+
+std::vector<Production> const &Grammar::Productions ()
+{
+	Compact ();
+	return productions;
 }
 
 int Grammar::DeriveNewVariable (Variable var, std::string str)
 {
 	// check if the variable name already exists, return it if it does
 	std::string new_prod_name = variables.at (var) + str;
-	for (auto [key, value] : variables)
-	{
-		if (value == new_prod_name) return key;
-	}
+	int key = FindVariable (new_prod_name);
+	if (key != -1) return key;
 	// if it doesn't exist, make a new one
-	int new_index = index;
-	variables[index++] = new_prod_name;
-
-	return new_index;
+	return AddVariable (new_prod_name);
 }
 
 
 int Grammar::CreateNewVariable (Variable var, std::string str)
 {
-	// check if the variable name already exists, return it if it does
+	// add str until the name is unique, jumping over the names earlier calls found taken
 	std::string new_prod_name = variables.at (var) + str;
-	bool isUnique = true;
-	while (isUnique)
+	std::vector<std::string> passed;
+	while (FindVariable (new_prod_name) != -1)
 	{
-		isUnique = false;
-		for (auto [key, value] : variables)
-		{
-			if (value == new_prod_name)
-			{
-				isUnique = true;
-				new_prod_name = new_prod_name + str;
-			}
-		}
+		passed.push_back (new_prod_name + '\0' + str);
+		auto it = taken_names.find (passed.back ());
+		new_prod_name = it != std::end (taken_names) ? it->second : new_prod_name + str;
 	}
-	// if it doesn't exist, make a new one
-	int new_index = index;
-	variables[index++] = new_prod_name;
-
-	return new_index;
+	for (auto &key : passed)
+		taken_names[key] = new_prod_name;
+	return AddVariable (new_prod_name);
 }
 
-bool Grammar::isEProd (Rule &rule) const
+bool Grammar::isEProd (Rule const &rule) const
 {
 	for (auto &token : rule)
 	{
-		if (token.isTerm && terminals.at (token.index).size () == 1 && terminals.at (token.index) == "e")
-		{ return true; }
-		else if (!token.isTerm && variables.at (token.index).size () == 1 && variables.at (token.index) == "e")
-		{
-			return true;
-		}
+		if (IsEpsilon (token)) return true;
 	}
 	return false;
 }
 
-int Grammar::find_epsilon_index () const
+bool Grammar::IsEpsilon (Token const &token) const
 {
-	int e_index = -1;
-	for (auto [key, value] : variables)
-	{
-		if (value == "e") e_index = key;
-	}
-	// if (e_index == -1) { variables[index++] = "e"; }
-	return e_index;
+	return token.index == (token.isTerm ? epsilon_terminal : epsilon);
 }
 
-int Grammar::find_eof_index () const
-{
-	int eof_index = -1;
-	for (auto [key, value] : terminals)
-	{
-		if (value == "$") eof_index = key;
-	}
-	return eof_index;
-}
+int Grammar::find_epsilon_index () const { return epsilon; }
+
+int Grammar::find_eof_index () const { return eof; }
 
 void Grammar::ReorderProductionsByVariable ()
 {
-	auto old_prods = productions;
-	productions.clear ();
+	auto old_prods = Productions ();
+	auto old_buckets = buckets;
+	ClearProductions ();
 	for (auto [key, value] : variables)
 	{
-		for (auto &prod : old_prods)
-		{
-			if (prod.var == key) productions.push_back (prod);
-		}
+		if (key >= old_buckets.size ()) continue;
+		for (int slot : old_buckets[key])
+			AppendProduction (old_prods[slot]);
 	}
 }
 
@@ -110,14 +177,10 @@ std::vector<Terminal> Grammar::find_firsts_of_production (Production &prod)
 		bool prod_has_epsilon = false;
 
 		// find if the var has an e prod and find all prods that start with var
-		std::vector<Production> token_prods;
-		for (auto &possible : productions)
+		std::vector<Production> token_prods = ProductionsOfVariable (token.index);
+		for (auto &possible : token_prods)
 		{
-			if (token.index == possible.var)
-			{
-				if (possible.rule.at (0).index == e_index) prod_has_epsilon = true;
-				token_prods.push_back (possible);
-			}
+			if (possible.rule.at (0).index == e_index) prod_has_epsilon = true;
 		}
 
 		for (auto &tok_prod : token_prods)
@@ -139,47 +202,46 @@ std::vector<Terminal> Grammar::find_firsts_of_production (Production &prod)
 	return possible_prods;
 }
 
-bool Grammar::ProductionExists (Production &p) const
-{
-	auto it = std::find (std::begin (productions), std::end (productions), p);
-	if (it != std::end (productions)) { return true; }
-	return false;
-}
+bool Grammar::ProductionExists (Production const &p) const { return FindSlot (p) != -1; }
 
 std::vector<Production> Grammar::ProductionsOfVariable (Variable var) const
 {
 	std::vector<Production> prods;
-	for (auto &prod : productions)
-	{
-		if (prod.var == var) prods.push_back (prod);
-	}
+	if (var < 0 || var >= buckets.size ()) return prods;
+	for (int slot : buckets[var])
+		if (!erased[slot]) prods.push_back (productions[slot]);
 	return prods;
 }
 
+std::vector<int> Grammar::ProductionIndexesOf (Variable var)
+{
+	Compact ();
+	if (var < 0 || var >= buckets.size ()) return {};
+	return buckets[var];
+}
+
 std::vector<std::pair<int, std::string>> CalcOutputOrder (std::map<int, std::string> variables)
 {
 	std::map<int, std::pair<int, std::string>> ordered_vars;
-	std::vector<std::pair<int, std::string>> vars_found;
+	std::unordered_map<std::string, int> vars_found; // variable names are unique
 	for (auto &[var, var_string] : variables)
 	{
-		bool contains_apostrophe = false;
 		int loc = var_string.find ("'");
 		if (loc == std::string::npos)
 		{
-			vars_found.push_back (std::pair<int, std::string> (var, var_string));
+			vars_found[var_string] = var;
 			ordered_vars[var * 1000] = std::pair<int, std::string> (var, var_string);
 		}
 		else
 		{
 			int apos_count = var_string.size () - loc;
 			// fmt::print ("{}\n", apos_count);
-			for (auto &[index, i_str] : vars_found)
+			auto found = vars_found.find (var_string.substr (0, loc));
+			if (found != std::end (vars_found))
 			{
-				if (i_str == var_string.substr (0, loc))
-				{
-					fmt::print ("{}  {}\n", var_string.substr (0, loc), index * 1000 + apos_count * 1);
-					ordered_vars[index * 1000 + apos_count * 1] = std::pair<int, std::string> (var, var_string);
-				}
+				int index = found->second;
+				if (massager_progress) fmt::print (massager_progress, "{}  {}\n", var_string.substr (0, loc), index * 1000 + apos_count * 1);
+				ordered_vars[index * 1000 + apos_count * 1] = std::pair<int, std::string> (var, var_string);
 			}
 		}
 	}
@@ -240,27 +302,24 @@ void Grammar::PrintGrammar (std::string out_file_name, std::function<void(FILE *
 		variable_decorator (ofh.FP (), var);
 
 		// fmt::print (ofh.FP (), "\n");
-		for (int i = 0; i < productions.size (); i++)
+		for (int i : ProductionIndexesOf (var))
 		{
-			if (productions.at (i).var == var)
+			// fmt::print(ofh.FP(), "({}) {} ->", std::to_string(isSame ? var_index - 1 : var_index), var_string);
+			// fmt::print (ofh.FP (), "\t({})\t", std::to_string (isSame ? var_index - 1 : var_index) + "." + std::to_string (prod_index++));
+
+			fmt::print (ofh.FP (),
+			"({}) {} -> ",
+			std::to_string (isSame ? var_index - 1 : var_index) + "." + std::to_string (prod_index),
+			var_string);
+			prod_index++;
+			for (auto &token : productions.at (i).rule)
 			{
-				// fmt::print(ofh.FP(), "({}) {} ->", std::to_string(isSame ? var_index - 1 : var_index), var_string);
-				// fmt::print (ofh.FP (), "\t({})\t", std::to_string (isSame ? var_index - 1 : var_index) + "." + std::to_string (prod_index++));
-
-				fmt::print (ofh.FP (),
-				"({}) {} -> ",
-				std::to_string (isSame ? var_index - 1 : var_index) + "." + std::to_string (prod_index),
-				var_string);
-				prod_index++;
-				for (auto &token : productions.at (i).rule)
-				{
-					if (token.isTerm)
-						fmt::print (ofh.FP (), "'{}' ", terminals.at (token.index));
-					else
-						fmt::print (ofh.FP (), "{} ", variables.at (token.index));
-				}
-				fmt::print (ofh.FP (), "\n");
+				if (token.isTerm)
+					fmt::print (ofh.FP (), "'{}' ", terminals.at (token.index));
+				else
+					fmt::print (ofh.FP (), "{} ", variables.at (token.index));
 			}
+			fmt::print (ofh.FP (), "\n");
 		}
 		if (!isSame) var_index++;
 		// fmt::print (ofh.FP (), "\n");
@@ -294,14 +353,11 @@ std::map<int, std::string> Grammar::ProperIndexes ()
 				prev = var_string;
 				prod_index = 1;
 			}
-			for (int i = 0; i < productions.size (); i++)
+			for (int i : ProductionIndexesOf (var))
 			{
-				if (productions.at (i).var == var)
-				{
-					out[i] = std::to_string (isSame ? var_index - 1 : var_index) + "."
-					         + std::to_string (prod_index);
-					prod_index++;
-				}
+				out[i] = std::to_string (isSame ? var_index - 1 : var_index) + "."
+				         + std::to_string (prod_index);
+				prod_index++;
 			}
 			if (!isSame) var_index++;
 		}
@@ -315,43 +371,37 @@ std::map<int, std::string> Grammar::ProperIndexes ()
 void Grammar::RemoveDuplicateProductions ()
 {
 	// copy old ones, and reinsert them, while checking if they are unique.
-	std::vector<Production> old_prods = productions;
-	productions.clear ();
+	std::vector<Production> old_prods = Productions ();
+	ClearProductions ();
 	for (auto &prod : old_prods)
 	{
 		AddProduction (prod);
 	}
 }
 
-std::vector<Rule> PermuteRule (Rule original_rule, std::vector<bool> &found_e_vars, int iteration)
+// Every rule left by dropping some of the symbols found_e_vars marks, the last symbol always kept,
+// in the order of choosing from the front, keeping a symbol before dropping it
+std::vector<Rule> PermuteRule (Rule const &original_rule, std::vector<bool> const &found_e_vars)
 {
-	if (iteration == found_e_vars.size () - 1)
-	{
-		std::vector<Rule> new_rules;
-		Rule r;
-		r.insert (std::begin (r), original_rule[iteration]);
-		new_rules.push_back (r);
-		// if(found_e_vars[iteration])
-		return new_rules;
-	} // base
-
-	// get all rule combos with (iteration + 1)
-	auto rules = PermuteRule (original_rule, found_e_vars, iteration + 1);
-
-	// append current token character to rules into new_rules
 	std::vector<Rule> new_rules;
-	for (auto &rule : rules)
+	std::vector<int> optional; // the first is the most significant bit of the count below
+	for (int i = 0; i + 1 < original_rule.size (); i++)
+		if (found_e_vars[i]) optional.push_back (i);
+
+	std::vector<bool> dropped (original_rule.size ());
+	for (uint64_t choice = 0; choice >> optional.size () == 0; choice++)
 	{
-		Rule r = rule;
-		r.insert (std::begin (r), original_rule[iteration]);
-		new_rules.push_back (r);
+		for (int b = 0; b < optional.size (); b++)
+			dropped[optional[b]] = choice >> (optional.size () - 1 - b) & 1;
+		Rule r;
+		for (int i = 0; i < original_rule.size (); i++)
+			if (!dropped[i]) r.push_back (original_rule[i]);
+		new_rules.push_back (std::move (r));
 	}
-	// if its a varable with e_prod, also add the rules without it being added
-	if (found_e_vars.at (iteration))
-	{ new_rules.insert (std::end (new_rules), std::begin (rules), std::end (rules)); } return new_rules;
+	return new_rules;
 }
 
-std::vector<Production> PermuteProductionOnERemoval (Production prod, std::unordered_set<Variable> &e_vars)
+std::vector<Production> PermuteProductionOnERemoval (Production const &prod, std::unordered_set<Variable> &e_vars)
 {
 	std::vector<Production> out_productions;
 
@@ -361,17 +411,13 @@ std::vector<Production> PermuteProductionOnERemoval (Production prod, std::unord
 
 	for (int i = 0; i < prod.rule.size (); i++)
 	{
-		if (!prod.rule.at (i).isTerm)
-		{
-			auto it = std::find (std::begin (e_vars), std::end (e_vars), prod.rule.at (i).index);
-			if (it != std::end (e_vars)) { found_e_vars[i] = true; }
-		}
+		if (!prod.rule.at (i).isTerm && e_vars.count (prod.rule.at (i).index)) found_e_vars[i] = true;
 	}
 
-	auto rules = PermuteRule (prod.rule, found_e_vars, 0);
+	auto rules = PermuteRule (prod.rule, found_e_vars);
 	for (auto &r : rules)
 	{
-		out_productions.push_back (Production (prod.var, r));
+		out_productions.push_back (Production (prod.var, std::move (r)));
 	}
 
 	return out_productions;
@@ -385,7 +431,7 @@ Grammar RemoveEProds (Grammar &grammar)
 	std::vector<Production> e_prods;
 
 	// finds direct e prods
-	for (auto &prod : res_grammar.productions)
+	for (auto &prod : res_grammar.Productions ())
 	{
 		if (res_grammar.isEProd (prod.rule))
 		{
@@ -395,7 +441,7 @@ Grammar RemoveEProds (Grammar &grammar)
 	}
 
 	std::vector<Production> contains_eProds;
-	for (auto &prod : res_grammar.productions)
+	for (auto &prod : res_grammar.Productions ())
 	{
 		bool contains_e = false;
 		for (auto &tok : prod.rule)
@@ -406,12 +452,11 @@ Grammar RemoveEProds (Grammar &grammar)
 	}
 
 
+	// appended even when already there, as a copy of an e production outlives the erasing below
 	for (auto &prod : contains_eProds)
 	{
-		auto new_prods = PermuteProductionOnERemoval (prod, e_vars);
-		if (new_prods.size () > 0)
-			res_grammar.productions.insert (
-			std::end (res_grammar.productions), std::begin (new_prods), std::end (new_prods));
+		for (auto &new_prod : PermuteProductionOnERemoval (prod, e_vars))
+			res_grammar.AppendProduction (std::move (new_prod));
 	}
 	for (auto &prod : e_prods)
 	{
@@ -422,25 +467,142 @@ Grammar RemoveEProds (Grammar &grammar)
 	return res_grammar;
 }
 
+// By variable key, whether it derives e: one of its rules is all e and nullable variables. Found
+// with a worklist rather than only from direct e productions.
+std::vector<bool> NullableVariables (Grammar const &grammar, std::vector<Production> const &prods)
+{
+	std::vector<bool> nullable (grammar.index);
+	std::vector<int> remaining (prods.size ()); // symbols of the rule not yet known to be nullable
+	std::vector<std::vector<int>> occurrences (grammar.index); // by variable, the rules it's in
+	std::vector<Variable> worklist;
+	for (int p = 0; p < prods.size (); p++)
+	{
+		for (auto &token : prods[p].rule)
+		{
+			if (grammar.IsEpsilon (token)) continue;
+			remaining[p]++;
+			if (!token.isTerm) occurrences[token.index].push_back (p);
+		}
+		if (remaining[p] == 0 && !nullable[prods[p].var])
+		{
+			nullable[prods[p].var] = true;
+			worklist.push_back (prods[p].var);
+		}
+	}
+	while (!worklist.empty ())
+	{
+		Variable var = worklist.back ();
+		worklist.pop_back ();
+		for (int p : occurrences[var])
+			if (--remaining[p] == 0 && !nullable[prods[p].var])
+			{
+				nullable[prods[p].var] = true;
+				worklist.push_back (prods[p].var);
+			}
+	}
+	return nullable;
+}
+
+/*
+Removes e productions without trying every subset of a rule's nullable symbols. For a rule
+A -> X1 .. Xn, each nullable Xj that has another nullable symbol after it starts a new variable
+for the rest of the rule, less e:
+    A -> P Xj R | P R        (P the symbols before Xj, R the rest without e)
+    A -> P Xj | P            too, when everything after Xj is nullable
+so each nullable symbol adds at most four productions. A variable is nullable when one of its
+rules is all nullable symbols, found with a worklist rather than only from direct e productions,
+and the start symbol keeps an e production when it's nullable.
+*/
 Grammar BetterRemoveEpsilonProductions (Grammar &in_grammar)
 {
-	auto res_grammar = in_grammar;
+	Grammar res_grammar = in_grammar;
+	std::vector<Production> prods = res_grammar.Productions ();
+	res_grammar.ClearProductions ();
 
-	for (auto [key, value] : res_grammar.variables)
+	// the rules without any e in them, an e production leaving an empty one
+	std::optional<Token> e_token;
+	for (auto &prod : prods)
 	{
-		auto var_prods = res_grammar.ProductionsOfVariable (key);
+		Rule rule;
+		for (auto &token : prod.rule)
+			if (res_grammar.IsEpsilon (token))
+				e_token = token;
+			else
+				rule.push_back (token);
+		prod.rule = std::move (rule);
+	}
 
-		// determine if A has an e production rule.
-		bool isE = false;
-		for (auto p : var_prods)
+	std::vector<bool> nullable = NullableVariables (res_grammar, prods);
+
+	auto is_nullable = [&] (Token const &token) { return !token.isTerm && nullable[token.index]; };
+	std::unordered_map<Variable, int> suffix_counts;
+	auto new_suffix_variable = [&] (Variable var) {
+		std::string name;
+		do
+			name = res_grammar.variables.at (var) + "_" + std::to_string (++suffix_counts[var]);
+		while (res_grammar.FindVariable (name) != -1);
+		return res_grammar.AddVariable (name);
+	};
+	auto add = [&] (Variable var, Rule rule) {
+		// A -> A adds nothing
+		if (rule.size () == 1 && !rule[0].isTerm && rule[0].index == var) return;
+		res_grammar.AddProduction (Production (var, std::move (rule)));
+	};
+
+	for (auto &prod : prods)
+	{
+		auto &rule = prod.rule;
+		int n = rule.size ();
+		// where the rule becomes all nullable symbols
+		int nullable_from = n;
+		while (nullable_from > 0 && is_nullable (rule[nullable_from - 1]))
+			nullable_from--;
+
+		Variable target = prod.var;
+		int i = 0; // target derives rule[i..n) less e
+		while (i < n)
 		{
-			if (res_grammar.isEProd (p.rule)) isE = true;
+			int j = i;
+			while (j < n && !is_nullable (rule[j]))
+				j++;
+			if (j == n)
+			{
+				add (target, Rule (std::begin (rule) + i, std::end (rule)));
+				break;
+			}
+			int k = j + 1;
+			while (k < n && !is_nullable (rule[k]))
+				k++;
+
+			Rule prefix (std::begin (rule) + i, std::begin (rule) + j);
+			auto with = [&] (std::initializer_list<Token> more, int from, int to) {
+				Rule r = prefix;
+				r.insert (std::end (r), more);
+				r.insert (std::end (r), std::begin (rule) + from, std::begin (rule) + to);
+				return r;
+			};
+			if (k == n)
+			{
+				// nothing after rule[j] can be dropped, so no more variables are needed
+				add (target, with ({ rule[j] }, j + 1, n));
+				if (prefix.size () > 0 || j + 1 < n) add (target, with ({}, j + 1, n));
+				break;
+			}
+			Variable rest = new_suffix_variable (prod.var);
+			add (target, with ({ rule[j], Token (false, rest) }, 0, 0));
+			add (target, with ({ Token (false, rest) }, 0, 0));
+			if (j + 1 >= nullable_from)
+			{
+				add (target, with ({ rule[j] }, 0, 0));
+				if (prefix.size () > 0) add (target, prefix);
+			}
+			target = rest;
+			i = j + 1;
 		}
-
-		if (isE) {}
 	}
 
-
+	if (e_token && nullable[res_grammar.start_symbol])
+		res_grammar.AddProduction (Production (res_grammar.start_symbol, Rule{ *e_token }));
 	return res_grammar;
 }
 
@@ -461,106 +623,68 @@ Grammar RemoveLeftRecursion (Grammar &eLess_Grammar)
 	Grammar res_grammar = eLess_Grammar;
 
 	// get a map of all variables with their relative priority (the order they appear in a left
-	// side variable)
+	// side variable), variables made along the way and ones looked up without productions of their
+	// own come in at 0
 	std::unordered_map<int, int> var_index_priority;
-	int priority = 0;
-	for (auto &prod : res_grammar.productions)
+	std::vector<Variable> by_priority;
+	for (auto &prod : res_grammar.Productions ())
 	{
-		// std::find (std::begin (var_index_priority), std::end (var_index_priority), prod.var);
-		auto it = var_index_priority.find (prod.var);
-		if (it != std::end (var_index_priority)) {}
-		else
+		if (var_index_priority.count (prod.var) == 0)
 		{
-			var_index_priority[prod.var] = priority++;
+			var_index_priority[prod.var] = by_priority.size ();
+			by_priority.push_back (prod.var);
 		}
 	}
 
 	// remove deep left recursion
+	int new_index = -1; // the variable the last iteration made
 	for (int priority = 0; priority < var_index_priority.size (); priority++)
 	{
-		int inner_priority = 0;
-		for (auto &prod : res_grammar.productions)
-		{
-			// std::find (std::begin (var_index_priority), std::end (var_index_priority), prod.var);
-			auto it = var_index_priority.find (prod.var);
-			if (it != std::end (var_index_priority)) {}
-			else
-			{
-				var_index_priority[prod.var] = inner_priority++;
-			}
-		}
+		if (new_index != -1 && var_index_priority.count (new_index) == 0) var_index_priority[new_index] = 0;
+		new_index = -1;
 
-		int index = -1;
-		for (auto [cur_key, cur_value] : var_index_priority)
-		{
-			if (priority == cur_value) index = cur_key;
-		}
+		int index = priority < by_priority.size () ? by_priority[priority] : -1;
 
-		fmt::print ("On iteration {}\n", priority);
+		if (massager_progress) fmt::print (massager_progress, "On iteration {}\n", priority);
 
-		bool keepSorting = true;
-		while (keepSorting)
+		// for each rule with Ai→αi, first the ones Ai has and then the ones substituting adds,
+		// which are all that going over Ai's rules again until nothing changes would find
+		std::vector<Production> var_productions = res_grammar.ProductionsOfVariable (index);
+		for (size_t i = 0; i < var_productions.size (); i++)
 		{
-			keepSorting = false;
+			Production prod = var_productions[i];
+			// if αi begins with nonterminal Aj and j<i
+			if (prod.rule.size () == 0 || prod.rule[0].isTerm || var_index_priority[prod.rule[0].index] >= priority)
+				continue;
 
+			// Let βi be αi without its leading Aj.
+			Variable Aj = prod.rule[0].index;
+			Rule r (std::begin (prod.rule) + 1, std::end (prod.rule));
 
-			// find prods with key as their starting variable;
-			std::vector<Production> var_productions;
+			// Remove the rule Ai→αi.
+			res_grammar.EraseProduction (prod);
 
-			for (auto &prod : res_grammar.productions)
+			// For each rule Aj→αj:
+			for (auto &j_prod : res_grammar.ProductionsOfVariable (Aj))
 			{
-				if (prod.var == index) var_productions.push_back (prod);
-			}
-			// for each rule with Ai→αi
-			for (auto &prod : var_productions)
-			{
-				// if αi begins with nonterminal Aj and j<i
-				if (prod.rule.size () > 0 && !prod.rule[0].isTerm
-				    && var_index_priority[prod.rule[0].index] < var_index_priority[index])
-				{
-					// Let βi be αi without its leading Aj.
-					Variable Aj = prod.rule[0].index;
-					Rule r = prod.rule;
-					r.erase (std::begin (r));
-
-					// Remove the rule Ai→αi.
-					auto it = std::find (
-					std::begin (res_grammar.productions), std::end (res_grammar.productions), prod);
-					if (it != std::end (res_grammar.productions))
-						res_grammar.productions.erase (it);
-
-
-					// Find Aj productions
-					std::vector<Production> Aj_prods;
-					for (auto &prod : res_grammar.productions)
-					{
-						if (prod.var == Aj) Aj_prods.push_back (prod);
-					}
-
-					// For each rule Aj→αj:
-					for (auto &j_prod : Aj_prods)
-					{
-						// Add the rule Ai→αjβi .
-						if (j_prod.rule.size () > 0)
-						{ //&& prod.rule[0].index == j_prod.var) {
-							Rule new_r = j_prod.rule;
-							new_r.insert (std::end (new_r), std::begin (r), std::end (r));
-
-							res_grammar.AddProduction (Production (prod.var, new_r));
-							keepSorting = true;
-						}
-					}
-				}
+				if (j_prod.rule.size () == 0) continue;
+
+				// Add the rule Ai→αjβi .
+				Production added (prod.var, j_prod.rule);
+				added.rule.insert (std::end (added.rule), std::begin (r), std::end (r));
+				if (res_grammar.ProductionExists (added)) continue;
+				res_grammar.AddProduction (added);
+				var_productions.push_back (added);
 			}
 		}
-		fmt::print ("Removing Left Recusion of {}\n", priority);
+		if (massager_progress) fmt::print (massager_progress, "Removing Left Recusion of {}\n", priority);
 
 		////////////////////// Remove Immediate left recursion //////////////////////////
 
 		bool hasILR = false;
-		for (auto &prod : res_grammar.productions)
+		for (auto &prod : res_grammar.ProductionsOfVariable (index))
 		{
-			if (prod.var == index && prod.rule.size () > 0 && !prod.rule[0].isTerm && prod.rule[0].index == index)
+			if (prod.rule.size () > 0 && !prod.rule[0].isTerm && prod.rule[0].index == index)
 			{ hasILR = true; } }
 
 		// only remove it if it has it
@@ -569,26 +693,24 @@ Grammar RemoveLeftRecursion (Grammar &eLess_Grammar)
 
 		// find all productions with this variable as its left side
 		std::vector<Production> prods;
-		for (auto &prod : res_grammar.productions)
+		for (auto &prod : res_grammar.ProductionsOfVariable (index))
 		{
-			if (prod.var == index && prod.rule.size () > 0) //&& !(*it).rule[0].isTerm && (*it).rule[0].index == var)
+			if (prod.rule.size () > 0) //&& !(*it).rule[0].isTerm && (*it).rule[0].index == var)
 			{ prods.push_back (prod); } }
 
 		for (auto &prod : prods)
 		{
-			auto it =
-			std::find (std::begin (res_grammar.productions), std::end (res_grammar.productions), prod);
-			if (it != std::end (res_grammar.productions)) { res_grammar.productions.erase (it); }
+			res_grammar.EraseProduction (prod);
 		}
 
-		fmt::print ("Immediately recursive {}\n", prods.size ());
+		if (massager_progress) fmt::print (massager_progress, "Immediately recursive {}\n", prods.size ());
 
 		if (prods.size () > 0)
 		{
 
 			// create a new variable
 
-			int new_index = res_grammar.DeriveNewVariable (index, "'");
+			new_index = res_grammar.DeriveNewVariable (index, "'");
 
 			// find the 'e' variable and add a new production for var_prime with e as its rule
 			int e_index = res_grammar.find_epsilon_index ();
@@ -597,7 +719,6 @@ Grammar RemoveLeftRecursion (Grammar &eLess_Grammar)
 			r.push_back (Token (false, e_index));
 			res_grammar.AddProduction (Production (new_index, r));
 
-			std::vector<Production> new_prods;
 			for (auto &prod : prods)
 			{
 				// For productions starting with var, make a new prod for var_prime
@@ -618,82 +739,122 @@ Grammar RemoveLeftRecursion (Grammar &eLess_Grammar)
 					res_grammar.AddProduction (Production (prod.var, r));
 				}
 			}
-
-			res_grammar.productions.insert (
-			std::end (res_grammar.productions), std::begin (new_prods), std::end (new_prods));
 			//}
 		}
 	}
 	return res_grammar;
 }
 
-Grammar RemoveXLeftFactoring (Grammar &in_grammar)
+// One variable's rules by their prefixes, each node knowing which rules go through it, in the
+// order they were added, and which one ends at it. Children are keyed by the symbol's key alone,
+// which no two symbols share.
+struct PrefixTrie
 {
-	Grammar res_grammar = in_grammar;
+	struct Node
+	{
+		std::map<int, int> children;
+		std::vector<int> rules;
+		int end = -1;
+	};
 
-	bool has_changed = true;
-	while (has_changed)
+	std::vector<Rule> rules;
+	std::vector<Node> nodes = std::vector<Node> (1);
+
+	// Returns the rule's index, the one it was given before when it's already there
+	int Add (Rule const &rule)
 	{
-		has_changed = false;
-		std::map<int, std::vector<Production>> num_variable_occurances;
-		for (auto &prod : res_grammar.productions)
+		int node = 0;
+		for (auto &token : rule)
 		{
-			int hash = prod.var * 10000 + prod.rule[0].index; // shouldn't be any collusions for small grammar sizes...
-			num_variable_occurances[hash].push_back (prod);
+			auto [it, added] = nodes[node].children.emplace (token.index, nodes.size ());
+			if (added) nodes.emplace_back ();
+			node = it->second;
 		}
-		for (auto &[key, prods] : num_variable_occurances)
+		if (nodes[node].end != -1) return nodes[node].end;
+
+		int id = rules.size ();
+		nodes[node].end = id;
+		rules.push_back (rule);
+		node = 0;
+		nodes[node].rules.push_back (id);
+		for (auto &token : rule)
 		{
-			if (prods.size () > 1)
-			{
+			node = nodes[node].children.at (token.index);
+			nodes[node].rules.push_back (id);
+		}
+		return id;
+	}
+};
 
-				has_changed = true;
-				// make new variable
-				int new_index = res_grammar.CreateNewVariable (prods.at (0).var, "'");
+/*
+Factors each variable from a trie of its rules. The rules under a child of the root share their
+first symbol, and following the child down until a rule ends or the rules branch gives their
+longest common prefix, which a new variable is made to follow. The new variables go on a queue to
+be factored the same way, so nothing goes over the whole grammar again, and taking the queue in
+order makes the same variables, in the same order, as repeating a pass over the grammar until
+nothing changes would.
+*/
+Grammar RemoveXLeftFactoring (Grammar &in_grammar)
+{
+	Grammar res_grammar = in_grammar;
 
+	std::vector<Variable> work;
+	for (auto &[key, value] : res_grammar.variables)
+		work.push_back (key);
+	for (int next = 0; next < work.size (); next++)
+	{
+		Variable var = work[next];
 
-				// remove original production
-				for (auto &prod : prods)
-				{
-					auto it = std::find (
-					std::begin (res_grammar.productions), std::end (res_grammar.productions), prod);
-					if (it != std::end (res_grammar.productions))
-						res_grammar.productions.erase (it);
-				}
+		PrefixTrie trie;
+		std::vector<int> copies; // by rule, how many productions the variable has with it
+		for (auto &prod : res_grammar.ProductionsOfVariable (var))
+		{
+			int id = trie.Add (prod.rule);
+			if (id == copies.size ()) copies.push_back (0);
+			copies[id]++;
+		}
 
-				// count number of repeated characters are at the front
-				int num_repeated = 0;
-				for (auto &token : prods[0].rule)
-				{
-					bool all_the_same = true;
-					for (auto &prod : prods)
-					{
-						if (prod.rule.size () <= num_repeated || !(prod.rule[num_repeated] == token))
-							all_the_same = false;
-					}
-					if (all_the_same)
-						num_repeated++;
-					else
-						break;
-				}
+		for (auto &[first, child] : trie.nodes[0].children)
+		{
+			auto &prods = trie.nodes[child].rules;
+			int count = 0;
+			for (int id : prods)
+				count += copies[id];
+			if (count < 2) continue;
+
+			// make new variable
+			int new_index = res_grammar.CreateNewVariable (var, "'");
+			work.push_back (new_index);
+
+			// remove original production
+			for (int id : prods)
+				for (int i = 0; i < copies[id]; i++)
+					res_grammar.EraseProduction (Production (var, trie.rules[id]));
+
+			// the longest common prefix ends where a rule does or the rules branch
+			int num_repeated = 1;
+			int node = child;
+			while (trie.nodes[node].end == -1 && trie.nodes[node].children.size () == 1)
+			{
+				node = std::begin (trie.nodes[node].children)->second;
+				num_repeated++;
+			}
 
-				// add replacement production with only the first token from rule
-				Rule rule;
-				rule.insert (std::end (rule), std::begin (prods[0].rule), std::begin (prods[0].rule) + num_repeated);
-				rule.push_back (Token (false, new_index));
-				res_grammar.AddProduction (Production (prods[0].var, rule));
+			// add replacement production with only the first token from rule
+			Rule &some_rule = trie.rules[prods[0]];
+			Rule rule (std::begin (some_rule), std::begin (some_rule) + num_repeated);
+			rule.push_back (Token (false, new_index));
+			res_grammar.AddProduction (Production (var, rule));
 
-				// Add new productions with
-				for (auto &prod : prods)
+			// Add new productions with
+			for (int id : prods)
+			{
+				Rule new_r (std::begin (trie.rules[id]) + num_repeated, std::end (trie.rules[id]));
+				if (new_r.size () == 0)
 				{
-					Rule new_r;
-					new_r.insert (
-					std::end (new_r), std::begin (prod.rule) + num_repeated, std::end (prod.rule));
-					if (new_r.size () == 0)
-					{
-						new_r.push_back (Token (false, res_grammar.find_epsilon_index ())); // insert epsilon
-					}
-					res_grammar.AddProduction (Production (new_index, new_r));
+					new_r.push_back (Token (false, res_grammar.find_epsilon_index ())); // insert epsilon
 				}
+				res_grammar.AddProduction (Production (new_index, new_r));
 			}
 		}
 	}
@@ -731,11 +892,11 @@ Grammar ReadGrammar (std::ifstream &in)
 			{
 				std::string str;
 				s >> str;
-				if (str.length () > 0) grammar.terminals[grammar.index++] = str;
+				if (str.length () > 0) grammar.AddTerminal (str);
 			}
 
 			// add a "EOF" terminal
-			grammar.terminals[grammar.index++] = "$";
+			grammar.AddTerminal ("$");
 		}
 		else if (line.size () > 0 && !isReadingProductionList)
 		{
@@ -745,24 +906,15 @@ Grammar ReadGrammar (std::ifstream &in)
 			s >> var_name;
 			if (var_name.size () > 0)
 			{
-				bool isNew = true;
-				for (auto [key, val] : grammar.variables)
-				{
-					if (var_name == val)
-					{
-						var_index = key;
-						isNew = false;
-					}
-				}
-				if (isNew)
+				var_index = grammar.FindVariable (var_name);
+				if (var_index == -1)
 				{
+					var_index = grammar.AddVariable (var_name);
 					if (hasFoundFirstVariable == false)
 					{
 						hasFoundFirstVariable = true;
-						grammar.start_symbol = grammar.index;
+						grammar.start_symbol = var_index;
 					}
-					var_index = grammar.index;
-					grammar.variables[grammar.index++] = var_name;
 				}
 			}
 		}
@@ -776,37 +928,20 @@ Grammar ReadGrammar (std::ifstream &in)
 				std::string str;
 				s >> str;
 
-				bool isTerm = false;
-				for (auto [key, val] : grammar.terminals)
+				int key = grammar.FindTerminal (str);
+				if (key != -1)
 				{
-					if (str == val)
-					{
-						rule.push_back (Token (true, key));
-						isTerm = true;
-					}
+					rule.push_back (Token (true, key));
 				}
-				if (isTerm == false)
+				else
 				{
-					bool isNew = true;
-					for (auto [key, val] : grammar.variables)
-					{
-						if (str == val)
-						{
-							rule.push_back (Token (false, key));
-							isNew = false;
-						}
-					}
-					if (isNew)
-					{
-						grammar.variables[grammar.index] = str;
-
-						rule.push_back (Token (false, grammar.index));
-						grammar.index++;
-					}
+					key = grammar.FindVariable (str);
+					if (key == -1) key = grammar.AddVariable (str);
+					rule.push_back (Token (false, key));
 				}
 			}
 
-			grammar.productions.push_back (Production (Variable (var_index), rule));
+			grammar.AppendProduction (Production (Variable (var_index), rule));
 		}
 		else if (line.size () == 0)
 		{
@@ -814,17 +949,75 @@ Grammar ReadGrammar (std::ifstream &in)
 		}
 	}
 
-	grammar.find_epsilon_index ();
-
 	return grammar;
 }
 
+bool SymbolBits::Any (int except) const
+{
+	for (int w = 0; w < words.size (); w++)
+	{
+		uint64_t word = words[w];
+		if (except != -1 && except / 64 == w) word &= ~(uint64_t (1) << (except % 64));
+		if (word != 0) return true;
+	}
+	return false;
+}
+
+bool SymbolBits::Merge (SymbolBits const &other, int except)
+{
+	bool grew = false;
+	for (int w = 0; w < words.size (); w++)
+	{
+		uint64_t more = other.words[w];
+		if (except != -1 && except / 64 == w) more &= ~(uint64_t (1) << (except % 64));
+		grew |= (words[w] | more) != words[w];
+		words[w] |= more;
+	}
+	return grew;
+}
+
 FirstsAndFollows::FirstsAndFollows (Grammar &grammar) : grammar (grammar)
 {
+	IndexSymbols ();
 	FindFirsts ();
 	FindFollows ();
 }
 
+void FirstsAndFollows::IndexSymbols ()
+{
+	int max_key = 0;
+	for (auto &[key, name] : grammar.terminals)
+		max_key = std::max (max_key, key);
+	for (auto &[key, name] : grammar.variables)
+		max_key = std::max (max_key, key);
+
+	variable_of.assign (max_key + 1, -1);
+	slot_of.assign (max_key + 1, -1);
+	for (auto &[key, name] : grammar.variables)
+	{
+		variable_of[key] = variable_keys.size ();
+		variable_keys.push_back (key);
+	}
+	for (auto &[key, name] : grammar.terminals)
+	{
+		slot_of[key] = slot_keys.size ();
+		slot_keys.push_back (key);
+	}
+	epsilon = grammar.find_epsilon_index ();
+	if (epsilon != -1)
+	{
+		slot_of[epsilon] = slot_keys.size ();
+		slot_keys.push_back (epsilon);
+	}
+}
+
+std::set<int> FirstsAndFollows::SymbolsOf (SymbolBits const &bits) const
+{
+	std::set<int> symbols;
+	bits.ForEach ([&] (int slot) { symbols.insert (slot_keys[slot]); });
+	return symbols;
+}
+
 /*
 1. If X is terminal, then FIRST(X) is {X}.
 2. If X -> e is a production, then add e to FIRST(X).
@@ -837,64 +1030,75 @@ FirstsAndFollows::FirstsAndFollows (Grammar &grammar) : grammar (grammar)
     add FIRST(Y2) and so on.
 */
 
+// Which variables derive e is found first, so a variable takes in the FIRST of the symbols of a
+// rule up to the first that doesn't. Each variable is recomputed from the variables its rules
+// start with when those change, rather than going over every production until nothing changes.
 void FirstsAndFollows::FindFirsts ()
 {
-	int epsilon = grammar.find_epsilon_index ();
-	std::set<int> e_vars;
+	int count = variable_keys.size ();
+	first_bits.assign (count, SymbolBits (slot_keys.size ()));
+	has_firsts.assign (count, false);
 
-	// 1. If X is terminal, then FIRST(X) is {X}.
-	for (auto [term, str] : grammar.terminals)
-	{
-		firsts[term].insert (term);
-	}
+	auto nullable = NullableVariables (grammar, grammar.Productions ());
+	int e_slot = epsilon != -1 ? slot_of[epsilon] : -1;
 
-	// get all the terminals first
-	for (auto &prod : grammar.productions)
+	// by variable, the variables whose FIRST takes in its FIRST
+	std::vector<std::vector<int>> dependents (count);
+	for (auto &prod : grammar.Productions ())
 	{
-		// 2. If X -> e is a production, then add e to FIRST(X).
-		if (grammar.isEProd (prod.rule))
+		int var = variable_of[prod.var];
+		// 2. If X -> e is a production, then add e to FIRST(X), and so for every X =*> e.
+		if (nullable[prod.var] && e_slot != -1)
 		{
-			firsts[prod.var].insert (epsilon);
-			if (epsilon != prod.var) e_vars.insert (prod.var);
+			first_bits[var].Set (e_slot);
+			has_firsts[var] = true;
 		}
-		// if X->a is a production and a is a terminal, then add a to FIRST(X) -- good optomization
-		if (prod.rule.size () > 0 && prod.rule.at (0).isTerm)
-		{ firsts[prod.var].insert (prod.rule.at (0).index); } }
-
-
-	bool hasChanged = true;
-	while (hasChanged)
-	{
-		hasChanged = false;
-
-		for (auto &prod : grammar.productions)
+		for (auto &token : prod.rule)
 		{
-			bool FailedEarly = false;
-			for (auto &token : prod.rule)
+			if (grammar.IsEpsilon (token)) continue;
+			// 1. If X is terminal, then FIRST(X) is {X}.
+			if (token.isTerm)
 			{
-				int size = firsts.count (prod.var) == 1 ? firsts.at (prod.var).size () : 0;
-				if (firsts.count (token.index) == 1)
-				{
-					firsts[prod.var].insert (
-					std::begin (firsts.at (token.index)), std::end (firsts.at (token.index)));
-				}
-				int after = firsts.count (prod.var) == 1 ? firsts.at (prod.var).size () : 0;
-				if (size != after) hasChanged = true; // loop until it doesn't change
-				if (e_vars.count (token.index) != 1)
-				{
-					FailedEarly = true;
-					break; // stop looping
-				}
+				first_bits[var].Set (slot_of[token.index]);
+				has_firsts[var] = true;
+				break;
 			}
-			if (!FailedEarly)
+			int y = variable_of[token.index];
+			dependents[y].push_back (var);
+			if (!nullable[token.index]) break;
+		}
+	}
+
+	std::vector<int> work;
+	std::vector<bool> queued (count);
+	for (int var = 0; var < count; var++)
+		if (has_firsts[var])
+		{
+			work.push_back (var);
+			queued[var] = true;
+		}
+	while (!work.empty ())
+	{
+		int y = work.back ();
+		work.pop_back ();
+		queued[y] = false;
+		for (int var : dependents[y])
+		{
+			// e only comes from nullable, not from the variables a rule starts with
+			bool grew = first_bits[var].Merge (first_bits[y], e_slot) || !has_firsts[var];
+			has_firsts[var] = true;
+			if (grew && !queued[var])
 			{
-				int size = firsts.count (prod.var) == 1 ? firsts.at (prod.var).size () : 0;
-				firsts[prod.var].insert (epsilon);
-				if (size != firsts.at (prod.var).size ())
-					hasChanged = true; // loop until it doesn't change}
+				work.push_back (var);
+				queued[var] = true;
 			}
 		}
 	}
+
+	for (auto &[term, str] : grammar.terminals)
+		firsts[term].insert (term);
+	for (int var = 0; var < count; var++)
+		if (has_firsts[var]) firsts[variable_keys[var]] = SymbolsOf (first_bits[var]);
 }
 /*
 1. Place $ in FOLLOW(S), where S is the start symbol and $ is the input right endmarker.
@@ -903,131 +1107,116 @@ void FirstsAndFollows::FindFirsts ()
 3. If there is a production A —> aB, or a production A -> aBB' where
     FIRST(B') contains e (i.e., B =*> e), then everything in FOLLOW(A)) is in FOLLOW(B).
 */
+// Rule 2 only depends on FIRST, so it is applied once. Rule 3 links FOLLOW(A) into FOLLOW(B), and
+// FOLLOW(B) is only recomputed when FOLLOW(A) changes. Both go over a rule right to left, carrying
+// FIRST of the symbols after B and whether they all derive e, so B' is every symbol after B rather
+// than only the next one.
 void FirstsAndFollows::FindFollows ()
 {
+	int count = variable_keys.size ();
+	int e_slot = epsilon != -1 ? slot_of[epsilon] : -1;
+	follow_bits.assign (count, SymbolBits (slot_keys.size ()));
+	has_follows.assign (count, false);
+
 	// 1. Place $ in FOLLOW(S), where S is the start symbol and $ is the input right endmarker.
-	int epsilon_index = grammar.find_epsilon_index ();
 	int eof = grammar.find_eof_index ();
-	follows[grammar.start_symbol].insert (eof);
+	int start = variable_of[grammar.start_symbol];
+	if (eof != -1) follow_bits[start].Set (slot_of[eof]);
+	has_follows[start] = true;
 
-	// 2. If there is a production A — > aBB', then everything in FIRST(B') except for
-	// e is placed in FOLLOW(B).
-	bool hasChanged = true;
-	while (hasChanged)
+	auto derives_e = [&] (int var) { return has_firsts[var] && e_slot != -1 && first_bits[var].Test (e_slot); };
+
+	// by variable A, the variables B whose FOLLOW takes in FOLLOW(A)
+	std::vector<std::vector<int>> dependents (count);
+	for (auto &prod : grammar.Productions ())
 	{
-		hasChanged = false;
+		auto &rule = prod.rule;
+		int var = variable_of[prod.var];
 
-		for (auto &prod : grammar.productions)
+		SymbolBits after (slot_keys.size ()); // FIRST(B') without e
+		bool after_derives_e = true;           // B' =*> e
+		for (int i = rule.size () - 1; i >= 0; i--)
 		{
-			for (int i = 0; i < prod.rule.size () - 1; i++)
+			auto &token = rule[i];
+			if (token.isTerm)
 			{
-				if (!prod.rule.at (i).isTerm && firsts.count (prod.rule.at (i + 1).index) == 1)
-				{
-					int size = follows.count (prod.rule.at (i).index) == 1 ?
-					           follows.at (prod.rule.at (i).index).size () :
-					           0;
-					for (auto &a : firsts.at (prod.rule.at (i + 1).index))
-					{
-						if (a != epsilon_index) follows[prod.rule.at (i).index].insert (a);
-					}
-					if (size != follows.at (prod.rule.at (i).index).size ()) { hasChanged = true; }
-				}
+				after = SymbolBits (slot_keys.size ());
+				after.Set (slot_of[token.index]);
+				after_derives_e = false;
+				continue;
 			}
-		}
-
-		// 3. If there is a production A — > aB then everything in FOLLOW(A) is in FOLLOW(B).
-		for (auto &prod : grammar.productions)
-		{
-			int i = prod.rule.size () - 1;
-			// for (int i = 1; i < prod.rule.size () - 1; i++)
+			int b = variable_of[token.index];
 
-			if (!prod.rule.at (i).isTerm && follows.count (prod.var) == 1)
-			{
-				int i_size = (follows.count (prod.rule.at (i).index) == 1) ?
-				             follows.at (prod.rule.at (i).index).size () :
-				             0;
+			// 2. If there is a production A — > aBB', then everything in FIRST(B') except for
+			// e is placed in FOLLOW(B).
+			follow_bits[b].Merge (after, e_slot);
+			if (after.Any (e_slot)) has_follows[b] = true;
 
-				follows[prod.rule.at (i).index].insert (
-				std::begin (follows.at (prod.var)), std::end (follows.at (prod.var)));
+			// 3. If there is a production A — > aB, or a production A -> aBB' where
+			// FIRST(B') contains e (i.e., B' =*> e), then everything in FOLLOW(A) is in FOLLOW(B).
+			if (after_derives_e) dependents[var].push_back (b);
 
-				if (i_size != follows.at (prod.rule.at (i).index).size ()) { hasChanged = true; }
+			if (token.index == epsilon) continue;
+			if (!derives_e (b))
+			{
+				after = SymbolBits (slot_keys.size ());
+				after_derives_e = false;
 			}
-			//}
+			if (has_firsts[b]) after.Merge (first_bits[b], e_slot);
 		}
+	}
 
-		// 3. If there is a production  A->aBB' where
-		//	FIRST(B') contains e (i.e., B' =*> e) then everything in FOLLOW(A) is in FOLLOW(B).
-		for (auto &prod : grammar.productions)
+	std::vector<int> work;
+	std::vector<bool> queued (count);
+	for (int var = 0; var < count; var++)
+		if (has_follows[var])
 		{
-			if (prod.rule.size () > 1)
+			work.push_back (var);
+			queued[var] = true;
+		}
+	while (!work.empty ())
+	{
+		int var = work.back ();
+		work.pop_back ();
+		queued[var] = false;
+		for (int b : dependents[var])
+		{
+			bool grew = follow_bits[b].Merge (follow_bits[var]) || !has_follows[b];
+			has_follows[b] = true;
+			if (grew && !queued[b])
 			{
-				for (int i = 0; i < prod.rule.size () - 1; i++)
-				{
-
-					Rule b_rule;
-					b_rule.insert (std::end (b_rule), std::begin (prod.rule) + 1, std::end (prod.rule));
-					auto b_firsts = GetFirstsOfRule (b_rule, epsilon_index);
-
-					bool has_epsilon = false;
-					for (auto &tok : b_firsts)
-					{
-						if (tok == epsilon_index) has_epsilon = true;
-					}
-
-					if (has_epsilon)
-					{
-
-						if (!prod.rule.at (i).isTerm && follows.count (prod.var) == 1)
-						{
-
-							int i_size = follows.count (prod.rule.at (i).index) == 1 ?
-							             follows.at (prod.rule.at (i).index).size () :
-							             0;
-
-							follows[prod.rule.at (i).index].insert (
-							std::begin (follows.at (prod.var)), std::end (follows.at (prod.var)));
-
-							if (i_size != follows.at (prod.rule.at (i).index).size ())
-							{ hasChanged = true; } }
-					}
-
-					/*int size = i;
-					if (size > 1 && !prod.rule.at (i).isTerm && firsts.count (prod.rule.at (i + 1).index) == 1
-					    && firsts.at (prod.rule.at (i + 1).index).count (epsilon_index) == 1
-					    && follows.count (prod.var) == 1)
-					{
-					    int i_size = follows.count (prod.rule.at (i).index) == 1 ?
-					                 follows.at (prod.rule.at (i).index).size () :
-					                 0;
-
-					    follows[prod.rule.at (i).index].insert (
-					    std::begin (follows.at (prod.var)), std::end (follows.at (prod.var)));
-
-					    if (i_size != follows.at (prod.rule.at (i).index).size ())
-					    { hasChanged = true; } }*/
-				}
+				work.push_back (b);
+				queued[b] = true;
 			}
 		}
 	}
+
+	for (int var = 0; var < count; var++)
+		if (has_follows[var]) follows[variable_keys[var]] = SymbolsOf (follow_bits[var]);
 }
 
-std::set<int> FirstsAndFollows::GetFirstsOfRule (Rule &rule, int epsilon_index)
+std::set<int> FirstsAndFollows::GetFirstsOfRule (Rule const &rule, int epsilon_index)
 {
 	std::set<int> ret;
 
+	// e is only in FIRST of the rule when every symbol of it derives e
 	for (auto &tok : rule)
 	{
-		if (tok.index != epsilon_index)
-			ret.insert (std::begin (firsts.at (tok.index)), std::end (firsts.at (tok.index)));
+		if (tok.index == epsilon_index) continue;
+		auto found = firsts.find (tok.index);
+		if (found == std::end (firsts)) return ret;
 
 		bool has_epsilon = false;
-		if (tok.index != epsilon_index)
-			for (auto &first : firsts.at (tok.index))
-			{
-				if (first == epsilon_index) has_epsilon = true;
-			}
-		if (!has_epsilon) break;
+		for (auto &first : found->second)
+		{
+			if (first == epsilon_index)
+				has_epsilon = true;
+			else
+				ret.insert (first);
+		}
+		if (!has_epsilon) return ret;
 	}
+	ret.insert (epsilon_index);
 	return ret;
 }
 
@@ -1150,7 +1339,7 @@ ParseTable::ParseTable (Grammar &grammar) : grammar (grammar), firstAndFollows (
 	// pre-bucket all the productions per key. Just removes needless searching in first
 	// calculation which could be heavily recursive...
 	std::map<int, std::vector<Production>> var_productions;
-	for (auto &prod : grammar.productions)
+	for (auto &prod : grammar.Productions ())
 	{
 		if (prod.var != e_index) // stupid special cases
 			var_productions[prod.var].push_back (prod);
@@ -1158,7 +1347,7 @@ ParseTable::ParseTable (Grammar &grammar) : grammar (grammar), firstAndFollows (
 
 	// 1. For each production A -> a' of the grammar, do steps 2 and 3.
 	index = 0;
-	for (auto &prod : grammar.productions)
+	for (auto &prod : grammar.Productions ())
 	{
 		// 2. For each terminal a in FIRST(a'), add A->a' to M[A, a].
 
@@ -1223,13 +1412,13 @@ ParseTable::ParseTable (Grammar &grammar) : grammar (grammar), firstAndFollows (
 	//}
 
 	// find all epsilon production variables
-	/*for (auto &prod : grammar.productions)
+	/*for (auto &prod : grammar.Productions ())
 	{
 	    if (prod.rule.size () > 0 && prod.rule.at (0).index == e_index)
 	    { e_prods[prod.var] = true; } }*/
 
 	// index = 0;
-	// for (auto &prod : grammar.productions)
+	// for (auto &prod : grammar.Productions ())
 	//{
 	//	if (prod.rule.at (0).isTerm)
 	//	{
@@ -1319,8 +1508,8 @@ void ParseTable::PrettyPrintParseTableCSV (std::string out_file_name)
 				for (auto &index : terms)
 				{
 					fmt::print (
-					ofh.FP (), "{} -> ", grammar.variables.at (grammar.productions.at (index).var));
-					for (auto &token : grammar.productions.at (index).rule)
+					ofh.FP (), "{} -> ", grammar.variables.at (grammar.Productions ().at (index).var));
+					for (auto &token : grammar.Productions ().at (index).rule)
 					{
 						if (token.isTerm)
 						{
@@ -1342,7 +1531,7 @@ void ParseTable::PrettyPrintParseTableCSV (std::string out_file_name)
 	}
 }
 
-void MassageGrammar (std::string grammar_fileName, std::string out_name = std::string ("grammar_"))
+void MassageGrammar (std::string grammar_fileName, std::string out_name, EpsilonRemoval epsilon_removal)
 {
 	std::ifstream in (grammar_fileName, std::ios::in);
 	if (!in.is_open ()) { fmt::print ("failed to open {}\n", grammar_fileName); }
@@ -1353,7 +1542,10 @@ void MassageGrammar (std::string grammar_fileName, std::string out_name = std::s
 		auto grammar = ReadGrammar (in);
 		grammar.PrintGrammar (out_name + "_original.txt"s);
 
-		auto eLess_Grammar = RemoveEProds (grammar);
+		size_t peak_before = PeakMemoryBytes ();
+		auto eLess_Grammar = epsilon_removal == EpsilonRemoval::linear ? BetterRemoveEpsilonProductions (grammar) : RemoveEProds (grammar);
+		if (massager_log)
+			fmt::print (massager_log, "Removed e productions, {} productions from {}, peak memory {:.1f} MB before, {:.1f} MB after\n", eLess_Grammar.Productions ().size (), grammar.Productions ().size (), peak_before / 1e6, PeakMemoryBytes () / 1e6);
 		eLess_Grammar.PrintGrammar (out_name + "_epsilon.txt"s);
 
 		auto ll_less_Grammar = RemoveLeftRecursion (eLess_Grammar);
@@ -1370,10 +1562,3 @@ void MassageGrammar (std::string grammar_fileName, std::string out_name = std::s
 		parse_table.firstAndFollows.PrintWithGrammar (out_name + "_ff_grammar.txt"s);
 	}
 }
-
-int main ()
-{
-	// MassageGrammar ("grammars/simple.txt", "simple");
-	MassageGrammar ("grammars/grammar_shorthand.txt", "pascal");
-	return 0;
-}
\ No newline at end of file
@@ -52,16 +52,28 @@ struct Production
 	}
 };
 
+// Hashes what Production's == compares, the variable and the keys of its rule's symbols
+struct ProductionHash
+{
+	size_t operator() (Production const &p) const;
+};
+
 class Grammar
 {
 	public:
+	// Read only outside of Grammar, AddTerminal and AddVariable keep the name indexes in step
 	std::map<int, std::string> terminals;
 	std::map<int, std::string> variables;
-	std::vector<Production> productions;
 
 	int start_symbol = 0; // should generally be the first production...
 	int index = 0;
 
+	int AddTerminal (std::string const &name);
+	int AddVariable (std::string const &name);
+	// The key of the symbol with the name, or -1
+	int FindTerminal (std::string const &name) const;
+	int FindVariable (std::string const &name) const;
+
 	void PrintTokenList(FILE *fp);
 
 	void PrintGrammar (std::string out_file_name);
@@ -69,25 +81,75 @@ class Grammar
 
 	int DeriveNewVariable (Variable var, std::string str);
 	int CreateNewVariable (Variable var, std::string str);
-	bool isEProd (Rule &rule) const;
+	bool isEProd (Rule const &rule) const;
+	bool IsEpsilon (Token const &token) const;
 
 	int find_epsilon_index () const;
 	int find_eof_index () const;
 
 	std::vector<Terminal> find_firsts_of_production (Production &prod);
 
-	bool ProductionExists (Production &p) const;
+	bool ProductionExists (Production const &p) const;
 
+	// Adds p unless an equal production is already there
 	void AddProduction (Production p);
-
-	void EraseProduction (Production &p);
+	// Adds p even if it's already there
+	void AppendProduction (Production p);
+	// Erases the first production equal to p
+	void EraseProduction (Production const &p);
 
 	void ReorderProductionsByVariable ();
 	void RemoveDuplicateProductions ();
+	void ClearProductions ();
 
+	// Every production in the order they were added, less the erased ones
+	std::vector<Production> const &Productions ();
 	std::vector<Production> ProductionsOfVariable (Variable var) const;
+	// Where var's productions are in Productions ()
+	std::vector<int> ProductionIndexesOf (Variable var);
 
 	std::map<int, std::string> ProperIndexes();
+
+	private:
+	int FindSlot (Production const &p) const;
+	void Compact ();
+
+	// Erasing only marks a slot, the slots are packed again before productions is handed out
+	std::vector<Production> productions;
+	std::vector<bool> erased;
+	int erased_count = 0;
+	std::unordered_multimap<size_t, int> slots_by_hash; // live slots only
+	std::vector<std::vector<int>> buckets;              // by variable key, its slots in order
+
+	std::unordered_map<std::string, int> terminal_keys;
+	std::unordered_map<std::string, int> variable_keys;
+	// by a name CreateNewVariable found taken and the str it was adding, the name it went on to
+	std::unordered_map<std::string, std::string> taken_names;
+	int epsilon = -1;
+	int epsilon_terminal = -1;
+	int eof = -1;
+};
+
+// A dense set over the slots FirstsAndFollows gives the terminals and e
+class SymbolBits
+{
+	public:
+	SymbolBits (int slots = 0) : words ((slots + 63) / 64) {}
+
+	void Set (int slot) { words[slot / 64] |= uint64_t (1) << (slot % 64); }
+	bool Test (int slot) const { return words[slot / 64] >> (slot % 64) & 1; }
+	// Both leave out the slot except, when it isn't -1. Merge returns whether anything was added.
+	bool Any (int except = -1) const;
+	bool Merge (SymbolBits const &other, int except = -1);
+	template <typename F> void ForEach (F f) const
+	{
+		for (int w = 0; w < words.size (); w++)
+			for (int b = 0; b < 64 && words[w] >> b != 0; b++)
+				if (words[w] >> b & 1) f (w * 64 + b);
+	}
+
+	private:
+	std::vector<uint64_t> words;
 };
 
 class FirstsAndFollows
@@ -98,7 +160,7 @@ class FirstsAndFollows
 	void FindFirsts ();
 	void FindFollows ();
 
-	std::set<int> GetFirstsOfRule(Rule& rule, int epsilon_index);
+	std::set<int> GetFirstsOfRule(Rule const &rule, int epsilon_index);
 
 	void PrintFirst(FILE *fp, int key);
 	void PrintFollow(FILE *fp, int key);
@@ -110,6 +172,22 @@ class FirstsAndFollows
 	std::map<int, std::set<int>> follows;
 
 	Grammar &grammar;
+
+	private:
+	void IndexSymbols ();
+	std::set<int> SymbolsOf (SymbolBits const &bits) const;
+
+	int epsilon = -1;
+	std::vector<int> variable_of; // by symbol key, the variable's dense index or -1
+	std::vector<int> slot_of;     // by symbol key, the terminal's (or e's) bit or -1
+	std::vector<int> variable_keys;
+	std::vector<int> slot_keys;
+
+	// by dense variable index; a variable only has a set in firsts or follows once has_ says so
+	std::vector<SymbolBits> first_bits;
+	std::vector<SymbolBits> follow_bits;
+	std::vector<bool> has_firsts;
+	std::vector<bool> has_follows;
 };
 
 struct ParseTable
@@ -127,4 +205,26 @@ struct ParseTable
 
 	// row-var, col-terminal, inner is for possible multiple entries
 	std::vector<std::vector<std::set<int>>> table;
-};
\ No newline at end of file
+};
+// Where the transformations below report their progress, nullptr for nowhere
+extern FILE *massager_log;
+// Where RemoveLeftRecursion reports each variable it works through, and CalcOutputOrder where it
+// puts each primed variable, nullptr (the default) for nowhere
+extern FILE *massager_progress;
+
+Grammar ReadGrammar (std::ifstream &in);
+Grammar RemoveEProds (Grammar &grammar);
+// Removes e productions in time and space linear in the grammar, adding a variable per nullable
+// symbol that has more of them after it rather than a production per subset of them
+Grammar BetterRemoveEpsilonProductions (Grammar &in_grammar);
+Grammar RemoveLeftRecursion (Grammar &eLess_Grammar);
+Grammar RemoveXLeftFactoring (Grammar &in_grammar);
+
+enum class EpsilonRemoval
+{
+	permute, // RemoveEProds
+	linear   // BetterRemoveEpsilonProductions
+};
+
+// Runs grammar_fileName through every transformation, writing each step to out_name_*.txt
+void MassageGrammar (std::string grammar_fileName, std::string out_name = std::string ("grammar_"), EpsilonRemoval epsilon_removal = EpsilonRemoval::permute);
@@ -0,0 +1,372 @@
+#include "lalr_table.h"
+
+#include "grammar_massager.h"
+#include "ll1_table.h"
+
+namespace
+{
+// A production with a dot before its symbol at dot
+struct LRItem
+{
+	int production;
+	int dot;
+
+	bool operator< (LRItem const &rhs) const { return production != rhs.production ? production < rhs.production : dot < rhs.dot; }
+};
+
+struct LRState
+{
+	std::vector<LRItem> items;      // the kernel, then its closure
+	std::map<int, int> transitions; // by symbol, the state it goes to
+};
+
+// DeRemer and Pennello's digraph: each x's set grows by the sets of all it reaches through
+// relation, so a cycle of them ends up with one set between them
+void Digraph (std::vector<std::vector<int>> const &relation, std::vector<SymbolBits> &sets)
+{
+	int count = sets.size ();
+	int done = count + 1;
+	std::vector<int> depth (count, 0);
+	std::vector<int> stack;
+	std::function<void (int)> traverse = [&] (int x) {
+		stack.push_back (x);
+		int d = stack.size ();
+		depth[x] = d;
+		for (int y : relation[x])
+		{
+			if (depth[y] == 0) traverse (y);
+			depth[x] = std::min (depth[x], depth[y]);
+			sets[x].Merge (sets[y]);
+		}
+		if (depth[x] != d) return;
+		while (true)
+		{
+			int top = stack.back ();
+			stack.pop_back ();
+			depth[top] = done;
+			if (top == x) break;
+			sets[top] = sets[x];
+		}
+	};
+	for (int x = 0; x < count; x++)
+		if (depth[x] == 0) traverse (x);
+}
+} // namespace
+
+std::optional<LALRTable> LoadLALRTable (std::string const &grammar_file, std::string &error)
+{
+	std::ifstream in (grammar_file, std::ios::in);
+	if (!in.is_open ())
+	{
+		error = "Could not open " + grammar_file;
+		return {};
+	}
+	auto grammar = ReadGrammar (in);
+	if (!CheckTableGrammar (grammar, grammar_file, error)) return {};
+
+	LALRTable table;
+	std::set<int> defined;
+	for (auto &prod : grammar.Productions ())
+		defined.insert (prod.var);
+	std::map<int, int> nonterminal_of; // by the grammar's key
+	for (auto &[key, name] : grammar.variables)
+	{
+		if (defined.count (key) == 0) continue;
+		nonterminal_of[key] = table.nonterminals.size ();
+		table.nonterminals.push_back (name);
+	}
+	std::map<int, int> terminal_of;
+	for (auto &[key, name] : grammar.terminals)
+	{
+		if (grammar.IsEpsilon (Token (true, key))) continue;
+		TTSet tokens = TerminalTokenTypes (name);
+		if (tokens == 0)
+		{
+			error = "No token type for the terminal '" + name + "' of " + grammar_file;
+			return {};
+		}
+		terminal_of[key] = table.terminals.size ();
+		table.terminals.push_back (name);
+		table.terminal_tokens.push_back (tokens);
+	}
+	table.start = nonterminal_of.at (grammar.start_symbol);
+	table.end_of_file = terminal_of.at (grammar.find_eof_index ());
+
+	// symbols from here on are a terminal's index, or a nonterminal's after all the terminals
+	int terminal_count = table.terminals.size ();
+	int nonterminal_count = table.nonterminals.size ();
+	std::vector<std::vector<int>> rules;
+	std::vector<std::vector<int>> productions_of (nonterminal_count);
+	for (auto &prod : grammar.Productions ())
+	{
+		LRProduction production{ nonterminal_of.at (prod.var) };
+		production.text = grammar.variables.at (prod.var) + " ->";
+		std::vector<int> rule;
+		for (auto &token : prod.rule)
+		{
+			if (token.isTerm)
+				production.text += " '" + grammar.terminals.at (token.index) + "'";
+			else
+				production.text += " " + grammar.variables.at (token.index);
+			if (grammar.IsEpsilon (token)) continue;
+			if (!token.isTerm && nonterminal_of.count (token.index) == 0)
+			{
+				error = "The nonterminal '" + grammar.variables.at (token.index) + "' of " + grammar_file + " has no productions";
+				return {};
+			}
+			production.rule.push_back (token.isTerm ? LRSymbol{ true, terminal_of.at (token.index) } : LRSymbol{ false, nonterminal_of.at (token.index) });
+			rule.push_back (token.isTerm ? production.rule.back ().index : terminal_count + production.rule.back ().index);
+		}
+		productions_of[production.nonterminal].push_back (rules.size ());
+		rules.push_back (std::move (rule));
+		table.productions.push_back (std::move (production));
+	}
+	// S' -> S, which only ever accepts
+	int accepting = rules.size ();
+	rules.push_back ({ terminal_count + table.start });
+
+	// LR(0) item sets, each kernel found once
+	std::vector<LRState> states;
+	std::map<std::vector<LRItem>, int> state_of; // by kernel
+	auto state_for = [&] (std::vector<LRItem> kernel) {
+		auto it = state_of.find (kernel);
+		if (it != std::end (state_of)) return it->second;
+		int state = states.size ();
+		state_of[kernel] = state;
+		states.push_back (LRState{ std::move (kernel) });
+		return state;
+	};
+	state_for ({ LRItem{ accepting, 0 } });
+	for (int s = 0; s < states.size (); s++)
+	{
+		std::vector<LRItem> items = states[s].items;
+		std::vector<bool> closed (nonterminal_count);
+		for (int i = 0; i < items.size (); i++)
+		{
+			auto &rule = rules[items[i].production];
+			if (items[i].dot == rule.size () || rule[items[i].dot] < terminal_count) continue;
+			int nonterminal = rule[items[i].dot] - terminal_count;
+			if (closed[nonterminal]) continue;
+			closed[nonterminal] = true;
+			for (int p : productions_of[nonterminal])
+				items.push_back (LRItem{ p, 0 });
+		}
+
+		std::map<int, std::vector<LRItem>> kernels; // by the symbol after the dot
+		for (auto &item : items)
+			if (item.dot < rules[item.production].size ())
+				kernels[rules[item.production][item.dot]].push_back (LRItem{ item.production, item.dot + 1 });
+		std::map<int, int> transitions;
+		for (auto &[symbol, kernel] : kernels)
+		{
+			std::sort (std::begin (kernel), std::end (kernel));
+			transitions[symbol] = state_for (kernel);
+		}
+		states[s].items = std::move (items);
+		states[s].transitions = std::move (transitions);
+	}
+
+	std::vector<bool> nullable (nonterminal_count);
+	for (bool changed = true; changed;)
+	{
+		changed = false;
+		for (int p = 0; p < table.productions.size (); p++)
+		{
+			int nonterminal = table.productions[p].nonterminal;
+			if (nullable[nonterminal]) continue;
+			bool all = true;
+			for (int symbol : rules[p])
+				all = all && symbol >= terminal_count && nullable[symbol - terminal_count];
+			if (all) nullable[nonterminal] = changed = true;
+		}
+	}
+	auto is_nullable = [&] (int symbol) { return symbol >= terminal_count && nullable[symbol - terminal_count]; };
+
+	// The transitions on nonterminals, which the lookaheads are worked out over
+	std::vector<std::pair<int, int>> transitions; // state, nonterminal
+	std::vector<std::map<int, int>> transition_of (states.size ()); // by state and nonterminal
+	for (int s = 0; s < states.size (); s++)
+		for (auto &[symbol, to] : states[s].transitions)
+			if (symbol >= terminal_count)
+			{
+				transition_of[s][symbol - terminal_count] = transitions.size ();
+				transitions.emplace_back (s, symbol - terminal_count);
+			}
+
+	// DR, what the state a transition goes to shifts, and reads, the transitions on nullable
+	// nonterminals from it, make Read. The start's transition from the first state reads the end of
+	// the file, as though S' -> S $.
+	std::vector<SymbolBits> follows (transitions.size (), SymbolBits (terminal_count));
+	std::vector<std::vector<int>> reads (transitions.size ());
+	for (int x = 0; x < transitions.size (); x++)
+	{
+		auto [from, nonterminal] = transitions[x];
+		int to = states[from].transitions.at (terminal_count + nonterminal);
+		for (auto &[symbol, next] : states[to].transitions)
+		{
+			if (symbol < terminal_count)
+				follows[x].Set (symbol);
+			else if (nullable[symbol - terminal_count])
+				reads[x].push_back (transition_of[to].at (symbol - terminal_count));
+		}
+		if (from == 0 && nonterminal == table.start) follows[x].Set (table.end_of_file);
+	}
+	Digraph (reads, follows);
+
+	// (p, A) includes (p', B) when B -> b A c with c nullable and b going from p' to p; a reduction
+	// by B -> w in q looks back at (p', B) when w goes from p' to q
+	std::vector<std::vector<int>> includes (transitions.size ());
+	std::map<std::pair<int, int>, std::vector<int>> lookbacks; // by state and production
+	for (int x = 0; x < transitions.size (); x++)
+	{
+		auto [from, nonterminal] = transitions[x];
+		for (int p : productions_of[nonterminal])
+		{
+			auto &rule = rules[p];
+			int nullable_from = rule.size ();
+			while (nullable_from > 0 && is_nullable (rule[nullable_from - 1]))
+				nullable_from--;
+			int state = from;
+			for (int i = 0; i < rule.size (); i++)
+			{
+				if (rule[i] >= terminal_count && i + 1 >= nullable_from)
+					includes[transition_of[state].at (rule[i] - terminal_count)].push_back (x);
+				state = states[state].transitions.at (rule[i]);
+			}
+			lookbacks[{ state, p }].push_back (x);
+		}
+	}
+	Digraph (includes, follows);
+
+	auto describe = [&] (LRAction action) {
+		if (action.kind == LRAction::shift) return fmt::format ("shift to {}", action.target);
+		if (action.kind == LRAction::reduce) return "reduce by " + table.productions[action.target].text;
+		return std::string (action.kind == LRAction::accept ? "accept" : "error");
+	};
+	// a shift or accept over a reduce, the earlier production of two reduces, the first of two shifts
+	auto put = [&] (LRAction &cell, LRAction action, int state, std::string const &on) {
+		if (cell.kind == LRAction::error || cell == action)
+		{
+			cell = action;
+			return;
+		}
+		LRAction kept = cell;
+		if (action.kind != LRAction::reduce && cell.kind == LRAction::reduce) kept = action;
+		if (action.kind == LRAction::reduce && cell.kind == LRAction::reduce) kept.target = std::min (cell.target, action.target);
+		table.conflicts.push_back (fmt::format ("state {} on {}: {} or {}, kept {}", state, on, describe (cell), describe (action), describe (kept)));
+		cell = kept;
+	};
+
+	table.states = states.size ();
+	table.actions.assign (table.states * tt_count, LRAction{});
+	table.gotos.assign (table.states * nonterminal_count, -1);
+	for (int s = 0; s < states.size (); s++)
+	{
+		std::vector<LRAction> row (terminal_count);
+		for (auto &[symbol, to] : states[s].transitions)
+		{
+			if (symbol < terminal_count)
+				row[symbol] = LRAction{ LRAction::shift, to };
+			else
+				table.gotos[s * nonterminal_count + symbol - terminal_count] = to;
+		}
+		for (auto &item : states[s].items)
+		{
+			if (item.dot < rules[item.production].size ()) continue;
+			if (item.production == accepting)
+			{
+				put (row[table.end_of_file], LRAction{ LRAction::accept }, s, "'$'");
+				continue;
+			}
+			SymbolBits lookaheads (terminal_count);
+			for (int x : lookbacks[{ s, item.production }])
+				lookaheads.Merge (follows[x]);
+			lookaheads.ForEach ([&] (int t) {
+				put (row[t], LRAction{ LRAction::reduce, item.production }, s, "'" + table.terminals[t] + "'");
+			});
+		}
+
+		// a token type two terminals stand for can only be one of them here
+		for (int t = 0; t < terminal_count; t++)
+		{
+			if (row[t].kind == LRAction::error) continue;
+			for (int tt = 0; tt < tt_count; tt++)
+				if (table.terminal_tokens[t] & TTBit (TT (tt)))
+					put (table.actions[s * tt_count + tt], row[t], s, std::string ("TT::") + TTIdentifier (TT (tt)));
+		}
+	}
+	return table;
+}
+
+bool WriteLALRHeader (LALRTable const &table, std::string const &grammar_file, std::string const &out_file, std::string &error)
+{
+	if (table.states > INT16_MAX)
+	{
+		error = fmt::format ("{} has {} states, more than the header's tables can hold", grammar_file, table.states);
+		return false;
+	}
+	int count = table.nonterminals.size ();
+
+	fmt::memory_buffer out;
+	auto put = [&] (auto &&... args) { fmt::format_to (std::back_inserter (out), args...); };
+
+	put ("// Generated by the massager from {}, don't edit.\n", grammar_file);
+	put ("// The LALR(1) tables of the grammar as written, for a shift-reduce parser: what to do in each\n");
+	put ("// state on each token type, and which state to go to after reducing to a nonterminal.\n");
+	if (table.conflicts.empty ()) put ("// No conflicts.\n");
+	else put ("// {} conflicts:\n", table.conflicts.size ());
+	for (auto &conflict : table.conflicts)
+		put ("//   {}\n", conflict);
+	put ("\n#pragma once\n\n#include \"lalr_table.h\"\n\nnamespace LALRTables\n{{\n");
+	put ("constexpr int nonterminal_count = {};\nconstexpr int state_count = {};\n\n", count, table.states);
+
+	put ("constexpr const char *nonterminal_names[] = {{\n");
+	for (auto &name : table.nonterminals)
+		put ("\t{},\n", StringLiteral (name));
+	put ("}};\n\n");
+
+	put ("constexpr LRGeneratedProduction productions[] = {{\n");
+	for (auto &production : table.productions)
+		put ("\t{{ {}, {}, {} }},\n", production.nonterminal, production.rule.size (), StringLiteral (production.text));
+	put ("}};\n\n");
+
+	put ("// By state * tt_count + TT\nconstexpr LRAction actions[] = {{\n");
+	for (int s = 0; s < table.states; s++)
+	{
+		put ("\t");
+		for (int tt = 0; tt < tt_count; tt++)
+		{
+			auto action = table.actions[s * tt_count + tt];
+			if (action.kind == LRAction::error)
+				put ("{{}}, ");
+			else if (action.kind == LRAction::accept)
+				put ("{{ LRAction::accept }}, ");
+			else
+				put ("{{ LRAction::{}, {} }}, ", action.kind == LRAction::shift ? "shift" : "reduce", action.target);
+		}
+		put ("// {}\n", s);
+	}
+	put ("}};\n\n");
+
+	put ("// By state * nonterminal_count + nonterminal, the state after reducing to it or -1\nconstexpr int16_t gotos[] = {{\n");
+	for (int s = 0; s < table.states; s++)
+	{
+		put ("\t");
+		for (int n = 0; n < count; n++)
+			put ("{}, ", table.gotos[s * count + n]);
+		put ("// {}\n", s);
+	}
+	put ("}};\n\n");
+
+	put ("constexpr int start = {}; // {}\n", table.start, table.nonterminals[table.start]);
+	put ("}} // namespace LALRTables\n");
+
+	std::ofstream file (out_file, std::ios::out | std::ios::binary);
+	file.write (out.data (), out.size ());
+	if (!file)
+	{
+		error = "Could not write " + out_file;
+		return false;
+	}
+	return true;
+}
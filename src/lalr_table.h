@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "lexer.h"
+
+struct LRSymbol
+{
+	bool terminal;
+	int index; // into LALRTable::terminals or LALRTable::nonterminals
+};
+
+struct LRProduction
+{
+	int nonterminal;
+	std::vector<LRSymbol> rule; // empty for an e production
+	std::string text;           // "term -> term 'mulop' factor"
+};
+
+// What a shift-reduce parser does in a state on a token type
+struct LRAction
+{
+	enum Kind : uint8_t
+	{
+		error,
+		shift,  // to the state target
+		reduce, // by the production target
+		accept
+	};
+	Kind kind = error;
+	int target = 0;
+
+	bool operator== (LRAction const &rhs) const { return kind == rhs.kind && target == rhs.target; }
+	bool operator!= (LRAction const &rhs) const { return !(*this == rhs); }
+};
+
+// The LALR(1) tables of a grammar as written, with the grammar's terminals replaced by the token
+// types the lexer gives for them
+struct LALRTable
+{
+	std::vector<std::string> nonterminals;
+	std::vector<std::string> terminals;
+	std::vector<TTSet> terminal_tokens; // by terminal, the token types it stands for
+	std::vector<LRProduction> productions;
+	int states = 0;
+	std::vector<LRAction> actions; // by state * tt_count + TT
+	std::vector<int> gotos;        // by state * nonterminals.size () + nonterminal, the state or -1
+	int start = 0;                 // nonterminal
+	int end_of_file = 0;           // terminal
+
+	// Every cell that had more than one action, from the grammar or from terminals the lexer gives
+	// the same token type for, and which one it kept
+	std::vector<std::string> conflicts;
+
+	LRAction Action (int state, TT tt) const { return actions[state * tt_count + static_cast<int> (tt)]; }
+	int Goto (int state, int nonterminal) const { return gotos[state * nonterminals.size () + nonterminal]; }
+};
+
+// A production of a table generated into a header, all a shift-reduce parser needs to reduce by it
+struct LRGeneratedProduction
+{
+	int nonterminal;
+	int length;
+	char const *text;
+};
+
+// Reads grammar_file and builds its LR(0) automaton, with the lookaheads of its reductions from
+// DeRemer and Pennello's relations, with no transformation of the grammar first. A conflict is
+// kept in conflicts and settled the way yacc does: a shift over a reduce, which binds an else to
+// the nearest if, and the production that comes first over a later one. Fails, saying why in
+// error, when the file can't be read, fails CheckTableGrammar, names a terminal the lexer has no
+// token type for or uses a nonterminal with no productions.
+std::optional<LALRTable> LoadLALRTable (std::string const &grammar_file, std::string &error);
+
+// Writes table as constexpr arrays into a header at out_file, conflicts in its opening comment.
+// Fails, saying why in error, when it can't be written.
+bool WriteLALRHeader (LALRTable const &table, std::string const &grammar_file, std::string const &out_file, std::string &error);
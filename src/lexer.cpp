@@ -2,6 +2,7 @@
 
 #include <cctype>
 #include <cstring>
+#include <mutex>
 
 template <>
 char const *enumStrings<TT>::data[] = {
@@ -84,86 +85,88 @@ char const *enumStrings<LexerErrorEnum>::data[] = {
 	"CommentContains2ndLeftCurlyBrace",
 };
 
-std::ostream &operator<< (std::ostream &os, const TokenAttribute &t)
+std::string AttribString (TokenInfo const &t, std::vector<LexerError> const &lexerErrors)
 {
-	if (t.index () == 0) return os << std::get<0> (t);
-	if (t.index () == 1) return os << enumToString (std::get<1> (t));
-	if (t.index () == 2) return os << enumToString (std::get<2> (t));
-	if (t.index () == 3) return os << enumToString (std::get<3> (t));
-	if (t.index () == 4) return os << enumToString (std::get<4> (t));
-	if (t.index () == 5) return os << enumToString (std::get<5> (t));
-	if (t.index () == 6) return os << std::get<6> (t);
-	if (t.index () == 7) return os << std::get<7> (t);
-	if (t.index () == 8) return os << std::get<8> (t);
-	if (t.index () == 9) return os << std::get<9> (t);
-	// if (t.index () == 10) return os << std::get<10> (t);
-	return os << "ATTRIB OSTREAM NOT UPDATED!";
+	std::ostringstream os;
+	switch (t.kind)
+	{
+		case (AttribKind::none):
+			os << "(NULL)";
+			break;
+		case (AttribKind::add_op):
+			os << enumToString (t.AddOp ());
+			break;
+		case (AttribKind::mul_op):
+			os << enumToString (t.MulOp ());
+			break;
+		case (AttribKind::sign_op):
+			os << enumToString (t.SignOp ());
+			break;
+		case (AttribKind::rel_op):
+			os << enumToString (t.RelOp ());
+			break;
+		case (AttribKind::standard_type):
+			os << enumToString (t.StandardType ());
+			break;
+		case (AttribKind::num):
+			if (t.is_real)
+				os << t.RealValue () << "(FLOAT)";
+			else
+				os << t.IntValue () << "(INT)";
+			break;
+		case (AttribKind::symbol):
+			os << t.Symbol () << " (index in symbol table)";
+			break;
+		case (AttribKind::string_literal):
+			os << t.value.i << "(index in literal table)";
+			break;
+		case (AttribKind::lexer_error):
+			os << lexerErrors.at (t.Error ().index);
+			break;
+		default:
+			os << "ATTRIB OSTREAM NOT UPDATED!";
+	}
+	return os.str ();
 }
 
 std::optional<ReservedWord> Lexer::GetReservedWord (std::string s)
 {
-	if (s == "program") return ReservedWord (s, TT::PROG);
-	if (s == "var") return ReservedWord (s, TT::VAR);
-	if (s == "array") return ReservedWord (s, TT::ARRAY);
-	if (s == "of") return ReservedWord (s, TT::OF);
-	if (s == "integer") return ReservedWord (s, TT::STD_T, StandardTypeEnum::integer);
-	if (s == "real") return ReservedWord (s, TT::STD_T, StandardTypeEnum::real);
-	// if (s == "function") return ReservedWord (s, TT::FUNCTION);
-	if (s == "procedure") return ReservedWord (s, TT::PROC);
-	if (s == "begin") return ReservedWord (s, TT::BEGIN);
-	if (s == "end") return ReservedWord (s, TT::END);
-	if (s == "if") return ReservedWord (s, TT::IF);
-	if (s == "then") return ReservedWord (s, TT::THEN);
-	if (s == "else") return ReservedWord (s, TT::ELSE);
-	if (s == "while") return ReservedWord (s, TT::WHILE);
-	if (s == "do") return ReservedWord (s, TT::DO);
-	if (s == "not") return ReservedWord (s, TT::NOT);
-	if (s == "or") return ReservedWord (s, TT::ADDOP, AddOpEnum::t_or);
-	if (s == "and") return ReservedWord (s, TT::MULOP, MulOpEnum::t_and);
-	if (s == "div") return ReservedWord (s, TT::MULOP, MulOpEnum::div);
-	if (s == "mod") return ReservedWord (s, TT::MULOP, MulOpEnum::mod);
-	if (s == "call") return ReservedWord (s, TT::CALL);
-	// if (s == "read") return ReservedWord(s, TT::ID, Symbo)
-	return {};
+	auto entry = reserved_word_table.Find (s);
+	if (entry == nullptr) return {};
+	return ReservedWord (s, entry->GetToken ());
 }
 
 void Lexer::ReadReservedWordsFile ()
 {
-	std::ifstream reserved_word_file (std::string ("test_input/reserved_words.txt"));
+	// reserved_word_table is shared by every Lexer, so the file only needs checking once
+	static std::once_flag checked;
+	std::call_once (checked, [] {
+		std::ifstream reserved_word_file (std::string ("test_input/reserved_words.txt"));
 
-	if (reserved_word_file)
-	{
+		if (reserved_word_file)
+		{
 
-		while (reserved_word_file.good ())
+			while (reserved_word_file.good ())
+			{
+				std::string word, token, attribute;
+				reserved_word_file >> word >> token >> attribute;
+				// the words themselves are compiled into reserved_word_table, this only checks the
+				// file hasn't drifted from it
+				auto res_word = GetReservedWord (word);
+				if (!res_word.has_value ()) fmt::print ("Reserved word not found! {}\n", word);
+			}
+		}
+		else
 		{
-			std::string word, token, attribute;
-			reserved_word_file >> word >> token >> attribute;
-			auto res_word = GetReservedWord (word);
-			if (res_word.has_value ())
-				reservedWords.insert (res_word.value ());
-			else
-				fmt::print ("Reserved word not found! {}\n", word);
+			fmt::print ("Reserved Word List not found!\n");
 		}
-
-		// fmt::print ("Res Word size = {}\n", reservedWords.size ());
-		// fmt::print ("Reserved Words:\n");
-		// for (auto &item : reservedWords)
-		//{
-		//	fmt::print ("Word: {} \t {}\n", item.word, enumToString (item.type));
-		//}
-	}
-	else
-	{
-		fmt::print ("Reserved Word List not found!\n");
-	}
+	});
 }
 
 std::optional<TokenInfo> Lexer::CheckReseredWords (std::string_view s)
 {
-	for (auto &item : reservedWords)
-	{
-		if (item == s) return item.GetToken ();
-	}
+	auto entry = reserved_word_table.Find (s);
+	if (entry != nullptr) return entry->GetToken ();
 	return {};
 }
 
@@ -175,31 +178,24 @@ void Lexer::AddMachine (LexerMachine &&machine)
 	});
 }
 
-void Lexer::TokenFilePrinter (int line_num, std::string_view lexeme, LexerMachineReturn::OptionalToken content)
+void Lexer::TokenFilePrinter (int line_num, std::string_view lexeme, TokenInfo const &token, CompilationContext const &context)
 {
-	if (content.has_value ())
-	{
-		if (lexeme[0] == '$') // EOF doesn't play nice in the output
-			lexeme = "EOF";
-		fmt::print (logger.token_file.FP (),
-		"{:^14}{:<14}{:<4}{:<12}{:<4}{:<4}\n",
-		line_num,
-		lexeme,
-		static_cast<int> (content->type),
-		enumToString ((content)->type),
-		(content)->attrib.index (),
-		(content)->attrib);
-
-		if ((content)->attrib.index () == 9) // lexer error
-		{
-			logger.AddLexErrPrint (
-			line_num, [=](FILE *fp) { fmt::print (fp, "{:<8}{}\n", "LEXERR:", content->attrib); });
-		}
-	}
-	else
+	if (lexeme[0] == '$') // EOF doesn't play nice in the output
+		lexeme = "EOF";
+	auto attrib = AttribString (token, context.lexerErrors);
+	fmt::print (logger.token_file.FP (),
+	"{:^14}{:<14}{:<4}{:<12}{:<4}{:<4}\n",
+	line_num,
+	lexeme,
+	static_cast<int> (token.type),
+	enumToString (token.type),
+	static_cast<int> (token.kind),
+	attrib);
+
+	if (token.kind == AttribKind::lexer_error)
 	{
-		// fmt::print (token_file.FP (), "{:^14}{:<14} {:<14}{:<4} (Unrecog Symbol)\n", line_num,
-		//            lexeme, "99 (LEXERR)", "1");
+		int code = static_cast<int> (context.lexerErrors.at (token.Error ().index).type);
+		logger.AddLexError (line_num, token.column_location, code, attrib);
 	}
 }
 
@@ -207,45 +203,58 @@ std::vector<TokenInfo> Lexer::GetTokens (CodeSource &sourceCode, CompilationCont
 {
 	std::vector<TokenInfo> tokens;
 
-	auto lines = sourceCode;
-	LexerContext context (compContext);
-
-
-	int backward_index = 0;
-	int cur_line_number = 0;
-
-	for (auto &s_line : lines)
+	LexerState state (sourceCode, compContext);
+	auto token = NextToken (state);
+	while (token.has_value ())
 	{
-		logger.AddListPrint (
-		cur_line_number, [=](FILE *fp) { fmt::print (fp, "{:<8}{}\n", cur_line_number, s_line); });
+		tokens.push_back (*token);
+		token = NextToken (state);
+	}
+	return tokens;
+}
 
-		while (backward_index < s_line.size ())
+std::optional<TokenInfo> Lexer::NextToken (LexerState &state)
+{
+	ScopedTimer timer (logger.stats, Phase::lex);
+	while (state.line < state.source.lines.size ())
+	{
+		int cur_line_number = state.line;
+		auto s_line = state.source.lines[cur_line_number];
+		if (!state.line_listed)
 		{
-			std::string_view buffer = std::string_view (s_line).substr (backward_index, s_line.size ());
+			logger.AddListing (cur_line_number, s_line);
+			state.line_listed = true;
+		}
 
-			auto iter = std::begin (machines);
-			std::optional<LexerMachineReturn> machine_ret = {};
-			while (!machine_ret.has_value () && iter != std::end (machines))
-			{
-				machine_ret = iter->machine (context, buffer);
+		while (state.column < s_line.size ())
+		{
+			std::string_view buffer = s_line.substr (state.column, s_line.size ());
 
-				iter++;
-			}
+			LexerMachineReturn::OptionalToken token;
+			std::optional<LexerMachineReturn> machine_ret = mode == LexerMode::Table ?
+			                                                RunTable (state.context, buffer) :
+			                                                RunMachines (state.context, buffer);
 			if (machine_ret.has_value ())
 			{
 				if (machine_ret->chars_to_eat > 0 && machine_ret->chars_to_eat < line_buffer_length)
 				{
 
-					backward_index += machine_ret->chars_to_eat;
+					state.column += machine_ret->chars_to_eat;
 					if (machine_ret->content.has_value ())
 					{
-						TokenFilePrinter (
-						cur_line_number, buffer.substr (0, machine_ret->chars_to_eat), machine_ret->content);
+						if (machine_ret->error.has_value ())
+							machine_ret->content = TokenInfo (
+							TT::LEXERR, state.context.compContext.AddLexerError (std::move (*machine_ret->error)));
 
 						machine_ret->content->line_location = cur_line_number;
-						machine_ret->content->column_location = backward_index - machine_ret->chars_to_eat;
+						machine_ret->content->column_location = state.column - machine_ret->chars_to_eat;
 
-						tokens.push_back (*machine_ret->content);
+						TokenFilePrinter (cur_line_number,
+						buffer.substr (0, machine_ret->chars_to_eat),
+						*machine_ret->content,
+						state.context.compContext);
+
+						token = machine_ret->content;
 					}
 				}
 			}
@@ -255,25 +264,176 @@ std::vector<TokenInfo> Lexer::GetTokens (CodeSource &sourceCode, CompilationCont
 				bad_symbol.push_back (buffer[0]);
 
 				machine_ret = LexerMachineReturn (1,
-				TokenInfo (TT::LEXERR, LexerError (LexerErrorEnum::Unrecognized_Symbol, bad_symbol)));
+				TokenInfo (TT::LEXERR,
+				state.context.compContext.AddLexerError (LexerError (LexerErrorEnum::Unrecognized_Symbol, bad_symbol))));
 
 				if (buffer[0] == '$')
-					logger.AddLexErrPrint (cur_line_number, [=](FILE *fp) {
-						fmt::print (fp, "{:<8}{}\t\n", "LEXERR:", "Unrecognized Symbol: EOF");
-					});
-
-				TokenFilePrinter (cur_line_number, bad_symbol, machine_ret->content);
-				tokens.push_back (*machine_ret->content);
-				backward_index++;
+					logger.AddLexError (cur_line_number,
+					state.column,
+					static_cast<int> (LexerErrorEnum::Unrecognized_Symbol),
+					"Unrecognized Symbol: EOF\t");
+
+				TokenFilePrinter (cur_line_number, bad_symbol, *machine_ret->content, state.context.compContext);
+				token = machine_ret->content;
+				state.column++;
+			}
+			// nothing after an end of file marker on the same line is lexed
+			if (token.has_value () && token->type == TT::END_FILE) { state.column = s_line.size (); }
+			if (token.has_value ())
+			{
+				logger.stats.Add (Counter::tokens_lexed);
+				return token;
 			}
-			if (machine_ret.has_value () && machine_ret->content->type == TT::END_FILE) { break; }
 		}
-		cur_line_number++;
-		backward_index = 0;
+		state.line++;
+		state.column = 0;
+		state.line_listed = false;
+	}
+	return {};
+}
+
+std::optional<LexerMachineReturn> Lexer::RunMachines (LexerContext &context, ProgramLine &line)
+{
+	auto iter = std::begin (machines);
+	std::optional<LexerMachineReturn> machine_ret = {};
+	while (!machine_ret.has_value () && iter != std::end (machines))
+	{
+		machine_ret = iter->machine (context, line);
+		logger.stats.Add (Counter::machines_tried);
+
+		iter++;
 	}
+	return machine_ret;
+}
 
+// The token building half of the IdRes, LReal, SReal and Integer machines, shared by both lexer modes
 
-	return tokens;
+LexerMachineReturn IdentifierToken (Lexer &lexer, LexerContext &context, ProgramLine sv)
+{
+	int index = sv.size ();
+	if (index > identifier_length)
+		return LexerMachineReturn (index,
+		LexerError (LexerErrorEnum::Id_TooLong, std::string (sv)));
+
+	auto res_word = lexer.CheckReseredWords (sv);
+	if (res_word.has_value ()) { return LexerMachineReturn (index, res_word.value ()); }
+	int loc = context.compContext.symbolTable.AddSymbol (sv);
+	return LexerMachineReturn (index, TokenInfo (TT::ID, SymbolType (loc)));
+}
+
+LexerMachineReturn LRealToken (ProgramLine line, int base_size, int decimal_size, int pow_size, bool hasSign)
+{
+	int i = line.size ();
+	if (pow_size == 0)
+		return LexerMachineReturn (i,
+		LexerError (LexerErrorEnum::LReal3_TooShort, line.substr (0, i)));
+
+	// error checking
+
+	if (base_size > real_base_length)
+		return LexerMachineReturn (i,
+		LexerError (LexerErrorEnum::LReal1_TooLong, line.substr (0, i)));
+
+	if (decimal_size > real_decimal_length)
+		return LexerMachineReturn (i,
+		LexerError (LexerErrorEnum::LReal2_TooLong, line.substr (0, i)));
+
+	if (pow_size > real_exponent_length)
+		return LexerMachineReturn (i,
+		LexerError (LexerErrorEnum::LReal3_TooLong, line.substr (0, i)));
+
+	if (i > 1 && line[0] == '0')
+		return LexerMachineReturn (i,
+		LexerError (LexerErrorEnum::LReal1_LeadingZero, line.substr (0, i)));
+
+	if (line[base_size + decimal_size + 2 + hasSign ? 1 : 0] == '0')
+		return LexerMachineReturn (i,
+		LexerError (LexerErrorEnum::LReal3_LeadingZero, line.substr (0, i)));
+
+	if (decimal_size == 0)
+		return LexerMachineReturn (i,
+		LexerError (LexerErrorEnum::LReal2_TooShort, line.substr (0, i)));
+
+	if (pow_size == 0)
+		return LexerMachineReturn (i,
+		LexerError (LexerErrorEnum::LReal3_TooShort, line.substr (0, i)));
+
+	auto sub = line.substr (0, i);
+	float fval;
+	try
+	{
+		fval = std::stof (std::string (sub));
+	}
+	catch (std::exception &e)
+	{
+		return LexerMachineReturn (i,
+		LexerError (LexerErrorEnum::LReal_InvalidNumericLiteral, line.substr (0, i)));
+	}
+
+	return LexerMachineReturn (i, TokenInfo (TT::NUM, NumType (fval)));
+}
+
+LexerMachineReturn SRealToken (ProgramLine line, int base_size, int decimal_size)
+{
+	int i = line.size ();
+	if (base_size > real_base_length)
+		return LexerMachineReturn (i,
+		LexerError (LexerErrorEnum::SReal1_TooLong, line.substr (0, i)));
+
+	if (decimal_size > real_decimal_length)
+		return LexerMachineReturn (i,
+		LexerError (LexerErrorEnum::SReal2_TooLong, line.substr (0, i)));
+
+	if (decimal_size == 0)
+		return LexerMachineReturn (i,
+		LexerError (LexerErrorEnum::SReal2_TooShort, line.substr (0, i)));
+	if (i > 1 && line[0] == '0')
+		return LexerMachineReturn (i,
+		LexerError (LexerErrorEnum::SReal1_LeadingZero, line.substr (0, i)));
+
+
+	auto sub = line.substr (0, i);
+	float fval;
+	try
+	{
+		fval = std::stof (std::string (sub));
+	}
+	catch (std::exception &e)
+	{
+		return LexerMachineReturn (i,
+		LexerError (LexerErrorEnum::SReal_InvalidNumericLiteral, line.substr (0, i)));
+	}
+
+	return LexerMachineReturn (i, TokenInfo (TT::NUM, NumType (fval)));
+}
+
+LexerMachineReturn IntegerToken (ProgramLine seq)
+{
+	int i = seq.size ();
+	int val = 0;
+
+	if (i > integer_digit_length)
+
+		return LexerMachineReturn (i, LexerError (LexerErrorEnum::Int_TooLong, seq));
+
+	if (i > 1 && seq[0] == '0')
+		return LexerMachineReturn (i, LexerError (LexerErrorEnum::Int_LeadingZero, seq));
+
+
+	try
+	{
+		val = std::stoi (std::string (seq));
+	}
+	catch (std::out_of_range e)
+	{
+		return LexerMachineReturn (i, LexerError (LexerErrorEnum::Int_TooLong, seq));
+	}
+	catch (std::invalid_argument e)
+	{
+		return LexerMachineReturn (
+		i, LexerError (LexerErrorEnum::Int_InvalidNumericLiteral, seq));
+	}
+	return LexerMachineReturn (i, TokenInfo (TT::NUM, NumType (val)));
 }
 
 void Lexer::CreateMachines ()
@@ -295,8 +455,7 @@ void Lexer::CreateMachines ()
 					 if (line[i] == '{')
 					 {
 						 return LexerMachineReturn (i + 1,
-						 TokenInfo (TT::LEXERR,
-						 LexerError (LexerErrorEnum::CommentContains2ndLeftCurlyBrace, line.substr (0, i + 1))));
+						 LexerError (LexerErrorEnum::CommentContains2ndLeftCurlyBrace, line.substr (0, i + 1)));
 					 }
 					 i++;
 				 }
@@ -326,7 +485,7 @@ void Lexer::CreateMachines ()
 	         {
 	             fmt::print ("{}\n", line);
 	             return LexerMachineReturn (i,
-	             TokenInfo (TT::LEXERR, LexerError (LexerErrorEnum::StrLit_NotTerminated, line)));
+	             LexerError (LexerErrorEnum::StrLit_NotTerminated, line));
 	         }
 	         i++; // needs to include the extra tick mark
 	         auto full_s = line.substr (0, i);
@@ -340,10 +499,10 @@ void Lexer::CreateMachines ()
 	         else
 	         {
 	             return LexerMachineReturn (i,
-	             TokenInfo (TT::LEXERR, LexerError (LexerErrorEnum::StrLit_TooLong, std::string (full_s))));
+	             LexerError (LexerErrorEnum::StrLit_TooLong, std::string (full_s)));
 	         }
 	         return LexerMachineReturn (i,
-	         TokenInfo (TT::LEXERR, LexerError (LexerErrorEnum::StrLit_TooLong, std::string (full_s))));
+	         LexerError (LexerErrorEnum::StrLit_TooLong, std::string (full_s)));
 	     } });
 	*/
 	AddMachine ({ "Whitespace", 100, [](LexerContext &context, ProgramLine &line) -> std::optional<LexerMachineReturn> {
@@ -364,16 +523,7 @@ void Lexer::CreateMachines ()
 		 while (index < line.size () && std::isalnum (line[index]))
 			 index++;
 
-		 auto sv = line.substr (0, index);
-
-		 if (index > identifier_length)
-			 return LexerMachineReturn (index,
-			 TokenInfo (TT::LEXERR, LexerError (LexerErrorEnum::Id_TooLong, std::string (sv))));
-
-		 auto res_word = CheckReseredWords (sv);
-		 if (res_word.has_value ()) { return LexerMachineReturn (index, res_word.value ()); }
-		 int loc = context.compContext.symbolTable.AddSymbol (sv);
-		 return LexerMachineReturn (index, TokenInfo (TT::ID, SymbolType (loc)));
+		 return IdentifierToken (*this, context, line.substr (0, index));
 	 } });
 
 	AddMachine ({ "Catch-all", 45, [](LexerContext &context, ProgramLine &line) -> std::optional<LexerMachineReturn> {
@@ -464,54 +614,7 @@ void Lexer::CreateMachines ()
 		 }
 
 
-		 if (pow_size == 0)
-			 return LexerMachineReturn (i,
-			 TokenInfo (TT::LEXERR, LexerError (LexerErrorEnum::LReal3_TooShort, line.substr (0, i))));
-
-		 // error checking
-
-		 if (base_size > real_base_length)
-			 return LexerMachineReturn (i,
-			 TokenInfo (TT::LEXERR, LexerError (LexerErrorEnum::LReal1_TooLong, line.substr (0, i))));
-
-		 if (decimal_size > real_decimal_length)
-			 return LexerMachineReturn (i,
-			 TokenInfo (TT::LEXERR, LexerError (LexerErrorEnum::LReal2_TooLong, line.substr (0, i))));
-
-		 if (pow_size > real_exponent_length)
-			 return LexerMachineReturn (i,
-			 TokenInfo (TT::LEXERR, LexerError (LexerErrorEnum::LReal3_TooLong, line.substr (0, i))));
-
-		 if (i > 1 && line[0] == '0')
-			 return LexerMachineReturn (i,
-			 TokenInfo (TT::LEXERR, LexerError (LexerErrorEnum::LReal1_LeadingZero, line.substr (0, i))));
-
-		 if (line[base_size + decimal_size + 2 + hasSign ? 1 : 0] == '0')
-			 return LexerMachineReturn (i,
-			 TokenInfo (TT::LEXERR, LexerError (LexerErrorEnum::LReal3_LeadingZero, line.substr (0, i))));
-
-		 if (decimal_size == 0)
-			 return LexerMachineReturn (i,
-			 TokenInfo (TT::LEXERR, LexerError (LexerErrorEnum::LReal2_TooShort, line.substr (0, i))));
-
-		 if (pow_size == 0)
-			 return LexerMachineReturn (i,
-			 TokenInfo (TT::LEXERR, LexerError (LexerErrorEnum::LReal3_TooShort, line.substr (0, i))));
-
-		 auto sub = line.substr (0, i);
-		 float fval;
-		 try
-		 {
-			 fval = std::stof (std::string (sub));
-		 }
-		 catch (std::exception &e)
-		 {
-			 return LexerMachineReturn (i,
-			 TokenInfo (TT::LEXERR,
-			 LexerError (LexerErrorEnum::LReal_InvalidNumericLiteral, line.substr (0, i))));
-		 }
-
-		 return LexerMachineReturn (i, TokenInfo (TT::NUM, NumType (fval)));
+		 return LRealToken (line.substr (0, i), base_size, decimal_size, pow_size, hasSign);
 	 } });
 
 	AddMachine (
@@ -539,38 +642,7 @@ void Lexer::CreateMachines ()
 			 decimal_size++;
 		 }
 
-		 // error checking
-
-		 if (base_size > real_base_length)
-			 return LexerMachineReturn (i,
-			 TokenInfo (TT::LEXERR, LexerError (LexerErrorEnum::SReal1_TooLong, line.substr (0, i))));
-
-		 if (decimal_size > real_decimal_length)
-			 return LexerMachineReturn (i,
-			 TokenInfo (TT::LEXERR, LexerError (LexerErrorEnum::SReal2_TooLong, line.substr (0, i))));
-
-		 if (decimal_size == 0)
-			 return LexerMachineReturn (i,
-			 TokenInfo (TT::LEXERR, LexerError (LexerErrorEnum::SReal2_TooShort, line.substr (0, i))));
-		 if (i > 1 && line[0] == '0')
-			 return LexerMachineReturn (i,
-			 TokenInfo (TT::LEXERR, LexerError (LexerErrorEnum::SReal1_LeadingZero, line.substr (0, i))));
-
-
-		 auto sub = line.substr (0, i);
-		 float fval;
-		 try
-		 {
-			 fval = std::stof (std::string (sub));
-		 }
-		 catch (std::exception &e)
-		 {
-			 return LexerMachineReturn (i,
-			 TokenInfo (TT::LEXERR,
-			 LexerError (LexerErrorEnum::SReal_InvalidNumericLiteral, line.substr (0, i))));
-		 }
-
-		 return LexerMachineReturn (i, TokenInfo (TT::NUM, NumType (fval)));
+		 return SRealToken (line.substr (0, i), base_size, decimal_size);
 	 } });
 
 	AddMachine (
@@ -582,34 +654,7 @@ void Lexer::CreateMachines ()
 		 }
 		 if (i == 0) return {};
 
-		 auto seq = line.substr (0, i);
-		 int val = 0;
-
-		 if (i > integer_digit_length)
-
-			 return LexerMachineReturn (
-			 i, TokenInfo (TT::LEXERR, LexerError (LexerErrorEnum::Int_TooLong, seq)));
-
-		 if (i > 1 && line[0] == '0')
-			 return LexerMachineReturn (
-			 i, TokenInfo (TT::LEXERR, LexerError (LexerErrorEnum::Int_LeadingZero, seq)));
-
-
-		 try
-		 {
-			 val = std::stoi (std::string (seq));
-		 }
-		 catch (std::out_of_range e)
-		 {
-			 return LexerMachineReturn (
-			 i, TokenInfo (TT::LEXERR, LexerError (LexerErrorEnum::Int_TooLong, seq)));
-		 }
-		 catch (std::invalid_argument e)
-		 {
-			 return LexerMachineReturn (
-			 i, TokenInfo (TT::LEXERR, LexerError (LexerErrorEnum::Int_InvalidNumericLiteral, seq)));
-		 }
-		 return LexerMachineReturn (i, TokenInfo (TT::NUM, NumType (val)));
+		 return IntegerToken (line.substr (0, i));
 	 } });
 
 	AddMachine (
@@ -632,29 +677,248 @@ void Lexer::CreateMachines ()
 	 } });
 }
 
+// Hand compiled union of the machines in CreateMachines. Each machine only ever accepts the longest
+// prefix it can, and no two machines accept on the same first character except the real/integer
+// ones (which are ordered longest first), so a longest match over this table gives the same
+// tokens as trying the machines in precedence order.
+void Lexer::CreateTable ()
+{
+	using S = LexState;
+	using C = CharClass;
+
+	for (int c = 0; c < 256; c++)
+	{
+		if (std::isalpha (c))
+			table.char_class[c] = C::Letter;
+		else if (std::isdigit (c))
+			table.char_class[c] = C::Digit;
+		else
+			table.char_class[c] = C::Other;
+	}
+	table.char_class['E'] = C::LetterE;
+	table.char_class[' '] = C::Space;
+	table.char_class['\t'] = C::Space;
+	table.char_class['\n'] = C::Space;
+	table.char_class['{'] = C::BraceOpen;
+	table.char_class['}'] = C::BraceClose;
+	table.char_class['.'] = C::Dot;
+	table.char_class[':'] = C::Colon;
+	table.char_class['='] = C::Equal;
+	table.char_class['<'] = C::Less;
+	table.char_class['>'] = C::Greater;
+	table.char_class['+'] = C::Plus;
+	table.char_class['-'] = C::Minus;
+	table.char_class['*'] = C::Star;
+	table.char_class['/'] = C::Slash;
+	table.char_class['('] = C::ParenOpen;
+	table.char_class[')'] = C::ParenClose;
+	table.char_class[';'] = C::Semicolon;
+	table.char_class[','] = C::Comma;
+	table.char_class['['] = C::BracketOpen;
+	table.char_class[']'] = C::BracketClose;
+	table.char_class['$'] = C::Dollar;
+	table.char_class['\0'] = C::Nul;
+
+	// Comment
+	table.Set (S::Start, C::BraceOpen, S::CommentBody);
+	for (int c = 0; c < static_cast<int> (C::Count); c++)
+	{
+		table.Set (S::CommentStart, static_cast<C> (c), S::CommentBody);
+		table.Set (S::CommentBody, static_cast<C> (c), S::CommentBody);
+	}
+	table.Set (S::CommentStart, C::BraceClose, S::CommentEnd);
+	table.Set (S::CommentBody, C::BraceClose, S::CommentEnd);
+	table.Set (S::CommentBody, C::BraceOpen, S::CommentError);
+
+	// Whitespace
+	table.Set (S::Start, C::Space, S::Whitespace);
+	table.Set (S::Whitespace, C::Space, S::Whitespace);
+
+	// IdRes
+	for (auto c : { C::Letter, C::LetterE })
+		table.Set (S::Start, c, S::Ident);
+	for (auto c : { C::Letter, C::LetterE, C::Digit })
+		table.Set (S::Ident, c, S::Ident);
+
+	// Relop
+	table.Set (S::Start, C::Less, S::Less);
+	table.Set (S::Less, C::Equal, S::LessEqual);
+	table.Set (S::Less, C::Greater, S::NotEqual);
+	table.Set (S::Start, C::Greater, S::Greater);
+	table.Set (S::Greater, C::Equal, S::GreaterEqual);
+	table.Set (S::Start, C::Equal, S::Equal);
+
+	// LReal, SReal, Integer
+	table.Set (S::Start, C::Digit, S::Int);
+	table.Set (S::Int, C::Digit, S::Int);
+	table.Set (S::Int, C::Dot, S::IntDot);
+	table.Set (S::IntDot, C::Digit, S::Frac);
+	table.Set (S::Dot, C::Digit, S::Frac);
+	table.Set (S::Frac, C::Digit, S::Frac);
+	table.Set (S::Frac, C::LetterE, S::Exp);
+	table.Set (S::Exp, C::Plus, S::ExpSign);
+	table.Set (S::Exp, C::Minus, S::ExpSign);
+	table.Set (S::Exp, C::Digit, S::ExpDigits);
+	table.Set (S::ExpSign, C::Digit, S::ExpDigits);
+	table.Set (S::ExpDigits, C::Digit, S::ExpDigits);
+
+	// Catch-all
+	table.Set (S::Start, C::Colon, S::Colon);
+	table.Set (S::Colon, C::Equal, S::Assign);
+	table.Set (S::Start, C::Dot, S::Dot);
+	table.Set (S::Dot, C::Dot, S::DotDot);
+	table.Set (S::Start, C::Plus, S::Plus);
+	table.Set (S::Start, C::Minus, S::Minus);
+	table.Set (S::Start, C::Star, S::Star);
+	table.Set (S::Start, C::Slash, S::Slash);
+	table.Set (S::Start, C::ParenOpen, S::ParenOpen);
+	table.Set (S::Start, C::ParenClose, S::ParenClose);
+	table.Set (S::Start, C::Semicolon, S::Semicolon);
+	table.Set (S::Start, C::Comma, S::Comma);
+	table.Set (S::Start, C::BracketOpen, S::BracketOpen);
+	table.Set (S::Start, C::BracketClose, S::BracketClose);
+	table.Set (S::Start, C::Dollar, S::EndFile);
+	table.Set (S::Start, C::Nul, S::EndFile);
+
+	for (int s = 0; s < static_cast<int> (S::Count); s++)
+		table.accepting[s] = true;
+	for (auto s : { S::Dead, S::Start, S::CommentStart, S::IntDot, S::Exp, S::ExpSign })
+		table.accepting[static_cast<int> (s)] = false;
+}
+
+std::optional<LexerMachineReturn> Lexer::RunTable (LexerContext &context, ProgramLine &line)
+{
+	logger.stats.Add (Counter::machines_tried);
+	LexState state = context.isInComment ? LexState::CommentStart : LexState::Start;
+	LexState accepted = LexState::Dead;
+	int length = 0;
+	for (int i = 0; i < line.size (); i++)
+	{
+		state = table.Next (state, line[i]);
+		if (state == LexState::Dead) break;
+		if (table.accepting[static_cast<int> (state)])
+		{
+			accepted = state;
+			length = i + 1;
+		}
+	}
+
+	auto lexeme = line.substr (0, length);
+	switch (accepted)
+	{
+		case (LexState::CommentBody):
+			context.isInComment = true;
+			return LexerMachineReturn (length);
+		case (LexState::CommentEnd):
+			context.isInComment = false;
+			return LexerMachineReturn (length);
+		case (LexState::CommentError):
+			context.isInComment = true;
+			return LexerMachineReturn (length,
+			LexerError (LexerErrorEnum::CommentContains2ndLeftCurlyBrace, lexeme));
+		case (LexState::Whitespace):
+			return LexerMachineReturn (length);
+		case (LexState::Ident):
+			return IdentifierToken (*this, context, lexeme);
+		case (LexState::Int):
+			return IntegerToken (lexeme);
+		case (LexState::Frac):
+		{
+			int base_size = lexeme.find ('.');
+			return SRealToken (lexeme, base_size, length - base_size - 1);
+		}
+		case (LexState::ExpDigits):
+		{
+			int base_size = lexeme.find ('.');
+			int exp = lexeme.find ('E');
+			bool hasSign = lexeme[exp + 1] == '+' || lexeme[exp + 1] == '-';
+			return LRealToken (lexeme, base_size, exp - base_size - 1, length - exp - 1 - hasSign, hasSign);
+		}
+		case (LexState::Less):
+			return LexerMachineReturn (length, TokenInfo (TT::RELOP, RelOpEnum::less_than));
+		case (LexState::LessEqual):
+			return LexerMachineReturn (length, TokenInfo (TT::RELOP, RelOpEnum::less_than_or_equal));
+		case (LexState::NotEqual):
+			return LexerMachineReturn (length, TokenInfo (TT::RELOP, RelOpEnum::not_equal));
+		case (LexState::Greater):
+			return LexerMachineReturn (length, TokenInfo (TT::RELOP, RelOpEnum::greater_than));
+		case (LexState::GreaterEqual):
+			return LexerMachineReturn (length, TokenInfo (TT::RELOP, RelOpEnum::greater_than_or_equal));
+		case (LexState::Equal):
+			return LexerMachineReturn (length, TokenInfo (TT::RELOP, RelOpEnum::equal));
+		case (LexState::Colon):
+			return LexerMachineReturn (length, TokenInfo (TT::COLON, NoAttrib ()));
+		case (LexState::Assign):
+			return LexerMachineReturn (length, TokenInfo (TT::A_OP, NoAttrib ()));
+		case (LexState::Dot):
+			return LexerMachineReturn (length, TokenInfo (TT::DOT, NoAttrib ()));
+		case (LexState::DotDot):
+			return LexerMachineReturn (length, TokenInfo (TT::DOT_DOT, NoAttrib ()));
+		case (LexState::Plus):
+			return LexerMachineReturn (length, TokenInfo (TT::SIGN, SignOpEnum::plus));
+		case (LexState::Minus):
+			return LexerMachineReturn (length, TokenInfo (TT::SIGN, SignOpEnum::minus));
+		case (LexState::Star):
+			return LexerMachineReturn (length, TokenInfo (TT::MULOP, MulOpEnum::mul));
+		case (LexState::Slash):
+			return LexerMachineReturn (length, TokenInfo (TT::MULOP, MulOpEnum::div));
+		case (LexState::ParenOpen):
+			return LexerMachineReturn (length, TokenInfo (TT::P_O, NoAttrib ()));
+		case (LexState::ParenClose):
+			return LexerMachineReturn (length, TokenInfo (TT::P_C, NoAttrib ()));
+		case (LexState::Semicolon):
+			return LexerMachineReturn (length, TokenInfo (TT::SEMIC, NoAttrib ()));
+		case (LexState::Comma):
+			return LexerMachineReturn (length, TokenInfo (TT::COMMA, NoAttrib ()));
+		case (LexState::BracketOpen):
+			return LexerMachineReturn (length, TokenInfo (TT::B_O, NoAttrib ()));
+		case (LexState::BracketClose):
+			return LexerMachineReturn (length, TokenInfo (TT::B_C, NoAttrib ()));
+		case (LexState::EndFile):
+			return LexerMachineReturn (length, TokenInfo (TT::END_FILE, NoAttrib ()));
+		default:
+			return {};
+	}
+}
+
 TokenStream::TokenStream (Lexer &lexer, CompilationContext &compilationContext, CodeSource &sourceCode)
-: compilationContext (compilationContext), lexer (lexer), sourceCode (sourceCode)
+: lexer (lexer), state (sourceCode, compilationContext)
 {
-	auto new_tokens = lexer.GetTokens (sourceCode, compilationContext);
-	tokens.insert (std::end (tokens), std::begin (new_tokens), std::end (new_tokens));
+	Fill (1);
 }
 
-TokenInfo TokenStream::Current () const
+bool TokenStream::Fill (int wanted)
 {
-	if (index >= tokens.size ()) return tokens.at (tokens.size () - 1);
+	while (count < wanted)
+	{
+		auto token = lexer.NextToken (state);
+		if (!token.has_value ()) return false;
+		ring[(head + count) % lookahead_size] = *token;
+		count++;
+	}
+	return true;
+}
 
-	return tokens.at (index);
+TokenInfo TokenStream::Current () const
+{
+	if (count == 0) return TokenInfo (TT::END_FILE, NoAttrib{});
+	return ring[head];
 }
+
 TokenInfo TokenStream::Advance ()
 {
-	// if (index + 1 >= tokens.size ())
-	//{
-	//	auto new_tokens = lexer.GetTokens (sourceCode, compilationContext);
-	//	if (new_tokens.size () > 0)
-	//		tokens.insert (std::end (tokens), std::begin (new_tokens), std::end (new_tokens));
-	//}
-	// auto t = tokens.at (index);
-	int old = index;
-	if (index + 1 < tokens.size ()) { index++; }
-	return tokens.at (old);
-}
\ No newline at end of file
+	auto old = Current ();
+	if (Fill (2))
+	{
+		head = (head + 1) % lookahead_size;
+		count--;
+	}
+	return old;
+}
+
+void TokenStream::Finish ()
+{
+	while (lexer.NextToken (state).has_value ())
+	{
+	}
+}
@@ -1,14 +1,18 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <cstdint>
 #include <functional>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <type_traits>
 #include <unordered_set>
 #include <variant>
 #include <vector>
 
+#include "ast.h"
 #include "common.h"
 #include "enumstring.h"
 
@@ -33,7 +37,7 @@ using ProgramLine = std::string_view;
 // std::ostream &operator<< (std::ostream &os, const ProgramLine &t);
 
 
-enum class TT
+enum class TT : uint8_t
 {
 	PROG,
 	ID,
@@ -74,20 +78,21 @@ enum class TT
 
 std::string operator+ (const std::string &out, TT tt);
 
+// A set of token types, one bit per TT
+using TTSet = uint64_t;
+constexpr int tt_count = static_cast<int> (TT::LEXERR) + 1;
+static_assert (tt_count <= 64, "TTSet needs a bit per token type");
+
+constexpr TTSet TTBit (TT tt) { return TTSet (1) << static_cast<int> (tt); }
+
 struct NoAttrib
 {
-	friend std::ostream &operator<< (std::ostream &os, const NoAttrib &t) { return os << "(NULL)"; }
 };
 
 struct SymbolType
 {
 	int loc = -1;
 	SymbolType (int loc) : loc (loc) {}
-
-	friend std::ostream &operator<< (std::ostream &os, const SymbolType &t)
-	{
-		return os << t.loc << " (index in symbol table)";
-	}
 };
 
 enum class AddOpEnum
@@ -132,13 +137,6 @@ struct NumType
 	std::variant<int, float> val;
 	NumType (int a) : val (a) {}
 	NumType (float a) : val (a) {}
-
-	friend std::ostream &operator<< (std::ostream &os, const NumType &t)
-	{
-		if (t.val.index () == 0) return os << std::get<0> (t.val) << "(INT)";
-		if (t.val.index () == 1) return os << std::get<1> (t.val) << "(FLOAT)";
-		return os;
-	}
 };
 
 // struct IntType
@@ -167,11 +165,6 @@ struct StringLiteral
 {
 	int loc = -1;
 	StringLiteral (int loc) : loc (loc) {}
-
-	friend std::ostream &operator<< (std::ostream &os, const StringLiteral &t)
-	{
-		return os << t.loc << "(index in literal table)";
-	}
 };
 
 enum class LexerErrorEnum
@@ -216,60 +209,214 @@ struct LexerError
 	}
 };
 
-using TokenAttribute =
-std::variant<NoAttrib, AddOpEnum, MulOpEnum, SignOpEnum, RelOpEnum, StandardTypeEnum, NumType, SymbolType, StringLiteral, LexerError>;
+// Which attribute a token carries, numbered as the alternatives of the std::variant tokens used to
+// hold so the token file reads the same
+enum class AttribKind : uint8_t
+{
+	none,
+	add_op,
+	mul_op,
+	sign_op,
+	rel_op,
+	standard_type,
+	num,
+	symbol,
+	string_literal,
+	lexer_error
+};
 
-std::ostream &operator<< (std::ostream &os, const TokenAttribute &t);
+// Index of a LexerError in CompilationContext::lexerErrors
+struct LexerErrorID
+{
+	int index = -1;
+};
 
+// Trivially copyable 16 byte token. The attribute is a single int or float, lexer errors are kept
+// out of line in CompilationContext::lexerErrors.
 struct TokenInfo
 {
-	TT type;
-	TokenAttribute attrib;
+	TT type = TT::END_FILE;
+	AttribKind kind = AttribKind::none;
+	bool is_real = false; // which of value.i or value.f a num token holds
+	union
+	{
+		int i;
+		float f;
+	} value = { 0 };
 	int line_location = -1;
 	int column_location = -1;
 
-	TokenInfo (TT type, TokenAttribute attrib) : type (type), attrib (attrib) {}
-
-	TokenInfo (TT type, TokenAttribute attrib, int line, int column)
-	: type (type), attrib (attrib), line_location (line), column_location (column)
+	TokenInfo () {}
+	TokenInfo (TT type, NoAttrib) : type (type) {}
+	TokenInfo (TT type, AddOpEnum op) : type (type), kind (AttribKind::add_op)
+	{
+		value.i = static_cast<int> (op);
+	}
+	TokenInfo (TT type, MulOpEnum op) : type (type), kind (AttribKind::mul_op)
+	{
+		value.i = static_cast<int> (op);
+	}
+	TokenInfo (TT type, SignOpEnum op) : type (type), kind (AttribKind::sign_op)
+	{
+		value.i = static_cast<int> (op);
+	}
+	TokenInfo (TT type, RelOpEnum op) : type (type), kind (AttribKind::rel_op)
+	{
+		value.i = static_cast<int> (op);
+	}
+	TokenInfo (TT type, StandardTypeEnum std_type) : type (type), kind (AttribKind::standard_type)
+	{
+		value.i = static_cast<int> (std_type);
+	}
+	TokenInfo (TT type, NumType num) : type (type), kind (AttribKind::num)
+	{
+		is_real = num.val.index () == 1;
+		if (is_real)
+			value.f = std::get<float> (num.val);
+		else
+			value.i = std::get<int> (num.val);
+	}
+	TokenInfo (TT type, SymbolType symbol) : type (type), kind (AttribKind::symbol)
+	{
+		value.i = symbol.loc;
+	}
+	TokenInfo (TT type, StringLiteral literal) : type (type), kind (AttribKind::string_literal)
+	{
+		value.i = literal.loc;
+	}
+	TokenInfo (TT type, LexerErrorID error) : type (type), kind (AttribKind::lexer_error)
 	{
+		value.i = error.index;
 	}
 
-	friend std::ostream &operator<< (std::ostream &os, const TokenInfo &t)
+	bool HasSymbol () const { return kind == AttribKind::symbol; }
+	int Symbol () const { return HasSymbol () ? value.i : -1; }
+	bool IsInt () const { return kind == AttribKind::num && !is_real; }
+	bool IsReal () const { return kind == AttribKind::num && is_real; }
+	int IntValue () const { return value.i; }
+	float RealValue () const { return value.f; }
+	AddOpEnum AddOp () const { return static_cast<AddOpEnum> (value.i); }
+	MulOpEnum MulOp () const { return static_cast<MulOpEnum> (value.i); }
+	SignOpEnum SignOp () const { return static_cast<SignOpEnum> (value.i); }
+	RelOpEnum RelOp () const { return static_cast<RelOpEnum> (value.i); }
+	StandardTypeEnum StandardType () const { return static_cast<StandardTypeEnum> (value.i); }
+	LexerErrorID Error () const { return LexerErrorID{ value.i }; }
+};
+
+static_assert (sizeof (TokenInfo) == 16, "TokenInfo should stay 16 bytes");
+static_assert (std::is_trivially_copyable<TokenInfo>::value, "TokenInfo should stay trivially copyable");
+
+// Prints the attribute of a token as the token file shows it
+std::string AttribString (TokenInfo const &token, std::vector<LexerError> const &lexerErrors);
+
+class CompilationContext
+{
+	public:
+	SymbolTable symbolTable;
+	SymbolTable literalTable;
+	std::vector<LexerError> lexerErrors;
+	Ast ast;
+
+	LexerErrorID AddLexerError (LexerError error)
 	{
-		return os << enumToString (t.type) << '\t' << t.attrib;
+		lexerErrors.push_back (std::move (error));
+		return LexerErrorID{ static_cast<int> (lexerErrors.size ()) - 1 };
 	}
 };
 
 struct ReservedWord
 {
 	std::string word;
-	TT type;
-	TokenAttribute attrib;
+	TokenInfo token;
 
-	ReservedWord (std::string word, TT type, TokenAttribute attrib = NoAttrib{})
-	: word (word), type (type), attrib (attrib){};
+	ReservedWord (std::string word, TokenInfo token) : word (word), token (token){};
 
 	bool operator== (const ReservedWord &other) const
 	{
-		return (word == other.word && type == other.type);
+		return (word == other.word && token.type == other.token.type);
 	}
 
 	bool operator== (const std::string &s) const { return (word == s); }
 	bool operator== (const std::string_view &s) const { return (word == s); }
 
-	TokenInfo GetToken () const { return TokenInfo (type, attrib); }
+	TokenInfo GetToken () const { return token; }
 };
 
-namespace std
+// Reserved words of test_input/reserved_words.txt, attrib is the value of the enum matching type
+// (StandardTypeEnum for STD_T, AddOpEnum for ADDOP, MulOpEnum for MULOP)
+struct ReservedWordEntry
 {
-template <> struct hash<ReservedWord>
+	std::string_view word;
+	TT type = TT::ID;
+	int attrib = 0;
+
+	TokenInfo GetToken () const
+	{
+		if (type == TT::STD_T) return TokenInfo (type, static_cast<StandardTypeEnum> (attrib));
+		if (type == TT::ADDOP) return TokenInfo (type, static_cast<AddOpEnum> (attrib));
+		if (type == TT::MULOP) return TokenInfo (type, static_cast<MulOpEnum> (attrib));
+		return TokenInfo (type, NoAttrib{});
+	}
+};
+
+constexpr ReservedWordEntry reserved_word_list[] = {
+	{ "program", TT::PROG },
+	{ "var", TT::VAR },
+	{ "array", TT::ARRAY },
+	{ "of", TT::OF },
+	{ "integer", TT::STD_T, static_cast<int> (StandardTypeEnum::integer) },
+	{ "real", TT::STD_T, static_cast<int> (StandardTypeEnum::real) },
+	{ "procedure", TT::PROC },
+	{ "begin", TT::BEGIN },
+	{ "end", TT::END },
+	{ "if", TT::IF },
+	{ "then", TT::THEN },
+	{ "else", TT::ELSE },
+	{ "while", TT::WHILE },
+	{ "do", TT::DO },
+	{ "not", TT::NOT },
+	{ "or", TT::ADDOP, static_cast<int> (AddOpEnum::t_or) },
+	{ "div", TT::MULOP, static_cast<int> (MulOpEnum::div) },
+	{ "mod", TT::MULOP, static_cast<int> (MulOpEnum::mod) },
+	{ "and", TT::MULOP, static_cast<int> (MulOpEnum::t_and) },
+	{ "call", TT::CALL },
+};
+
+constexpr int reserved_word_hash_size = 64;
+
+// Only has to be collision free for reserved_word_list, which ReservedWordTable checks
+constexpr int ReservedWordHash (std::string_view s)
+{
+	return (s.size () + static_cast<unsigned char> (s[0]) + 3 * static_cast<unsigned char> (s[1]))
+	       % reserved_word_hash_size;
+}
+
+struct ReservedWordTable
 {
-	size_t operator() (const ReservedWord &w) const { return hash<std::string> () (w.word); }
+	std::array<ReservedWordEntry, reserved_word_hash_size> slots{};
+	bool is_perfect = true;
+
+	constexpr ReservedWordTable ()
+	{
+		for (auto &entry : reserved_word_list)
+		{
+			auto &slot = slots[ReservedWordHash (entry.word)];
+			if (!slot.word.empty ()) is_perfect = false;
+			slot = entry;
+		}
+	}
+
+	constexpr const ReservedWordEntry *Find (std::string_view s) const
+	{
+		if (s.size () < 2) return nullptr;
+		auto &slot = slots[ReservedWordHash (s)];
+		if (slot.word == s) return &slot;
+		return nullptr;
+	}
 };
-} // namespace std
 
-using ReservedWordList = std::unordered_set<ReservedWord>;
+constexpr ReservedWordTable reserved_word_table;
+static_assert (reserved_word_table.is_perfect, "ReservedWordHash has a collision in reserved_word_list");
 
 
 struct LexerMachineReturn
@@ -278,6 +425,7 @@ struct LexerMachineReturn
 
 	int chars_to_eat = 0;
 	OptionalToken content;
+	std::optional<LexerError> error; // set for LEXERR tokens, moved into the error table once emitted
 
 	LexerMachineReturn (int chars_to_eat) : chars_to_eat (chars_to_eat){};
 
@@ -285,6 +433,11 @@ struct LexerMachineReturn
 	: chars_to_eat (chars_to_eat), content (token)
 	{
 	}
+
+	LexerMachineReturn (int chars_to_eat, LexerError error)
+	: chars_to_eat (chars_to_eat), content (TokenInfo (TT::LEXERR, LexerErrorID{})), error (error)
+	{
+	}
 };
 
 struct LexerContext
@@ -295,6 +448,20 @@ struct LexerContext
 	CompilationContext &compContext;
 };
 
+// Where Lexer::NextToken is up to in a source
+struct LexerState
+{
+	LexerState (CodeSource &source, CompilationContext &compContext)
+	: source (source), context (compContext)
+	{
+	}
+	CodeSource &source;
+	LexerContext context;
+	int line = 0;
+	int column = 0;
+	bool line_listed = false;
+};
+
 using LexerMachineFuncSig =
 std::function<std::optional<LexerMachineReturn> (LexerContext &context, ProgramLine &line)>;
 
@@ -308,7 +475,103 @@ struct LexerMachine
 	: name (name), precedence (precedence), machine (machine){};
 };
 
+enum class LexerMode
+{
+	Machines, // reference path, tries every LexerMachine in precedence order
+	Table     // single pass over the transition table built by Lexer::CreateTable
+};
+
+// Character classes the transition table is indexed by
+enum class CharClass : uint8_t
+{
+	Other,
+	Letter,
+	LetterE, // 'E' is both a letter and the exponent marker of an LReal
+	Digit,
+	Space,
+	BraceOpen,
+	BraceClose,
+	Dot,
+	Colon,
+	Equal,
+	Less,
+	Greater,
+	Plus,
+	Minus,
+	Star,
+	Slash,
+	ParenOpen,
+	ParenClose,
+	Semicolon,
+	Comma,
+	BracketOpen,
+	BracketClose,
+	Dollar,
+	Nul,
+	Count
+};
+
+// States of the table lexer, each group mirrors one of the machines in Lexer::CreateMachines
+enum class LexState : uint8_t
+{
+	Dead,
+	Start,
+	CommentStart, // start state when a comment is still open from a previous line
+	CommentBody,
+	CommentEnd,
+	CommentError,
+	Whitespace,
+	Ident,
+	Int,
+	IntDot,
+	Frac,
+	Exp,
+	ExpSign,
+	ExpDigits,
+	Dot,
+	DotDot,
+	Colon,
+	Assign,
+	Less,
+	LessEqual,
+	NotEqual,
+	Greater,
+	GreaterEqual,
+	Equal,
+	Plus,
+	Minus,
+	Star,
+	Slash,
+	ParenOpen,
+	ParenClose,
+	Semicolon,
+	Comma,
+	BracketOpen,
+	BracketClose,
+	EndFile,
+	Count
+};
+
+struct LexerTable
+{
+	std::array<CharClass, 256> char_class{};
+	std::array<std::array<LexState, static_cast<int> (CharClass::Count)>, static_cast<int> (LexState::Count)> transitions{};
+	std::array<bool, static_cast<int> (LexState::Count)> accepting{};
+
+	void Set (LexState from, CharClass c, LexState to)
+	{
+		transitions[static_cast<int> (from)][static_cast<int> (c)] = to;
+	}
+
+	LexState Next (LexState from, char c) const
+	{
+		return transitions[static_cast<int> (from)]
+		                  [static_cast<int> (char_class[static_cast<unsigned char> (c)])];
+	}
+};
+
 class Lexer;
+// Lexes on demand, holding only the current token and a few tokens of lookahead
 class TokenStream
 {
 	public:
@@ -317,42 +580,54 @@ class TokenStream
 	TokenInfo Current () const;
 	TokenInfo Advance ();
 
+	// Lexes whatever the parser didn't consume, so the listing and token file cover the whole source
+	void Finish ();
+
+	static constexpr int lookahead_size = 8;
+
 	private:
-	int index = 0;
-	std::vector<TokenInfo> tokens;
-	CompilationContext &compilationContext;
-	CodeSource &sourceCode;
+	bool Fill (int wanted);
+
+	std::array<TokenInfo, lookahead_size> ring;
+	int head = 0;
+	int count = 0;
 	Lexer &lexer;
+	LexerState state;
 };
 
 class Lexer
 {
 	public:
-	Lexer (Logger &logger) : logger (logger)
+	Lexer (Logger &logger, LexerMode mode = LexerMode::Table) : logger (logger), mode (mode)
 	{
 		ReadReservedWordsFile ();
 		CreateMachines ();
+		CreateTable ();
 	}
 
-	// void LoadReservedWords (ReservedWordList list) { reservedWords = list; };
 	void CreateMachines ();
+	void CreateTable ();
 
 	void AddMachine (LexerMachine &&machine);
 
+	std::optional<LexerMachineReturn> RunMachines (LexerContext &context, ProgramLine &line);
+	std::optional<LexerMachineReturn> RunTable (LexerContext &context, ProgramLine &line);
+
 	std::vector<TokenInfo> GetTokens (CodeSource &sourceCode, CompilationContext &context);
+	std::optional<TokenInfo> NextToken (LexerState &state);
 
-	void TokenFilePrinter (int line_num, std::string_view lexeme, LexerMachineReturn::OptionalToken content);
+	void TokenFilePrinter (int line_num, std::string_view lexeme, TokenInfo const &token, CompilationContext const &context);
 
 
-	std::optional<TokenInfo> CheckReseredWords (std::string_view s);
-	std::optional<ReservedWord> GetReservedWord (std::string s);
+	// Only read reserved_word_table, which is constexpr, so any thread may call these
+	static std::optional<TokenInfo> CheckReseredWords (std::string_view s);
+	static std::optional<ReservedWord> GetReservedWord (std::string s);
 
-	void ReadReservedWordsFile ();
+	static void ReadReservedWordsFile ();
 
 	std::vector<LexerMachine> machines;
-	ReservedWordList reservedWords;
+	LexerTable table;
 	Logger &logger;
+	LexerMode mode;
 };
 
-
-std::ostream &operator<< (std::ostream &os, const TokenAttribute &t);
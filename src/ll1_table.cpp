@@ -0,0 +1,325 @@
+#include "ll1_table.h"
+
+#include <cctype>
+
+#include "grammar_massager.h"
+
+// The token types each terminal of grammars/grammar_shorthand.txt is lexed as. The lexer gives +
+// and - as SIGN whether they are a sign or an addop, so addop takes SIGN too.
+struct TerminalTokens
+{
+	const char *name;
+	TTSet tokens;
+};
+constexpr TerminalTokens terminal_tokens[] = {
+	{ "program", TTBit (TT::PROG) },
+	{ "id", TTBit (TT::ID) },
+	{ "(", TTBit (TT::P_O) },
+	{ ")", TTBit (TT::P_C) },
+	{ ";", TTBit (TT::SEMIC) },
+	{ ".", TTBit (TT::DOT) },
+	{ "var", TTBit (TT::VAR) },
+	{ ":", TTBit (TT::COLON) },
+	{ "array", TTBit (TT::ARRAY) },
+	{ "[", TTBit (TT::B_O) },
+	{ "]", TTBit (TT::B_C) },
+	{ "num", TTBit (TT::NUM) },
+	{ "of", TTBit (TT::OF) },
+	{ "integer", TTBit (TT::STD_T) },
+	{ "real", TTBit (TT::STD_T) },
+	{ "procedure", TTBit (TT::PROC) },
+	{ "begin", TTBit (TT::BEGIN) },
+	{ "end", TTBit (TT::END) },
+	{ "call", TTBit (TT::CALL) },
+	{ ",", TTBit (TT::COMMA) },
+	{ "relop", TTBit (TT::RELOP) },
+	{ "addop", TTBit (TT::ADDOP) | TTBit (TT::SIGN) },
+	{ "assignop", TTBit (TT::A_OP) },
+	{ "mulop", TTBit (TT::MULOP) },
+	{ "not", TTBit (TT::NOT) },
+	{ "+", TTBit (TT::SIGN) },
+	{ "-", TTBit (TT::SIGN) },
+	{ "if", TTBit (TT::IF) },
+	{ "then", TTBit (TT::THEN) },
+	{ "else", TTBit (TT::ELSE) },
+	{ "while", TTBit (TT::WHILE) },
+	{ "do", TTBit (TT::DO) },
+	{ "..", TTBit (TT::DOT_DOT) },
+	{ "$", TTBit (TT::END_FILE) },
+};
+
+// How each TT is spelled in code
+constexpr const char *tt_identifiers[] = { "PROG", "ID", "P_O", "P_C", "SEMIC", "DOT", "VAR", "COLON", "ARRAY",
+	"B_O", "B_C", "NUM", "OF", "STD_T", "INT", "REAL", "PROC", "BEGIN", "END", "CALL", "COMMA", "RELOP", "ADDOP", "A_OP",
+	"MULOP", "NOT", "SIGN", "IF", "THEN", "ELSE", "WHILE", "DO", "DOT_DOT", "END_FILE", "LEXERR" };
+static_assert (std::size (tt_identifiers) == tt_count, "tt_identifiers needs a name per TT");
+
+TTSet TerminalTokenTypes (std::string const &name)
+{
+	for (auto &t : terminal_tokens)
+		if (name == t.name) return t.tokens;
+	return 0;
+}
+
+char const *TTIdentifier (TT tt) { return tt_identifiers[static_cast<int> (tt)]; }
+
+bool CheckTableGrammar (Grammar const &grammar, std::string const &grammar_file, std::string &error)
+{
+	if (grammar.find_eof_index () == -1)
+	{
+		error = "No TOKENS line in " + grammar_file + ", so no '$' terminal to end the input with";
+		return false;
+	}
+	if (grammar.ProductionsOfVariable (grammar.start_symbol).empty ())
+	{
+		auto name = grammar.variables.find (grammar.start_symbol);
+		error = name == std::end (grammar.variables) ? "No productions in " + grammar_file
+		        : "The start symbol '" + name->second + "' of " + grammar_file + " has no productions";
+		return false;
+	}
+	return true;
+}
+
+std::optional<LL1Table> LoadLL1Table (std::string const &grammar_file, std::string &error)
+{
+	std::ifstream in (grammar_file, std::ios::in);
+	if (!in.is_open ())
+	{
+		error = "Could not open " + grammar_file;
+		return {};
+	}
+
+	auto grammar = ReadGrammar (in);
+	if (!CheckTableGrammar (grammar, grammar_file, error)) return {};
+	auto e_less = RemoveEProds (grammar);
+	auto recursion_less = RemoveLeftRecursion (e_less);
+	auto factored = RemoveXLeftFactoring (recursion_less);
+
+	LL1Table table;
+	int e_index = factored.find_epsilon_index ();
+	std::map<int, int> nonterminal_of; // by the grammar's key
+	for (auto &[key, name] : factored.variables)
+	{
+		if (key == e_index) continue;
+		nonterminal_of[key] = table.nonterminals.size ();
+		table.nonterminals.push_back (name);
+	}
+	std::map<int, int> terminal_of;
+	for (auto &[key, name] : factored.terminals)
+	{
+		TTSet tokens = TerminalTokenTypes (name);
+		if (tokens == 0)
+		{
+			error = "No token type for the terminal '" + name + "' of " + grammar_file;
+			return {};
+		}
+		terminal_of[key] = table.terminals.size ();
+		table.terminals.push_back (tokens);
+	}
+	table.start = nonterminal_of.at (factored.start_symbol);
+	table.end_of_file = terminal_of.at (factored.find_eof_index ());
+
+	for (auto &prod : factored.Productions ())
+	{
+		LL1Production production{ nonterminal_of.at (prod.var) };
+		production.text = factored.variables.at (prod.var) + " ->";
+		for (auto &token : prod.rule)
+		{
+			if (token.isTerm)
+			{
+				production.rule.push_back (LL1Symbol{ true, terminal_of.at (token.index) });
+				production.text += " '" + factored.terminals.at (token.index) + "'";
+			}
+			else
+			{
+				if (token.index != e_index)
+					production.rule.push_back (LL1Symbol{ false, nonterminal_of.at (token.index) });
+				production.text += " " + factored.variables.at (token.index);
+			}
+		}
+		table.productions.push_back (std::move (production));
+	}
+
+	// FIRST and FOLLOW are the massager's, the ones ParseTable fills its table from, with each
+	// terminal in them taken to the token types the lexer gives for it
+	FirstsAndFollows firsts_and_follows (factored);
+	auto token_types = [&] (std::set<int> const &symbols) {
+		TTSet set = 0;
+		for (int symbol : symbols)
+		{
+			auto terminal = terminal_of.find (symbol);
+			if (terminal != std::end (terminal_of)) set |= table.terminals[terminal->second];
+		}
+		return set;
+	};
+	int count = table.nonterminals.size ();
+	table.firsts.assign (count, 0);
+	table.nullable.assign (count, false);
+	table.follows.assign (count, 0);
+	for (auto &[key, nonterminal] : nonterminal_of)
+	{
+		auto firsts = firsts_and_follows.firsts.find (key);
+		if (firsts != std::end (firsts_and_follows.firsts))
+		{
+			table.firsts[nonterminal] = token_types (firsts->second);
+			table.nullable[nonterminal] = firsts->second.count (e_index) == 1;
+		}
+		auto follows = firsts_and_follows.follows.find (key);
+		if (follows != std::end (firsts_and_follows.follows)) table.follows[nonterminal] = token_types (follows->second);
+	}
+
+	// A cell with more than one production is the dangling else, or terminals the lexer doesn't
+	// tell apart. The production that isn't e goes first, so an else binds to the nearest if.
+	table.entries.assign (count * tt_count, -1);
+	for (int p = 0; p < table.productions.size (); p++)
+	{
+		auto &production = table.productions[p];
+		auto rule_firsts = firsts_and_follows.GetFirstsOfRule (factored.Productions ()[p].rule, e_index);
+		TTSet first = token_types (rule_firsts);
+		if (rule_firsts.count (e_index) == 1) first |= table.follows[production.nonterminal];
+		for (int tt = 0; tt < tt_count; tt++)
+		{
+			if (!(first & TTBit (TT (tt)))) continue;
+			int &entry = table.entries[production.nonterminal * tt_count + tt];
+			if (entry == -1 || (table.productions[entry].rule.empty () && !production.rule.empty ())) entry = p;
+		}
+	}
+	return table;
+}
+
+std::string TTSetCode (TTSet set)
+{
+	std::string code;
+	for (int tt = 0; tt < tt_count; tt++)
+		if (set & TTBit (TT (tt)))
+			code += (code.empty () ? "TTBit (TT::" : " | TTBit (TT::") + std::string (tt_identifiers[tt]) + ")";
+	return code.empty () ? "0" : code;
+}
+
+// stmt'' is written stmt_2, as an identifier can't have primes
+std::optional<std::string> NonterminalIdentifier (std::string const &name)
+{
+	size_t primes = 0;
+	while (primes < name.size () && name[name.size () - 1 - primes] == '\'')
+		primes++;
+	std::string identifier = name.substr (0, name.size () - primes);
+	if (identifier.empty () || std::isdigit (static_cast<unsigned char> (identifier[0]))) return {};
+	for (char c : identifier)
+		if (!std::isalnum (static_cast<unsigned char> (c)) && c != '_') return {};
+	if (primes > 0) identifier += "_" + std::to_string (primes);
+	return identifier;
+}
+
+std::string StringLiteral (std::string const &text)
+{
+	std::string literal = "\"";
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\') literal += '\\';
+		literal += c;
+	}
+	return literal + "\"";
+}
+
+bool WriteLL1Header (LL1Table const &table, std::string const &grammar_file, std::string const &out_file, std::string &error)
+{
+	std::vector<std::string> identifiers;
+	for (auto &name : table.nonterminals)
+	{
+		auto identifier = NonterminalIdentifier (name);
+		if (!identifier)
+		{
+			error = "The nonterminal '" + name + "' of " + grammar_file + " can't be made an identifier";
+			return false;
+		}
+		identifiers.push_back (*identifier);
+	}
+	int count = table.nonterminals.size ();
+
+	fmt::memory_buffer out;
+	auto put = [&] (auto &&... args) { fmt::format_to (std::back_inserter (out), args...); };
+
+	put ("// Generated by the massager from {}, don't edit.\n", grammar_file);
+	put ("// The LL(1) table of the grammar, with its FIRST, FOLLOW and synchronizing sets as token type\n");
+	put ("// masks, for the parsers to recover from errors by. A nonterminal's primes become _1, _2 and so on.\n\n");
+	put ("#pragma once\n\n#include \"ll1_table.h\"\n\nnamespace GrammarTables\n{{\n");
+
+	put ("enum class NT : uint8_t\n{{\n");
+	for (auto &identifier : identifiers)
+		put ("\t{},\n", identifier);
+	put ("}};\nconstexpr int nonterminal_count = {};\n\n", count);
+
+	put ("constexpr const char *nonterminal_names[] = {{\n");
+	for (auto &name : table.nonterminals)
+		put ("\t{},\n", StringLiteral (name));
+	put ("}};\n\n");
+
+	auto sets = [&] (const char *comment, const char *array, auto set_of) {
+		put ("// {}\nconstexpr TTSet {}[] = {{\n", comment, array);
+		for (int n = 0; n < count; n++)
+			put ("\t{}, // {}\n", TTSetCode (set_of (n)), table.nonterminals[n]);
+		put ("}};\n\n");
+	};
+	sets ("FIRST, without e", "firsts", [&] (int n) { return table.firsts[n]; });
+	put ("// Whether it derives e\nconstexpr bool nullable[] = {{\n");
+	for (int n = 0; n < count; n++)
+		put ("\t{}, // {}\n", table.nullable[n] ? "true" : "false", table.nonterminals[n]);
+	put ("}};\n\n");
+	sets ("FOLLOW", "follows", [&] (int n) { return table.follows[n]; });
+	sets ("What a nonterminal expects: FIRST, and FOLLOW when it derives e", "expected", [&] (int n) {
+		return table.firsts[n] | (table.nullable[n] ? table.follows[n] : 0);
+	});
+	sets ("Where recovery from an error in a nonterminal skips to: FOLLOW, or the end of the file", "synchs", [&] (int n) {
+		return table.follows[n] | TTBit (TT::END_FILE);
+	});
+
+	put ("constexpr TTSet Expected (NT nt) {{ return expected[static_cast<int> (nt)]; }}\n");
+	put ("constexpr TTSet Synch (NT nt) {{ return synchs[static_cast<int> (nt)]; }}\n\n");
+
+	put ("// By grammar terminal, the token types it stands for\nconstexpr TTSet terminals[] = {{\n");
+	for (auto tokens : table.terminals)
+		put ("\t{},\n", TTSetCode (tokens));
+	put ("}};\n\n");
+
+	put ("constexpr LL1Symbol symbols[] = {{\n");
+	for (auto &production : table.productions)
+	{
+		put ("\t");
+		for (auto &symbol : production.rule)
+			put ("{{ {}, {} }}, ", symbol.terminal ? "true" : "false", symbol.index);
+		put ("// {}\n", production.text);
+	}
+	put ("}};\n\n");
+
+	put ("constexpr LL1GeneratedProduction productions[] = {{\n");
+	int symbols = 0;
+	for (auto &production : table.productions)
+	{
+		put ("\t{{ {}, {}, {}, {} }},\n", production.nonterminal, symbols, production.rule.size (), StringLiteral (production.text));
+		symbols += production.rule.size ();
+	}
+	put ("}};\n\n");
+
+	put ("// By nonterminal * tt_count + TT, the production to expand or -1\nconstexpr int16_t entries[] = {{\n");
+	for (int n = 0; n < count; n++)
+	{
+		put ("\t");
+		for (int tt = 0; tt < tt_count; tt++)
+			put ("{}, ", table.entries[n * tt_count + tt]);
+		put ("// {}\n", table.nonterminals[n]);
+	}
+	put ("}};\n\n");
+
+	put ("constexpr int start = {}; // {}\n", table.start, table.nonterminals[table.start]);
+	put ("constexpr int end_of_file = {};\n", table.end_of_file);
+	put ("}} // namespace GrammarTables\n");
+
+	std::ofstream file (out_file, std::ios::out | std::ios::binary);
+	file.write (out.data (), out.size ());
+	if (!file)
+	{
+		error = "Could not write " + out_file;
+		return false;
+	}
+	return true;
+}
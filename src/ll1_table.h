@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "lexer.h"
+
+class Grammar;
+
+struct LL1Symbol
+{
+	bool terminal;
+	int index; // into LL1Table::terminals or LL1Table::nonterminals
+};
+
+struct LL1Production
+{
+	int nonterminal;
+	std::vector<LL1Symbol> rule; // empty for an e production
+	std::string text;            // "factor -> 'id' factor'", as the massager writes it
+};
+
+// The LL(1) parse table of a grammar after the massager's transformations, with the grammar's
+// terminals replaced by the token types the lexer gives for them
+struct LL1Table
+{
+	std::vector<std::string> nonterminals;
+	std::vector<TTSet> terminals; // by grammar terminal, the token types it stands for
+	std::vector<LL1Production> productions;
+	std::vector<TTSet> firsts;  // by nonterminal, without e
+	std::vector<bool> nullable; // by nonterminal, derives e
+	std::vector<TTSet> follows; // by nonterminal
+	std::vector<int> entries;   // by nonterminal * tt_count + TT, the production to expand or -1
+	int start = 0;              // nonterminal
+	int end_of_file = 0;        // terminal
+
+	int Entry (int nonterminal, TT tt) const { return entries[nonterminal * tt_count + static_cast<int> (tt)]; }
+};
+
+// A production of a table generated into a header, its rule being length symbols from symbols
+struct LL1GeneratedProduction
+{
+	int nonterminal;
+	int symbols;
+	int length;
+	char const *text;
+};
+
+// The token types the lexer gives for a terminal of grammars/grammar_shorthand.txt, 0 for none
+TTSet TerminalTokenTypes (std::string const &name);
+// How tt is spelled in code, "TT::" left off
+char const *TTIdentifier (TT tt);
+// set as code, "TTBit (TT::ID) | TTBit (TT::NUM)"
+std::string TTSetCode (TTSet set);
+// text as a C++ string literal
+std::string StringLiteral (std::string const &text);
+
+// Whether grammar read from grammar_file has what a parse table is built around: the $ terminal
+// ReadGrammar adds with the TOKENS line, and productions for its start symbol. Says which is
+// missing in error when it doesn't.
+bool CheckTableGrammar (Grammar const &grammar, std::string const &grammar_file, std::string &error);
+
+// Reads grammar_file and removes its e productions, left recursion and left factors as the
+// massager does, then builds the table from its FirstsAndFollows. Fails, saying why in error,
+// when the file can't be read, fails CheckTableGrammar or names a terminal the lexer has no token
+// type for.
+std::optional<LL1Table> LoadLL1Table (std::string const &grammar_file, std::string &error);
+
+// Writes table as constexpr arrays into a header at out_file, for the compiler to be built with
+// instead of reading grammar_file at startup. Fails, saying why in error, when it can't be written.
+bool WriteLL1Header (LL1Table const &table, std::string const &grammar_file, std::string const &out_file, std::string &error);
@@ -0,0 +1,626 @@
+#include "llvm_ir.h"
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+namespace
+{
+
+struct Variable
+{
+	uint16_t level = 0; // 0 for the program's globals
+	uint32_t field = 0; // in its procedure's frame
+	RetType type = RT_none;
+	int32_t low = 0;
+};
+
+struct Frame
+{
+	std::string name; // of the function
+	uint16_t level = 0;
+	int parent = -1;      // frame index
+	bool linked = false;  // takes a static link, field 0 of the frame
+	std::vector<NodeID> params;
+};
+
+std::string TypeName (RetType type)
+{
+	if (type == RT_bool) return "i1";
+	if (type == RT_real) return "double";
+	if (IsArrInt (type)) return fmt::format ("[{} x i32]", ArraySize (type));
+	if (IsArrReal (type)) return fmt::format ("[{} x double]", ArraySize (type));
+	return "i32";
+}
+
+// A constant C string, escaped as LLVM wants it
+struct StringConstant
+{
+	char const *name;
+	char const *text;
+};
+
+constexpr StringConstant string_constants[] = {
+	{ ".int_format", "%s = %d\\0A\\00" },
+	{ ".real_format", "%s = %.17g\\0A\\00" },
+	{ ".int_element", "%s%d\\00" },
+	{ ".real_element", "%s%.17g\\00" },
+	{ ".array_open", "%s = [\\00" },
+	{ ".array_close", "]\\0A\\00" },
+	{ ".separator", ", \\00" },
+	{ ".nothing", "\\00" },
+	{ ".error_format", "Runtime error on line %d: %s\\0A\\00" },
+	{ ".division_message", "division by zero\\00" },
+	{ ".index_message", "array index out of range\\00" },
+};
+
+// Bytes in an escaped string, each \XX being one
+size_t EscapedLength (std::string_view text)
+{
+	return text.size () - 2 * std::count (text.begin (), text.end (), '\\');
+}
+
+// i8* to the start of a string constant
+std::string StringPointer (std::string_view name, size_t length)
+{
+	return fmt::format ("getelementptr inbounds ([{0} x i8], [{0} x i8]* @{1}, i64 0, i64 0)", length, name);
+}
+
+std::string StringPointer (std::string_view name)
+{
+	for (auto &constant : string_constants)
+		if (name == constant.name) return StringPointer (name, EscapedLength (constant.text));
+	return {};
+}
+
+// Reports runtime errors for the generated code, {0} being the format
+constexpr const char *runtime_support = R"(
+declare i32 @printf(i8*, ...)
+declare void @exit(i32) noreturn
+declare void @llvm.memcpy.p0i8.p0i8.i64(i8*, i8*, i64, i1)
+
+define internal void @pascal.runtime_error(i32 %line, i8* %message) noreturn cold {{
+entry:
+	call i32 (i8*, ...) @printf(i8* {0}, i32 %line, i8* %message)
+	call void @exit(i32 1)
+	unreachable
+}}
+)";
+
+// Prints name = [a, b, ...] for an array of {1}, the rest being the strings it uses
+constexpr const char *print_array = R"(
+define internal void @pascal.print_{0}s(i8* %name, {1}* %data, i32 %count) {{
+entry:
+	call i32 (i8*, ...) @printf(i8* {2}, i8* %name)
+	br label %check
+check:
+	%i = phi i32 [ 0, %entry ], [ %next, %element ]
+	%more = icmp slt i32 %i, %count
+	br i1 %more, label %element, label %done
+element:
+	%first = icmp eq i32 %i, 0
+	%before = select i1 %first, i8* {3}, i8* {4}
+	%index = sext i32 %i to i64
+	%address = getelementptr inbounds {1}, {1}* %data, i64 %index
+	%value = load {1}, {1}* %address
+	call i32 (i8*, ...) @printf(i8* {5}, i8* %before, {1} %value)
+	%next = add i32 %i, 1
+	br label %check
+done:
+	call i32 (i8*, ...) @printf(i8* {6})
+	ret void
+}}
+)";
+
+class LlvmEmitter
+{
+	public:
+	LlvmEmitter (Ast const &ast, SymbolTable const &symbols)
+	: ast (ast), symbols (symbols), variables (ast.Size ()), frame_of (ast.Size (), -1)
+	{
+	}
+
+	bool Emit (FILE *fp, std::string &error)
+	{
+		NodeID root = ast.Root ();
+		if (root == no_node)
+		{
+			error = "there is no program";
+			return false;
+		}
+		if (NodeID bad = ast.FindUnresolved (); bad != no_node)
+		{
+			error = fmt::format ("line {}: the program has errors", ast.Line (bad));
+			return false;
+		}
+		Layout (root, 0, -1);
+		Procedure (root);
+
+		fmt::memory_buffer module;
+		auto to = std::back_inserter (module);
+		fmt::format_to (to, "; generated from {}\n\n", symbols.SymbolView (ast.Symbol (root)));
+		module.append (types.data (), types.data () + types.size ());
+		fmt::format_to (to, "\n");
+		for (auto &constant : string_constants)
+			fmt::format_to (to, "@{} = private unnamed_addr constant [{} x i8] c\"{}\"\n", constant.name, EscapedLength (constant.text), constant.text);
+		for (NodeID decl : globals)
+		{
+			auto name = symbols.SymbolView (ast.Symbol (decl));
+			RetType type = variables[decl].type;
+			fmt::format_to (to, "@.name.{} = private unnamed_addr constant [{} x i8] c\"{}\\00\"\n", decl, name.size () + 1, name);
+			fmt::format_to (to, "@var.{} = internal global {} {}\n", name, TypeName (type), IsArrayType (type) ? "zeroinitializer" : type == RT_real ? "0.0" : "0");
+		}
+		fmt::format_to (to, fmt::runtime (runtime_support), StringPointer (".error_format"));
+		for (bool real : { false, true })
+			fmt::format_to (to,
+			fmt::runtime (print_array),
+			real ? "real" : "int",
+			real ? "double" : "i32",
+			StringPointer (".array_open"),
+			StringPointer (".nothing"),
+			StringPointer (".separator"),
+			StringPointer (real ? ".real_element" : ".int_element"),
+			StringPointer (".array_close"));
+		module.append (out.data (), out.data () + out.size ());
+
+		std::fwrite (module.data (), 1, module.size (), fp);
+		return true;
+	}
+
+	private:
+	template <typename... Args> void Line (fmt::format_string<Args...> format, Args &&... args)
+	{
+		out.push_back ('\t');
+		fmt::format_to (std::back_inserter (out), format, std::forward<Args> (args)...);
+		out.push_back ('\n');
+	}
+
+	void Label (std::string const &label)
+	{
+		fmt::format_to (std::back_inserter (out), "{}:\n", label);
+	}
+
+	std::string NewValue () { return fmt::format ("%t{}", next_value++); }
+	std::string NewLabel () { return fmt::format ("L{}", next_label++); }
+
+	std::string FrameType (int frame) const { return fmt::format ("%frame.{}", frame); }
+
+	// Gives each procedure a frame struct with a field per param and local, after the static link
+	// for procedures nested in another procedure
+	void Layout (NodeID proc, uint16_t level, int parent)
+	{
+		int index = frames.size ();
+		frame_of[proc] = index;
+		frames.push_back (Frame{});
+		frames[index].level = level;
+		frames[index].parent = parent;
+		frames[index].linked = level >= 2;
+		frames[index].name =
+		level == 0 ? "main" : fmt::format ("pascal.{}.{}", symbols.SymbolView (ast.Symbol (proc)), index);
+
+		std::vector<std::string> fields;
+		if (frames[index].linked) fields.push_back (FrameType (parent) + "*");
+		for (NodeID child : ast.Children (proc))
+		{
+			if (ast.Kind (child) != NodeKind::declaration || ast.Type (child) == RT_none) continue;
+			auto &v = variables[child];
+			v.level = level;
+			v.type = ast.Type (child);
+			v.low = ast.LowBound (child);
+			if (ast.IsParam (child)) frames[index].params.push_back (child);
+			if (level == 0)
+				globals.push_back (child);
+			else
+			{
+				v.field = fields.size ();
+				fields.push_back (TypeName (v.type));
+			}
+		}
+		if (level > 0)
+		{
+			fmt::format_to (std::back_inserter (types), "{} = type {{ ", FrameType (index));
+			for (size_t i = 0; i < fields.size (); i++)
+				fmt::format_to (std::back_inserter (types), "{}{}", i ? ", " : "", fields[i]);
+			fmt::format_to (std::back_inserter (types), "{}}}\n", fields.empty () ? "" : " ");
+		}
+
+		for (NodeID child : ast.Children (proc))
+			if (ast.Kind (child) == NodeKind::procedure) Layout (child, level + 1, index);
+	}
+
+	void Procedure (NodeID proc)
+	{
+		int index = frame_of[proc];
+		auto &frame = frames[index];
+		level = frame.level;
+		if (chain.size () <= level) chain.resize (level + 1);
+		chain[level] = index;
+		next_value = 0;
+		line = ast.Line (proc);
+
+		if (level == 0)
+			fmt::format_to (std::back_inserter (out), "\ndefine i32 @main() {{\nentry:\n");
+		else
+		{
+			fmt::format_to (std::back_inserter (out), "\n; procedure {}\ndefine internal void @{}(", symbols.SymbolView (ast.Symbol (proc)), frame.name);
+			bool first = true;
+			if (frame.linked)
+			{
+				fmt::format_to (std::back_inserter (out), "{}* %link", FrameType (frame.parent));
+				first = false;
+			}
+			for (NodeID param : frame.params)
+			{
+				fmt::format_to (std::back_inserter (out), "{}{}{} %param.{}", first ? "" : ", ", TypeName (variables[param].type), IsArrayType (variables[param].type) ? "*" : "", param);
+				first = false;
+			}
+			fmt::format_to (std::back_inserter (out), ") {{\nentry:\n");
+
+			std::string type = FrameType (index);
+			Line ("%frame = alloca {}", type);
+			Line ("store {0} zeroinitializer, {0}* %frame", type);
+			if (frame.linked)
+			{
+				std::string field = NewValue ();
+				Line ("{} = getelementptr inbounds {}, {}* %frame, i32 0, i32 0", field, type, type);
+				Line ("store {0}* %link, {0}** {1}", FrameType (frame.parent), field);
+			}
+			for (NodeID param : frame.params)
+			{
+				std::string address = Address (param);
+				RetType param_type = variables[param].type;
+				if (IsArrayType (param_type))
+					Copy (address, fmt::format ("%param.{}", param), param_type);
+				else
+					Line ("store {0} %param.{1}, {0}* {2}", TypeName (param_type), param, address);
+			}
+		}
+
+		for (NodeID child : ast.Children (proc))
+			if (ast.Kind (child) == NodeKind::compound) Statement (child);
+
+		if (level == 0)
+		{
+			PrintGlobals ();
+			Line ("ret i32 0");
+		}
+		else
+			Line ("ret void");
+		fmt::format_to (std::back_inserter (out), "}}\n");
+
+		for (NodeID child : ast.Children (proc))
+			if (ast.Kind (child) == NodeKind::procedure) Procedure (child);
+		level = frame.level;
+	}
+
+	// The frame of the enclosing procedure at target_level, following static links out
+	std::string FramePointer (uint16_t target_level)
+	{
+		std::string frame = "%frame";
+		for (uint16_t l = level; l > target_level; l--)
+		{
+			std::string field = NewValue (), parent = NewValue ();
+			std::string type = FrameType (chain[l]), parent_type = FrameType (chain[l - 1]);
+			Line ("{} = getelementptr inbounds {}, {}* {}, i32 0, i32 0", field, type, type, frame);
+			Line ("{} = load {}*, {}** {}", parent, parent_type, parent_type, field);
+			frame = parent;
+		}
+		return frame;
+	}
+
+	// Pointer to the variable, of its type
+	std::string Address (NodeID decl)
+	{
+		auto &v = variables[decl];
+		if (v.level == 0) return fmt::format ("@var.{}", symbols.SymbolView (ast.Symbol (decl)));
+		std::string frame = FramePointer (v.level);
+		std::string type = FrameType (chain[v.level]);
+		std::string address = NewValue ();
+		Line ("{} = getelementptr inbounds {}, {}* {}, i32 0, i32 {}", address, type, type, frame, v.field);
+		return address;
+	}
+
+	void Copy (std::string const &to, std::string const &from, RetType type)
+	{
+		std::string to_bytes = NewValue (), from_bytes = NewValue ();
+		std::string type_name = TypeName (type);
+		Line ("{} = bitcast {}* {} to i8*", to_bytes, type_name, to);
+		Line ("{} = bitcast {}* {} to i8*", from_bytes, type_name, from);
+		Line ("call void @llvm.memcpy.p0i8.p0i8.i64(i8* {}, i8* {}, i64 {}, i1 false)", to_bytes, from_bytes, type.size ());
+	}
+
+	// Branches on to the rest of the block when ok holds, otherwise stops with message
+	void Check (std::string const &ok, char const *message)
+	{
+		std::string fail = NewLabel (), pass = NewLabel ();
+		Line ("br i1 {}, label %{}, label %{}", ok, pass, fail);
+		Label (fail);
+		Line ("call void @pascal.runtime_error(i32 {}, i8* {})", line, StringPointer (message));
+		Line ("unreachable");
+		Label (pass);
+	}
+
+	// The element's index from 0, as i64, after taking off the low bound
+	std::string Offset (NodeID index, std::string const &value)
+	{
+		auto &v = variables[ast.Declaration (ast.Child (index, 0))];
+		std::string wide = NewValue (), offset = NewValue ();
+		Line ("{} = sext i32 {} to i64", wide, value);
+		Line ("{} = sub i64 {}, {}", offset, wide, v.low);
+		return offset;
+	}
+
+	// Pointer to the element, after checking offset against the bounds
+	std::string Element (NodeID index, std::string const &offset)
+	{
+		NodeID decl = ast.Declaration (ast.Child (index, 0));
+		auto &v = variables[decl];
+		line = ast.Line (index);
+		std::string in_bounds = NewValue ();
+		Line ("{} = icmp ult i64 {}, {}", in_bounds, offset, ArraySize (v.type));
+		Check (in_bounds, ".index_message");
+		std::string array = Address (decl), element = NewValue ();
+		std::string type = TypeName (v.type);
+		Line ("{} = getelementptr inbounds {}, {}* {}, i64 0, i64 {}", element, type, type, array, offset);
+		return element;
+	}
+
+	std::string RealConstant (NodeID n)
+	{
+		// the lexer keeps a float, its shortest spelling gives back the literal as written
+		double value = std::stod (fmt::format ("{}", ast.RealValue (n)));
+		uint64_t bits;
+		std::memcpy (&bits, &value, sizeof (bits));
+		return fmt::format ("0x{:016X}", bits);
+	}
+
+	std::string Expression (NodeID n)
+	{
+		line = ast.Line (n);
+		std::string type = TypeName (ast.Type (n));
+		std::string result;
+		switch (ast.Kind (n))
+		{
+			case (NodeKind::int_literal): return fmt::format ("{}", ast.IntValue (n));
+			case (NodeKind::real_literal): return RealConstant (n);
+			case (NodeKind::variable):
+			{
+				std::string address = Address (ast.Declaration (n));
+				result = NewValue ();
+				Line ("{} = load {}, {}* {}", result, type, type, address);
+				return result;
+			}
+			case (NodeKind::index):
+			{
+				std::string element = Element (n, Offset (n, Expression (ast.Child (n, 1))));
+				result = NewValue ();
+				Line ("{} = load {}, {}* {}", result, type, type, element);
+				return result;
+			}
+			case (NodeKind::unary):
+			{
+				std::string operand = Expression (ast.Child (n, 0));
+				if (ast.UnaryOperator (n) == UnaryOp::plus) return operand;
+				result = NewValue ();
+				if (ast.UnaryOperator (n) == UnaryOp::t_not)
+					Line ("{} = xor i1 {}, true", result, operand);
+				else if (ast.Type (n) == RT_real)
+					Line ("{} = fneg double {}", result, operand);
+				else
+					Line ("{} = sub i32 0, {}", result, operand);
+				return result;
+			}
+			case (NodeKind::binary): return Binary (n);
+			default: return "undef";
+		}
+	}
+
+	std::string Binary (NodeID n)
+	{
+		BinaryOp op = ast.BinaryOperator (n);
+		bool real = ast.Type (ast.Child (n, 0)) == RT_real;
+		std::string left = Expression (ast.Child (n, 0));
+		std::string right = Expression (ast.Child (n, 1));
+		line = ast.Line (n);
+		std::string operand_type = real ? "double" : ast.Type (ast.Child (n, 0)) == RT_bool ? "i1" : "i32";
+		if (!real && (op == BinaryOp::div || op == BinaryOp::mod)) return Divide (n, left, right, op == BinaryOp::mod);
+
+		char const *instruction = "";
+		switch (op)
+		{
+			case (BinaryOp::add): instruction = real ? "fadd" : "add"; break;
+			case (BinaryOp::sub): instruction = real ? "fsub" : "sub"; break;
+			case (BinaryOp::mul): instruction = real ? "fmul" : "mul"; break;
+			case (BinaryOp::div): instruction = "fdiv"; break;
+			case (BinaryOp::t_and): instruction = "and"; break;
+			case (BinaryOp::t_or): instruction = "or"; break;
+			// ordered compares are false when either side is NaN, as with the VM, apart from <>
+			case (BinaryOp::equal): instruction = real ? "fcmp oeq" : "icmp eq"; break;
+			case (BinaryOp::not_equal): instruction = real ? "fcmp une" : "icmp ne"; break;
+			case (BinaryOp::less_than): instruction = real ? "fcmp olt" : "icmp slt"; break;
+			case (BinaryOp::less_than_or_equal): instruction = real ? "fcmp ole" : "icmp sle"; break;
+			case (BinaryOp::greater_than): instruction = real ? "fcmp ogt" : "icmp sgt"; break;
+			default: instruction = real ? "fcmp oge" : "icmp sge"; break;
+		}
+		std::string result = NewValue ();
+		Line ("{} = {} {} {}, {}", result, instruction, operand_type, left, right);
+		return result;
+	}
+
+	// Truncating division. A zero divisor is a runtime error and -1 is done apart, as sdiv of
+	// INT32_MIN by -1 is undefined.
+	std::string Divide (NodeID n, std::string const &left, std::string const &right, bool mod)
+	{
+		NodeID right_node = ast.Child (n, 1);
+		bool literal = ast.Kind (right_node) == NodeKind::int_literal;
+		if (literal && ast.IntValue (right_node) != 0 && ast.IntValue (right_node) != -1)
+		{
+			std::string result = NewValue ();
+			Line ("{} = {} i32 {}, {}", result, mod ? "srem" : "sdiv", left, right);
+			return result;
+		}
+		std::string nonzero = NewValue ();
+		Line ("{} = icmp ne i32 {}, 0", nonzero, right);
+		Check (nonzero, ".division_message");
+		std::string minus_one = NewValue (), divisor = NewValue (), divided = NewValue (), result = NewValue ();
+		Line ("{} = icmp eq i32 {}, -1", minus_one, right);
+		Line ("{} = select i1 {}, i32 1, i32 {}", divisor, minus_one, right);
+		Line ("{} = {} i32 {}, {}", divided, mod ? "srem" : "sdiv", left, divisor);
+		if (mod)
+			Line ("{} = select i1 {}, i32 0, i32 {}", result, minus_one, divided);
+		else
+		{
+			std::string negated = NewValue ();
+			Line ("{} = sub i32 0, {}", negated, left);
+			Line ("{} = select i1 {}, i32 {}, i32 {}", result, minus_one, negated, divided);
+		}
+		return result;
+	}
+
+	void Statement (NodeID n)
+	{
+		line = ast.Line (n);
+		switch (ast.Kind (n))
+		{
+			case (NodeKind::compound):
+				for (NodeID child : ast.Children (n))
+					Statement (child);
+				break;
+			case (NodeKind::assign): Assign (ast.Child (n, 0), ast.Child (n, 1)); break;
+			case (NodeKind::if_then):
+			{
+				std::string then_label = NewLabel (), else_label = NewLabel (), end = NewLabel ();
+				bool has_else = ast.Children (n).size () == 3;
+				std::string condition = Expression (ast.Child (n, 0));
+				Line ("br i1 {}, label %{}, label %{}", condition, then_label, has_else ? else_label : end);
+				Label (then_label);
+				Statement (ast.Child (n, 1));
+				Line ("br label %{}", end);
+				if (has_else)
+				{
+					Label (else_label);
+					Statement (ast.Child (n, 2));
+					Line ("br label %{}", end);
+				}
+				Label (end);
+				break;
+			}
+			case (NodeKind::while_do):
+			{
+				std::string test = NewLabel (), body = NewLabel (), end = NewLabel ();
+				Line ("br label %{}", test);
+				Label (test);
+				std::string condition = Expression (ast.Child (n, 0));
+				Line ("br i1 {}, label %{}, label %{}", condition, body, end);
+				Label (body);
+				Statement (ast.Child (n, 1));
+				Line ("br label %{}", test);
+				Label (end);
+				break;
+			}
+			case (NodeKind::call): Call (n); break;
+			default: break;
+		}
+	}
+
+	void Assign (NodeID target, NodeID value)
+	{
+		RetType type = ast.Type (target);
+		if (ast.Kind (target) == NodeKind::index)
+		{
+			// in the order the VM goes: index, value, then the bounds check
+			std::string offset = Offset (target, Expression (ast.Child (target, 1)));
+			std::string result = Expression (value);
+			std::string element = Element (target, offset);
+			Line ("store {0} {1}, {0}* {2}", TypeName (type), result, element);
+		}
+		else if (IsArrayType (type))
+		{
+			std::string from = Address (ast.Declaration (value));
+			Copy (Address (ast.Declaration (target)), from, type);
+		}
+		else
+		{
+			std::string result = Expression (value);
+			Line ("store {0} {1}, {0}* {2}", TypeName (type), result, Address (ast.Declaration (target)));
+		}
+	}
+
+	// Scalars go by value; arrays as a pointer to the caller's, which the callee copies
+	void Call (NodeID n)
+	{
+		auto &callee = frames[frame_of[ast.Callee (n)]];
+		std::vector<std::string> args;
+		if (callee.linked) args.push_back (fmt::format ("{}* {}", FrameType (callee.parent), FramePointer (callee.level - 1)));
+		for (size_t i = 0; i < callee.params.size () && i < ast.Children (n).size (); i++)
+		{
+			NodeID arg = ast.Child (n, i);
+			RetType type = ast.Type (arg);
+			if (IsArrayType (type))
+				args.push_back (fmt::format ("{}* {}", TypeName (type), Address (ast.Declaration (arg))));
+			else
+			{
+				std::string value = Expression (arg);
+				args.push_back (fmt::format ("{} {}", TypeName (type), value));
+			}
+		}
+		line = ast.Line (n);
+		fmt::memory_buffer call;
+		fmt::format_to (std::back_inserter (call), "call void @{}(", callee.name);
+		for (size_t i = 0; i < args.size (); i++)
+			fmt::format_to (std::back_inserter (call), "{}{}", i ? ", " : "", args[i]);
+		Line ("{})", fmt::to_string (call));
+	}
+
+	// The language has no output statements, so the program's variables are its result
+	void PrintGlobals ()
+	{
+		for (NodeID decl : globals)
+		{
+			auto &v = variables[decl];
+			auto name = symbols.SymbolView (ast.Symbol (decl));
+			std::string name_pointer = StringPointer (fmt::format (".name.{}", decl), name.size () + 1);
+			std::string type = TypeName (v.type);
+			if (IsArrayType (v.type))
+			{
+				bool real = IsArrReal (v.type);
+				Line ("call void @pascal.print_{}s(i8* {}, {}* getelementptr inbounds ({}, {}* @var.{}, i64 0, i64 0), i32 {})",
+				real ? "real" : "int",
+				name_pointer,
+				real ? "double" : "i32",
+				type,
+				type,
+				name,
+				ArraySize (v.type));
+				continue;
+			}
+			std::string value = NewValue ();
+			Line ("{} = load {}, {}* @var.{}", value, type, type, name);
+			Line ("call i32 (i8*, ...) @printf(i8* {}, i8* {}, {} {})", StringPointer (v.type == RT_real ? ".real_format" : ".int_format"), name_pointer, type, value);
+		}
+	}
+
+	Ast const &ast;
+	SymbolTable const &symbols;
+	std::vector<Variable> variables; // by declaration node
+	std::vector<int> frame_of;       // by procedure node
+	std::vector<Frame> frames;       // the program first
+	std::vector<NodeID> globals;
+	fmt::memory_buffer types;
+	fmt::memory_buffer out;
+	size_t next_label = 0;
+
+	// the procedure being emitted
+	std::vector<int> chain; // frame of it and each procedure around it, by level
+	uint16_t level = 0;
+	size_t next_value = 0;
+	int line = 0;
+};
+
+} // namespace
+
+bool EmitLlvmIr (Ast const &ast, SymbolTable const &symbols, FILE *fp, std::string &error)
+{
+	LlvmEmitter emitter (ast, symbols);
+	return emitter.Emit (fp, error);
+}
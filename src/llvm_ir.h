@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+#include "ast.h"
+#include "common.h"
+
+// Textual LLVM IR (typed pointers, as LLVM 14 reads) from a checked program, which must have no
+// errors. The module defines main, which runs the program and prints its variables as -run does,
+// so `opt -O2` then llc or clang turn it into an executable.
+//
+// The program's variables are internal globals. Each procedure keeps its params and locals in a
+// frame struct it allocas; a nested procedure is passed a pointer to its enclosing procedure's
+// frame, its static link, as the first argument and keeps it in field 0 of its own frame.
+// Arrays are aggregates indexed from 0 after taking off the declared low bound, reals are double.
+//
+// Fails, saying why in error, for programs with errors.
+bool EmitLlvmIr (Ast const &ast, SymbolTable const &symbols, FILE *fp, std::string &error);
@@ -1,56 +1,512 @@
 
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <spawn.h>
+#include <sys/wait.h>
+extern char **environ;
+#endif
+
 #include "lexer.h"
 
+#include "bytecode.h"
+#include "llvm_ir.h"
 #include "parser.h"
+#include "ssa_passes.h"
+#include "table_parser.h"
+#include "vm.h"
+#include "x86_64.h"
+
+// Runs args[0], found on the PATH, with args as they are and no shell between, leaving its exit
+// status in status. Fails, saying why in error, when it can't be started.
+bool RunProgram (std::vector<std::string> const &args, int &status, std::string &error)
+{
+	std::vector<char *> argv;
+	for (auto &arg : args)
+		argv.push_back (const_cast<char *> (arg.c_str ()));
+	argv.push_back (nullptr);
+#ifdef _WIN32
+	intptr_t result = _spawnvp (_P_WAIT, argv[0], argv.data ());
+	if (result == -1)
+	{
+		error = std::strerror (errno);
+		return false;
+	}
+	status = static_cast<int> (result);
+	return true;
+#else
+	pid_t pid;
+	if (int spawn_error = posix_spawnp (&pid, argv[0], nullptr, nullptr, argv.data (), environ); spawn_error != 0)
+	{
+		error = std::strerror (spawn_error);
+		return false;
+	}
+	int wait_status;
+	while (waitpid (pid, &wait_status, 0) == -1)
+		if (errno != EINTR)
+		{
+			error = std::strerror (errno);
+			return false;
+		}
+	status = WIFEXITED (wait_status) ? WEXITSTATUS (wait_status) : -1;
+	return true;
+#endif
+}
 
 class Compiler
 {
 	public:
-	Compiler () : logger (), lexer (logger) {}
+	// output_dir is empty or ends in a separator, every output file of this compiler goes there
+	Compiler (std::string const &output_dir = "")
+	: logger (output_dir), lexer (logger), output_dir (output_dir)
+	{
+	}
 
 	void Compile (CodeSource &source)
 	{
 		CompilationContext context;
+		context.ast.Reserve (source.Size () / 4);
 
 		TokenStream ts (lexer, context, source);
 
 		ParserContext ct (context, ts, logger);
-		Parser::Parse (ct);
+		{
+			// tokens are lexed as the parser asks for them, so take the lex time back out
+			double lex_before = logger.stats.Seconds (Phase::lex);
+			auto start = std::chrono::steady_clock::now ();
+			if (table_parser)
+				table_parser->Parse (ct);
+			else
+				Parser::Parse (ct);
+			ts.Finish ();
+			auto elapsed = std::chrono::steady_clock::now () - start;
+			double lexed = logger.stats.Seconds (Phase::lex) - lex_before;
+			logger.stats.AddTime (Phase::parse, std::chrono::duration<double> (elapsed).count () - lexed);
+		}
+		logger.stats.Add (Counter::symbols_interned, context.symbolTable.Size ());
+		logger.stats.Add (Counter::ast_nodes, context.ast.Size ());
+
+		{
+			ScopedTimer timer (logger.stats, Phase::print_symbols);
+			OutputFileHandle sym (output_dir + "symbol_file.txt");
+			context.symbolTable.Print (sym);
+		}
+		{
+			ScopedTimer timer (logger.stats, Phase::print_addresses);
+			OutputFileHandle addr_comp (output_dir + "variable_address.txt");
+			ct.Print (addr_comp);
+		}
+		if (!emit_bytecode && !run && !emit_assembly && !native && !emit_llvm && !emit_ssa && !time_passes) return;
+		if (size_t errors = logger.ErrorCount (); errors > 0)
+		{
+			backend_output += fmt::format ("No code generated: {} errors, see the listing file\n", errors);
+			backend_failed = true;
+			return;
+		}
+		if (emit_bytecode || run) Execute (context);
+		if (emit_assembly || native) BuildNative (context);
+		if (emit_llvm) EmitLlvm (context);
+		if (emit_ssa || time_passes) Optimize (context);
+	}
+
+	// Lowers the program to SSA and runs the passes over it, writing the result to ssa.txt
+	void Optimize (CompilationContext &context)
+	{
+		std::optional<SsaModule> module;
+		std::string error;
+		{
+			ScopedTimer timer (logger.stats, Phase::ssa);
+			module = BuildSsa (context.ast, error);
+		}
+		if (module)
+		{
+			ScopedTimer timer (logger.stats, Phase::optimize);
+			passes.Run (*module, pass_stats, error);
+		}
+		if (!error.empty ())
+		{
+			backend_output += fmt::format ("No SSA: {}\n", error);
+			backend_failed = true;
+			return;
+		}
+		if (emit_ssa)
+		{
+			OutputFileHandle out (output_dir + "ssa.txt");
+			PrintSsa (*module, context.ast, context.symbolTable, out.FP ());
+		}
+	}
+
+	// Writes program.ll, for opt and llc to take from there
+	void EmitLlvm (CompilationContext &context)
+	{
+		ScopedTimer timer (logger.stats, Phase::llvm_ir);
+		std::string error;
+		OutputFileHandle out (output_dir + "program.ll");
+		if (!EmitLlvmIr (context.ast, context.symbolTable, out.FP (), error))
+		{
+			backend_output += fmt::format ("No LLVM IR: {}\n", error);
+			backend_failed = true;
+		}
+	}
+
+	// Writes program.s and, for native, assembles and links it with cc into program
+	void BuildNative (CompilationContext &context)
+	{
+		std::string assembly = output_dir + "program.s";
+		std::string error;
+		bool emitted;
+		{
+			ScopedTimer timer (logger.stats, Phase::assembly);
+			OutputFileHandle out (assembly);
+			emitted = EmitX86_64 (context.ast, context.symbolTable, out.FP (), error);
+		}
+		if (!emitted)
+		{
+			backend_output += fmt::format ("No assembly: {}\n", error);
+			backend_failed = true;
+			return;
+		}
+		if (!native) return;
 
-		OutputFileHandle sym ("symbol_file.txt");
-		context.symbolTable.Print (sym);
+		ScopedTimer timer (logger.stats, Phase::link);
+		std::vector<std::string> command = { "cc", "-o", output_dir + "program", assembly };
+		int status = 0;
+		if (!RunProgram (command, status, error))
+		{
+			backend_output += fmt::format ("Could not run cc: {}\n", error);
+			backend_failed = true;
+		}
+		else if (status != 0)
+		{
+			backend_output += fmt::format ("Linking failed: cc exited with {}, {}\n", status, fmt::join (command, " "));
+			backend_failed = true;
+		}
+	}
+
+	// Lowers the program to bytecode to write out and/or run, leaving what the run printed in
+	// backend_output
+	void Execute (CompilationContext &context)
+	{
+		std::optional<Bytecode> bytecode;
+		std::string error;
+		{
+			ScopedTimer timer (logger.stats, Phase::bytecode);
+			bytecode = CompileBytecode (context.ast, error);
+		}
+		if (!bytecode)
+		{
+			backend_output += fmt::format ("Not run: {}\n", error);
+			backend_failed = true;
+			return;
+		}
+		if (emit_bytecode)
+		{
+			OutputFileHandle out (output_dir + "bytecode.txt");
+			PrintBytecode (*bytecode, context.symbolTable, out.FP ());
+		}
+		if (!run) return;
 
-		OutputFileHandle addr_comp ("variable_address.txt");
-		ct.Print (addr_comp);
+		VM vm (*bytecode);
+		RunStatus status;
+		{
+			ScopedTimer timer (logger.stats, Phase::run);
+			status = vm.Run ();
+		}
+		if (status != RunStatus::ok)
+		{
+			backend_output += fmt::format ("Runtime error on line {}: {}\n", vm.ErrorLine (), run_status_messages[static_cast<size_t> (status)]);
+			backend_failed = true;
+			return;
+		}
+		// the language has no output statements, so the program's variables are its result
+		auto print_value = [&] (RetType type, uint32_t slot) {
+			Value v = vm.Global (slot);
+			backend_output += type == RT_real || IsArrReal (type) ? fmt::format ("{}", v.r) : fmt::format ("{}", v.i);
+		};
+		for (auto &global : bytecode->globals)
+		{
+			backend_output += fmt::format ("{} = ", context.symbolTable.SymbolView (global.name));
+			if (IsArrayType (global.type))
+			{
+				backend_output += "[";
+				for (uint32_t i = 0; i < ArraySize (global.type); i++)
+				{
+					if (i > 0) backend_output += ", ";
+					print_value (global.type, global.slot + i);
+				}
+				backend_output += "]";
+			}
+			else
+				print_value (global.type, global.slot);
+			backend_output += "\n";
+		}
 	}
 
+	bool emit_bytecode = false;
+	bool run = false;
+	bool emit_assembly = false;
+	bool native = false;
+	bool emit_llvm = false;
+	bool emit_ssa = false;
+	bool time_passes = false;
+	TableParser const *table_parser = nullptr; // parses with Parser::Parse when null
+	PassManager passes;
+	PassStats pass_stats;
+	std::string backend_output; // printed once the file is done, so files don't interleave
+	bool backend_failed = false;
+
 	Logger logger;
 	Lexer lexer;
+	std::string output_dir;
 };
 
+struct CompileJob
+{
+	std::string input;
+	std::string output_dir;
+};
 
-int main (int argc, char *argv[])
+// One output directory per input under output_root, named after the input file. The directories are
+// made once their input has been opened.
+std::vector<CompileJob> MakeJobs (std::vector<std::string> const &inputs, std::filesystem::path const &output_root)
 {
-	std::vector<std::string> file_list;
-	// file_list.push_back("test_input/test_passing.txt");
-	// file_list.push_back ("test_input/test_some_errors.txt");
-	// file_list.push_back("test_input/test_syn_error.txt");
+	std::vector<CompileJob> jobs;
+	std::unordered_set<std::string> used_names;
+	for (auto &input : inputs)
+	{
+		std::string name = std::filesystem::path (input).stem ().string ();
+		std::string unique_name = name;
+		for (int i = 1; used_names.count (unique_name); i++)
+			unique_name = name + "_" + std::to_string (i);
+		used_names.insert (unique_name);
+
+		auto dir = output_root / unique_name;
+		jobs.push_back (CompileJob{ input, (dir / "").string () });
+	}
+	return jobs;
+}
 
-	file_list.push_back ("test_input/test_sem.txt");
+void PrintUsage ()
+{
+	fmt::print ("usage: compiler [-j threads] [-o output_dir] [-ftime-report[=json]] [-run] [-emit-bytecode] [-S] [-native] [-emit-llvm] [-emit-ssa] [-passes=list] [-verify-ssa] [-time-passes] [-table-parser[=grammar]] files...\n"
+	            "With no files, test_input/test_sem.txt is compiled into the current directory.\n"
+	            "-ftime-report prints the time spent per phase (summed over threads) and event counts.\n"
+	            "-run runs each program without errors in the bytecode VM and prints its variables.\n"
+	            "-emit-bytecode writes the program's bytecode to bytecode.txt.\n"
+	            "-S writes x86-64 assembly to program.s, -native also links it with cc into program.\n"
+	            "-emit-llvm writes LLVM IR to program.ll.\n"
+	            "-emit-ssa writes the program's SSA, after the passes, to ssa.txt.\n"
+	            "-passes=list runs the comma separated passes over the SSA instead of {}.\n"
+	            "-verify-ssa checks the SSA after every pass.\n"
+	            "-time-passes prints the time and instructions in and out of each pass.\n"
+	            "-table-parser parses from the LL(1) table of the grammar instead of with the hand-written\n"
+	            "parser, by default the table of grammars/grammar_shorthand.txt built into the compiler.\n",
+	default_ssa_pipeline);
+	for (auto &pass : ssa_passes)
+		fmt::print ("  {:<10} {}\n", pass.name, pass.description);
+}
 
-	// if (argc == 2) { inFileName = std::string (argv[1]); }
+int main (int argc, char *argv[])
+{
+	std::vector<std::string> inputs;
+	std::filesystem::path output_root = "out";
+	unsigned thread_count = std::max (1u, std::thread::hardware_concurrency ());
+	enum class Report
+	{
+		none,
+		table,
+		json
+	} report = Report::none;
+	bool emit_bytecode = false;
+	bool run = false;
+	bool emit_assembly = false;
+	bool native = false;
+	bool emit_llvm = false;
+	bool emit_ssa = false;
+	bool time_passes = false;
+	std::string pipeline = default_ssa_pipeline;
+	bool verify_ssa = false;
+	bool use_table_parser = false;
+	std::string grammar; // for the table parser, empty for the built in table
 
-	FileReader fileReader (file_list);
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if ((arg == "-j" || arg == "-o") && i + 1 == argc)
+		{
+			PrintUsage ();
+			return 1;
+		}
+		if (arg == "-j")
+		{
+			std::string_view value = argv[++i];
+			int threads = 0;
+			auto [end, ec] = std::from_chars (value.data (), value.data () + value.size (), threads);
+			if (ec != std::errc () || end != value.data () + value.size ())
+			{
+				PrintUsage ();
+				return 1;
+			}
+			thread_count = std::max (1, threads);
+		}
+		else if (arg == "-o")
+			output_root = argv[++i];
+		else if (arg == "-ftime-report")
+			report = Report::table;
+		else if (arg == "-ftime-report=json")
+			report = Report::json;
+		else if (arg == "-run")
+			run = true;
+		else if (arg == "-emit-bytecode")
+			emit_bytecode = true;
+		else if (arg == "-S")
+			emit_assembly = true;
+		else if (arg == "-native")
+			native = true;
+		else if (arg == "-emit-llvm")
+			emit_llvm = true;
+		else if (arg == "-emit-ssa")
+			emit_ssa = true;
+		else if (arg.rfind ("-passes=", 0) == 0)
+			pipeline = arg.substr (std::strlen ("-passes="));
+		else if (arg == "-verify-ssa")
+			verify_ssa = true;
+		else if (arg == "-time-passes")
+			time_passes = true;
+		else if (arg == "-table-parser")
+			use_table_parser = true;
+		else if (arg.rfind ("-table-parser=", 0) == 0)
+		{
+			use_table_parser = true;
+			grammar = arg.substr (std::strlen ("-table-parser="));
+		}
+		else if (arg == "-h" || arg == "--help")
+		{
+			PrintUsage ();
+			return 0;
+		}
+		else
+			inputs.push_back (arg);
+	}
 
-	auto sc = fileReader.Read ();
-	while (sc.has_value ())
+	PassManager passes;
+	passes.verify = verify_ssa;
+	if (std::string error; !passes.AddPipeline (pipeline, error))
 	{
-		Compiler compiler;
+		fmt::print ("{}\n", error);
+		return 1;
+	}
 
-		compiler.Compile (sc.value ());
-		compiler.logger.LogErrors ();
-		sc = fileReader.Read ();
+	std::optional<TableParser> table_parser;
+	if (use_table_parser)
+	{
+		std::string error;
+		auto ll1_table = grammar.empty () ? GeneratedLL1Table () : LoadLL1Table (grammar, error);
+		if (!ll1_table || !table_parser.emplace ().Bind (std::move (*ll1_table), error))
+		{
+			fmt::print ("{}\n", error);
+			return 1;
+		}
 	}
 
-	return 0;
+	std::vector<CompileJob> jobs;
+	if (inputs.empty ())
+		jobs.push_back (CompileJob{ "test_input/test_sem.txt", "" });
+	else
+		jobs = MakeJobs (inputs, output_root);
+	thread_count = std::min<unsigned> (thread_count, jobs.size ());
+
+	std::atomic<size_t> next_job = 0;
+	std::atomic<size_t> total_bytes = 0;
+	std::atomic<size_t> total_lines = 0;
+	std::atomic<int> failed = 0;
+	Stats total_stats;
+	PassStats total_pass_stats;
+	std::mutex stats_mutex;
+
+	auto worker = [&] {
+		for (size_t job = next_job++; job < jobs.size (); job = next_job++)
+		{
+			Stats read_stats;
+			std::optional<CodeSource> source;
+			{
+				ScopedTimer timer (read_stats, Phase::read);
+				source.emplace (jobs[job].input);
+			}
+			if (!source->IsOpen ())
+			{
+				fmt::print ("Could not open {}\n", jobs[job].input);
+				failed++;
+				continue;
+			}
+			if (std::error_code ec; !jobs[job].output_dir.empty ()
+			    && !std::filesystem::is_directory (jobs[job].output_dir)
+			    && !std::filesystem::create_directories (jobs[job].output_dir, ec))
+			{
+				fmt::print ("Could not create {}: {}\n", jobs[job].output_dir, ec.message ());
+				failed++;
+				continue;
+			}
+			Compiler compiler (jobs[job].output_dir);
+			compiler.emit_bytecode = emit_bytecode;
+			compiler.run = run;
+			compiler.emit_assembly = emit_assembly;
+			compiler.native = native;
+			compiler.emit_llvm = emit_llvm;
+			compiler.emit_ssa = emit_ssa;
+			compiler.time_passes = time_passes;
+			compiler.passes = passes;
+			if (table_parser) compiler.table_parser = &*table_parser;
+			compiler.Compile (*source);
+			compiler.logger.LogErrors ();
+			if (compiler.backend_failed) failed++;
+			{
+				std::lock_guard<std::mutex> lock (stats_mutex);
+				if (!compiler.backend_output.empty () && jobs.size () > 1) fmt::print ("{}:\n", jobs[job].input);
+				fmt::print ("{}", compiler.backend_output);
+				total_stats.Merge (read_stats);
+				total_stats.Merge (compiler.logger.stats);
+				total_pass_stats.Merge (compiler.pass_stats);
+			}
+
+			total_bytes += source->Size ();
+			total_lines += source->lines.size ();
+		}
+	};
+
+	auto start = std::chrono::high_resolution_clock::now ();
+	std::vector<std::thread> threads;
+	for (unsigned i = 1; i < thread_count; i++)
+		threads.emplace_back (worker);
+	worker ();
+	for (auto &t : threads)
+		t.join ();
+	double seconds =
+	std::chrono::duration<double> (std::chrono::high_resolution_clock::now () - start).count ();
+
+	if (!inputs.empty ())
+	{
+		fmt::print ("Compiled {} files ({} lines, {:.2f} MB) on {} threads in {:.3f}s: {:.0f} lines/s, {:.2f} MB/s\n",
+		jobs.size () - failed,
+		total_lines.load (),
+		total_bytes / (1024.0 * 1024.0),
+		thread_count,
+		seconds,
+		total_lines / seconds,
+		total_bytes / (1024.0 * 1024.0) / seconds);
+	}
+	if (report == Report::table) total_stats.PrintTable (stdout);
+	if (report == Report::json) total_stats.PrintJson (stdout);
+	if (time_passes) total_pass_stats.PrintTable (stdout);
+	return failed == 0 ? 0 : 1;
 }
@@ -0,0 +1,53 @@
+#include "grammar_massager.h"
+#include "lalr_table.h"
+#include "ll1_table.h"
+
+// usage: massager                            writes each step for grammars/grammar_shorthand.txt
+//        massager -linear-e grammar out_name  writes each step for grammar, taking the e productions
+//                                             out with BetterRemoveEpsilonProductions
+//        massager -header grammar out_file   writes the grammar's tables as a C++ header
+//        massager -lalr grammar out_file     writes the LALR(1) tables of the grammar as it is as a
+//                                             C++ header, listing their conflicts
+// -progress before any of these reports each variable left recursion is taken out of
+int main (int argc, char *argv[])
+{
+	if (argc >= 2 && std::string (argv[1]) == "-progress")
+	{
+		massager_progress = stdout;
+		argc--;
+		argv++;
+	}
+	if (argc == 4 && std::string (argv[1]) == "-header")
+	{
+		std::string error;
+		auto table = LoadLL1Table (argv[2], error);
+		if (!table || !WriteLL1Header (*table, argv[2], argv[3], error))
+		{
+			fmt::print (stderr, "{}\n", error);
+			return 1;
+		}
+		return 0;
+	}
+	if (argc == 4 && std::string (argv[1]) == "-lalr")
+	{
+		std::string error;
+		auto table = LoadLALRTable (argv[2], error);
+		if (!table || !WriteLALRHeader (*table, argv[2], argv[3], error))
+		{
+			fmt::print (stderr, "{}\n", error);
+			return 1;
+		}
+		fmt::print ("{} states, {} conflicts\n", table->states, table->conflicts.size ());
+		for (auto &conflict : table->conflicts)
+			fmt::print ("{}\n", conflict);
+		return 0;
+	}
+	if (argc == 4 && std::string (argv[1]) == "-linear-e")
+	{
+		MassageGrammar (argv[2], argv[3], EpsilonRemoval::linear);
+		return 0;
+	}
+	// MassageGrammar ("grammars/simple.txt", "simple");
+	MassageGrammar ("grammars/grammar_shorthand.txt", "pascal");
+	return 0;
+}
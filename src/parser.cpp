@@ -1,171 +1,264 @@
 #include "parser.h"
 
-uint32_t RT_err = 0;
-uint32_t RT_none = 1;
-uint32_t RT_bool = 2;
-uint32_t RT_int = 3;
-uint32_t RT_real = 4;
-uint32_t RT_arr_int = 5;
-uint32_t RT_arr_real = 6;
-bool IsArrInt (RetType rt) { return (rt.data & 255) == RT_arr_int; }
+#include "grammar_tables.h"
 
-bool IsArrReal (RetType rt) { return (rt.data & 255) == RT_arr_real; }
-bool IsArrayType (RetType rt) { return IsArrInt (rt) || IsArrReal (rt); }
+bool HasSymbol (TokenInfo t) { return t.HasSymbol (); }
+int GetSymbol (TokenInfo t) { return t.Symbol (); }
+int GetNumValInt (TokenInfo t) { return t.IntValue (); }
+float GetNumValReal (TokenInfo t) { return t.RealValue (); }
 
-bool HasSymbol (TokenInfo t) { return std::holds_alternative<SymbolType> (t.attrib); }
-int GetSymbol (TokenInfo t) { return std::get<SymbolType> (t.attrib).loc; }
-int GetNumValInt (TokenInfo t) { return std::get<int> (std::get<NumType> (t.attrib).val); }
-float GetNumValReal (TokenInfo t) { return std::get<float> (std::get<NumType> (t.attrib).val); }
+// BinaryOp of an operator token's attribute, for the nodes of binary expressions
+uint8_t NodeOp (SignOpEnum op)
+{
+	return static_cast<uint8_t> (op == SignOpEnum::minus ? BinaryOp::sub : BinaryOp::add);
+}
+uint8_t NodeOp (MulOpEnum op)
+{
+	switch (op)
+	{
+		case (MulOpEnum::mul): return static_cast<uint8_t> (BinaryOp::mul);
+		case (MulOpEnum::div): return static_cast<uint8_t> (BinaryOp::div);
+		case (MulOpEnum::mod): return static_cast<uint8_t> (BinaryOp::mod);
+		default: return static_cast<uint8_t> (BinaryOp::t_and);
+	}
+}
+uint8_t NodeOp (RelOpEnum op)
+{
+	return static_cast<uint8_t> (BinaryOp::equal) + static_cast<uint8_t> (op);
+}
 
 
-ProcedureID ParseTree::SetStartProcedure (SymbolID name)
+int &ParseTree::Slot (std::vector<int> &by_symbol, SymbolID s, int fill)
 {
-	procedures.emplace (0, name);
-	return procIDCounter++;
+	size_t index = s + 1;
+	if (index >= by_symbol.size ()) by_symbol.resize (index + 1, fill);
+	return by_symbol[index];
 }
 
-ProcedureID ParseTree::AddSubProcedure (SymbolID newProcName)
+void ParseTree::BindProcedure (SymbolID name, ProcedureID proc, bool is_sub_proc)
 {
-	ProcedureID curProc = eye;
-	while (curProc != -1)
+	int &head = Slot (procedure_head, name, -1);
+	int index = procedure_names.size ();
+	// within one scope the own name, then the first sub procedure of a name, is the one found
+	if (head >= 0 && procedure_names[head].scope == eye)
+		procedure_names.push_back (ProcedureBinding{ name, eye, proc, is_sub_proc, not_linked });
+	else
 	{
+		procedure_names.push_back (ProcedureBinding{ name, eye, proc, is_sub_proc, head });
+		head = index;
+	}
 
-		if (newProcName == procedures.at (curProc).name) return -1;
-
-		for (auto [id, name] : procedures.at (curProc).sub_procs)
-		{
-			if (name == newProcName)
-			{
-				// error - not unique
-				return -1;
-			}
-		}
-		curProc = procedures.at (curProc).parent;
+	if (is_sub_proc)
+	{
+		Slot (sub_proc_count, name, 0)++;
+		if (proc >= sub_proc_in_scope.size ()) sub_proc_in_scope.resize (proc + 1, 0);
+		sub_proc_in_scope[proc] = 1;
 	}
+	else
+		Slot (own_name_count, name, 0)++;
+}
 
-	procedures.emplace (std::make_pair (procIDCounter, Procedure (newProcName, eye)));
-	procedures.at (eye).AddSubProc (newProcName, procIDCounter);
-	//	procedures[procIDCounter] = Procedure (newProcName, eye);
-	return procIDCounter++;
+ProcedureID ParseTree::SetStartProcedure (SymbolID name)
+{
+	if (procedures.empty ()) procedures.emplace_back (name);
+	return 0;
 }
 
-bool ParseTree::CheckProcedure (SymbolID s)
+ProcedureID ParseTree::AddSubProcedure (SymbolID newProcName)
 {
-	ProcedureID curProc = eye;
-	while (curProc != -1)
-	{
-		for (auto [id, name] : procedures.at (curProc).sub_procs)
-		{
-			if (id == s) { return true; }
-		}
-		curProc = procedures.at (curProc).parent;
-	}
-	return false;
+	if (Slot (own_name_count, newProcName, 0) > 0) return -1;
+	// the scan over sub_procs this replaced compared newProcName with their ProcedureIDs, keep
+	// reporting the same procedures as not unique
+	if (newProcName >= 0 && newProcName < sub_proc_in_scope.size () && sub_proc_in_scope[newProcName])
+		return -1;
+
+	ProcedureID id = procedures.size ();
+	procedures.emplace_back (newProcName, eye);
+	sub_procedures_linked = false;
+	BindProcedure (newProcName, id, true);
+	return id;
 }
 
+bool ParseTree::CheckProcedure (SymbolID s) { return Slot (sub_proc_count, s, 0) > 0; }
+
 std::vector<RetType> ParseTree::SubProcedureType (SymbolID s)
 {
-	ProcedureID curProc = eye;
-	while (curProc != -1)
-	{
-		if (s == procedures.at (curProc).name) { return procedures.at (curProc).Signature (); }
-		for (auto [s_id, proc_id] : procedures.at (curProc).sub_procs)
-		{
-			if (s == s_id) { return procedures.at (proc_id).Signature (); }
-		}
-		curProc = procedures.at (curProc).parent;
-	}
-	return {};
+	int head = Slot (procedure_head, s, -1);
+	if (head < 0) return {};
+	return Signature (procedure_names[head].proc);
 }
 
 
-bool ParseTree::AddVariable (SymbolID newName, RetType type, bool isParam)
+bool ParseTree::AddVariable (SymbolID newName, RetType type, bool isParam, NodeID decl)
 {
 	// TODO: check for procedures with same name
-	if (procedures.count (eye) == 1)
+	if (HasProcedure (eye))
 	{
-		for (auto [name, type] : procedures.at (eye).params)
-		{
-			if (newName == name)
-			{ // error
-				return true;
-			}
-		}
-		for (auto [name, type] : procedures.at (eye).locals)
-		{
-			if (newName == name)
-			{ // error
-				return true;
-			}
+		int &head = Slot (variable_head, newName, -1);
+		if (head >= 0 && variables[head].scope == eye)
+		{ // error
+			return true;
 		}
 
 		if (isParam)
-		{ procedures.at (eye).params.push_back (std::pair<SymbolID, RetType> (newName, type)); } else
-		{
-			procedures.at (eye).locals.push_back (std::pair<SymbolID, RetType> (newName, type));
-		}
-	}
-	else
-	{
-		int i = 0;
+			Append (variable_pool, procedures[eye].params, Variable (newName, type));
+		else
+			Append (variable_pool, procedures[eye].locals, Variable (newName, type));
+		variables.push_back (VariableBinding{ newName, eye, type, decl, head });
+		head = variables.size () - 1;
 	}
 	return false;
 }
 
 std::optional<RetType> ParseTree::CheckVariable (SymbolID s)
 {
-	ProcedureID curProc = eye;
-	while (curProc != -1)
+	int head = Slot (variable_head, s, -1);
+	if (head < 0) return {};
+	return variables[head].type;
+}
+
+NodeID ParseTree::Declaration (SymbolID s)
+{
+	int head = Slot (variable_head, s, -1);
+	if (head < 0) return no_node;
+	return variables[head].decl;
+}
+
+ProcedureID ParseTree::FindProcedure (SymbolID s)
+{
+	int head = Slot (procedure_head, s, -1);
+	if (head < 0) return -1;
+	return procedure_names[head].proc;
+}
+
+void ParseTree::Push (ProcedureID id)
+{
+	eye = id;
+	if (HasProcedure (id)) BindProcedure (procedures[id].name, id, false);
+}
+void ParseTree::Pop ()
+{
+	if (!HasProcedure (eye)) return;
+
+	while (!variables.empty () && variables.back ().scope == eye)
 	{
-		for (auto [id, type] : procedures.at (curProc).params)
-		{
-			if (id == s) { return type; }
-		}
-		for (auto [id, type] : procedures.at (curProc).locals)
+		Slot (variable_head, variables.back ().name, -1) = variables.back ().shadowed;
+		variables.pop_back ();
+	}
+	while (!procedure_names.empty () && procedure_names.back ().scope == eye)
+	{
+		auto &binding = procedure_names.back ();
+		if (binding.shadowed != not_linked) Slot (procedure_head, binding.name, -1) = binding.shadowed;
+		if (binding.is_sub_proc)
 		{
-			if (id == s) { return type; }
+			Slot (sub_proc_count, binding.name, 0)--;
+			sub_proc_in_scope[binding.proc] = 0;
 		}
-		curProc = procedures.at (curProc).parent;
+		else
+			Slot (own_name_count, binding.name, 0)--;
+		procedure_names.pop_back ();
 	}
-	return {};
+	eye = procedures[eye].parent;
 }
 
-void ParseTree::Push (ProcedureID id) { eye = id; }
-void ParseTree::Pop ()
+PoolView<Variable> ParseTree::Params (ProcedureID id) const
+{
+	return PoolView<Variable> (variable_pool, procedures.at (id).params);
+}
+
+PoolView<Variable> ParseTree::Locals (ProcedureID id) const
+{
+	return PoolView<Variable> (variable_pool, procedures.at (id).locals);
+}
+
+PoolView<SubProcedure> ParseTree::SubProcedures (ProcedureID id)
+{
+	if (!sub_procedures_linked) LinkSubProcedures ();
+	return PoolView<SubProcedure> (sub_procedure_pool, procedures.at (id).sub_procs);
+}
+
+std::vector<RetType> ParseTree::Signature (ProcedureID id) const
 {
-	if (procedures.count (eye) == 1) eye = procedures.at (eye).parent;
+	std::vector<RetType> out;
+	for (auto [name, type] : Params (id))
+		out.push_back (type);
+	return out;
+}
+
+void ParseTree::Append (std::vector<Variable> &pool, PoolSpan &span, Variable variable)
+{
+	// normally a procedure's variables are all declared before the next procedure's, if not its
+	// run is moved to the end of the pool so it stays in one piece
+	if (span.offset + span.length != pool.size ())
+	{
+		uint32_t offset = pool.size ();
+		for (uint32_t i = 0; i < span.length; i++)
+			pool.push_back (pool[span.offset + i]);
+		span.offset = offset;
+	}
+	pool.push_back (variable);
+	span.length++;
+}
+
+// Children of a procedure are interleaved with their own children as they are parsed, so the
+// sub procedure runs are laid out afterwards, grouping procedures by parent in id order.
+void ParseTree::LinkSubProcedures ()
+{
+	for (auto &proc : procedures)
+		proc.sub_procs = PoolSpan{};
+	for (auto &proc : procedures)
+		if (HasProcedure (proc.parent)) procedures[proc.parent].sub_procs.length++;
+
+	uint32_t offset = 0;
+	for (auto &proc : procedures)
+	{
+		proc.sub_procs.offset = offset;
+		offset += proc.sub_procs.length;
+		proc.sub_procs.length = 0;
+	}
+
+	sub_procedure_pool.resize (offset);
+	for (ProcedureID id = 0; id < procedures.size (); id++)
+	{
+		ProcedureID parent = procedures[id].parent;
+		if (!HasProcedure (parent)) continue;
+		auto &span = procedures[parent].sub_procs;
+		sub_procedure_pool[span.offset + span.length++] = SubProcedure (procedures[id].name, id);
+	}
+	sub_procedures_linked = true;
 }
 
 ParserContext::ParserContext (CompilationContext &context, TokenStream &ts, Logger &logger)
-: context (context), ts (ts), logger (logger)
+: ast (context.ast), context (context), ts (ts), logger (logger)
 {
 }
 
 TokenInfo ParserContext::Current () const { return ts.Current (); }
 TokenInfo ParserContext::Advance () { return ts.Advance (); }
 
-void ParserContext::LogErrorExpectedGot (std::vector<TT> const &types)
+void ParserContext::LogErrorExpectedGot (TTSet types)
 {
 	using namespace std::string_literals;
 
 	std::string out = "SYNERR: Expected "s;
-	int count = 0;
-	for (auto &t : types)
+	bool first = true;
+	for (int t = 0; t < tt_count; t++)
 	{
-		out = out + t;
-		if (count++ != types.size () - 1) out += ", ";
+		if (!(types & TTBit (TT (t)))) continue;
+		if (!first) out += ", ";
+		out = out + TT (t);
+		first = false;
 	}
 	out += "; Recieved "s + Current ().type;
 
-	logger.AddSynErrPrint (Current ().line_location, [=](FILE *fp) { fmt::print (fp, "{}\n", out); });
+	logger.AddSynError (Current ().line_location, Current ().column_location, out);
 }
 
 
 void ParserContext::LogErrorSem (RetType in, std::string msg, TokenInfo const &t)
 {
 	if (in != RT_err)
-		logger.AddSemErrPrint (
-		t.line_location, [=](FILE *fp) { fmt::print (fp, "{}\n", "SEMERR: " + msg); });
+		logger.AddSemError (t.line_location, t.column_location, msg);
 }
 
 void ParserContext::LogErrorUniqueProcedure (RetType in, TokenInfo const &t)
@@ -184,16 +277,41 @@ void ParserContext::LogErrorUniqueIdentifier (RetType in, TokenInfo const &t)
 }
 
 
+NodeID ParserContext::Emit (NodeKind kind, RetType type, SymbolID symbol, int32_t value, int line, uint8_t op)
+{
+	NodeID node = ast.Add (kind, type, symbol, value, line, op);
+	open_nodes.push_back (node);
+	return node;
+}
+
+NodeID ParserContext::Reduce (size_t height, NodeKind kind, RetType type, SymbolID symbol, int32_t value, int line, uint8_t op)
+{
+	NodeID node = ast.Add (kind, type, symbol, value, line, op);
+	ast.SetChildren (node, open_nodes.data () + height, open_nodes.data () + open_nodes.size ());
+	open_nodes.resize (height);
+	open_nodes.push_back (node);
+	return node;
+}
+
+void ParserContext::Adopt (size_t height)
+{
+	auto first = open_nodes.data () + height + 1;
+	ast.SetChildren (open_nodes[height], first, open_nodes.data () + open_nodes.size ());
+	open_nodes.resize (height + 1);
+}
+
+NodeID ParserContext::EmitError () { return Emit (NodeKind::error, RT_err, -1, 0, Current ().line_location); }
+
 std::string ParserContext::SymbolName (SymbolID loc)
 {
-	return context.symbolTable.SymbolView (loc);
+	return std::string (context.symbolTable.SymbolView (loc));
 }
 
 
 void ParserContext::Print (OutputFileHandle &out)
 {
 	std::function<void(ProcedureID, int)> proc_print = [&, this](ProcedureID id, int width) {
-		if (tree.procedures.count (id) == 1)
+		if (tree.HasProcedure (id))
 		{
 
 
@@ -202,10 +320,10 @@ void ParserContext::Print (OutputFileHandle &out)
 			"",
 			width,
 			std::to_string (id),
-			SymbolName (tree.procedures.at (id).name));
+			SymbolName (tree.GetProcedure (id).name));
 
 			uint32_t addr = 0;
-			for (auto &[name, type] : tree.procedures.at (id).locals)
+			for (auto &[name, type] : tree.Locals (id))
 			{
 				fmt::print (out.FP (),
 				"{:-<{}}Local variable Name: {}, Type: {}, Address: {}\n",
@@ -217,7 +335,7 @@ void ParserContext::Print (OutputFileHandle &out)
 
 				addr += type.size ();
 			}
-			for (auto &[name, sub_id] : tree.procedures.at (id).sub_procs)
+			for (auto &[name, sub_id] : tree.SubProcedures (id))
 			{
 				proc_print (sub_id, width + 4);
 			}
@@ -240,36 +358,60 @@ void ParserContext::Match (TT tt, RetType &rt)
 
 	else //  (tt != Current ().type)
 	{
-		LogErrorExpectedGot ({ tt });
+		LogErrorExpectedGot (TTBit (tt));
 		Advance ();
 		rt = RT_err;
 	}
 }
 
-void ParserContext::Synch (std::vector<TT> const &set)
+void ParserContext::Synch (TTSet set)
 {
+	set |= TTBit (TT::END_FILE);
 	TT tt = Current ().type;
-
-	bool found = false;
-	if (tt == TT::END_FILE) found = true;
-	for (auto &s : set)
-		if (s == tt) found = true;
-	while (!found)
+	while (!(set & TTBit (tt)))
 	{
+		logger.stats.Add (Counter::synch_tokens_skipped);
 		tt = Advance ().type;
-		if (tt == TT::END_FILE) found = true;
-		for (auto &s : set)
-			if (s == tt) found = true;
 	}
 }
 
-RetType DefaultErr (ParserContext &pc, std::vector<TT> got, std::vector<TT> synch)
+RetType DefaultErr (ParserContext &pc, TTSet expected, TTSet synch)
 {
-	pc.LogErrorExpectedGot (got);
+	pc.LogErrorExpectedGot (expected);
 	pc.Synch (synch);
 	return RT_err;
 }
 
+// Reports what nt expects and recovers to its FOLLOW, from the sets generated from the grammar
+RetType DefaultErr (ParserContext &pc, GrammarTables::NT nt)
+{
+	return DefaultErr (pc, GrammarTables::Expected (nt), GrammarTables::Synch (nt));
+}
+
+NodeID EmitDeclaration (ParserContext &pc, TokenInfo const &tid, RetType type, bool isParam)
+{
+	int low = IsArrayType (type) ? pc.array_low_bound : 0;
+	return pc.Emit (NodeKind::declaration, type, GetSymbol (tid), low, tid.line_location, isParam);
+}
+
+NodeID EmitProcedure (ParserContext &pc, NodeKind kind, ProcedureID id, TokenInfo const &tid)
+{
+	NodeID node = pc.Emit (kind, RT_none, GetSymbol (tid), id, tid.line_location);
+	if (id >= 0)
+	{
+		if (id >= pc.procedure_nodes.size ()) pc.procedure_nodes.resize (id + 1, no_node);
+		pc.procedure_nodes[id] = node;
+	}
+	return node;
+}
+
+NodeID CalleeNode (ParserContext &pc, SymbolID s)
+{
+	ProcedureID id = pc.tree.FindProcedure (s);
+	if (id < 0 || id >= pc.procedure_nodes.size ()) return no_node;
+	return pc.procedure_nodes[id];
+}
+
 namespace Parser
 {
 void Parse (ParserContext &pc)
@@ -287,13 +429,21 @@ void Parse (ParserContext &pc)
 	//}
 }
 
-void prog_stmt_program (ParserContext &pc, RetType in)
+size_t ProgramHead (ParserContext &pc, RetType in)
 {
-	pc.Match (TT::PROG, in);
-
 	ProcedureID cur = pc.tree.SetStartProcedure (GetSymbol (pc.Current ()));
 	if (cur == -1) { pc.LogErrorUniqueProcedure (in, pc.Current ()); }
 	pc.tree.Push (cur);
+	size_t height = pc.OpenNodes ();
+	pc.ast.SetRoot (EmitProcedure (pc, NodeKind::program, cur, pc.Current ()));
+	return height;
+}
+
+void prog_stmt_program (ParserContext &pc, RetType in)
+{
+	pc.Match (TT::PROG, in);
+
+	size_t height = ProgramHead (pc, in);
 	pc.Match (TT::ID, in);
 
 	pc.Match (TT::P_O, in);
@@ -301,7 +451,8 @@ void prog_stmt_program (ParserContext &pc, RetType in)
 	IdentifierList (pc, in);
 	pc.Match (TT::P_C, in);
 	pc.Match (TT::SEMIC, in);
-	return ProgramStatementFactored (pc, in);
+	ProgramStatementFactored (pc, in);
+	pc.Adopt (height);
 }
 
 void ProgramStatement (ParserContext &pc, RetType in)
@@ -312,7 +463,7 @@ void ProgramStatement (ParserContext &pc, RetType in)
 			prog_stmt_program (pc, in);
 			break;
 		default:
-			DefaultErr (pc, { TT::PROG }, { TT::END_FILE });
+			DefaultErr (pc, GrammarTables::NT::prog_stmt);
 	}
 }
 void ProgramStatementFactored (ParserContext &pc, RetType in)
@@ -333,7 +484,7 @@ void ProgramStatementFactored (ParserContext &pc, RetType in)
 			pc.Match (TT::DOT, in);
 			break;
 		default:
-			DefaultErr (pc, { TT::VAR, TT::PROC, TT::BEGIN }, { TT::END_FILE });
+			DefaultErr (pc, GrammarTables::NT::prog_stmt_1);
 	}
 }
 void ProgramStatementFactoredFactored (ParserContext &pc, RetType in)
@@ -350,14 +501,20 @@ void ProgramStatementFactoredFactored (ParserContext &pc, RetType in)
 			pc.Match (TT::DOT, in);
 			break;
 		default:
-			DefaultErr (pc, { TT::PROC, TT::BEGIN }, { TT::END_FILE });
+			DefaultErr (pc, GrammarTables::NT::prog_stmt_2);
 	}
 }
 
-void ident_list_id (ParserContext &pc, RetType in)
+void DeclareProgramParameter (ParserContext &pc, RetType in)
 {
-	bool exists = pc.tree.AddVariable (GetSymbol (pc.Current ()), RT_none, true);
+	NodeID decl = EmitDeclaration (pc, pc.Current (), RT_none, true);
+	bool exists = pc.tree.AddVariable (GetSymbol (pc.Current ()), RT_none, true, decl);
 	if (exists) { pc.LogErrorUniqueIdentifier (in, pc.Current ()); }
+}
+
+void ident_list_id (ParserContext &pc, RetType in)
+{
+	DeclareProgramParameter (pc, in);
 	pc.Match (TT::ID, in);
 
 	return IdentifierListPrime (pc, in);
@@ -371,15 +528,14 @@ void IdentifierList (ParserContext &pc, RetType in)
 			ident_list_id (pc, in);
 			break;
 		default:
-			DefaultErr (pc, { TT::ID }, { TT::P_C });
+			DefaultErr (pc, GrammarTables::NT::id_list);
 	}
 }
 
 void ident_list_prime (ParserContext &pc, RetType in)
 {
 	pc.Match (TT::COMMA, in);
-	bool exists = pc.tree.AddVariable (GetSymbol (pc.Current ()), RT_none, true);
-	if (exists) { pc.LogErrorUniqueIdentifier (in, pc.Current ()); }
+	DeclareProgramParameter (pc, in);
 	pc.Match (TT::ID, in);
 	return IdentifierListPrime (pc, in);
 }
@@ -393,11 +549,23 @@ void IdentifierListPrime (ParserContext &pc, RetType in)
 		case (TT::P_C):
 			break;
 		default:
-			DefaultErr (pc, { TT::COMMA, TT::P_C }, { TT::P_C });
+			DefaultErr (pc, GrammarTables::NT::id_list_1);
 	}
 	// e-prod
 }
 
+void DeclareVariable (ParserContext &pc, TokenInfo const &tid, RetType type, RetType in, bool first)
+{
+	if (!HasSymbol (tid)) return;
+	NodeID decl = EmitDeclaration (pc, tid, type, false);
+	auto exists = pc.tree.AddVariable (GetSymbol (tid), type, false, decl);
+	if (exists && first) { pc.LogErrorIdentifierScope (in, tid); }
+	else if (exists)
+	{
+		pc.LogErrorUniqueIdentifier (in, tid);
+	}
+}
+
 void decls (ParserContext &pc, RetType in)
 {
 	pc.Match (TT::VAR, in);
@@ -406,11 +574,7 @@ void decls (ParserContext &pc, RetType in)
 
 	pc.Match (TT::COLON, in);
 	auto t = Type (pc, in);
-	if (HasSymbol (tid))
-	{
-		auto exists = pc.tree.AddVariable (GetSymbol (tid), t, false);
-		if (exists) { pc.LogErrorIdentifierScope (in, tid); }
-	}
+	DeclareVariable (pc, tid, t, in, true);
 
 	pc.Match (TT::SEMIC, in);
 	return DeclarationsPrime (pc, in);
@@ -424,7 +588,7 @@ void Declarations (ParserContext &pc, RetType in)
 			decls (pc, in);
 			break;
 		default:
-			DefaultErr (pc, { TT::VAR }, { TT::PROC, TT::BEGIN });
+			DefaultErr (pc, GrammarTables::NT::decls);
 	}
 }
 
@@ -435,11 +599,7 @@ void decls_prime (ParserContext &pc, RetType in)
 	pc.Match (TT::ID, in);
 	pc.Match (TT::COLON, in);
 	auto tt = Type (pc, in);
-	if (HasSymbol (tid))
-	{
-		auto exists = pc.tree.AddVariable (GetSymbol (tid), tt, false);
-		if (exists) { pc.LogErrorUniqueIdentifier (in, tid); }
-	}
+	DeclareVariable (pc, tid, tt, in, false);
 	pc.Match (TT::SEMIC, in);
 	return DeclarationsPrime (pc, in);
 }
@@ -455,54 +615,58 @@ void DeclarationsPrime (ParserContext &pc, RetType in)
 		case (TT::BEGIN):
 			break;
 		default:
-			DefaultErr (pc, { TT::PROC, TT::BEGIN, TT::VAR }, { TT::PROC, TT::BEGIN });
+			DefaultErr (pc, GrammarTables::NT::decls_1);
 	}
 	// e-prod
 }
 
-RetType type_array (ParserContext &pc, RetType in)
+bool CheckArrayBound (ParserContext &pc, TokenInfo const &t, RetType in, char const *message)
 {
-	RetType ret = RT_none;
-	pc.Match (TT::ARRAY, in);
-	pc.Match (TT::B_O, in);
-	auto ts = pc.Current ();
-	if (std::get<NumType> (ts.attrib).val.index () != 0)
-	{
-		ret = RT_err;
-		pc.LogErrorSem (in, "Array right bound not an int", ts);
-	}
-	pc.Match (TT::NUM, in);
-	pc.Match (TT::DOT_DOT, in);
+	if (t.IsInt ()) return true;
+	pc.LogErrorSem (in, message, t);
+	return false;
+}
 
-	auto te = pc.Current ();
-	if (std::get<NumType> (te.attrib).val.index () != 0)
-	{
-		ret = RT_err;
-		pc.LogErrorSem (in, "Array left bound not an int", te);
-	}
-	pc.Match (TT::NUM, in);
-	pc.Match (TT::B_C, in);
-	pc.Match (TT::OF, in);
-	auto t = StandardType (pc, in);
-	if (ret != RT_err)
+RetType ArrayType (ParserContext &pc, TokenInfo const &ts, TokenInfo const &te, RetType element, RetType in, bool bounds_ok)
+{
+	if (bounds_ok)
 	{
+		pc.array_low_bound = GetNumValInt (ts);
 		int size = GetNumValInt (te) - GetNumValInt (ts) + 1;
 		if (size <= 0)
 		{
 			pc.LogErrorSem (in, "Array bounds must be positive", te);
 			return RT_err;
 		}
-		else if (t == RT_int)
+		else if (element == RT_int)
 		{
 			return RetType (RT_arr_int, size);
 		}
-		else if (t == RT_real)
+		else if (element == RT_real)
 		{
 			return RetType (RT_arr_real, size);
 		}
 	}
 	return RT_err;
 }
+
+RetType type_array (ParserContext &pc, RetType in)
+{
+	pc.Match (TT::ARRAY, in);
+	pc.Match (TT::B_O, in);
+	auto ts = pc.Current ();
+	bool bounds_ok = CheckArrayBound (pc, ts, in, "Array right bound not an int");
+	pc.Match (TT::NUM, in);
+	pc.Match (TT::DOT_DOT, in);
+
+	auto te = pc.Current ();
+	bounds_ok = CheckArrayBound (pc, te, in, "Array left bound not an int") && bounds_ok;
+	pc.Match (TT::NUM, in);
+	pc.Match (TT::B_C, in);
+	pc.Match (TT::OF, in);
+	auto t = StandardType (pc, in);
+	return ArrayType (pc, ts, te, t, in, bounds_ok);
+}
 RetType Type (ParserContext &pc, RetType in)
 {
 	switch (pc.Current ().type)
@@ -512,7 +676,7 @@ RetType Type (ParserContext &pc, RetType in)
 		case (TT::STD_T):
 			return StandardType (pc, in);
 		default:
-			return DefaultErr (pc, { TT::ARRAY, TT::STD_T }, { TT::P_C, TT::SEMIC });
+			return DefaultErr (pc, GrammarTables::NT::type);
 	}
 }
 
@@ -520,7 +684,12 @@ RetType std_type (ParserContext &pc, RetType in)
 {
 	auto t = pc.Current ();
 	pc.Match (TT::STD_T, in);
-	switch (std::get<StandardTypeEnum> (t.attrib))
+	return StandardTypeOf (pc, t, in);
+}
+
+RetType StandardTypeOf (ParserContext &pc, TokenInfo const &t, RetType in)
+{
+	switch (t.StandardType ())
 	{
 		case (StandardTypeEnum::integer):
 			return RT_int;
@@ -540,7 +709,7 @@ RetType StandardType (ParserContext &pc, RetType in)
 		case (TT::STD_T):
 			return std_type (pc, in);
 		default:
-			return DefaultErr (pc, { TT::STD_T }, { TT::P_C, TT::SEMIC });
+			return DefaultErr (pc, GrammarTables::NT::standard_type);
 	}
 }
 void SubprogramDeclarations (ParserContext &pc, RetType in)
@@ -553,7 +722,7 @@ void SubprogramDeclarations (ParserContext &pc, RetType in)
 			SubprogramDeclarationsPrime (pc, in);
 			break;
 		default:
-			DefaultErr (pc, { TT::PROC }, { TT::BEGIN });
+			DefaultErr (pc, GrammarTables::NT::sp_decls);
 	}
 }
 void SubprogramDeclarationsPrime (ParserContext &pc, RetType in)
@@ -568,7 +737,7 @@ void SubprogramDeclarationsPrime (ParserContext &pc, RetType in)
 		case (TT::BEGIN):
 			break;
 		default:
-			DefaultErr (pc, { TT::PROC, TT::BEGIN }, { TT::BEGIN });
+			DefaultErr (pc, GrammarTables::NT::sp_decls_1);
 	}
 	// e-prod
 }
@@ -577,11 +746,15 @@ void SubprogramDeclaration (ParserContext &pc, RetType in)
 	switch (pc.Current ().type)
 	{
 		case (TT::PROC):
+		{
+			size_t height = pc.OpenNodes ();
 			SubprogramHead (pc, in);
 			SubprogramDeclarationFactored (pc, in);
+			pc.Adopt (height);
 			break;
+		}
 		default:
-			DefaultErr (pc, { TT::PROC }, { TT::SEMIC });
+			DefaultErr (pc, GrammarTables::NT::sp_decl);
 	}
 }
 void SubprogramDeclarationFactored (ParserContext &pc, RetType in)
@@ -600,7 +773,7 @@ void SubprogramDeclarationFactored (ParserContext &pc, RetType in)
 			CompoundStatement (pc, in);
 			break;
 		default:
-			DefaultErr (pc, { TT::VAR, TT::PROC, TT::BEGIN }, { TT::SEMIC });
+			DefaultErr (pc, GrammarTables::NT::sp_decl_1);
 	}
 }
 void SubprogramDeclarationFactoredFactored (ParserContext &pc, RetType in)
@@ -615,15 +788,22 @@ void SubprogramDeclarationFactoredFactored (ParserContext &pc, RetType in)
 			CompoundStatement (pc, in);
 			break;
 		default:
-			DefaultErr (pc, { TT::PROC, TT::BEGIN }, { TT::SEMIC });
+			DefaultErr (pc, GrammarTables::NT::sp_decl_2);
 	}
 }
 
-void sub_prog_head_procedure (ParserContext &pc, RetType in)
+ProcedureID ProcedureHead (ParserContext &pc, RetType in)
 {
-	pc.Match (TT::PROC, in);
 	ProcedureID cur = pc.tree.AddSubProcedure (GetSymbol (pc.Current ()));
 	if (cur == -1) { pc.LogErrorUniqueProcedure (in, pc.Current ()); }
+	EmitProcedure (pc, NodeKind::procedure, cur, pc.Current ());
+	return cur;
+}
+
+void sub_prog_head_procedure (ParserContext &pc, RetType in)
+{
+	pc.Match (TT::PROC, in);
+	ProcedureID cur = ProcedureHead (pc, in);
 	pc.Match (TT::ID, in);
 	if (cur != -1) pc.tree.Push (cur);
 
@@ -638,7 +818,7 @@ void SubprogramHead (ParserContext &pc, RetType in)
 			sub_prog_head_procedure (pc, in);
 			break;
 		default:
-			DefaultErr (pc, { TT::PROC }, { TT::PROC, TT::VAR, TT::BEGIN });
+			DefaultErr (pc, GrammarTables::NT::sp_head);
 	}
 }
 void SubprogramHeadFactored (ParserContext &pc, RetType in)
@@ -653,7 +833,7 @@ void SubprogramHeadFactored (ParserContext &pc, RetType in)
 			pc.Match (TT::SEMIC, in);
 			break;
 		default:
-			DefaultErr (pc, { TT::SEMIC, TT::P_O }, { TT::VAR, TT::BEGIN, TT::PROC });
+			DefaultErr (pc, GrammarTables::NT::sp_head_1);
 	}
 }
 RetType Arguments (ParserContext &pc, RetType in)
@@ -666,9 +846,23 @@ RetType Arguments (ParserContext &pc, RetType in)
 			pc.Match (TT::P_C, in);
 			return in;
 		default:
-			return DefaultErr (pc, { TT::P_O }, { TT::SEMIC });
+			return DefaultErr (pc, GrammarTables::NT::args);
+	}
+}
+void DeclareParameter (ParserContext &pc, TokenInfo const &tid, RetType type, RetType in, bool first)
+{
+	if (type == RT_err && !first)
+	{ pc.LogErrorSem (in, "Parameter type cannot be an error", pc.Current ()); }
+	if (type == RT_none) { pc.LogErrorSem (in, "Parameter type cannot be none", pc.Current ()); }
+
+	if (HasSymbol (tid))
+	{
+		NodeID decl = EmitDeclaration (pc, tid, type, true);
+		bool exists = pc.tree.AddVariable (GetSymbol (tid), type, true, decl);
+		if (exists) { pc.LogErrorUniqueIdentifier (in, first ? pc.Current () : tid); }
 	}
 }
+
 RetType param_list_id (ParserContext &pc, RetType in)
 {
 	auto tid = pc.Current ();
@@ -676,15 +870,7 @@ RetType param_list_id (ParserContext &pc, RetType in)
 
 	pc.Match (TT::COLON, in);
 	auto t = Type (pc, in);
-	// if (t == RT_err) { pc.LogErrorSem (in, "Parameter type cannot be an error"); }
-
-	if (t == RT_none) { pc.LogErrorSem (in, "Parameter type cannot be none", pc.Current ()); }
-
-	if (HasSymbol (tid))
-	{
-		bool exists = pc.tree.AddVariable (GetSymbol (tid), t, true);
-		if (exists) { pc.LogErrorUniqueIdentifier (in, pc.Current ()); }
-	}
+	DeclareParameter (pc, tid, t, in, true);
 	return ParameterListPrime (pc, in);
 }
 
@@ -695,7 +881,7 @@ RetType ParameterList (ParserContext &pc, RetType in)
 		case (TT::ID):
 			return param_list_id (pc, in);
 		default:
-			return DefaultErr (pc, { TT::ID }, { TT::P_C });
+			return DefaultErr (pc, GrammarTables::NT::p_list);
 	}
 }
 RetType param_list_prime_id (ParserContext &pc, RetType in)
@@ -705,14 +891,7 @@ RetType param_list_prime_id (ParserContext &pc, RetType in)
 	pc.Match (TT::ID, in);
 	pc.Match (TT::COLON, in);
 	auto t = Type (pc, in);
-	if (t == RT_err) { pc.LogErrorSem (in, "Parameter type cannot be an error", pc.Current ()); }
-
-	if (t == RT_none) { pc.LogErrorSem (in, "Parameter type cannot be none", pc.Current ()); }
-	if (HasSymbol (tid))
-	{
-		bool exists = pc.tree.AddVariable (GetSymbol (tid), t, true);
-		if (exists) { pc.LogErrorUniqueIdentifier (in, tid); }
-	}
+	DeclareParameter (pc, tid, t, in, false);
 	return ParameterListPrime (pc, in);
 }
 RetType ParameterListPrime (ParserContext &pc, RetType in)
@@ -724,7 +903,7 @@ RetType ParameterListPrime (ParserContext &pc, RetType in)
 		case (TT::P_C):
 			return in;
 		default:
-			return DefaultErr (pc, { TT::SEMIC, TT::P_C }, { TT::P_C });
+			return DefaultErr (pc, GrammarTables::NT::p_list_1);
 	}
 	// e-prod
 }
@@ -733,11 +912,16 @@ void CompoundStatement (ParserContext &pc, RetType in)
 	switch (pc.Current ().type)
 	{
 		case (TT::BEGIN):
+		{
+			size_t height = pc.OpenNodes ();
+			int line = pc.Current ().line_location;
 			pc.Match (TT::BEGIN, in);
 			CompoundStatementFactored (pc, in);
+			pc.Reduce (height, NodeKind::compound, RT_none, -1, 0, line);
 			break;
+		}
 		default:
-			DefaultErr (pc, { TT::BEGIN }, { TT::SEMIC, TT::DOT });
+			DefaultErr (pc, GrammarTables::NT::comp_stmt);
 	}
 }
 void CompoundStatementFactored (ParserContext &pc, RetType in)
@@ -759,7 +943,7 @@ void CompoundStatementFactored (ParserContext &pc, RetType in)
 			break;
 
 		default:
-			DefaultErr (pc, { TT::END, TT::BEGIN, TT::ID, TT::CALL, TT::IF, TT::WHILE }, { TT::SEMIC, TT::DOT });
+			DefaultErr (pc, GrammarTables::NT::comp_stmt_1);
 	}
 }
 void OptionalStatements (ParserContext &pc, RetType in)
@@ -774,7 +958,7 @@ void OptionalStatements (ParserContext &pc, RetType in)
 			StatementList (pc, in);
 			break;
 		default:
-			DefaultErr (pc, { TT::ID, TT::WHILE, TT::BEGIN, TT::IF, TT::CALL }, { TT::END });
+			DefaultErr (pc, GrammarTables::NT::opt_stmt);
 	}
 }
 void StatementList (ParserContext &pc, RetType in)
@@ -790,7 +974,7 @@ void StatementList (ParserContext &pc, RetType in)
 			StatementListPrime (pc, in);
 			break;
 		default:
-			DefaultErr (pc, { TT::ID, TT::WHILE, TT::BEGIN, TT::IF, TT::CALL }, { TT::END });
+			DefaultErr (pc, GrammarTables::NT::stmt_list);
 	}
 }
 
@@ -806,46 +990,70 @@ void StatementListPrime (ParserContext &pc, RetType in)
 			break;
 
 		default:
-			DefaultErr (pc, { TT::END, TT::SEMIC }, { TT::END });
+			DefaultErr (pc, GrammarTables::NT::stmt_list_1);
 	}
 	// e -prod
 }
 
+void CheckAssignment (ParserContext &pc, RetType variable, RetType value, RetType in, TokenInfo const &at)
+{
+	if (variable == RT_err || value == RT_err) return;
+	if (variable == RT_int && value == RT_int || variable == RT_real && value == RT_real) return;
+
+	if (variable != value)
+		pc.LogErrorSem (in, "Cannot assign " + value.to_string () + " to " + variable.to_string (), at);
+}
+
 void stmt_id (ParserContext &pc, RetType in)
 {
+	size_t height = pc.OpenNodes ();
 	auto ret = Variable (pc, in);
+	int line = pc.Current ().line_location;
 	pc.Match (TT::A_OP, in);
 	auto ll = pc.Current ();
 	auto eret = Expression (pc, ret);
-	if (ret == RT_err || eret == RT_err) return;
-	if (ret == RT_int && eret == RT_int || ret == RT_real && eret == RT_real) return;
+	pc.Reduce (height, NodeKind::assign, RT_none, -1, 0, line);
+	CheckAssignment (pc, ret, eret, in, ll);
+}
 
-	if (ret != eret)
-		pc.LogErrorSem (in, "Cannot assign " + eret.to_string () + " to " + ret.to_string (), ll);
+void CheckIfCondition (ParserContext &pc, RetType condition, RetType in)
+{
+	if (condition != RT_err && condition != RT_bool)
+	{
+		pc.LogErrorSem (in, "Conditional must use a boolean type, not " + condition.to_string (), pc.Current ());
+	}
+}
+
+void CheckWhileCondition (ParserContext &pc, RetType condition, RetType in)
+{
+	if (condition != RT_bool)
+	{
+		pc.LogErrorSem (in, "While condition must use a boolean type, not " + condition.to_string (), pc.Current ());
+	}
 }
 
 void stmt_if (ParserContext &pc, RetType in)
 {
+	size_t height = pc.OpenNodes ();
+	int line = pc.Current ().line_location;
 	pc.Match (TT::IF, in);
 	auto eret = Expression (pc, RT_none);
-	if (eret != RT_err && eret != RT_bool)
-	{
-		pc.LogErrorSem (in, "Conditional must use a boolean type, not " + eret.to_string (), pc.Current ());
-	}
+	CheckIfCondition (pc, eret, in);
 	pc.Match (TT::THEN, in);
 	Statement (pc, RT_none);
 	StatementFactoredElse (pc, RT_none);
+	pc.Reduce (height, NodeKind::if_then, RT_none, -1, 0, line);
 }
 void stmt_while (ParserContext &pc, RetType in)
 {
+	size_t height = pc.OpenNodes ();
+	int line = pc.Current ().line_location;
 	pc.Match (TT::WHILE, in);
 	auto ret = Expression (pc, RT_none);
-	if (ret != RT_bool)
-	{
-		pc.LogErrorSem (in, "While condition must use a boolean type, not " + ret.to_string (), pc.Current ());
-	}
+	CheckWhileCondition (pc, ret, in);
 	pc.Match (TT::DO, in);
 	Statement (pc, RT_none);
+	pc.Reduce (height, NodeKind::while_do, RT_none, -1, 0, line);
 }
 
 void Statement (ParserContext &pc, RetType in)
@@ -859,10 +1067,15 @@ void Statement (ParserContext &pc, RetType in)
 			stmt_while (pc, in);
 			break;
 		case (TT::BEGIN):
+		{
+			size_t height = pc.OpenNodes ();
+			int line = pc.Current ().line_location;
 			pc.Match (TT::BEGIN, in);
 			// pc.tree.Push (-2);
 			StatementFactoredBegin (pc, RT_none);
+			pc.Reduce (height, NodeKind::compound, RT_none, -1, 0, line);
 			break;
+		}
 		case (TT::IF):
 			stmt_if (pc, in);
 			break;
@@ -870,8 +1083,8 @@ void Statement (ParserContext &pc, RetType in)
 			ProcedureStatement (pc, in);
 			break;
 		default:
-			DefaultErr (
-			pc, { TT::ID, TT::WHILE, TT::BEGIN, TT::IF, TT::CALL }, { TT::SEMIC, TT::ELSE, TT::END });
+			pc.EmitError ();
+			DefaultErr (pc, GrammarTables::NT::stmt);
 	}
 }
 
@@ -893,9 +1106,7 @@ void StatementFactoredBegin (ParserContext &pc, RetType in)
 			// pc.tree.Pop ();
 			break;
 		default:
-			DefaultErr (pc,
-			{ TT::END, TT::BEGIN, TT::ID, TT::CALL, TT::IF, TT::WHILE },
-			{ TT::SEMIC, TT::ELSE, TT::END });
+			DefaultErr (pc, GrammarTables::NT::stmt_1);
 	}
 }
 void StatementFactoredElse (ParserContext &pc, RetType in)
@@ -910,20 +1121,27 @@ void StatementFactoredElse (ParserContext &pc, RetType in)
 		case (TT::END):
 			break;
 		default:
-			DefaultErr (pc, { TT::END, TT::ELSE, TT::SEMIC }, { TT::SEMIC, TT::ELSE, TT::END });
+			DefaultErr (pc, GrammarTables::NT::stmt_2);
 	}
 	// e-prod
 }
 
-RetType var_id (ParserContext &pc, RetType in)
+RetType EmitVariable (ParserContext &pc, RetType in)
 {
 	auto tid = pc.Current ();
 	auto exists = pc.tree.CheckVariable (GetSymbol (tid));
 	if (!exists.has_value ()) { pc.LogErrorIdentifierScope (in, tid); }
 
-	pc.Match (TT::ID, in);
 	RetType fp = RT_err;
 	if (exists.has_value ()) fp = exists.value ();
+	pc.Emit (NodeKind::variable, fp, GetSymbol (tid), pc.tree.Declaration (GetSymbol (tid)), tid.line_location);
+	return fp;
+}
+
+RetType var_id (ParserContext &pc, RetType in)
+{
+	RetType fp = EmitVariable (pc, in);
+	pc.Match (TT::ID, in);
 	return VariableFactored (pc, fp);
 }
 RetType Variable (ParserContext &pc, RetType in)
@@ -933,7 +1151,8 @@ RetType Variable (ParserContext &pc, RetType in)
 		case (TT::ID):
 			return var_id (pc, in);
 		default:
-			return DefaultErr (pc, { TT::ID }, { TT::A_OP });
+			pc.EmitError ();
+			return DefaultErr (pc, GrammarTables::NT::variable);
 	}
 }
 RetType var_factored_bracket_open (ParserContext &pc, RetType in)
@@ -941,6 +1160,11 @@ RetType var_factored_bracket_open (ParserContext &pc, RetType in)
 	pc.Match (TT::B_O, in);
 	auto rt = Expression (pc, RT_none);
 	pc.Match (TT::B_C, in);
+	return VariableIndexType (pc, in, rt);
+}
+
+RetType VariableIndexType (ParserContext &pc, RetType in, RetType rt)
+{
 	if (in == RT_err || rt == RT_err) { return RT_err; }
 	if (IsArrInt (in) && rt == RT_int) { return RT_int; }
 	else if (IsArrReal (in) && rt == RT_int)
@@ -963,30 +1187,42 @@ RetType VariableFactored (ParserContext &pc, RetType in)
 	switch (pc.Current ().type)
 	{
 		case (TT::B_O):
-			return var_factored_bracket_open (pc, in);
+		{
+			size_t height = pc.OpenNodes () - 1; // the variable
+			int line = pc.Current ().line_location;
+			auto ret = var_factored_bracket_open (pc, in);
+			pc.Reduce (height, NodeKind::index, ret, -1, 0, line);
+			return ret;
+		}
 		case (TT::A_OP):
 			return in;
 		default:
-			return DefaultErr (pc, { TT::B_O, TT::A_OP }, { TT::A_OP });
+			return DefaultErr (pc, GrammarTables::NT::variable_1);
 	}
 	// e-prod
 }
+RetType CheckCallee (ParserContext &pc, RetType in)
+{
+	if (pc.tree.CheckProcedure (GetSymbol (pc.Current ()))) return RT_none;
+	pc.LogErrorSem (in,
+	"Procedure \"" + pc.SymbolName (GetSymbol (pc.Current ())) + "\" not in current scope",
+	pc.Current ());
+	return RT_err;
+}
+
 RetType proc_stmt_call (ParserContext &pc, RetType in)
 {
-	RetType ret = RT_none;
+	size_t height = pc.OpenNodes ();
+	int line = pc.Current ().line_location;
 	pc.Match (TT::CALL, in);
-	bool exists = pc.tree.CheckProcedure (GetSymbol (pc.Current ()));
-	if (!exists)
-	{
-		ret = RT_err;
-		pc.LogErrorSem (in,
-		"Procedure \"" + pc.SymbolName (GetSymbol (pc.Current ())) + "\" not in current scope",
-		pc.Current ());
-	}
+	RetType ret = CheckCallee (pc, in);
 	auto tid = GetSymbol (pc.Current ());
+	NodeID callee = CalleeNode (pc, tid);
 	pc.Match (TT::ID, in);
 
-	return ProcedureStatmentFactored (pc, tid, ret);
+	ret = ProcedureStatmentFactored (pc, tid, ret);
+	pc.Reduce (height, NodeKind::call, ret, tid, callee, line);
+	return ret;
 }
 RetType ProcedureStatement (ParserContext &pc, RetType in)
 {
@@ -996,10 +1232,11 @@ RetType ProcedureStatement (ParserContext &pc, RetType in)
 			return proc_stmt_call (pc, in);
 
 		default:
-			return DefaultErr (pc, { TT::CALL }, { TT::SEMIC, TT::ELSE, TT::END });
+			pc.EmitError ();
+			return DefaultErr (pc, GrammarTables::NT::proc_stmt);
 	}
 }
-RetType check_param_list_with_expr_list (ParserContext &pc, SymbolID id, RetType in, std::vector<RetType> expr_list)
+RetType check_param_list_with_expr_list (ParserContext &pc, SymbolID id, RetType in, std::vector<RetType> const &expr_list)
 {
 	auto param_list = pc.tree.SubProcedureType (id);
 	RetType ret = RT_none;
@@ -1068,7 +1305,7 @@ RetType ProcedureStatmentFactored (ParserContext &pc, SymbolID id, RetType in)
 		case (TT::END):
 			return check_param_list_with_expr_list (pc, id, in, {});
 		default:
-			return DefaultErr (pc, { TT::P_O, TT::SEMIC, TT::ELSE }, { TT::ELSE, TT::SEMIC, TT::END });
+			return DefaultErr (pc, GrammarTables::NT::proc_stmt_1);
 	}
 	// e-prod
 }
@@ -1091,7 +1328,7 @@ RetType ExpressionList (ParserContext &pc, std::vector<RetType> &expr_list, RetT
 			return expr_list_elem (pc, expr_list, in);
 
 		default:
-			return DefaultErr (pc, { TT::ID, TT::P_O, TT::NUM, TT::NOT, TT::SIGN }, { TT::P_C });
+			return DefaultErr (pc, GrammarTables::NT::expr_list);
 	}
 }
 RetType expr_list_prime_elem (ParserContext &pc, std::vector<RetType> &expr_list, RetType in)
@@ -1110,7 +1347,7 @@ RetType ExpressionListPrime (ParserContext &pc, std::vector<RetType> &expr_list,
 		case (TT::P_C):
 			return in;
 		default:
-			return DefaultErr (pc, { TT::P_C, TT::COMMA }, { TT::P_C });
+			return DefaultErr (pc, GrammarTables::NT::expr_list_1);
 	}
 	// e -prod
 }
@@ -1127,23 +1364,32 @@ RetType Expression (ParserContext &pc, RetType in)
 			in = SimpleExpression (pc, in);
 			return ExpressionFactored (pc, in);
 		default:
-			return DefaultErr (pc,
-			{ TT::ID, TT::P_O, TT::NUM, TT::NOT, TT::SIGN },
-			{ TT::P_C, TT::SEMIC, TT::B_C, TT::COMMA, TT::THEN, TT::ELSE, TT::DO, TT::END });
+			pc.EmitError ();
+			return DefaultErr (pc, GrammarTables::NT::expr);
+	}
+}
+RetType RelopType (ParserContext &pc, RetType in, RetType right, TokenInfo const &at)
+{
+	if (in == RT_err || right == RT_err) { return RT_err; }
+	else if (!((in == RT_int && right == RT_int) || (in == RT_real && right == RT_real)))
+	{
+		pc.LogErrorSem (in, "Cannot compare types " + in.to_string () + " and " + right.to_string (), at);
+		return RT_err;
 	}
+	return RT_bool;
 }
+
 RetType expr_factored_relop (ParserContext &pc, RetType in)
 {
+	size_t height = pc.OpenNodes () - 1; // the left operand
+	auto op = NodeOp (pc.Current ().RelOp ());
+	int line = pc.Current ().line_location;
 	pc.Match (TT::RELOP, in);
 	auto ll = pc.Current ();
 	auto ser = SimpleExpression (pc, in);
-	if (in == RT_err || ser == RT_err) return RT_err;
-	if ((in == RT_int && ser == RT_int) || (in == RT_real && ser == RT_real)) { return RT_bool; }
-	else
-	{
-		pc.LogErrorSem (in, "Cannot compare types " + in.to_string () + " and " + ser.to_string (), ll);
-		return RT_err;
-	}
+	RetType ret = RelopType (pc, in, ser, ll);
+	pc.Reduce (height, NodeKind::binary, ret, -1, 0, line, op);
+	return ret;
 }
 
 RetType ExpressionFactored (ParserContext &pc, RetType in)
@@ -1162,13 +1408,21 @@ RetType ExpressionFactored (ParserContext &pc, RetType in)
 		case (TT::END):
 			return in;
 		default:
-			return DefaultErr (pc,
-			{ TT::RELOP, TT::P_C, TT::SEMIC, TT::B_C, TT::COMMA, TT::THEN, TT::ELSE, TT::DO, TT::END },
-			{ TT::P_C, TT::SEMIC, TT::B_C, TT::COMMA, TT::THEN, TT::ELSE, TT::DO, TT::END });
+			return DefaultErr (pc, GrammarTables::NT::expr_1);
 	}
 	// e-prod
 }
 
+RetType SignedType (ParserContext &pc, RetType in)
+{
+	if (in != RT_int && in != RT_real)
+	{
+		pc.LogErrorSem (in, "Cannot add a sign to a non int or real term", pc.Current ());
+		return RT_err;
+	}
+	return in;
+}
+
 RetType SimpleExpression (ParserContext &pc, RetType in)
 {
 	switch (pc.Current ().type)
@@ -1180,24 +1434,49 @@ RetType SimpleExpression (ParserContext &pc, RetType in)
 			in = Term (pc, in);
 			return SimpleExpressionPrime (pc, in);
 		case (TT::SIGN):
+		{
+			size_t height = pc.OpenNodes ();
+			int line = pc.Current ().line_location;
+			auto op = pc.Current ().SignOp () == SignOpEnum::minus ? UnaryOp::minus : UnaryOp::plus;
 			pc.Match (TT::SIGN, in);
-			in = Term (pc, in);
-			if (in != RT_int && in != RT_real)
-			{
-				pc.LogErrorSem (in, "Cannot add a sign to a non int or real term", pc.Current ());
-				in = RT_err;
-			}
+			in = SignedType (pc, Term (pc, in));
+			pc.Reduce (height, NodeKind::unary, in, -1, 0, line, static_cast<uint8_t> (op));
 			return SimpleExpressionPrime (pc, in);
+		}
 		default:
-			return DefaultErr (pc,
-			{ TT::ID, TT::P_O, TT::NUM, TT::NOT, TT::SIGN },
-			{ TT::P_C, TT::SEMIC, TT::B_C, TT::COMMA, TT::RELOP, TT::THEN, TT::ELSE, TT::DO, TT::END });
+			pc.EmitError ();
+			return DefaultErr (pc, GrammarTables::NT::simp_expr);
+	}
+}
+
+RetType AddType (ParserContext &pc, RetType in, RetType right, bool isOr)
+{
+	if (!isOr)
+	{ // + or -
+		if (in == RT_int && right == RT_int || in == RT_real && right == RT_real) { return in; }
+		else if (in == RT_err || right == RT_err)
+		{
+			return RT_err;
+		}
+		pc.LogErrorSem (in, "Cannot add types " + in.to_string () + " and " + right.to_string (), pc.Current ());
+		return RT_err;
+	}
+	// or
+	if (in == RT_bool && right == RT_bool) { return in; }
+	else if (in == RT_err || right == RT_err)
+	{
+		return RT_err;
 	}
+	pc.LogErrorSem (in, "Cannot or types " + in.to_string () + " and " + right.to_string (), pc.Current ());
+	return RT_err;
 }
 
 RetType simp_expr_prime_add (ParserContext &pc, RetType in)
 {
+	size_t height = pc.OpenNodes () - 1; // the left operand
+	int line = pc.Current ().line_location;
 	bool isOr = pc.Current ().type == TT::ADDOP ? true : false;
+	auto op = isOr ? static_cast<uint8_t> (BinaryOp::t_or) : NodeOp (pc.Current ().SignOp ());
 	if (isOr) { pc.Match (TT::ADDOP, in); }
 	else
 	{
@@ -1205,35 +1484,8 @@ RetType simp_expr_prime_add (ParserContext &pc, RetType in)
 	}
 
 	auto tr = Term (pc, in);
-	RetType sep = RT_none;
-
-	if (!isOr)
-	{ // + or -
-		if (in == RT_int && tr == RT_int || in == RT_real && tr == RT_real) { sep = in; }
-		else if (in == RT_err || tr == RT_err)
-		{
-			sep = RT_err;
-		}
-		else
-		{
-			pc.LogErrorSem (
-			in, "Cannot add types " + in.to_string () + " and " + tr.to_string (), pc.Current ());
-			sep = RT_err;
-		}
-	}
-	else
-	{ // or
-		if (in == RT_bool && tr == RT_bool) { sep = in; }
-		else if (in == RT_err || tr == RT_err)
-		{
-			sep = RT_err;
-		}
-		else
-		{
-			pc.LogErrorSem (in, "Cannot or types " + in.to_string () + " and " + tr.to_string (), pc.Current ());
-			sep = RT_err;
-		}
-	}
+	RetType sep = AddType (pc, in, tr, isOr);
+	pc.Reduce (height, NodeKind::binary, sep, -1, 0, line, op);
 	return SimpleExpressionPrime (pc, sep);
 }
 RetType SimpleExpressionPrime (ParserContext &pc, RetType in)
@@ -1254,9 +1506,7 @@ RetType SimpleExpressionPrime (ParserContext &pc, RetType in)
 		case (TT::END):
 			return in;
 		default:
-			return DefaultErr (pc,
-			{ TT::P_C, TT::SEMIC, TT::B_C, TT::COMMA, TT::SIGN, TT::ADDOP, TT::RELOP, TT::THEN, TT::ELSE, TT::DO, TT::END },
-			{ TT::P_C, TT::SEMIC, TT::B_C, TT::COMMA, TT::RELOP, TT::THEN, TT::ELSE, TT::DO, TT::END });
+			return DefaultErr (pc, GrammarTables::NT::simp_expr_1);
 	}
 	// e -prod
 }
@@ -1271,19 +1521,27 @@ RetType Term (ParserContext &pc, RetType in)
 			in = Factor (pc, in);
 			return TermPrime (pc, in);
 		default:
-			return DefaultErr (pc,
-			{ TT::ID, TT::P_O, TT::NUM, TT::NOT },
-			{ TT::P_C, TT::SEMIC, TT::B_C, TT::COMMA, TT::RELOP, TT::ADDOP, TT::SIGN, TT::THEN, TT::ELSE, TT::DO, TT::END });
+			pc.EmitError ();
+			return DefaultErr (pc, GrammarTables::NT::term);
 	}
 }
 RetType term_prime_mulop (ParserContext &pc, RetType in)
 {
-	auto mulOp = std::get<MulOpEnum> (pc.Current ().attrib);
+	size_t height = pc.OpenNodes () - 1; // the left operand
+	int line = pc.Current ().line_location;
+	auto mulOp = pc.Current ().MulOp ();
+	pc.Match (TT::MULOP, in);
+	auto fr = Factor (pc, in);
+	RetType itp = MulType (pc, in, fr, mulOp);
+	pc.Reduce (height, NodeKind::binary, itp, -1, 0, line, NodeOp (mulOp));
+	return TermPrime (pc, itp);
+}
+
+RetType MulType (ParserContext &pc, RetType in, RetType fr, MulOpEnum mulOp)
+{
 	bool isMul = mulOp == MulOpEnum::mul || mulOp == MulOpEnum::div;
 	bool isMod = mulOp == MulOpEnum::mod;
 	bool isAnd = mulOp == MulOpEnum::t_and;
-	pc.Match (TT::MULOP, in);
-	auto fr = Factor (pc, in);
 	RetType itp = RT_none;
 	if (isMul)
 	{
@@ -1326,7 +1584,7 @@ RetType term_prime_mulop (ParserContext &pc, RetType in)
 			itp = RT_err;
 		}
 	}
-	return TermPrime (pc, itp);
+	return itp;
 }
 RetType TermPrime (ParserContext &pc, RetType in)
 {
@@ -1347,33 +1605,40 @@ RetType TermPrime (ParserContext &pc, RetType in)
 		case (TT::END):
 			return in;
 		default:
-			return DefaultErr (pc,
-			{ TT::P_C, TT::SEMIC, TT::B_C, TT::COMMA, TT::MULOP, TT::SIGN, TT::ADDOP, TT::RELOP, TT::THEN, TT::ELSE, TT::DO, TT::END },
-			{ TT::P_C, TT::SEMIC, TT::B_C, TT::COMMA, TT::SIGN, TT::ADDOP, TT::RELOP, TT::THEN, TT::ELSE, TT::END, TT::DO });
+			return DefaultErr (pc, GrammarTables::NT::term_1);
 	}
 	// e -prod
 }
 RetType factor_id (ParserContext &pc, RetType in)
 {
-	auto tid = pc.Current ();
-	auto exists = pc.tree.CheckVariable (GetSymbol (tid));
-	if (!exists.has_value ()) { pc.LogErrorIdentifierScope (in, tid); }
-
+	RetType fp = EmitVariable (pc, in);
 	pc.Match (TT::ID, in);
-	RetType fp = RT_err;
-	if (exists.has_value ()) fp = exists.value ();
 	return FactorPrime (pc, fp);
 }
 RetType factor_num (ParserContext &pc, RetType in)
 {
 	auto tid = pc.Current ();
 	pc.Match (TT::NUM, in);
-	if (std::get<NumType> (tid.attrib).val.index () == 0)
+	return EmitNumber (pc, tid);
+}
+
+RetType EmitNumber (ParserContext &pc, TokenInfo const &tid)
+{
+	if (tid.IsInt ())
+	{
+		pc.Emit (NodeKind::int_literal, RT_int, -1, GetNumValInt (tid), tid.line_location);
 		return RT_int;
-	else if (std::get<NumType> (tid.attrib).val.index () == 1)
+	}
+	else if (tid.IsReal ())
+	{
+		pc.Emit (NodeKind::real_literal, RT_real, -1, Ast::RealBits (GetNumValReal (tid)), tid.line_location);
 		return RT_real;
+	}
 	else
+	{
+		pc.Emit (NodeKind::error, RT_err, -1, 0, tid.line_location);
 		return RT_err;
+	}
 }
 RetType factor_paren_open (ParserContext &pc, RetType in)
 {
@@ -1382,17 +1647,26 @@ RetType factor_paren_open (ParserContext &pc, RetType in)
 	pc.Match (TT::P_C, in);
 	return ret;
 }
-RetType factor_not (ParserContext &pc, RetType in)
+RetType NotType (ParserContext &pc, RetType in, RetType operand)
 {
-	pc.Match (TT::NOT, in);
-	auto ret = Factor (pc, in);
-	if (ret == RT_bool) { return RT_bool; }
-	else if (ret != RT_err)
+	if (operand == RT_bool) { return RT_bool; }
+	else if (operand != RT_err)
 	{
-		pc.LogErrorSem (in, "Can only negate booleans, not " + ret.to_string () + "s", pc.Current ());
+		pc.LogErrorSem (in, "Can only negate booleans, not " + operand.to_string () + "s", pc.Current ());
 	}
 	return RT_err;
 }
+
+RetType factor_not (ParserContext &pc, RetType in)
+{
+	size_t height = pc.OpenNodes ();
+	int line = pc.Current ().line_location;
+	pc.Match (TT::NOT, in);
+	auto ret = Factor (pc, in);
+	RetType out = NotType (pc, in, ret);
+	pc.Reduce (height, NodeKind::unary, out, -1, 0, line, static_cast<uint8_t> (UnaryOp::t_not));
+	return out;
+}
 RetType Factor (ParserContext &pc, RetType in)
 {
 	switch (pc.Current ().type)
@@ -1406,9 +1680,8 @@ RetType Factor (ParserContext &pc, RetType in)
 		case (TT::NOT):
 			return factor_not (pc, in);
 		default:
-			return DefaultErr (pc,
-			{ TT::ID, TT::P_O, TT::NUM, TT::NOT },
-			{ TT::P_C, TT::SEMIC, TT::B_C, TT::COMMA, TT::RELOP, TT::SIGN, TT::ADDOP, TT::MULOP, TT::THEN, TT::ELSE, TT::DO, TT::END });
+			pc.EmitError ();
+			return DefaultErr (pc, GrammarTables::NT::factor);
 	}
 }
 
@@ -1417,6 +1690,11 @@ RetType factor_prime_braket_open (ParserContext &pc, RetType in)
 	pc.Match (TT::B_O, in);
 	auto ret = Expression (pc, in);
 	pc.Match (TT::B_C, in);
+	return FactorIndexType (pc, in, ret);
+}
+
+RetType FactorIndexType (ParserContext &pc, RetType in, RetType ret)
+{
 	if (IsArrInt (in) && ret == RT_int) return RT_int;
 	if (IsArrReal (in) && ret == RT_int) return RT_real;
 	if (in == RT_err || ret == RT_err) return RT_err;
@@ -1434,7 +1712,13 @@ RetType FactorPrime (ParserContext &pc, RetType in)
 	switch (pc.Current ().type)
 	{
 		case (TT::B_O):
-			return factor_prime_braket_open (pc, in);
+		{
+			size_t height = pc.OpenNodes () - 1; // the variable
+			int line = pc.Current ().line_location;
+			auto ret = factor_prime_braket_open (pc, in);
+			pc.Reduce (height, NodeKind::index, ret, -1, 0, line);
+			return ret;
+		}
 		case (TT::P_C):
 		case (TT::SEMIC):
 		case (TT::B_C):
@@ -1449,9 +1733,7 @@ RetType FactorPrime (ParserContext &pc, RetType in)
 		case (TT::END):
 			return in;
 		default:
-			return DefaultErr (pc,
-			{ TT::B_O, TT::P_C, TT::SEMIC, TT::B_C, TT::COMMA, TT::RELOP, TT::SIGN, TT::ADDOP, TT::MULOP, TT::THEN, TT::ELSE, TT::DO, TT::END },
-			{ TT::P_C, TT::SEMIC, TT::B_C, TT::COMMA, TT::RELOP, TT::SIGN, TT::ADDOP, TT::MULOP, TT::THEN, TT::ELSE, TT::DO, TT::END });
+			return DefaultErr (pc, GrammarTables::NT::factor_1);
 	}
 }
 
@@ -1463,7 +1745,7 @@ RetType Sign (ParserContext &pc, RetType in)
 			pc.Match (TT::SIGN, in);
 			return in;
 		default:
-			return DefaultErr (pc, { TT::SIGN }, { TT::ID, TT::P_O, TT::NUM, TT::NOT });
+			return DefaultErr (pc, GrammarTables::NT::sign);
 	}
 }
 
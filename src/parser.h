@@ -5,84 +5,22 @@
 #include <variant>
 #include <vector>
 
+#include "ast.h"
 #include "common.h"
 #include "lexer.h"
 
-struct RetType
-{
-	RetType (const uint32_t cat, uint32_t size) { data = (size << 8) | (cat); }
-	RetType (const uint32_t t) { data = t; }
-
-	uint32_t data;
-	operator uint32_t () const { return data; }
-	std::string to_string () const
-	{
-		if (data == 0) return "error";
-		if (data == 1) return "none";
-		if (data == 2) return "bool";
-		if (data == 3) return "int";
-		if (data == 4) return "real";
-		if ((data & 255) == 5)
-		{
-			int size = data >> 8;
-			return "array of ints with size of " + std::to_string (size);
-		}
-		if ((data & 255) == 6)
-		{
-			int size = data >> 8;
-			return "array of reals with size of " + std::to_string (size);
-		}
-		return "NOT A TYPE!";
-	}
-	uint32_t size () const
-	{
-		if (data == 3) return 4;
-		if (data == 4) return 8;
-		if ((data & 255) == 5) { return 4 * (data >> 8); }
-		if ((data & 255) == 6) { return 8 * (data >> 8); }
-		return 0;
-	}
-};
-
-// using RetType = std::variant<Type_bool, Type_int, Type_real, Type_arr_int, Type_arr_real, Type_none, Type_err>;
-
-using ProcedureID = int;
-using SymbolID = int;
+using Variable = std::pair<SymbolID, RetType>;
+using SubProcedure = std::pair<SymbolID, ProcedureID>;
 
 struct Procedure
 {
 	SymbolID name; // symbol table id;
-	std::vector<std::pair<SymbolID, RetType>> params;
-	std::vector<std::pair<SymbolID, RetType>> locals;
-	std::vector<std::pair<SymbolID, ProcedureID>> sub_procs;
 	ProcedureID parent;
+	PoolSpan params;
+	PoolSpan locals;
+	PoolSpan sub_procs; // only up to date after ParseTree::SubProcedures
 
 	Procedure (SymbolID name, ProcedureID parent = -1) : name (name), parent (parent) {}
-
-	void AddParam (SymbolID name, RetType type)
-	{
-		params.push_back (std::pair<SymbolID, RetType> (name, type));
-	}
-
-	void AddLocal (SymbolID name, RetType type)
-	{
-		locals.push_back (std::pair<SymbolID, RetType> (name, type));
-	}
-
-	void AddSubProc (SymbolID name, ProcedureID id)
-	{
-		sub_procs.push_back (std::pair<SymbolID, ProcedureID> (name, id));
-	}
-
-	std::vector<RetType> Signature ()
-	{
-		std::vector<RetType> out;
-		for (auto [id, type] : params)
-		{
-			out.push_back (type);
-		}
-		return out;
-	}
 };
 
 class ParseTree
@@ -92,17 +30,67 @@ class ParseTree
 	ProcedureID AddSubProcedure (SymbolID s);
 	std::vector<RetType> SubProcedureType (SymbolID s);
 	bool CheckProcedure (SymbolID s);
-	bool AddVariable (SymbolID s, RetType type, bool isParam);
+	bool AddVariable (SymbolID s, RetType type, bool isParam, NodeID decl = no_node);
 	std::optional<RetType> CheckVariable (SymbolID s);
+	NodeID Declaration (SymbolID s);       // declaration node of the variable s names, or no_node
+	ProcedureID FindProcedure (SymbolID s); // the procedure a call to s goes to, or -1
 
 	void Push (ProcedureID id);
 	void Pop ();
 
-	std::unordered_map<ProcedureID, Procedure> procedures;
+	bool HasProcedure (ProcedureID id) const { return id >= 0 && id < procedures.size (); }
+	Procedure const &GetProcedure (ProcedureID id) const { return procedures.at (id); }
+	size_t ProcedureCount () const { return procedures.size (); }
+	PoolView<Variable> Params (ProcedureID id) const;
+	PoolView<Variable> Locals (ProcedureID id) const;
+	PoolView<SubProcedure> SubProcedures (ProcedureID id);
+	std::vector<RetType> Signature (ProcedureID id) const;
 
 	private:
+	// Procedures are indexed by ProcedureID, which are handed out densely. Their params and locals
+	// go in variable_pool and sub procedures in sub_procedure_pool, each procedure's as one run.
+	std::vector<Procedure> procedures;
+	std::vector<Variable> variable_pool;
+	std::vector<SubProcedure> sub_procedure_pool;
+	bool sub_procedures_linked = true;
+
+	static void Append (std::vector<Variable> &pool, PoolSpan &span, Variable variable);
+	void LinkSubProcedures ();
+
+	// Names visible from eye are kept on binding stacks, innermost last. Each SymbolID has a chain
+	// of the bindings it shadows starting at its head, so a lookup only reads the head. Bindings
+	// are only made in eye, which makes the ones to undo on Pop the top of the stack.
+	struct VariableBinding
+	{
+		SymbolID name;
+		ProcedureID scope;
+		RetType type;
+		NodeID decl;
+		int shadowed; // index of the binding this one hides, or -1
+	};
+	struct ProcedureBinding
+	{
+		SymbolID name;
+		ProcedureID scope;
+		ProcedureID proc;
+		bool is_sub_proc; // false for the procedure's own name, bound in its own scope
+		int shadowed;     // as above, or not_linked when an earlier binding in scope takes precedence
+	};
+	static constexpr int not_linked = -2;
+
+	void BindProcedure (SymbolID name, ProcedureID proc, bool is_sub_proc);
+	static int &Slot (std::vector<int> &by_symbol, SymbolID s, int fill);
+
+	std::vector<VariableBinding> variables;
+	std::vector<ProcedureBinding> procedure_names;
+	// indexed by SymbolID + 1, as tokens without a symbol give -1
+	std::vector<int> variable_head;
+	std::vector<int> procedure_head;
+	std::vector<int> own_name_count;
+	std::vector<int> sub_proc_count;
+	std::vector<int> sub_proc_in_scope; // by ProcedureID
+
 	ProcedureID eye = 0;
-	ProcedureID procIDCounter = 0;
 };
 
 
@@ -114,9 +102,9 @@ class ParserContext
 	TokenInfo Current () const;
 
 	void Match (TT tt, RetType &rt);
-	void Synch (std::vector<TT> const &set);
+	void Synch (TTSet set); // skips to a token of set or the end of the file
 
-	void LogErrorExpectedGot (std::vector<TT> const &types);
+	void LogErrorExpectedGot (TTSet types);
 
 	void LogErrorSem (RetType in, std::string msg, TokenInfo const& tok);
 
@@ -128,15 +116,38 @@ class ParserContext
 
 	std::string SymbolName (SymbolID);
 
+	// Nodes are pushed as they are parsed until the production they belong to is done and gives
+	// them to a parent, so the open nodes from some height on are the children parsed so far.
+	size_t OpenNodes () const { return open_nodes.size (); }
+	NodeID Emit (NodeKind kind, RetType type, SymbolID symbol, int32_t value, int line, uint8_t op = 0);
+	// Pops the open nodes from height on as the children of a new node, pushed in their place
+	NodeID Reduce (size_t height, NodeKind kind, RetType type, SymbolID symbol, int32_t value, int line, uint8_t op = 0);
+	// The open node at height takes the ones after it as its children
+	void Adopt (size_t height);
+	NodeID EmitError ();
+
 	ParseTree tree;
+	Ast &ast; // the CompilationContext's
+	std::vector<NodeID> procedure_nodes; // by ProcedureID
+	int array_low_bound = 0;             // of the array type Type parsed last
 
 	private:
 	CompilationContext &context;
+	std::vector<NodeID> open_nodes;
 	TokenInfo Advance ();
 	Logger &logger;
 	TokenStream &ts;
 };
 
+int GetSymbol (TokenInfo t);
+// BinaryOp of an operator token's attribute, for the nodes of binary expressions
+uint8_t NodeOp (SignOpEnum op);
+uint8_t NodeOp (MulOpEnum op);
+uint8_t NodeOp (RelOpEnum op);
+// Logs that one of expected was expected and skips ahead to one of synch
+RetType DefaultErr (ParserContext &pc, TTSet expected, TTSet synch);
+NodeID CalleeNode (ParserContext &pc, SymbolID s); // the procedure node a call to s goes to, or no_node
+
 namespace Parser
 {
 void Parse (ParserContext &pc);
@@ -183,4 +194,34 @@ RetType TermPrime (ParserContext &pc, RetType in);
 RetType Factor (ParserContext &pc, RetType in);
 RetType FactorPrime (ParserContext &pc, RetType in);
 RetType Sign (ParserContext &pc, RetType in);
+
+// Semantic actions, shared with the table driven parser in table_parser.cpp, which runs each at
+// the point of its production where the function above calls it. in is the calling function's.
+
+// On the program's id, opens its scope and node, returning the height its children start at
+size_t ProgramHead (ParserContext &pc, RetType in);
+void DeclareProgramParameter (ParserContext &pc, RetType in); // on the id
+// first is for the first declaration of a list, which reports a duplicate as out of scope
+void DeclareVariable (ParserContext &pc, TokenInfo const &tid, RetType type, RetType in, bool first);
+bool CheckArrayBound (ParserContext &pc, TokenInfo const &t, RetType in, char const *message);
+RetType ArrayType (ParserContext &pc, TokenInfo const &ts, TokenInfo const &te, RetType element, RetType in, bool bounds_ok);
+RetType StandardTypeOf (ParserContext &pc, TokenInfo const &t, RetType in); // after matching t
+ProcedureID ProcedureHead (ParserContext &pc, RetType in); // on the procedure's id
+// first is for the first parameter of a list, which skips the check for an error type and reports a
+// duplicate at the current token rather than the name
+void DeclareParameter (ParserContext &pc, TokenInfo const &tid, RetType type, RetType in, bool first);
+void CheckAssignment (ParserContext &pc, RetType variable, RetType value, RetType in, TokenInfo const &at);
+void CheckIfCondition (ParserContext &pc, RetType condition, RetType in);
+void CheckWhileCondition (ParserContext &pc, RetType condition, RetType in);
+RetType EmitVariable (ParserContext &pc, RetType in); // on the id
+RetType VariableIndexType (ParserContext &pc, RetType in, RetType rt);
+RetType RelopType (ParserContext &pc, RetType in, RetType right, TokenInfo const &at);
+RetType CheckCallee (ParserContext &pc, RetType in); // on the id
+RetType check_param_list_with_expr_list (ParserContext &pc, SymbolID id, RetType in, std::vector<RetType> const &expr_list);
+RetType SignedType (ParserContext &pc, RetType in);
+RetType AddType (ParserContext &pc, RetType in, RetType right, bool isOr);
+RetType MulType (ParserContext &pc, RetType in, RetType fr, MulOpEnum mulOp);
+RetType EmitNumber (ParserContext &pc, TokenInfo const &tid); // after matching tid
+RetType NotType (ParserContext &pc, RetType in, RetType operand);
+RetType FactorIndexType (ParserContext &pc, RetType in, RetType ret);
 }; // namespace Parser
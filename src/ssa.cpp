@@ -0,0 +1,625 @@
+#include "ssa.h"
+
+#include <unordered_map>
+
+namespace
+{
+
+// Builds each function's SSA as it lowers the statements, reading variables back through the
+// blocks as in Braun et al., "Simple and Efficient Construction of Static Single Assignment
+// Form": a block that may still gain predecessors, a loop header, gets placeholder phis that are
+// filled in when it is sealed, and a phi left with a single distinct operand is forwarded to it.
+class SsaBuilder
+{
+	public:
+	explicit SsaBuilder (Ast const &ast) : ast (ast), owner (ast.Size (), no_node), escapes (ast.Size (), false) {}
+
+	bool Build (SsaModule &module, std::string &error)
+	{
+		NodeID root = ast.Root ();
+		if (root == no_node)
+		{
+			error = "there is no program";
+			return false;
+		}
+		if (NodeID bad = ast.FindUnresolved (); bad != no_node)
+		{
+			error = fmt::format ("line {}: the program has errors", ast.Line (bad));
+			return false;
+		}
+		FindOwners (root);
+		Function (module, root, 0);
+		return true;
+	}
+
+	private:
+	// Which procedure declares each variable, and which variables a nested procedure uses
+	void FindOwners (NodeID proc)
+	{
+		for (NodeID child : ast.Children (proc))
+			if (ast.Kind (child) == NodeKind::declaration) owner[child] = proc;
+		for (NodeID child : ast.Children (proc))
+			if (ast.Kind (child) == NodeKind::compound)
+				ast.Walk (child, [&] (NodeID n) {
+					if (ast.Kind (n) == NodeKind::variable && owner[ast.Declaration (n)] != proc)
+						escapes[ast.Declaration (n)] = true;
+					return true;
+				});
+		for (NodeID child : ast.Children (proc))
+			if (ast.Kind (child) == NodeKind::procedure) FindOwners (child);
+	}
+
+	bool Promoted (NodeID decl) const
+	{
+		RetType type = ast.Type (decl);
+		return (type == RT_int || type == RT_real) && !escapes[decl];
+	}
+
+	void Function (SsaModule &module, NodeID proc, int level)
+	{
+		module.functions.push_back (SsaFunction{ proc, ast.Symbol (proc), level, {}, {}, {} });
+		f = &module.functions.back ();
+		defs.clear ();
+		sealed.clear ();
+		incomplete.clear ();
+		forward.clear ();
+		current = NewBlock ();
+		Seal (current);
+
+		std::vector<NodeID> promoted;
+		for (NodeID child : ast.Children (proc))
+		{
+			if (ast.Kind (child) != NodeKind::declaration || ast.Type (child) == RT_none) continue;
+			RetType type = ast.Type (child);
+			if (ast.IsParam (child))
+			{
+				SsaValue param{ SsaOp::param, type, no_block, ast.Line (child) };
+				param.int_value = static_cast<int32_t> (f->params.size ());
+				param.name = ast.Symbol (child);
+				f->params.push_back (child);
+				ValueID v = f->Add (current, param);
+				if (Promoted (child))
+					Write (child, current, v);
+				else if (IsArrayType (type))
+					Emit (SsaOp::copy_array, RT_none, { Array (child), v });
+				else
+					Emit (SsaOp::store, RT_none, { v }, child);
+			}
+			else if (Promoted (child))
+				Write (child, current, type == RT_real ? RealConst (0) : IntConst (0));
+			if (Promoted (child)) promoted.push_back (child);
+		}
+
+		for (NodeID child : ast.Children (proc))
+			if (ast.Kind (child) == NodeKind::compound) Statement (child);
+		line = ast.Line (proc);
+		// the program's variables are its result, so they go back to memory for the printing
+		if (level == 0)
+			for (NodeID decl : promoted)
+				Emit (SsaOp::store, RT_none, { Read (decl, current) }, decl);
+		f->blocks[current].exit = BlockExit::ret;
+
+		for (auto &value : f->values)
+			for (auto &operand : value.operands)
+				operand = Resolve (operand);
+		for (auto &block : f->blocks)
+			if (block.condition != no_value) block.condition = Resolve (block.condition);
+
+		for (NodeID child : ast.Children (proc))
+			if (ast.Kind (child) == NodeKind::procedure) Function (module, child, level + 1);
+	}
+
+	BlockID NewBlock ()
+	{
+		defs.emplace_back ();
+		sealed.push_back (false);
+		incomplete.emplace_back ();
+		return f->AddBlock ();
+	}
+
+	ValueID Emit (SsaOp op, RetType type, std::vector<ValueID> operands, NodeID node = no_node)
+	{
+		SsaValue value{ op, type, no_block, line, node };
+		value.operands = std::move (operands);
+		return f->Add (current, std::move (value));
+	}
+
+	ValueID IntConst (int32_t i)
+	{
+		SsaValue value{ SsaOp::int_const, RT_int, no_block, line };
+		value.int_value = i;
+		return f->Add (current, value);
+	}
+
+	ValueID RealConst (double r)
+	{
+		SsaValue value{ SsaOp::real_const, RT_real, no_block, line };
+		value.real_value = r;
+		return f->Add (current, value);
+	}
+
+	ValueID Array (NodeID decl) { return Emit (SsaOp::array, ast.Type (decl), {}, decl); }
+
+	void Jump (BlockID to)
+	{
+		f->blocks[current].exit = BlockExit::jump;
+		f->blocks[current].next[0] = to;
+		f->blocks[to].preds.push_back (current);
+	}
+
+	void Branch (ValueID condition, BlockID then_block, BlockID else_block)
+	{
+		auto &block = f->blocks[current];
+		block.exit = BlockExit::branch;
+		block.condition = condition;
+		block.next[0] = then_block;
+		block.next[1] = else_block;
+		f->blocks[then_block].preds.push_back (current);
+		f->blocks[else_block].preds.push_back (current);
+	}
+
+	ValueID Resolve (ValueID v) const
+	{
+		while (v < forward.size () && forward[v] != no_value)
+			v = forward[v];
+		return v;
+	}
+
+	void Write (NodeID decl, BlockID block, ValueID v) { defs[block][decl] = v; }
+
+	ValueID Read (NodeID decl, BlockID block)
+	{
+		auto it = defs[block].find (decl);
+		if (it != defs[block].end ()) return Resolve (it->second);
+
+		ValueID v;
+		if (!sealed[block])
+		{
+			v = NewPhi (decl, block);
+			incomplete[block].emplace_back (decl, v);
+		}
+		else if (f->blocks[block].preds.size () == 1)
+			v = Read (decl, f->blocks[block].preds[0]);
+		else
+		{
+			// written before reading the operands, so a loop back to this block finds the phi
+			v = NewPhi (decl, block);
+			Write (decl, block, v);
+			v = AddPhiOperands (decl, v);
+		}
+		Write (decl, block, v);
+		return v;
+	}
+
+	ValueID NewPhi (NodeID decl, BlockID block)
+	{
+		SsaValue phi{ SsaOp::phi, ast.Type (decl), block, ast.Line (decl) };
+		phi.name = ast.Symbol (decl);
+		f->values.push_back (phi);
+		auto id = static_cast<ValueID> (f->values.size () - 1);
+		auto &code = f->blocks[block].code;
+		code.insert (code.begin (), id);
+		return id;
+	}
+
+	ValueID AddPhiOperands (NodeID decl, ValueID phi)
+	{
+		BlockID block = f->values[phi].block;
+		for (BlockID pred : f->blocks[block].preds)
+		{
+			ValueID operand = Read (decl, pred);
+			f->values[phi].operands.push_back (operand);
+		}
+		return RemoveTrivialPhi (phi);
+	}
+
+	// A phi whose operands are all one value, or itself, is that value. Phis using this one may
+	// become trivial in turn; copy propagation takes those out.
+	ValueID RemoveTrivialPhi (ValueID phi)
+	{
+		ValueID same = no_value;
+		for (ValueID operand : f->values[phi].operands)
+		{
+			operand = Resolve (operand);
+			if (operand == same || operand == phi) continue;
+			if (same != no_value) return phi;
+			same = operand;
+		}
+		if (same == no_value) return phi;
+		if (forward.size () < f->values.size ()) forward.resize (f->values.size (), no_value);
+		forward[phi] = same;
+		auto &code = f->blocks[f->values[phi].block].code;
+		code.erase (std::find (code.begin (), code.end (), phi));
+		f->values[phi].block = no_block;
+		return same;
+	}
+
+	void Seal (BlockID block)
+	{
+		for (size_t i = 0; i < incomplete[block].size (); i++)
+			AddPhiOperands (incomplete[block][i].first, incomplete[block][i].second);
+		incomplete[block].clear ();
+		sealed[block] = true;
+	}
+
+	void Statement (NodeID n)
+	{
+		line = ast.Line (n);
+		switch (ast.Kind (n))
+		{
+			case (NodeKind::compound):
+				for (NodeID child : ast.Children (n))
+					Statement (child);
+				break;
+			case (NodeKind::assign): Assign (ast.Child (n, 0), ast.Child (n, 1)); break;
+			case (NodeKind::if_then):
+			{
+				ValueID condition = Value (ast.Child (n, 0));
+				BlockID then_block = NewBlock ();
+				BlockID join = NewBlock ();
+				BlockID else_block = ast.Children (n).size () == 3 ? NewBlock () : join;
+				Branch (condition, then_block, else_block);
+				Seal (then_block);
+				current = then_block;
+				Statement (ast.Child (n, 1));
+				Jump (join);
+				if (else_block != join)
+				{
+					Seal (else_block);
+					current = else_block;
+					Statement (ast.Child (n, 2));
+					Jump (join);
+				}
+				Seal (join);
+				current = join;
+				break;
+			}
+			case (NodeKind::while_do):
+			{
+				BlockID header = NewBlock ();
+				Jump (header);
+				current = header;
+				ValueID condition = Value (ast.Child (n, 0));
+				BlockID body = NewBlock ();
+				BlockID exit = NewBlock ();
+				Branch (condition, body, exit);
+				Seal (body);
+				Seal (exit);
+				current = body;
+				Statement (ast.Child (n, 1));
+				Jump (header);
+				Seal (header);
+				current = exit;
+				break;
+			}
+			case (NodeKind::call):
+			{
+				std::vector<ValueID> arguments;
+				for (NodeID arg : ast.Children (n))
+					arguments.push_back (IsArrayType (ast.Type (arg)) ? Array (ast.Declaration (arg)) : Value (arg));
+				line = ast.Line (n);
+				Emit (SsaOp::call, RT_none, std::move (arguments), ast.Callee (n));
+				break;
+			}
+			default: break;
+		}
+	}
+
+	void Assign (NodeID target, NodeID value)
+	{
+		if (ast.Kind (target) == NodeKind::index)
+		{
+			ValueID array = Array (ast.Declaration (ast.Child (target, 0)));
+			ValueID index = Value (ast.Child (target, 1));
+			ValueID v = Value (value);
+			line = ast.Line (target);
+			Emit (SsaOp::store_elem, RT_none, { array, index, v });
+			return;
+		}
+		NodeID decl = ast.Declaration (target);
+		if (IsArrayType (ast.Type (target)))
+			Emit (SsaOp::copy_array, RT_none, { Array (decl), Array (ast.Declaration (value)) });
+		else if (Promoted (decl))
+		{
+			// every assignment gets its own named copy, for copy propagation to fold away
+			ValueID copy = Emit (SsaOp::copy, ast.Type (decl), { Value (value) });
+			f->values[copy].name = ast.Symbol (decl);
+			Write (decl, current, copy);
+		}
+		else
+			Emit (SsaOp::store, RT_none, { Value (value) }, decl);
+	}
+
+	ValueID Value (NodeID n)
+	{
+		line = ast.Line (n);
+		switch (ast.Kind (n))
+		{
+			case (NodeKind::int_literal): return IntConst (ast.IntValue (n));
+			// the lexer keeps a float, its shortest spelling gives back the literal as written
+			case (NodeKind::real_literal): return RealConst (std::stod (fmt::format ("{}", ast.RealValue (n))));
+			case (NodeKind::variable):
+			{
+				NodeID decl = ast.Declaration (n);
+				if (Promoted (decl)) return Read (decl, current);
+				return Emit (SsaOp::load, ast.Type (decl), {}, decl);
+			}
+			case (NodeKind::index):
+			{
+				ValueID array = Array (ast.Declaration (ast.Child (n, 0)));
+				ValueID index = Value (ast.Child (n, 1));
+				line = ast.Line (n);
+				return Emit (SsaOp::load_elem, ast.Type (n), { array, index });
+			}
+			case (NodeKind::unary):
+			{
+				ValueID operand = Value (ast.Child (n, 0));
+				line = ast.Line (n);
+				switch (ast.UnaryOperator (n))
+				{
+					case (UnaryOp::plus): return operand;
+					case (UnaryOp::t_not): return Emit (SsaOp::t_not, ast.Type (n), { operand });
+					default: return Emit (ast.Type (n) == RT_real ? SsaOp::neg_r : SsaOp::neg_i, ast.Type (n), { operand });
+				}
+			}
+			case (NodeKind::binary):
+			{
+				NodeID left = ast.Child (n, 0);
+				ValueID l = Value (left);
+				ValueID r = Value (ast.Child (n, 1));
+				line = ast.Line (n);
+				return Emit (BinaryOpcode (ast.BinaryOperator (n), ast.Type (left) == RT_real), ast.Type (n), { l, r });
+			}
+			default: return IntConst (0);
+		}
+	}
+
+	static SsaOp BinaryOpcode (BinaryOp op, bool real)
+	{
+		switch (op)
+		{
+			case (BinaryOp::add): return real ? SsaOp::add_r : SsaOp::add_i;
+			case (BinaryOp::sub): return real ? SsaOp::sub_r : SsaOp::sub_i;
+			case (BinaryOp::mul): return real ? SsaOp::mul_r : SsaOp::mul_i;
+			case (BinaryOp::div): return real ? SsaOp::div_r : SsaOp::div_i;
+			case (BinaryOp::mod): return SsaOp::mod_i;
+			case (BinaryOp::t_and): return SsaOp::t_and;
+			case (BinaryOp::t_or): return SsaOp::t_or;
+			case (BinaryOp::equal): return real ? SsaOp::eq_r : SsaOp::eq_i;
+			case (BinaryOp::not_equal): return real ? SsaOp::ne_r : SsaOp::ne_i;
+			case (BinaryOp::less_than): return real ? SsaOp::lt_r : SsaOp::lt_i;
+			case (BinaryOp::less_than_or_equal): return real ? SsaOp::le_r : SsaOp::le_i;
+			case (BinaryOp::greater_than): return real ? SsaOp::gt_r : SsaOp::gt_i;
+			default: return real ? SsaOp::ge_r : SsaOp::ge_i;
+		}
+	}
+
+	Ast const &ast;
+	std::vector<NodeID> owner; // by declaration node, its procedure
+	std::vector<bool> escapes; // by declaration node, used by a nested procedure
+
+	// the function being built
+	SsaFunction *f = nullptr;
+	BlockID current = 0;
+	int line = 0;
+	std::vector<std::unordered_map<NodeID, ValueID>> defs; // by block, each variable's value at its end
+	std::vector<bool> sealed;
+	std::vector<std::vector<std::pair<NodeID, ValueID>>> incomplete; // by block, phis to fill when sealed
+	std::vector<ValueID> forward; // by value, what a removed phi stands for
+};
+
+} // namespace
+
+DominatorTree::DominatorTree (SsaFunction const &f)
+: position (f.blocks.size (), unreached), idom (f.blocks.size (), no_block), children (f.blocks.size ())
+{
+	// postorder by an explicit stack of (block, successors visited)
+	std::vector<std::pair<BlockID, size_t>> stack;
+	std::vector<bool> visited (f.blocks.size (), false);
+	stack.emplace_back (0, 0);
+	visited[0] = true;
+	while (!stack.empty ())
+	{
+		auto &[b, next] = stack.back ();
+		auto &block = f.blocks[b];
+		if (next < block.SuccessorCount ())
+		{
+			BlockID s = block.next[next++];
+			if (!visited[s])
+			{
+				visited[s] = true;
+				stack.emplace_back (s, 0);
+			}
+		}
+		else
+		{
+			order.push_back (b);
+			stack.pop_back ();
+		}
+	}
+	std::reverse (order.begin (), order.end ());
+	for (uint32_t i = 0; i < order.size (); i++)
+		position[order[i]] = i;
+
+	auto intersect = [&] (BlockID a, BlockID b) {
+		while (a != b)
+		{
+			while (position[a] > position[b])
+				a = idom[a];
+			while (position[b] > position[a])
+				b = idom[b];
+		}
+		return a;
+	};
+	idom[0] = 0;
+	for (bool changed = true; changed;)
+	{
+		changed = false;
+		for (size_t i = 1; i < order.size (); i++)
+		{
+			BlockID b = order[i];
+			BlockID new_idom = no_block;
+			for (BlockID pred : f.blocks[b].preds)
+			{
+				if (!Reachable (pred) || idom[pred] == no_block) continue;
+				new_idom = new_idom == no_block ? pred : intersect (pred, new_idom);
+			}
+			if (new_idom != idom[b])
+			{
+				idom[b] = new_idom;
+				changed = true;
+			}
+		}
+	}
+	for (size_t i = 1; i < order.size (); i++)
+		children[idom[order[i]]].push_back (order[i]);
+}
+
+bool DominatorTree::Dominates (BlockID a, BlockID b) const
+{
+	if (!Reachable (a) || !Reachable (b)) return false;
+	while (b != a && b != 0)
+		b = idom[b];
+	return b == a;
+}
+
+std::optional<SsaModule> BuildSsa (Ast const &ast, std::string &error)
+{
+	SsaModule module;
+	SsaBuilder builder (ast);
+	if (!builder.Build (module, error)) return std::nullopt;
+	return module;
+}
+
+std::string VerifySsa (SsaFunction const &f)
+{
+	DominatorTree dom (f);
+	std::vector<uint32_t> index_in_block (f.values.size (), UINT32_MAX);
+	for (BlockID b = 0; b < f.blocks.size (); b++)
+	{
+		auto &block = f.blocks[b];
+		if (block.removed) continue;
+		if (!dom.Reachable (b)) return fmt::format ("b{} is unreachable", b);
+		for (uint32_t i = 0; i < block.code.size (); i++)
+		{
+			ValueID v = block.code[i];
+			if (f.values[v].block != b) return fmt::format ("%{} is listed in b{} but says b{}", v, b, f.values[v].block);
+			if (i > 0 && f.values[v].op == SsaOp::phi && f.values[block.code[i - 1]].op != SsaOp::phi)
+				return fmt::format ("phi %{} comes after other instructions", v);
+			index_in_block[v] = i;
+		}
+		for (size_t s = 0; s < block.SuccessorCount (); s++)
+		{
+			BlockID next = block.next[s];
+			if (next >= f.blocks.size () || f.blocks[next].removed) return fmt::format ("b{} goes to a removed block", b);
+			auto &preds = f.blocks[next].preds;
+			if (std::count (preds.begin (), preds.end (), b) != std::count (block.next, block.next + block.SuccessorCount (), next))
+				return fmt::format ("b{} is not listed once per edge among the predecessors of b{}", b, next);
+		}
+		for (BlockID pred : block.preds)
+		{
+			auto &p = f.blocks[pred];
+			if (p.removed || std::find (p.next, p.next + p.SuccessorCount (), b) == p.next + p.SuccessorCount ())
+				return fmt::format ("b{} lists b{} as a predecessor without an edge", b, pred);
+		}
+	}
+
+	// a use is fine when the definition's block dominates it and, in the same block, comes first
+	auto defined_before = [&] (ValueID def, BlockID block, uint32_t index) {
+		if (def >= f.values.size () || f.values[def].block == no_block) return false;
+		BlockID def_block = f.values[def].block;
+		if (def_block == block) return index_in_block[def] < index;
+		return dom.Dominates (def_block, block);
+	};
+	for (BlockID b = 0; b < f.blocks.size (); b++)
+	{
+		auto &block = f.blocks[b];
+		if (block.removed) continue;
+		for (uint32_t i = 0; i < block.code.size (); i++)
+		{
+			ValueID v = block.code[i];
+			auto &value = f.values[v];
+			if (value.op == SsaOp::phi)
+			{
+				if (value.operands.size () != block.preds.size ())
+					return fmt::format ("phi %{} has {} operands for {} predecessors", v, value.operands.size (), block.preds.size ());
+				for (size_t k = 0; k < value.operands.size (); k++)
+					if (!defined_before (value.operands[k], block.preds[k], UINT32_MAX))
+						return fmt::format ("phi %{} operand {} is not defined in b{}", v, k, block.preds[k]);
+			}
+			else
+				for (ValueID operand : value.operands)
+					if (!defined_before (operand, b, i))
+						return fmt::format ("%{} uses %{} before it is defined", v, operand);
+		}
+		if (block.exit == BlockExit::branch && !defined_before (block.condition, b, UINT32_MAX))
+			return fmt::format ("the branch out of b{} uses %{} before it is defined", b, block.condition);
+	}
+	return {};
+}
+
+void PrintSsa (SsaModule const &module, Ast const &ast, SymbolTable const &symbols, FILE *fp)
+{
+	auto name = [&] (NodeID node) { return symbols.SymbolView (ast.Symbol (node)); };
+	for (auto &f : module.functions)
+	{
+		if (f.level == 0)
+			fmt::print (fp, "program:\n");
+		else
+		{
+			fmt::print (fp, "\nprocedure {}: level {}, params (", symbols.SymbolView (f.name), f.level);
+			for (size_t i = 0; i < f.params.size (); i++)
+				fmt::print (fp, "{}{}", i ? ", " : "", name (f.params[i]));
+			fmt::print (fp, ")\n");
+		}
+		for (BlockID b = 0; b < f.blocks.size (); b++)
+		{
+			auto &block = f.blocks[b];
+			if (block.removed) continue;
+			fmt::print (fp, "b{}:", b);
+			for (size_t i = 0; i < block.preds.size (); i++)
+				fmt::print (fp, "{}b{}", i ? ", " : " from ", block.preds[i]);
+			fmt::print (fp, "\n");
+			for (ValueID v : block.code)
+			{
+				auto &value = f.values[v];
+				if (value.type == RT_none)
+					fmt::print (fp, "{:9}{:<11}", "", ssa_op_names[static_cast<size_t> (value.op)]);
+				else
+					fmt::print (fp, "{:>6} = {:<11}", fmt::format ("%{}", v), ssa_op_names[static_cast<size_t> (value.op)]);
+				switch (value.op)
+				{
+					case (SsaOp::int_const):
+					case (SsaOp::param): fmt::print (fp, "{}", value.int_value); break;
+					case (SsaOp::real_const): fmt::print (fp, "{}", value.real_value); break;
+					case (SsaOp::array):
+					case (SsaOp::load): fmt::print (fp, "{}", name (value.node)); break;
+					case (SsaOp::store): fmt::print (fp, "{}, %{}", name (value.node), value.operands[0]); break;
+					case (SsaOp::phi):
+						for (size_t i = 0; i < value.operands.size (); i++)
+							fmt::print (fp, "{}[%{}, b{}]", i ? ", " : "", value.operands[i], block.preds[i]);
+						break;
+					case (SsaOp::call):
+						fmt::print (fp, "{} (", name (value.node));
+						for (size_t i = 0; i < value.operands.size (); i++)
+							fmt::print (fp, "{}%{}", i ? ", " : "", value.operands[i]);
+						fmt::print (fp, ")");
+						break;
+					default:
+						for (size_t i = 0; i < value.operands.size (); i++)
+							fmt::print (fp, "{}%{}", i ? ", " : "", value.operands[i]);
+				}
+				if (value.name != 0 && value.op != SsaOp::param) fmt::print (fp, "  ; {}", symbols.SymbolView (value.name));
+				fmt::print (fp, "\n");
+			}
+			switch (block.exit)
+			{
+				case (BlockExit::jump): fmt::print (fp, "{:9}{:<11}b{}\n", "", "jump", block.next[0]); break;
+				case (BlockExit::branch):
+					fmt::print (fp, "{:9}{:<11}%{}, b{}, b{}\n", "", "branch", block.condition, block.next[0], block.next[1]);
+					break;
+				case (BlockExit::ret): fmt::print (fp, "{:9}ret\n", ""); break;
+			}
+		}
+	}
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "ast.h"
+#include "common.h"
+
+// A mid-level IR in SSA form, lowered from a checked program for the passes in ssa_passes.h to
+// work on whatever backend comes after. Each procedure is a function of basic blocks. A scalar
+// variable that no nested procedure uses lives in SSA values, phis joining them where control
+// flow meets; every other variable stays in memory behind load and store. The program's own
+// variables are stored back as it returns, so they read out of memory as for the other backends.
+// Types come from the checker, so each arithmetic op has an int (_i) and a real (_r) version and
+// bools are ints 0 and 1, as in the bytecode.
+enum class SsaOp : uint8_t
+{
+	int_const,  // int_value
+	real_const, // real_value
+	param,      // int_value: which param of the function
+	phi,        // one operand per predecessor of the block, in the same order
+	copy,       // a
+	array,      // node: an array declaration; its address, for the ops below
+	load,       // node: a scalar declaration of this or an enclosing procedure
+	store,      // node: as load; the value
+	load_elem,  // array, index; checked against the bounds
+	store_elem, // array, index, value; as above
+	copy_array, // to, from
+	call,       // node: the callee procedure; arguments, arrays by their address
+	add_i,      // a + b, wrapping
+	sub_i,
+	mul_i,
+	div_i, // truncates, a runtime error for a zero divisor
+	mod_i, // sign of the dividend, as above
+	neg_i,
+	add_r,
+	sub_r,
+	mul_r,
+	div_r,
+	neg_r,
+	eq_i,
+	ne_i,
+	lt_i,
+	le_i,
+	gt_i,
+	ge_i,
+	eq_r,
+	ne_r,
+	lt_r,
+	le_r,
+	gt_r,
+	ge_r,
+	t_and,
+	t_or,
+	t_not,
+	count
+};
+
+constexpr const char *ssa_op_names[] = { "int", "real", "param", "phi", "copy", "array", "load",
+	"store", "load_elem", "store_elem", "copy_array", "call", "add_i", "sub_i", "mul_i", "div_i",
+	"mod_i", "neg_i", "add_r", "sub_r", "mul_r", "div_r", "neg_r", "eq_i", "ne_i", "lt_i", "le_i",
+	"gt_i", "ge_i", "eq_r", "ne_r", "lt_r", "le_r", "gt_r", "ge_r", "and", "or", "not" };
+static_assert (std::size (ssa_op_names) == static_cast<size_t> (SsaOp::count), "an SSA op is missing its name");
+
+using ValueID = uint32_t;
+using BlockID = uint32_t;
+constexpr ValueID no_value = UINT32_MAX;
+constexpr BlockID no_block = UINT32_MAX;
+
+// Ops that change memory or end the program, kept however their results are used
+inline bool HasSideEffects (SsaOp op)
+{
+	return op == SsaOp::store || op == SsaOp::store_elem || op == SsaOp::copy_array || op == SsaOp::call;
+}
+
+// Ops that read memory, their result can change between two of them with the same operands
+inline bool ReadsMemory (SsaOp op) { return op == SsaOp::load || op == SsaOp::load_elem; }
+
+// An instruction and the value it defines, one per ValueID
+struct SsaValue
+{
+	SsaOp op;
+	RetType type = RT_none; // RT_none for ops without a result
+	BlockID block = no_block; // no_block once a pass removed it
+	int line = 0;
+	NodeID node = no_node;
+	int32_t int_value = 0;
+	double real_value = 0;
+	std::vector<ValueID> operands;
+	SymbolID name = 0; // the variable a copy or phi was made for, for printing
+};
+
+enum class BlockExit : uint8_t
+{
+	jump,   // to next[0]
+	branch, // to next[0] if condition, else next[1]
+	ret
+};
+
+struct SsaBlock
+{
+	std::vector<ValueID> code; // phis first
+	std::vector<BlockID> preds;
+	BlockExit exit = BlockExit::ret;
+	ValueID condition = no_value;
+	BlockID next[2] = { no_block, no_block };
+	bool removed = false;
+
+	size_t SuccessorCount () const { return exit == BlockExit::ret ? 0 : exit == BlockExit::jump ? 1 : 2; }
+};
+
+struct SsaFunction
+{
+	NodeID proc;
+	SymbolID name;
+	int level; // 0 for the program
+	std::vector<NodeID> params; // declarations, in order
+	std::vector<SsaBlock> blocks; // the entry first
+	std::vector<SsaValue> values;
+
+	ValueID Add (BlockID block, SsaValue value)
+	{
+		value.block = block;
+		values.push_back (std::move (value));
+		auto id = static_cast<ValueID> (values.size () - 1);
+		blocks[block].code.push_back (id);
+		return id;
+	}
+
+	BlockID AddBlock ()
+	{
+		blocks.emplace_back ();
+		return static_cast<BlockID> (blocks.size () - 1);
+	}
+
+	// Instructions still in a block
+	size_t InstructionCount () const
+	{
+		size_t count = 0;
+		for (auto &block : blocks)
+			if (!block.removed) count += block.code.size ();
+		return count;
+	}
+
+	bool IsConst (ValueID v) const { return values[v].op == SsaOp::int_const || values[v].op == SsaOp::real_const; }
+};
+
+struct SsaModule
+{
+	std::vector<SsaFunction> functions; // the program first
+
+	size_t InstructionCount () const
+	{
+		size_t count = 0;
+		for (auto &f : functions)
+			count += f.InstructionCount ();
+		return count;
+	}
+};
+
+// The blocks reachable from the entry in reverse postorder, and each one's immediate dominator,
+// found by the iteration of Cooper, Harvey and Kennedy over that order
+class DominatorTree
+{
+	public:
+	explicit DominatorTree (SsaFunction const &f);
+
+	std::vector<BlockID> const &ReversePostorder () const { return order; }
+	BlockID ImmediateDominator (BlockID b) const { return idom[b]; }
+	std::vector<BlockID> const &Children (BlockID b) const { return children[b]; }
+	bool Reachable (BlockID b) const { return position[b] != unreached; }
+	bool Dominates (BlockID a, BlockID b) const;
+
+	private:
+	static constexpr uint32_t unreached = UINT32_MAX;
+	std::vector<BlockID> order;
+	std::vector<uint32_t> position; // in order, by block
+	std::vector<BlockID> idom;
+	std::vector<std::vector<BlockID>> children;
+};
+
+// Lowers a checked program, which must have no errors. Fails, saying why in error, for programs
+// with errors.
+std::optional<SsaModule> BuildSsa (Ast const &ast, std::string &error);
+
+// An empty string when f is well formed: every operand defined and dominating its use, phis
+// matching the predecessors, and the block lists agreeing with each other. Otherwise the first
+// problem found.
+std::string VerifySsa (SsaFunction const &f);
+
+void PrintSsa (SsaModule const &module, Ast const &ast, SymbolTable const &symbols, FILE *fp);
@@ -0,0 +1,551 @@
+#include "ssa_passes.h"
+
+#include <chrono>
+#include <cstring>
+#include <tuple>
+#include <unordered_map>
+
+namespace
+{
+
+// Where a chain of replacements ends
+ValueID Find (std::vector<ValueID> const &replacement, ValueID v)
+{
+	while (replacement[v] != no_value)
+		v = replacement[v];
+	return v;
+}
+
+// Points every use at what replacement says and takes the replaced values out of their blocks
+void ApplyReplacements (SsaFunction &f, std::vector<ValueID> const &replacement)
+{
+	for (auto &value : f.values)
+		for (auto &operand : value.operands)
+			operand = Find (replacement, operand);
+	for (auto &block : f.blocks)
+	{
+		if (block.exit == BlockExit::branch) block.condition = Find (replacement, block.condition);
+		auto replaced = [&] (ValueID v) { return replacement[v] != no_value; };
+		block.code.erase (std::remove_if (block.code.begin (), block.code.end (), replaced), block.code.end ());
+	}
+	for (ValueID v = 0; v < f.values.size (); v++)
+		if (replacement[v] != no_value) f.values[v].block = no_block;
+}
+
+// Takes one edge from -> to away, with the phi operands that came along it
+void RemoveEdge (SsaFunction &f, BlockID from, BlockID to)
+{
+	auto &preds = f.blocks[to].preds;
+	auto k = std::find (preds.begin (), preds.end (), from) - preds.begin ();
+	preds.erase (preds.begin () + k);
+	for (ValueID v : f.blocks[to].code)
+		if (f.values[v].op == SsaOp::phi) f.values[v].operands.erase (f.values[v].operands.begin () + k);
+}
+
+struct Constant
+{
+	bool real;
+	int32_t i;
+	double r;
+
+	bool operator== (Constant const &other) const
+	{
+		return real == other.real && (real ? std::memcmp (&r, &other.r, sizeof (r)) == 0 : i == other.i);
+	}
+};
+
+std::optional<Constant> ConstantOf (SsaFunction const &f, ValueID v)
+{
+	auto &value = f.values[v];
+	if (value.op == SsaOp::int_const) return Constant{ false, value.int_value, 0 };
+	if (value.op == SsaOp::real_const) return Constant{ true, 0, value.real_value };
+	return std::nullopt;
+}
+
+int32_t Wrap (uint32_t u) { return static_cast<int32_t> (u); }
+
+Constant Int (int32_t i) { return Constant{ false, i, 0 }; }
+Constant Bool (bool b) { return Constant{ false, b ? 1 : 0, 0 }; }
+Constant Real (double r) { return Constant{ true, 0, r }; }
+
+// The result as the VM would compute it, nothing for a division that fails at run time
+std::optional<Constant> Fold (SsaOp op, Constant a, Constant b)
+{
+	auto ua = static_cast<uint32_t> (a.i);
+	auto ub = static_cast<uint32_t> (b.i);
+	switch (op)
+	{
+		case (SsaOp::add_i): return Int (Wrap (ua + ub));
+		case (SsaOp::sub_i): return Int (Wrap (ua - ub));
+		case (SsaOp::mul_i): return Int (Wrap (ua * ub));
+		case (SsaOp::div_i):
+			if (b.i == 0) return std::nullopt;
+			return Int (b.i == -1 ? Wrap (0u - ua) : a.i / b.i);
+		case (SsaOp::mod_i):
+			if (b.i == 0) return std::nullopt;
+			return Int (b.i == -1 ? 0 : a.i % b.i);
+		case (SsaOp::neg_i): return Int (Wrap (0u - ua));
+		case (SsaOp::add_r): return Real (a.r + b.r);
+		case (SsaOp::sub_r): return Real (a.r - b.r);
+		case (SsaOp::mul_r): return Real (a.r * b.r);
+		case (SsaOp::div_r): return Real (a.r / b.r);
+		case (SsaOp::neg_r): return Real (-a.r);
+		case (SsaOp::eq_i): return Bool (a.i == b.i);
+		case (SsaOp::ne_i): return Bool (a.i != b.i);
+		case (SsaOp::lt_i): return Bool (a.i < b.i);
+		case (SsaOp::le_i): return Bool (a.i <= b.i);
+		case (SsaOp::gt_i): return Bool (a.i > b.i);
+		case (SsaOp::ge_i): return Bool (a.i >= b.i);
+		case (SsaOp::eq_r): return Bool (a.r == b.r);
+		case (SsaOp::ne_r): return Bool (a.r != b.r);
+		case (SsaOp::lt_r): return Bool (a.r < b.r);
+		case (SsaOp::le_r): return Bool (a.r <= b.r);
+		case (SsaOp::gt_r): return Bool (a.r > b.r);
+		case (SsaOp::ge_r): return Bool (a.r >= b.r);
+		case (SsaOp::t_and): return Bool (a.i && b.i);
+		case (SsaOp::t_or): return Bool (a.i || b.i);
+		case (SsaOp::t_not): return Bool (!a.i);
+		default: return std::nullopt;
+	}
+}
+
+bool IsArithmetic (SsaOp op) { return op >= SsaOp::add_i; }
+
+void MakeConstant (SsaValue &value, Constant c)
+{
+	value.op = c.real ? SsaOp::real_const : SsaOp::int_const;
+	value.int_value = c.i;
+	value.real_value = c.r;
+	value.operands.clear ();
+}
+
+void MakeCopy (SsaValue &value, ValueID of)
+{
+	value.op = SsaOp::copy;
+	value.operands = { of };
+}
+
+// Rewrites v in place as a constant, or as a copy of an operand for the int identities
+bool FoldValue (SsaFunction &f, ValueID v)
+{
+	auto &value = f.values[v];
+	if (value.op == SsaOp::phi)
+	{
+		std::optional<Constant> same;
+		for (ValueID operand : value.operands)
+		{
+			if (operand == v) continue;
+			auto c = ConstantOf (f, operand);
+			if (!c || (same && !(*same == *c))) return false;
+			same = c;
+		}
+		if (!same) return false;
+		MakeConstant (value, *same);
+		return true;
+	}
+	if (value.op == SsaOp::copy)
+	{
+		auto c = ConstantOf (f, value.operands[0]);
+		if (c) MakeConstant (value, *c);
+		return c.has_value ();
+	}
+	if (!IsArithmetic (value.op)) return false;
+
+	auto a = ConstantOf (f, value.operands[0]);
+	std::optional<Constant> b;
+	if (value.operands.size () == 2) b = ConstantOf (f, value.operands[1]);
+	if (a && (b || value.operands.size () == 1))
+	{
+		auto folded = Fold (value.op, *a, b ? *b : Int (0));
+		if (folded) MakeConstant (value, *folded);
+		return folded.has_value ();
+	}
+
+	auto is = [] (std::optional<Constant> const &c, int32_t i) { return c && !c->real && c->i == i; };
+	ValueID left = value.operands[0];
+	ValueID right = value.operands.size () == 2 ? value.operands[1] : no_value;
+	switch (value.op)
+	{
+		case (SsaOp::add_i):
+			if (is (a, 0)) MakeCopy (value, right);
+			else if (is (b, 0)) MakeCopy (value, left);
+			else return false;
+			return true;
+		case (SsaOp::sub_i):
+		case (SsaOp::div_i):
+			if (!is (b, value.op == SsaOp::sub_i ? 0 : 1)) return false;
+			MakeCopy (value, left);
+			return true;
+		case (SsaOp::mul_i):
+		case (SsaOp::t_and):
+			if (is (a, 0) || is (b, 0)) MakeConstant (value, Int (0));
+			else if (is (a, 1)) MakeCopy (value, right);
+			else if (is (b, 1)) MakeCopy (value, left);
+			else return false;
+			return true;
+		case (SsaOp::t_or):
+			if (is (a, 1) || is (b, 1)) MakeConstant (value, Int (1));
+			else if (is (a, 0)) MakeCopy (value, right);
+			else if (is (b, 0)) MakeCopy (value, left);
+			else return false;
+			return true;
+		default: return false;
+	}
+}
+
+bool RemoveUnreachableBlocks (SsaFunction &f)
+{
+	DominatorTree dom (f);
+	bool changed = false;
+	for (BlockID b = 0; b < f.blocks.size (); b++)
+	{
+		auto &block = f.blocks[b];
+		if (block.removed || dom.Reachable (b)) continue;
+		for (size_t s = 0; s < block.SuccessorCount (); s++)
+			if (dom.Reachable (block.next[s])) RemoveEdge (f, b, block.next[s]);
+		for (ValueID v : block.code)
+			f.values[v].block = no_block;
+		block.code.clear ();
+		block.preds.clear ();
+		block.removed = true;
+		changed = true;
+	}
+	return changed;
+}
+
+// Ops that may stop the program with a runtime error, kept like side effects
+bool MayTrap (SsaFunction const &f, SsaValue const &value)
+{
+	if (value.op == SsaOp::load_elem || value.op == SsaOp::store_elem) return true;
+	if (value.op != SsaOp::div_i && value.op != SsaOp::mod_i) return false;
+	auto divisor = ConstantOf (f, value.operands[1]);
+	return !divisor || divisor->i == 0;
+}
+
+bool IsCommutative (SsaOp op)
+{
+	switch (op)
+	{
+		case (SsaOp::add_i):
+		case (SsaOp::mul_i):
+		case (SsaOp::add_r):
+		case (SsaOp::mul_r):
+		case (SsaOp::eq_i):
+		case (SsaOp::ne_i):
+		case (SsaOp::eq_r):
+		case (SsaOp::ne_r):
+		case (SsaOp::t_and):
+		case (SsaOp::t_or): return true;
+		default: return false;
+	}
+}
+
+using ValueKey = std::vector<uint64_t>;
+
+struct ValueKeyHash
+{
+	size_t operator() (ValueKey const &key) const
+	{
+		size_t h = 0;
+		for (uint64_t word : key)
+			h = h * 1000003 ^ std::hash<uint64_t> () (word);
+		return h;
+	}
+};
+
+} // namespace
+
+// Folds to a fixed point, in reverse postorder so a value's operands are folded before it except
+// around loops, then drops the blocks that a folded branch cut off
+bool PropagateConstants (SsaFunction &f)
+{
+	bool changed_any = false;
+	for (bool changed = true; changed;)
+	{
+		changed = false;
+		DominatorTree dom (f);
+		for (BlockID b : dom.ReversePostorder ())
+		{
+			auto &block = f.blocks[b];
+			bool folded = false;
+			for (ValueID v : block.code)
+				folded |= FoldValue (f, v);
+			if (folded)
+			{
+				// a phi that became a constant moves below the phis left
+				auto is_phi = [&] (ValueID v) { return f.values[v].op == SsaOp::phi; };
+				std::stable_partition (block.code.begin (), block.code.end (), is_phi);
+				changed = true;
+			}
+			if (block.exit != BlockExit::branch) continue;
+			auto condition = ConstantOf (f, block.condition);
+			if (!condition) continue;
+			BlockID taken = condition->i != 0 ? block.next[0] : block.next[1];
+			BlockID dropped = condition->i != 0 ? block.next[1] : block.next[0];
+			RemoveEdge (f, b, dropped);
+			block.exit = BlockExit::jump;
+			block.next[0] = taken;
+			block.next[1] = no_block;
+			block.condition = no_value;
+			changed = true;
+		}
+		changed_any |= changed;
+	}
+	changed_any |= RemoveUnreachableBlocks (f);
+	return changed_any;
+}
+
+// Marks what stores, calls, possible runtime errors and branches need, and removes the rest
+bool EliminateDeadCode (SsaFunction &f)
+{
+	std::vector<bool> live (f.values.size (), false);
+	std::vector<ValueID> work;
+	auto mark = [&] (ValueID v) {
+		if (live[v]) return;
+		live[v] = true;
+		work.push_back (v);
+	};
+	for (auto &block : f.blocks)
+	{
+		if (block.removed) continue;
+		for (ValueID v : block.code)
+			if (HasSideEffects (f.values[v].op) || MayTrap (f, f.values[v])) mark (v);
+		if (block.exit == BlockExit::branch) mark (block.condition);
+	}
+	while (!work.empty ())
+	{
+		ValueID v = work.back ();
+		work.pop_back ();
+		for (ValueID operand : f.values[v].operands)
+			mark (operand);
+	}
+
+	bool changed = false;
+	for (auto &block : f.blocks)
+	{
+		auto dead = [&] (ValueID v) { return !live[v]; };
+		for (ValueID v : block.code)
+			if (dead (v)) f.values[v].block = no_block;
+		auto first_dead = std::remove_if (block.code.begin (), block.code.end (), dead);
+		changed |= first_dead != block.code.end ();
+		block.code.erase (first_dead, block.code.end ());
+	}
+	return changed;
+}
+
+// Walks the dominator tree keeping a table of the ops seen on the way down, so an op equal to
+// one in the table is dominated by it and can take its value. Loads only match within a block
+// and only while nothing between them could have written memory.
+bool NumberValues (SsaFunction &f)
+{
+	DominatorTree dom (f);
+	std::vector<ValueID> replacement (f.values.size (), no_value);
+	std::unordered_map<ValueKey, ValueID, ValueKeyHash> table;
+	std::vector<ValueKey> scope; // keys in table, innermost block last
+	uint64_t memory_epoch = 0;
+	bool changed = false;
+
+	auto visit = [&] (BlockID b) {
+		for (ValueID v : f.blocks[b].code)
+		{
+			auto &value = f.values[v];
+			if (HasSideEffects (value.op))
+			{
+				memory_epoch++;
+				continue;
+			}
+			if (value.op == SsaOp::copy) continue;
+
+			ValueKey key{ static_cast<uint64_t> (value.op), value.type, value.node, static_cast<uint32_t> (value.int_value) };
+			uint64_t real_bits;
+			std::memcpy (&real_bits, &value.real_value, sizeof (real_bits));
+			key.push_back (real_bits);
+			if (value.op == SsaOp::phi) key.push_back (b);
+			if (ReadsMemory (value.op))
+			{
+				key.push_back (b);
+				key.push_back (memory_epoch);
+			}
+			size_t first_operand = key.size ();
+			for (ValueID operand : value.operands)
+				key.push_back (Find (replacement, operand));
+			if (IsCommutative (value.op) && key[first_operand] > key[first_operand + 1])
+				std::swap (key[first_operand], key[first_operand + 1]);
+
+			auto [it, inserted] = table.emplace (key, v);
+			if (inserted)
+				scope.push_back (std::move (key));
+			else
+			{
+				replacement[v] = it->second;
+				changed = true;
+			}
+		}
+	};
+
+	// depth first by an explicit stack of (block, children visited, scope size on entry)
+	std::vector<std::tuple<BlockID, size_t, size_t>> stack;
+	stack.emplace_back (0, 0, 0);
+	visit (0);
+	while (!stack.empty ())
+	{
+		auto &[b, next, mark] = stack.back ();
+		auto &children = dom.Children (b);
+		if (next < children.size ())
+		{
+			BlockID child = children[next++];
+			stack.emplace_back (child, 0, scope.size ());
+			visit (child);
+			continue;
+		}
+		for (size_t i = mark; i < scope.size (); i++)
+			table.erase (scope[i]);
+		scope.resize (mark);
+		stack.pop_back ();
+	}
+
+	if (changed) ApplyReplacements (f, replacement);
+	return changed;
+}
+
+// Replaces copies by what they copy and phis whose operands, apart from the phi itself, are all
+// one value by that value, until none are left
+bool PropagateCopies (SsaFunction &f)
+{
+	std::vector<ValueID> replacement (f.values.size (), no_value);
+	bool changed_any = false;
+	for (bool changed = true; changed;)
+	{
+		changed = false;
+		for (auto &block : f.blocks)
+			for (ValueID v : block.code)
+			{
+				auto &value = f.values[v];
+				if (replacement[v] != no_value) continue;
+				if (value.op == SsaOp::copy)
+				{
+					replacement[v] = Find (replacement, value.operands[0]);
+					changed = true;
+				}
+				else if (value.op == SsaOp::phi)
+				{
+					ValueID same = no_value;
+					bool trivial = true;
+					for (ValueID operand : value.operands)
+					{
+						operand = Find (replacement, operand);
+						if (operand == v || operand == same) continue;
+						if (same != no_value) trivial = false;
+						same = operand;
+					}
+					if (trivial && same != no_value)
+					{
+						replacement[v] = same;
+						changed = true;
+					}
+				}
+			}
+		changed_any |= changed;
+	}
+	if (changed_any) ApplyReplacements (f, replacement);
+	return changed_any;
+}
+
+void PassStats::Add (std::string_view name, bool changed, double seconds, size_t instructions_in, size_t instructions_out)
+{
+	auto it = std::find_if (entries.begin (), entries.end (), [&] (Entry const &e) { return e.name == name; });
+	if (it == entries.end ())
+	{
+		entries.push_back (Entry{ std::string (name) });
+		it = entries.end () - 1;
+	}
+	it->runs++;
+	it->changed += changed;
+	it->seconds += seconds;
+	it->instructions_in += instructions_in;
+	it->instructions_out += instructions_out;
+}
+
+void PassStats::Merge (PassStats const &other)
+{
+	for (auto &e : other.entries)
+	{
+		auto it = std::find_if (entries.begin (), entries.end (), [&] (Entry const &mine) { return mine.name == e.name; });
+		if (it == entries.end ())
+		{
+			entries.push_back (e);
+			continue;
+		}
+		it->runs += e.runs;
+		it->changed += e.changed;
+		it->seconds += e.seconds;
+		it->instructions_in += e.instructions_in;
+		it->instructions_out += e.instructions_out;
+	}
+}
+
+void PassStats::PrintTable (FILE *fp) const
+{
+	double total = 0;
+	for (auto &e : entries)
+		total += e.seconds;
+	fmt::print (fp, "{:<12}{:>8}{:>9}{:>12}{:>10}{:>14}{:>14}\n", "Pass", "Runs", "Changed", "Seconds", "Percent", "Instrs in", "Instrs out");
+	for (auto &e : entries)
+		fmt::print (fp,
+		"{:<12}{:>8}{:>9}{:>12.6f}{:>9.1f}%{:>14}{:>14}\n",
+		e.name,
+		e.runs,
+		e.changed,
+		e.seconds,
+		total > 0 ? 100 * e.seconds / total : 0.0,
+		e.instructions_in,
+		e.instructions_out);
+	fmt::print (fp, "{:<12}{:>29.6f}\n", "total", total);
+}
+
+bool PassManager::AddPipeline (std::string_view list, std::string &error)
+{
+	while (!list.empty ())
+	{
+		size_t comma = list.find (',');
+		std::string_view name = list.substr (0, comma);
+		list = comma == std::string_view::npos ? std::string_view () : list.substr (comma + 1);
+		auto it = std::find_if (std::begin (ssa_passes), std::end (ssa_passes), [&] (SsaPass const &p) { return name == p.name; });
+		if (it == std::end (ssa_passes))
+		{
+			error = fmt::format ("there is no pass named '{}'", name);
+			return false;
+		}
+		pipeline.push_back (&*it);
+	}
+	return true;
+}
+
+bool PassManager::Run (SsaModule &module, PassStats &stats, std::string &error) const
+{
+	for (size_t i = 0; i < module.functions.size (); i++)
+	{
+		auto &f = module.functions[i];
+		if (verify) error = VerifySsa (f);
+		if (!error.empty ())
+		{
+			error = fmt::format ("function {} is broken as built: {}", i, error);
+			return false;
+		}
+		for (auto *pass : pipeline)
+		{
+			size_t instructions_in = f.InstructionCount ();
+			auto start = std::chrono::steady_clock::now ();
+			bool changed = pass->run (f);
+			double seconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+			stats.Add (pass->name, changed, seconds, instructions_in, f.InstructionCount ());
+			if (verify) error = VerifySsa (f);
+			if (!error.empty ())
+			{
+				error = fmt::format ("{} broke function {}: {}", pass->name, i, error);
+				return false;
+			}
+		}
+	}
+	return true;
+}
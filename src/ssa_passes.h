@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ssa.h"
+
+// A transformation of one function, true if it changed anything
+struct SsaPass
+{
+	const char *name;
+	const char *description;
+	bool (*run) (SsaFunction &f);
+};
+
+bool PropagateConstants (SsaFunction &f);
+bool EliminateDeadCode (SsaFunction &f);
+bool NumberValues (SsaFunction &f);
+bool PropagateCopies (SsaFunction &f);
+
+constexpr SsaPass ssa_passes[] = {
+	{ "constprop", "folds ops on constants and branches on constant conditions, drops unreachable blocks", PropagateConstants },
+	{ "dce", "removes instructions whose results are unused and that can neither trap nor change memory", EliminateDeadCode },
+	{ "gvn", "replaces an op with an equal one that dominates it, loads only within a block", NumberValues },
+	{ "copyprop", "replaces copies and phis of a single value with that value", PropagateCopies },
+};
+
+// What the pipeline below runs when none is given
+constexpr const char *default_ssa_pipeline = "copyprop,constprop,gvn,copyprop,dce";
+
+// Time and instructions per pass, summed over every function and run, for -time-passes
+class PassStats
+{
+	public:
+	struct Entry
+	{
+		std::string name;
+		long runs = 0;
+		long changed = 0; // runs that changed the function
+		double seconds = 0;
+		size_t instructions_in = 0;
+		size_t instructions_out = 0;
+	};
+
+	void Add (std::string_view name, bool changed, double seconds, size_t instructions_in, size_t instructions_out);
+	void Merge (PassStats const &other);
+	void PrintTable (FILE *fp) const;
+	bool Empty () const { return entries.empty (); }
+
+	private:
+	std::vector<Entry> entries; // in the order the passes first ran
+};
+
+class PassManager
+{
+	public:
+	// Appends the passes named in a comma separated list; fails, saying why in error, on a name
+	// that is not a pass
+	bool AddPipeline (std::string_view list, std::string &error);
+
+	// Runs the passes in order over each function. With verify, checks each function after every
+	// pass and fails, saying why in error, on the first pass that breaks one.
+	bool Run (SsaModule &module, PassStats &stats, std::string &error) const;
+
+	bool verify = false;
+
+	private:
+	std::vector<SsaPass const *> pipeline;
+};
@@ -0,0 +1,596 @@
+#include "table_parser.h"
+
+#include "grammar_tables.h"
+#include "parser.h"
+
+using namespace Parser;
+
+// What to do at the steps of a production, named for the hand-written function it stands in for
+enum class TableParser::Action : uint8_t
+{
+	none,
+	program,           // prog_stmt_program
+	program_parameter, // ident_list_id, ident_list_prime
+	declaration,       // decls
+	declaration_next,  // decls_prime
+	compound,          // CompoundStatement
+	close_scope,       // CompoundStatementFactored
+	child_type,        // Type, factor_paren_open
+	array_type,        // type_array
+	standard_type,     // std_type
+	procedure,         // SubprogramDeclaration
+	procedure_head,    // sub_prog_head_procedure
+	parameter,         // param_list_id
+	parameter_next,    // param_list_prime_id
+	statement_list,    // StatementListPrime
+	assignment,        // stmt_id
+	while_do,          // stmt_while
+	block,             // Statement on begin
+	if_then,           // stmt_if
+	variable,          // var_id, factor_id
+	in_type,           // the e productions that return in
+	variable_index,    // VariableFactored on [
+	chain,             // Expression, SimpleExpression, Term
+	relop,             // expr_factored_relop
+	call,              // proc_stmt_call
+	no_arguments,      // ProcedureStatmentFactored on its follows
+	arguments,         // proc_stmt_factored_paren_open
+	argument,          // expr_list_elem, expr_list_prime_elem
+	signed_term,       // SimpleExpression on a sign
+	add,               // simp_expr_prime_add
+	mul,               // term_prime_mulop
+	number,            // factor_num
+	negation,          // factor_not
+	factor_index,      // FactorPrime on [
+};
+
+using Action = TableParser::Action;
+
+// The productions of grammars/grammar_shorthand.txt after the massager, with the steps, before
+// which symbol of the rule or after the last, that their action runs at. A production ending in a
+// nonterminal that has nothing to do after it returns what that nonterminal returns, as the
+// hand-written function returns the call it ends in.
+struct ProductionActions
+{
+	const char *text;
+	Action action;
+	std::initializer_list<int> steps;
+};
+
+const ProductionActions production_actions[] = {
+	{ "prog_stmt -> 'program' 'id' '(' id_list ')' ';' prog_stmt'", Action::program, { 1, 7 } },
+	{ "prog_stmt' -> sp_decls comp_stmt '.'", Action::none, {} },
+	{ "prog_stmt' -> comp_stmt '.'", Action::none, {} },
+	{ "prog_stmt' -> decls prog_stmt''", Action::none, {} },
+	{ "prog_stmt'' -> sp_decls comp_stmt '.'", Action::none, {} },
+	{ "prog_stmt'' -> comp_stmt '.'", Action::none, {} },
+	{ "id_list -> 'id' id_list'", Action::program_parameter, { 0 } },
+	{ "id_list' -> e", Action::none, {} },
+	{ "id_list' -> ',' 'id' id_list'", Action::program_parameter, { 1 } },
+	{ "decls -> 'var' 'id' ':' type ';' decls'", Action::declaration, { 1, 4 } },
+	{ "decls' -> e", Action::none, {} },
+	{ "decls' -> 'var' 'id' ':' type ';' decls'", Action::declaration_next, { 1, 4 } },
+	{ "sp_decls -> sp_decl ';' sp_decls'", Action::none, {} },
+	{ "sp_decls' -> e", Action::none, {} },
+	{ "sp_decls' -> sp_decl ';' sp_decls'", Action::none, {} },
+	{ "comp_stmt -> 'begin' comp_stmt'", Action::compound, { 0, 2 } },
+	{ "comp_stmt' -> opt_stmt 'end'", Action::close_scope, { 2 } },
+	{ "comp_stmt' -> 'end'", Action::close_scope, { 1 } },
+	{ "type -> standard_type", Action::child_type, { 1 } },
+	{ "type -> 'array' '[' 'num' '..' 'num' ']' 'of' standard_type", Action::array_type, { 2, 4, 8 } },
+	{ "standard_type -> 'integer'", Action::standard_type, { 0, 1 } },
+	{ "standard_type -> 'real'", Action::standard_type, { 0, 1 } },
+	{ "sp_decl -> sp_head sp_decl'", Action::procedure, { 0, 2 } },
+	{ "sp_decl' -> sp_decls comp_stmt", Action::none, {} },
+	{ "sp_decl' -> comp_stmt", Action::none, {} },
+	{ "sp_decl' -> decls sp_decl''", Action::none, {} },
+	{ "sp_decl'' -> sp_decls comp_stmt", Action::none, {} },
+	{ "sp_decl'' -> comp_stmt", Action::none, {} },
+	{ "sp_head -> 'procedure' 'id' sp_head'", Action::procedure_head, { 1, 2 } },
+	{ "sp_head' -> args ';'", Action::none, {} },
+	{ "sp_head' -> ';'", Action::none, {} },
+	{ "args -> '(' p_list ')'", Action::none, {} },
+	{ "p_list -> 'id' ':' type p_list'", Action::parameter, { 0, 3 } },
+	{ "p_list' -> e", Action::none, {} },
+	{ "p_list' -> ';' 'id' ':' type p_list'", Action::parameter_next, { 1, 4 } },
+	{ "opt_stmt -> stmt_list", Action::none, {} },
+	{ "stmt_list -> stmt stmt_list'", Action::none, {} },
+	{ "stmt_list' -> e", Action::none, {} },
+	{ "stmt_list' -> ';' stmt stmt_list'", Action::statement_list, { 1, 2 } },
+	{ "stmt -> variable 'assignop' expr", Action::assignment, { 0, 1, 2, 3 } },
+	{ "stmt -> proc_stmt", Action::none, {} },
+	{ "stmt -> 'while' expr 'do' stmt", Action::while_do, { 0, 1, 2, 3, 4 } },
+	{ "stmt -> 'begin' stmt'", Action::block, { 0, 1, 2 } },
+	{ "stmt -> 'if' expr 'then' stmt stmt''", Action::if_then, { 0, 1, 2, 3, 4, 5 } },
+	{ "stmt' -> opt_stmt 'end'", Action::none, {} },
+	{ "stmt' -> 'end'", Action::none, {} },
+	{ "stmt'' -> 'else' stmt", Action::none, {} },
+	{ "stmt'' -> e", Action::none, {} },
+	{ "variable -> 'id' variable'", Action::variable, { 0 } },
+	{ "variable' -> e", Action::in_type, { 0 } },
+	{ "variable' -> '[' expr ']'", Action::variable_index, { 0, 1, 3 } },
+	{ "expr -> simp_expr expr'", Action::chain, { 1 } },
+	{ "expr' -> e", Action::in_type, { 0 } },
+	{ "expr' -> 'relop' simp_expr", Action::relop, { 0, 1, 2 } },
+	{ "proc_stmt -> 'call' 'id' proc_stmt'", Action::call, { 0, 1, 2, 3 } },
+	{ "proc_stmt' -> e", Action::no_arguments, { 0 } },
+	{ "proc_stmt' -> '(' expr_list ')'", Action::arguments, { 0, 2, 3 } },
+	{ "expr_list -> expr expr_list'", Action::argument, { 1 } },
+	{ "expr_list' -> e", Action::in_type, { 0 } },
+	{ "expr_list' -> ',' expr expr_list'", Action::argument, { 2 } },
+	{ "simp_expr -> term simp_expr'", Action::chain, { 1 } },
+	{ "simp_expr -> sign term simp_expr'", Action::signed_term, { 0, 2 } },
+	{ "simp_expr' -> e", Action::in_type, { 0 } },
+	{ "simp_expr' -> 'addop' term simp_expr'", Action::add, { 0, 2 } },
+	{ "term -> factor term'", Action::chain, { 1 } },
+	{ "term' -> e", Action::in_type, { 0 } },
+	{ "term' -> 'mulop' factor term'", Action::mul, { 0, 2 } },
+	{ "sign -> '+'", Action::none, {} },
+	{ "sign -> '-'", Action::none, {} },
+	{ "factor -> 'num'", Action::number, { 0, 1 } },
+	{ "factor -> '(' expr ')'", Action::child_type, { 3 } },
+	{ "factor -> 'not' factor", Action::negation, { 0, 2 } },
+	{ "factor -> 'id' factor'", Action::variable, { 0 } },
+	{ "factor' -> e", Action::in_type, { 0 } },
+	{ "factor' -> '[' expr ']'", Action::factor_index, { 0, 3 } },
+};
+
+// The nonterminals whose hand-written functions emit an error node when they can't expand, as
+// their callers expect a node from them
+const char *const error_node_nonterminals[] = { "stmt", "variable", "proc_stmt", "expr", "simp_expr", "term", "factor" };
+
+LL1Table GeneratedLL1Table ()
+{
+	using namespace GrammarTables;
+
+	LL1Table table;
+	table.nonterminals.assign (std::begin (nonterminal_names), std::end (nonterminal_names));
+	table.terminals.assign (std::begin (terminals), std::end (terminals));
+	for (auto &production : productions)
+		table.productions.push_back (LL1Production{ production.nonterminal,
+		std::vector<LL1Symbol> (symbols + production.symbols, symbols + production.symbols + production.length),
+		production.text });
+	table.firsts.assign (std::begin (firsts), std::end (firsts));
+	table.nullable.assign (std::begin (nullable), std::end (nullable));
+	table.follows.assign (std::begin (follows), std::end (follows));
+	table.entries.assign (std::begin (entries), std::end (entries));
+	table.start = start;
+	table.end_of_file = end_of_file;
+	return table;
+}
+
+bool TableParser::Bind (LL1Table table, std::string &error)
+{
+	this->table = std::move (table);
+	actions.clear ();
+	action_steps.clear ();
+	tail_calls.clear ();
+	for (auto &production : this->table.productions)
+	{
+		auto it = std::find_if (std::begin (production_actions), std::end (production_actions), [&] (auto &p) {
+			return production.text == p.text;
+		});
+		if (it == std::end (production_actions))
+		{
+			error = "No actions for the production " + production.text;
+			return false;
+		}
+		uint32_t steps = 0;
+		for (int step : it->steps)
+			steps |= uint32_t (1) << step;
+		actions.push_back (it->action);
+		action_steps.push_back (steps);
+		auto &rule = production.rule;
+		tail_calls.push_back (!rule.empty () && !rule.back ().terminal && !(steps & (uint32_t (1) << rule.size ())));
+	}
+	error_nodes.clear ();
+	for (auto &name : this->table.nonterminals)
+		error_nodes.push_back (std::find (std::begin (error_node_nonterminals), std::end (error_node_nonterminals), name)
+		                       != std::end (error_node_nonterminals));
+	return true;
+}
+
+namespace
+{
+struct StackItem
+{
+	enum class Kind : uint8_t
+	{
+		terminal,
+		nonterminal,
+		step, // of the production on top of the frames
+		end,  // of the production on top of the frames
+		tail  // of the production on top of the frames, before its last symbol
+	};
+	Kind kind;
+	uint8_t step;
+	uint16_t index; // terminal or nonterminal
+};
+
+// The locals of a hand-written function, for a production being parsed. There is one per level
+// of nesting in the input, so it's kept small.
+struct Frame
+{
+	int16_t production;
+	bool passing = false;
+	bool flag = false;
+	RetType in;              // the function's in, which a failed match makes RT_err
+	RetType ret = RT_none;   // what it returns
+	RetType child = RT_none; // what the last nonterminal done under it returned
+	RetType value = RT_none;
+	RetType pass = RT_none; // in for the next nonterminal, when passing
+	uint8_t op = 0;
+	int line = 0;
+	uint32_t height = 0;
+	int32_t id = -1; // the ProcedureID declared or SymbolID called
+	NodeID callee = no_node;
+	TokenInfo token;
+	TokenInfo token2;
+
+	Frame (int production, RetType in) : production (production), in (in) {}
+
+	void Pass (RetType type)
+	{
+		pass = type;
+		passing = true;
+	}
+};
+} // namespace
+
+void TableParser::Parse (ParserContext &pc) const
+{
+	std::vector<StackItem> stack;
+	std::vector<Frame> frames;
+	std::vector<RetType> arguments; // of the calls being parsed
+
+	frames.emplace_back (-1, RT_none);
+	stack.push_back (StackItem{ StackItem::Kind::terminal, 0, static_cast<uint16_t> (table.end_of_file) });
+	stack.push_back (StackItem{ StackItem::Kind::nonterminal, 0, static_cast<uint16_t> (table.start) });
+
+	while (!stack.empty ())
+	{
+		StackItem item = stack.back ();
+		stack.pop_back ();
+		Frame &f = frames.back ();
+		switch (item.kind)
+		{
+			case (StackItem::Kind::terminal):
+			{
+				TTSet tokens = table.terminals[item.index];
+				TT tt = pc.Current ().type;
+				if (!(tokens & TTBit (tt)))
+				{
+					int lowest = 0;
+					while (!(tokens & TTBit (TT (lowest))))
+						lowest++;
+					tt = TT (lowest);
+				}
+				pc.Match (tt, f.in);
+				break;
+			}
+			case (StackItem::Kind::nonterminal):
+			{
+				int p = table.Entry (item.index, pc.Current ().type);
+				if (p < 0)
+				{
+					if (error_nodes[item.index]) pc.EmitError ();
+					TTSet follows = table.follows[item.index];
+					DefaultErr (pc, table.firsts[item.index] | (table.nullable[item.index] ? follows : 0), follows);
+					f.child = RT_err;
+					f.passing = false;
+					break;
+				}
+				RetType in = f.passing ? f.pass : f.in;
+				f.passing = false;
+				frames.emplace_back (p, in);
+
+				auto &rule = table.productions[p].rule;
+				uint32_t steps = action_steps[p];
+				if (!tail_calls[p]) stack.push_back (StackItem{ StackItem::Kind::end, 0, 0 });
+				for (int k = rule.size (); k >= 0; k--)
+				{
+					if (k < rule.size ())
+					{
+						auto kind = rule[k].terminal ? StackItem::Kind::terminal : StackItem::Kind::nonterminal;
+						stack.push_back (StackItem{ kind, 0, static_cast<uint16_t> (rule[k].index) });
+					}
+					if (k == rule.size () - 1 && tail_calls[p])
+						stack.push_back (StackItem{ StackItem::Kind::tail, 0, 0 });
+					if (steps & (uint32_t (1) << k))
+						stack.push_back (StackItem{ StackItem::Kind::step, static_cast<uint8_t> (k), 0 });
+				}
+				break;
+			}
+			case (StackItem::Kind::end):
+			{
+				RetType ret = f.ret;
+				frames.pop_back ();
+				frames.back ().child = ret;
+				break;
+			}
+			case (StackItem::Kind::tail):
+			{
+				// the last symbol returns to the production under this one, so lists don't pile up
+				RetType in = f.passing ? f.pass : f.in;
+				frames.pop_back ();
+				frames.back ().Pass (in);
+				break;
+			}
+			case (StackItem::Kind::step):
+			{
+				int step = item.step;
+				bool last = step == table.productions[f.production].rule.size ();
+				switch (actions[f.production])
+				{
+					case (Action::none):
+						break;
+					case (Action::program):
+						if (!last)
+							f.height = ProgramHead (pc, f.in);
+						else
+							pc.Adopt (f.height);
+						break;
+					case (Action::program_parameter):
+						DeclareProgramParameter (pc, f.in);
+						break;
+					case (Action::declaration):
+					case (Action::declaration_next):
+						if (!last && step == 1)
+							f.token = pc.Current ();
+						else
+							DeclareVariable (pc, f.token, f.child, f.in, actions[f.production] == Action::declaration);
+						break;
+					case (Action::compound):
+					case (Action::block):
+						if (step == 0)
+						{
+							f.height = pc.OpenNodes ();
+							f.line = pc.Current ().line_location;
+						}
+						else if (!last)
+							f.Pass (RT_none);
+						else
+							pc.Reduce (f.height, NodeKind::compound, RT_none, -1, 0, f.line);
+						break;
+					case (Action::close_scope):
+						pc.tree.Pop ();
+						break;
+					case (Action::child_type):
+						f.ret = f.child;
+						break;
+					case (Action::array_type):
+						if (step == 2)
+						{
+							f.token = pc.Current ();
+							f.flag = CheckArrayBound (pc, f.token, f.in, "Array right bound not an int");
+						}
+						else if (step == 4)
+						{
+							f.token2 = pc.Current ();
+							f.flag = CheckArrayBound (pc, f.token2, f.in, "Array left bound not an int") && f.flag;
+						}
+						else
+							f.ret = ArrayType (pc, f.token, f.token2, f.child, f.in, f.flag);
+						break;
+					case (Action::standard_type):
+						if (!last)
+							f.token = pc.Current ();
+						else
+							f.ret = StandardTypeOf (pc, f.token, f.in);
+						break;
+					case (Action::procedure):
+						if (!last)
+							f.height = pc.OpenNodes ();
+						else
+							pc.Adopt (f.height);
+						break;
+					case (Action::procedure_head):
+						if (step == 1)
+							f.id = ProcedureHead (pc, f.in);
+						else if (f.id != -1)
+							pc.tree.Push (f.id);
+						break;
+					case (Action::parameter):
+					case (Action::parameter_next):
+						if (step == (actions[f.production] == Action::parameter ? 0 : 1))
+							f.token = pc.Current ();
+						else
+							DeclareParameter (pc, f.token, f.child, f.in, actions[f.production] == Action::parameter);
+						break;
+					case (Action::statement_list):
+						f.Pass (RT_none);
+						break;
+					case (Action::assignment):
+						if (step == 0)
+							f.height = pc.OpenNodes ();
+						else if (step == 1)
+						{
+							f.value = f.child;
+							f.line = pc.Current ().line_location;
+						}
+						else if (step == 2)
+						{
+							f.token = pc.Current ();
+							f.Pass (f.value);
+						}
+						else
+						{
+							pc.Reduce (f.height, NodeKind::assign, RT_none, -1, 0, f.line);
+							CheckAssignment (pc, f.value, f.child, f.in, f.token);
+						}
+						break;
+					case (Action::while_do):
+						if (step == 0)
+						{
+							f.height = pc.OpenNodes ();
+							f.line = pc.Current ().line_location;
+						}
+						else if (step == 2)
+							CheckWhileCondition (pc, f.child, f.in);
+						else if (!last)
+							f.Pass (RT_none);
+						else
+							pc.Reduce (f.height, NodeKind::while_do, RT_none, -1, 0, f.line);
+						break;
+					case (Action::if_then):
+						if (step == 0)
+						{
+							f.height = pc.OpenNodes ();
+							f.line = pc.Current ().line_location;
+						}
+						else if (step == 2)
+							CheckIfCondition (pc, f.child, f.in);
+						else if (!last)
+							f.Pass (RT_none);
+						else
+							pc.Reduce (f.height, NodeKind::if_then, RT_none, -1, 0, f.line);
+						break;
+					case (Action::variable):
+						f.Pass (EmitVariable (pc, f.in));
+						break;
+					case (Action::in_type):
+						f.ret = f.in;
+						break;
+					case (Action::variable_index):
+					case (Action::factor_index):
+						if (step == 0)
+						{
+							f.height = pc.OpenNodes () - 1; // the variable
+							f.line = pc.Current ().line_location;
+						}
+						else if (!last)
+							f.Pass (RT_none);
+						else
+						{
+							if (actions[f.production] == Action::variable_index)
+								f.ret = VariableIndexType (pc, f.in, f.child);
+							else
+								f.ret = FactorIndexType (pc, f.in, f.child);
+							pc.Reduce (f.height, NodeKind::index, f.ret, -1, 0, f.line);
+						}
+						break;
+					case (Action::chain):
+						f.Pass (f.child);
+						break;
+					case (Action::relop):
+						if (step == 0)
+						{
+							f.height = pc.OpenNodes () - 1; // the left operand
+							f.op = NodeOp (pc.Current ().RelOp ());
+							f.line = pc.Current ().line_location;
+						}
+						else if (step == 1)
+							f.token = pc.Current ();
+						else
+						{
+							f.ret = RelopType (pc, f.in, f.child, f.token);
+							pc.Reduce (f.height, NodeKind::binary, f.ret, -1, 0, f.line, f.op);
+						}
+						break;
+					case (Action::call):
+						if (step == 0)
+						{
+							f.height = pc.OpenNodes ();
+							f.line = pc.Current ().line_location;
+						}
+						else if (step == 1)
+						{
+							f.value = CheckCallee (pc, f.in);
+							f.id = GetSymbol (pc.Current ());
+							f.callee = CalleeNode (pc, f.id);
+						}
+						else if (step == 2)
+							f.Pass (f.value);
+						else
+						{
+							f.ret = f.child;
+							pc.Reduce (f.height, NodeKind::call, f.ret, f.id, f.callee, f.line);
+						}
+						break;
+					case (Action::no_arguments):
+						f.ret = check_param_list_with_expr_list (pc, frames[frames.size () - 2].id, f.in, {});
+						break;
+					case (Action::arguments):
+						if (step == 0)
+							f.height = arguments.size ();
+						else if (!last)
+						{
+							std::vector<RetType> expr_list (arguments.begin () + f.height, arguments.end ());
+							arguments.erase (arguments.begin () + f.height, arguments.end ());
+							f.value = f.child;
+							f.flag = check_param_list_with_expr_list (pc, frames[frames.size () - 2].id, f.in, expr_list) == RT_err;
+						}
+						else
+							f.ret = f.flag || f.value == RT_err ? RetType (RT_err) : f.value;
+						break;
+					case (Action::argument):
+						arguments.push_back (f.child);
+						break;
+					case (Action::signed_term):
+						if (step == 0)
+						{
+							f.height = pc.OpenNodes ();
+							f.line = pc.Current ().line_location;
+							f.op = static_cast<uint8_t> (
+							pc.Current ().SignOp () == SignOpEnum::minus ? UnaryOp::minus : UnaryOp::plus);
+						}
+						else
+						{
+							f.value = SignedType (pc, f.child);
+							pc.Reduce (f.height, NodeKind::unary, f.value, -1, 0, f.line, f.op);
+							f.Pass (f.value);
+						}
+						break;
+					case (Action::add):
+						if (step == 0)
+						{
+							f.height = pc.OpenNodes () - 1; // the left operand
+							f.line = pc.Current ().line_location;
+							f.flag = pc.Current ().type == TT::ADDOP;
+							f.op = f.flag ? static_cast<uint8_t> (BinaryOp::t_or) : NodeOp (pc.Current ().SignOp ());
+						}
+						else
+						{
+							f.value = AddType (pc, f.in, f.child, f.flag);
+							pc.Reduce (f.height, NodeKind::binary, f.value, -1, 0, f.line, f.op);
+							f.Pass (f.value);
+						}
+						break;
+					case (Action::mul):
+						if (step == 0)
+						{
+							f.height = pc.OpenNodes () - 1; // the left operand
+							f.line = pc.Current ().line_location;
+							f.token = pc.Current ();
+						}
+						else
+						{
+							f.value = MulType (pc, f.in, f.child, f.token.MulOp ());
+							pc.Reduce (f.height, NodeKind::binary, f.value, -1, 0, f.line, NodeOp (f.token.MulOp ()));
+							f.Pass (f.value);
+						}
+						break;
+					case (Action::number):
+						if (!last)
+							f.token = pc.Current ();
+						else
+							f.ret = EmitNumber (pc, f.token);
+						break;
+					case (Action::negation):
+						if (step == 0)
+						{
+							f.height = pc.OpenNodes ();
+							f.line = pc.Current ().line_location;
+						}
+						else
+						{
+							f.ret = NotType (pc, f.in, f.child);
+							pc.Reduce (f.height, NodeKind::unary, f.ret, -1, 0, f.line, static_cast<uint8_t> (UnaryOp::t_not));
+						}
+						break;
+				}
+				break;
+			}
+		}
+	}
+}
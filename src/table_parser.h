@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "ll1_table.h"
+
+class ParserContext;
+
+// The table of grammars/grammar_shorthand.txt, generated into grammar_tables.h by the build
+LL1Table GeneratedLL1Table ();
+
+// Parses from an LL(1) table with a stack of its own instead of one function per nonterminal, so
+// nesting in the input doesn't nest calls. It builds the same tree and reports the same semantic
+// errors as Parser::Parse, running the same actions at the same points of each production.
+class TableParser
+{
+	public:
+	// Fails, saying why in error, when the table has a production there are no actions for
+	bool Bind (LL1Table table, std::string &error);
+
+	void Parse (ParserContext &pc) const;
+
+	enum class Action : uint8_t;
+
+	private:
+	LL1Table table;
+	std::vector<Action> actions;       // by production
+	std::vector<uint32_t> action_steps; // by production, bit k set to act before symbol k of its rule
+	std::vector<bool> tail_calls;       // by production, returns what its last nonterminal does
+	std::vector<bool> error_nodes;      // by nonterminal, emits an error node when it can't expand
+};
@@ -0,0 +1,337 @@
+#include "vm.h"
+
+#include <algorithm>
+#include <cstring>
+
+VM::VM (Bytecode const &bytecode, size_t stack_slots, size_t max_depth)
+: bytecode (bytecode), stack (stack_slots), calls (max_depth)
+{
+	uint16_t levels = 0;
+	for (auto &proc : bytecode.procedures)
+		levels = std::max<uint16_t> (levels, proc.level + 1);
+	display.resize (levels);
+}
+
+// Each handler jumps straight to the next one through a table of label addresses where the
+// compiler supports it, otherwise it goes back round a switch
+#if defined(__GNUC__)
+#define VM_COMPUTED_GOTO
+#endif
+
+#ifdef VM_COMPUTED_GOTO
+#define VM_NEXT() goto *labels[static_cast<size_t> (ip->op)]
+#else
+#define VM_NEXT() continue
+#endif
+#define VM_STEP()                                                                                  \
+	{                                                                                              \
+		++ip;                                                                                      \
+		VM_NEXT ();                                                                                \
+	}
+#define VM_FAIL(status)                                                                            \
+	{                                                                                              \
+		error_line = bytecode.lines[ip - code];                                                    \
+		return status;                                                                             \
+	}
+
+RunStatus VM::Run ()
+{
+	Instruction const *code = bytecode.code.data ();
+	Instruction const *ip = code + bytecode.procedures[0].entry;
+	ArrayRef const *arrays = bytecode.arrays.data ();
+	double const *reals = bytecode.reals.data ();
+	Value **levels = display.data ();
+	Value *const stack_end = stack.data () + stack.size ();
+	CallRecord *call = calls.data ();
+	CallRecord *const calls_end = calls.data () + calls.size ();
+
+	Value zero;
+	zero.r = 0.0; // all bits clear, so an int zero as well
+	error_line = 0;
+	Value *frame = stack.data ();
+	if (bytecode.procedures[0].frame_size > stack.size ())
+	{
+		error_line = bytecode.lines[ip - code];
+		return RunStatus::stack_overflow;
+	}
+	std::fill_n (frame, bytecode.procedures[0].frame_size, zero);
+	levels[0] = frame;
+
+	// int arithmetic wraps, done on unsigned to keep it defined
+	auto wrap = [] (uint32_t v) { return static_cast<int32_t> (v); };
+
+#ifdef VM_COMPUTED_GOTO
+	// in the order of Op
+	static void *const labels[] = { &&op_halt, &&op_ret, &&op_call, &&op_move, &&op_load_int,
+		&&op_load_real, &&op_load_outer, &&op_store_outer, &&op_load_elem, &&op_store_elem,
+		&&op_copy_array, &&op_add_i, &&op_sub_i, &&op_mul_i, &&op_div_i, &&op_mod_i, &&op_neg_i,
+		&&op_add_r, &&op_sub_r, &&op_mul_r, &&op_div_r, &&op_neg_r, &&op_eq_i, &&op_ne_i, &&op_lt_i,
+		&&op_le_i, &&op_gt_i, &&op_ge_i, &&op_eq_r, &&op_ne_r, &&op_lt_r, &&op_le_r, &&op_gt_r,
+		&&op_ge_r, &&op_t_and, &&op_t_or, &&op_t_not, &&op_jump, &&op_jump_if, &&op_jump_unless,
+		&&op_jump_eq_i, &&op_jump_ne_i, &&op_jump_lt_i, &&op_jump_le_i, &&op_jump_gt_i,
+		&&op_jump_ge_i };
+	static_assert (std::size (labels) == static_cast<size_t> (Op::count), "an op is missing its label");
+	VM_NEXT ();
+#define VM_CASE(name) op_##name
+#else
+#define VM_CASE(name) case (Op::name)
+	for (;;)
+		switch (ip->op)
+		{
+#endif
+
+	VM_CASE (halt) : return RunStatus::ok;
+	VM_CASE (ret) :
+	{
+		--call;
+		levels[call->level] = call->saved_display;
+		frame = call->frame;
+		ip = call->ret;
+		VM_NEXT ();
+	}
+	VM_CASE (call) :
+	{
+		auto &proc = bytecode.procedures[ip->a];
+		Value *callee = frame + ip->b;
+		if (call == calls_end || callee + proc.frame_size > stack_end) VM_FAIL (RunStatus::stack_overflow);
+		std::fill (callee + proc.param_slots, callee + proc.frame_size, zero);
+		*call++ = CallRecord{ ip + 1, frame, levels[proc.level], proc.level };
+		levels[proc.level] = callee;
+		frame = callee;
+		ip = code + proc.entry;
+		VM_NEXT ();
+	}
+	VM_CASE (move) :
+	{
+		frame[ip->a] = frame[ip->b];
+		VM_STEP ();
+	}
+	VM_CASE (load_int) :
+	{
+		frame[ip->a].i = static_cast<int32_t> (ip->BC ());
+		VM_STEP ();
+	}
+	VM_CASE (load_real) :
+	{
+		frame[ip->a].r = reals[ip->BC ()];
+		VM_STEP ();
+	}
+	VM_CASE (load_outer) :
+	{
+		frame[ip->a] = levels[ip->b][ip->c];
+		VM_STEP ();
+	}
+	VM_CASE (store_outer) :
+	{
+		levels[ip->a][ip->b] = frame[ip->c];
+		VM_STEP ();
+	}
+	VM_CASE (load_elem) :
+	{
+		auto &array = arrays[ip->b];
+		int64_t index = static_cast<int64_t> (frame[ip->c].i) - array.low;
+		if (index < 0 || index >= array.size) VM_FAIL (RunStatus::index_out_of_range);
+		frame[ip->a] = levels[array.level][array.base + index];
+		VM_STEP ();
+	}
+	VM_CASE (store_elem) :
+	{
+		auto &array = arrays[ip->a];
+		int64_t index = static_cast<int64_t> (frame[ip->b].i) - array.low;
+		if (index < 0 || index >= array.size) VM_FAIL (RunStatus::index_out_of_range);
+		levels[array.level][array.base + index] = frame[ip->c];
+		VM_STEP ();
+	}
+	VM_CASE (copy_array) :
+	{
+		auto &to = arrays[ip->a];
+		auto &from = arrays[ip->b];
+		std::memmove (levels[to.level] + to.base, levels[from.level] + from.base, to.size * sizeof (Value));
+		VM_STEP ();
+	}
+	VM_CASE (add_i) :
+	{
+		frame[ip->a].i = wrap (static_cast<uint32_t> (frame[ip->b].i) + static_cast<uint32_t> (frame[ip->c].i));
+		VM_STEP ();
+	}
+	VM_CASE (sub_i) :
+	{
+		frame[ip->a].i = wrap (static_cast<uint32_t> (frame[ip->b].i) - static_cast<uint32_t> (frame[ip->c].i));
+		VM_STEP ();
+	}
+	VM_CASE (mul_i) :
+	{
+		frame[ip->a].i = wrap (static_cast<uint32_t> (frame[ip->b].i) * static_cast<uint32_t> (frame[ip->c].i));
+		VM_STEP ();
+	}
+	VM_CASE (div_i) :
+	{
+		int32_t divisor = frame[ip->c].i;
+		if (divisor == 0) VM_FAIL (RunStatus::division_by_zero);
+		// INT32_MIN / -1 overflows
+		frame[ip->a].i = divisor == -1 ? wrap (0u - static_cast<uint32_t> (frame[ip->b].i)) : frame[ip->b].i / divisor;
+		VM_STEP ();
+	}
+	VM_CASE (mod_i) :
+	{
+		int32_t divisor = frame[ip->c].i;
+		if (divisor == 0) VM_FAIL (RunStatus::division_by_zero);
+		frame[ip->a].i = divisor == -1 ? 0 : frame[ip->b].i % divisor;
+		VM_STEP ();
+	}
+	VM_CASE (neg_i) :
+	{
+		frame[ip->a].i = wrap (0u - static_cast<uint32_t> (frame[ip->b].i));
+		VM_STEP ();
+	}
+	VM_CASE (add_r) :
+	{
+		frame[ip->a].r = frame[ip->b].r + frame[ip->c].r;
+		VM_STEP ();
+	}
+	VM_CASE (sub_r) :
+	{
+		frame[ip->a].r = frame[ip->b].r - frame[ip->c].r;
+		VM_STEP ();
+	}
+	VM_CASE (mul_r) :
+	{
+		frame[ip->a].r = frame[ip->b].r * frame[ip->c].r;
+		VM_STEP ();
+	}
+	VM_CASE (div_r) :
+	{
+		frame[ip->a].r = frame[ip->b].r / frame[ip->c].r;
+		VM_STEP ();
+	}
+	VM_CASE (neg_r) :
+	{
+		frame[ip->a].r = -frame[ip->b].r;
+		VM_STEP ();
+	}
+	VM_CASE (eq_i) :
+	{
+		frame[ip->a].i = frame[ip->b].i == frame[ip->c].i;
+		VM_STEP ();
+	}
+	VM_CASE (ne_i) :
+	{
+		frame[ip->a].i = frame[ip->b].i != frame[ip->c].i;
+		VM_STEP ();
+	}
+	VM_CASE (lt_i) :
+	{
+		frame[ip->a].i = frame[ip->b].i < frame[ip->c].i;
+		VM_STEP ();
+	}
+	VM_CASE (le_i) :
+	{
+		frame[ip->a].i = frame[ip->b].i <= frame[ip->c].i;
+		VM_STEP ();
+	}
+	VM_CASE (gt_i) :
+	{
+		frame[ip->a].i = frame[ip->b].i > frame[ip->c].i;
+		VM_STEP ();
+	}
+	VM_CASE (ge_i) :
+	{
+		frame[ip->a].i = frame[ip->b].i >= frame[ip->c].i;
+		VM_STEP ();
+	}
+	VM_CASE (eq_r) :
+	{
+		frame[ip->a].i = frame[ip->b].r == frame[ip->c].r;
+		VM_STEP ();
+	}
+	VM_CASE (ne_r) :
+	{
+		frame[ip->a].i = frame[ip->b].r != frame[ip->c].r;
+		VM_STEP ();
+	}
+	VM_CASE (lt_r) :
+	{
+		frame[ip->a].i = frame[ip->b].r < frame[ip->c].r;
+		VM_STEP ();
+	}
+	VM_CASE (le_r) :
+	{
+		frame[ip->a].i = frame[ip->b].r <= frame[ip->c].r;
+		VM_STEP ();
+	}
+	VM_CASE (gt_r) :
+	{
+		frame[ip->a].i = frame[ip->b].r > frame[ip->c].r;
+		VM_STEP ();
+	}
+	VM_CASE (ge_r) :
+	{
+		frame[ip->a].i = frame[ip->b].r >= frame[ip->c].r;
+		VM_STEP ();
+	}
+	VM_CASE (t_and) :
+	{
+		frame[ip->a].i = frame[ip->b].i & frame[ip->c].i;
+		VM_STEP ();
+	}
+	VM_CASE (t_or) :
+	{
+		frame[ip->a].i = frame[ip->b].i | frame[ip->c].i;
+		VM_STEP ();
+	}
+	VM_CASE (t_not) :
+	{
+		frame[ip->a].i = !frame[ip->b].i;
+		VM_STEP ();
+	}
+	VM_CASE (jump) :
+	{
+		ip = code + ip->BC ();
+		VM_NEXT ();
+	}
+	VM_CASE (jump_if) :
+	{
+		ip = frame[ip->a].i ? code + ip->BC () : ip + 1;
+		VM_NEXT ();
+	}
+	VM_CASE (jump_unless) :
+	{
+		ip = frame[ip->a].i ? ip + 1 : code + ip->BC ();
+		VM_NEXT ();
+	}
+	VM_CASE (jump_eq_i) :
+	{
+		ip += frame[ip->a].i == frame[ip->b].i ? static_cast<int16_t> (ip->c) : 1;
+		VM_NEXT ();
+	}
+	VM_CASE (jump_ne_i) :
+	{
+		ip += frame[ip->a].i != frame[ip->b].i ? static_cast<int16_t> (ip->c) : 1;
+		VM_NEXT ();
+	}
+	VM_CASE (jump_lt_i) :
+	{
+		ip += frame[ip->a].i < frame[ip->b].i ? static_cast<int16_t> (ip->c) : 1;
+		VM_NEXT ();
+	}
+	VM_CASE (jump_le_i) :
+	{
+		ip += frame[ip->a].i <= frame[ip->b].i ? static_cast<int16_t> (ip->c) : 1;
+		VM_NEXT ();
+	}
+	VM_CASE (jump_gt_i) :
+	{
+		ip += frame[ip->a].i > frame[ip->b].i ? static_cast<int16_t> (ip->c) : 1;
+		VM_NEXT ();
+	}
+	VM_CASE (jump_ge_i) :
+	{
+		ip += frame[ip->a].i >= frame[ip->b].i ? static_cast<int16_t> (ip->c) : 1;
+		VM_NEXT ();
+	}
+
+#ifndef VM_COMPUTED_GOTO
+			default: return RunStatus::ok;
+		}
+#endif
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include "bytecode.h"
+
+enum class RunStatus : uint8_t
+{
+	ok,
+	division_by_zero,
+	index_out_of_range,
+	stack_overflow,
+	count
+};
+
+constexpr const char *run_status_messages[] = { "ok", "division by zero", "array index out of range",
+	"stack overflow" };
+static_assert (std::size (run_status_messages) == static_cast<size_t> (RunStatus::count), "a status is missing its message");
+
+// Runs Bytecode from the program's entry to its halt. Frames are laid end to end on one stack of
+// value slots, a call's frame starting where its caller put the arguments.
+class VM
+{
+	public:
+	VM (Bytecode const &bytecode, size_t stack_slots = 1 << 20, size_t max_depth = 1 << 16);
+
+	RunStatus Run ();
+
+	// Source line of the instruction that stopped the run with an error
+	int ErrorLine () const { return error_line; }
+
+	// A slot of the program's frame, where its variables stay after the run
+	Value Global (uint32_t slot) const { return stack[slot]; }
+
+	private:
+	struct CallRecord
+	{
+		Instruction const *ret;
+		Value *frame;
+		Value *saved_display; // of the callee's level
+		uint16_t level;
+	};
+
+	Bytecode const &bytecode;
+	std::vector<Value> stack;
+	std::vector<Value *> display; // by level
+	std::vector<CallRecord> calls;
+	int error_line = 0;
+};
@@ -0,0 +1,709 @@
+#include "x86_64.h"
+
+#include <iterator>
+#include <vector>
+
+namespace
+{
+
+// Where a declaration lives, relative to %rbp of its procedure's frame or to pascal_globals
+struct Location
+{
+	uint16_t level = 0; // 0 for the program's variables
+	int32_t offset = 0;
+	RetType type = RT_none;
+	int32_t low = 0;
+};
+
+struct Frame
+{
+	std::string label;
+	uint16_t level = 0;
+	uint32_t locals = 0; // bytes, as ParserContext::Print adds them up
+	uint32_t params = 0;
+};
+
+uint32_t AlignTo16 (uint32_t bytes) { return (bytes + 15) & ~15u; }
+
+uint32_t ElementSize (RetType type) { return IsArrReal (type) ? 8 : 4; }
+
+class X86Emitter
+{
+	public:
+	X86Emitter (Ast const &ast, SymbolTable const &symbols)
+	: ast (ast), symbols (symbols), locations (ast.Size ()), frame_of (ast.Size (), -1)
+	{
+	}
+
+	bool Emit (FILE *fp, std::string &error)
+	{
+		NodeID root = ast.Root ();
+		if (root == no_node)
+		{
+			error = "there is no program";
+			return false;
+		}
+		if (NodeID bad = ast.FindUnresolved (); bad != no_node)
+		{
+			error = fmt::format ("line {}: the program has errors", ast.Line (bad));
+			return false;
+		}
+		Layout (root, 0);
+
+		Line (".text");
+		Procedure (root);
+		RuntimeSupport ();
+
+		Line (".section .rodata");
+		Line (".align 8");
+		for (size_t i = 0; i < reals.size (); i++)
+			Label (fmt::format (".LC{}:\n\t.quad {:#x}", i, reals[i]));
+		for (NodeID decl : globals)
+			Label (fmt::format (".Lname{}:\n\t.string \"{}\"", decl, symbols.SymbolView (ast.Symbol (decl))));
+		Line (".bss");
+		Line (".align 16");
+		Label ("pascal_globals:");
+		Line (".zero {}", std::max<uint32_t> (frames[0].locals, 1));
+		Line (".section .note.GNU-stack,\"\",@progbits");
+
+		std::fwrite (out.data (), 1, out.size (), fp);
+		return true;
+	}
+
+	private:
+	template <typename... Args> void Line (fmt::format_string<Args...> format, Args &&... args)
+	{
+		out.push_back ('\t');
+		fmt::format_to (std::back_inserter (out), format, std::forward<Args> (args)...);
+		out.push_back ('\n');
+	}
+
+	void Label (std::string_view label)
+	{
+		out.append (label.data (), label.data () + label.size ());
+		out.push_back ('\n');
+	}
+
+	std::string NewLabel () { return fmt::format (".L{}", next_label++); }
+
+	// The program's variables go in .bss, a procedure's locals below its saved static link and
+	// its params above the return address
+	void Layout (NodeID proc, uint16_t level)
+	{
+		frame_of[proc] = frames.size ();
+		frames.push_back (Frame{});
+		size_t index = frames.size () - 1;
+		frames[index].level = level;
+		frames[index].label =
+		level == 0 ? "main" : fmt::format ("pascal_{}_{}", symbols.SymbolView (ast.Symbol (proc)), index);
+
+		uint32_t locals = 0, params = 0;
+		std::vector<NodeID> local_decls;
+		for (NodeID child : ast.Children (proc))
+		{
+			if (ast.Kind (child) != NodeKind::declaration) continue;
+			RetType type = ast.Type (child);
+			auto &loc = locations[child];
+			loc.level = level;
+			loc.type = type;
+			loc.low = ast.LowBound (child);
+			if (ast.IsParam (child))
+			{
+				loc.offset = 16 + params;
+				params += type.size ();
+			}
+			else
+			{
+				loc.offset = locals;
+				locals += type.size ();
+				local_decls.push_back (child);
+				if (level == 0) globals.push_back (child);
+			}
+		}
+		// locals count up from the bottom of the frame, which is known once they are all added
+		if (level > 0)
+			for (NodeID decl : local_decls)
+				locations[decl].offset -= 8 + locals;
+		frames[index].locals = locals;
+		frames[index].params = params;
+
+		for (NodeID child : ast.Children (proc))
+			if (ast.Kind (child) == NodeKind::procedure) Layout (child, level + 1);
+	}
+
+	void Procedure (NodeID proc)
+	{
+		auto &frame = frames[frame_of[proc]];
+		level = frame.level;
+		line = ast.Line (proc);
+
+		Label (fmt::format ("\n# {} {}", level == 0 ? "program" : "procedure", symbols.SymbolView (ast.Symbol (proc))));
+		if (level == 0) Line (".globl main");
+		Line (".type {}, @function", frame.label);
+		Label (frame.label + ":");
+		Line ("pushq %rbp");
+		Line ("movq %rsp, %rbp");
+		if (level > 0)
+		{
+			Line ("subq ${}, %rsp", AlignTo16 (8 + frame.locals));
+			Line ("movq %r10, -8(%rbp)");
+			if (frame.locals > 0)
+			{
+				Line ("leaq {}(%rbp), %rdi", -8 - static_cast<int32_t> (frame.locals));
+				Line ("movl ${}, %ecx", frame.locals);
+				Line ("xorl %eax, %eax");
+				Line ("rep stosb");
+			}
+		}
+
+		for (NodeID child : ast.Children (proc))
+			if (ast.Kind (child) == NodeKind::compound) Statement (child);
+
+		if (level == 0)
+		{
+			PrintGlobals ();
+			Line ("xorl %eax, %eax");
+			Line ("popq %rbp");
+		}
+		else
+			Line ("leave");
+		Line ("ret");
+		Line (".size {}, .-{}", frame.label, frame.label);
+
+		for (NodeID child : ast.Children (proc))
+			if (ast.Kind (child) == NodeKind::procedure) Procedure (child);
+	}
+
+	// The frame pointer of the procedure at target_level into reg, following static links out
+	// from the current procedure
+	void FrameOf (uint16_t target_level, char const *reg)
+	{
+		Line ("movq -8(%rbp), {}", reg);
+		for (int l = level - 1; l > target_level; l--)
+			Line ("movq -8({}), {}", reg, reg);
+	}
+
+	// A memory operand for the variable, emitting the walk out to its frame into %r11 if it
+	// belongs to an enclosing procedure
+	std::string Place (NodeID decl)
+	{
+		auto &loc = locations[decl];
+		if (loc.level == 0) return fmt::format ("pascal_globals+{}(%rip)", loc.offset);
+		if (loc.level == level) return fmt::format ("{}(%rbp)", loc.offset);
+		FrameOf (loc.level, "%r11");
+		return fmt::format ("{}(%r11)", loc.offset);
+	}
+
+	// Operands that need no code to reach: literals and variables of this frame or the program
+	bool Direct (NodeID n, std::string &operand)
+	{
+		if (ast.Kind (n) == NodeKind::int_literal)
+			operand = fmt::format ("${}", ast.IntValue (n));
+		else if (ast.Kind (n) == NodeKind::real_literal)
+			operand = RealConstant (n);
+		else if (ast.Kind (n) == NodeKind::variable && !IsArrayType (ast.Type (n)))
+		{
+			auto &loc = locations[ast.Declaration (n)];
+			if (loc.level != 0 && loc.level != level) return false;
+			operand = Place (ast.Declaration (n));
+		}
+		else
+			return false;
+		return true;
+	}
+
+	std::string RealConstant (NodeID n)
+	{
+		// the lexer keeps a float, its shortest spelling gives back the literal as written
+		double value = std::stod (fmt::format ("{}", ast.RealValue (n)));
+		uint64_t bits;
+		std::memcpy (&bits, &value, sizeof (bits));
+		reals.push_back (bits);
+		return fmt::format (".LC{}(%rip)", reals.size () - 1);
+	}
+
+	void RuntimeError (char const *message_label)
+	{
+		Line ("movl ${}, %edi", line);
+		Line ("leaq {}(%rip), %rsi", message_label);
+		Line ("call pascal_runtime_error");
+	}
+
+	// Turns the index of an element of the index node's array in reg into one from 0, checking it
+	// against the bounds
+	void CheckIndex (NodeID index, char const *reg, char const *reg32)
+	{
+		auto &loc = locations[ast.Declaration (ast.Child (index, 0))];
+		line = ast.Line (index);
+		std::string ok = NewLabel ();
+		Line ("movslq {}, {}", reg32, reg);
+		if (loc.low != 0) Line ("subq ${}, {}", loc.low, reg);
+		Line ("cmpq ${}, {}", ArraySize (loc.type), reg);
+		Line ("jb {}", ok);
+		RuntimeError (".Lindex_message");
+		Label (ok + ":");
+	}
+
+	// A memory operand for the element of the index node's array at the index in index_reg,
+	// addressed through %rdx
+	std::string Element (NodeID index, char const *index_reg)
+	{
+		NodeID array = ast.Declaration (ast.Child (index, 0));
+		Line ("leaq {}, %rdx", Place (array));
+		return fmt::format ("(%rdx,{},{})", index_reg, ElementSize (locations[array].type));
+	}
+
+	// Ints and bools into %eax, reals into %xmm0
+	void Expression (NodeID n)
+	{
+		line = ast.Line (n);
+		bool real = ast.Type (n) == RT_real;
+		std::string operand;
+		switch (ast.Kind (n))
+		{
+			case (NodeKind::int_literal):
+			case (NodeKind::real_literal):
+			case (NodeKind::variable):
+				if (!Direct (n, operand)) operand = Place (ast.Declaration (n));
+				Line (fmt::runtime (real ? "movsd {}, %xmm0" : "movl {}, %eax"), operand);
+				break;
+			case (NodeKind::index):
+				Expression (ast.Child (n, 1));
+				CheckIndex (n, "%rax", "%eax");
+				operand = Element (n, "%rax");
+				Line (fmt::runtime (real ? "movsd {}, %xmm0" : "movl {}, %eax"), operand);
+				break;
+			case (NodeKind::unary):
+				Expression (ast.Child (n, 0));
+				if (ast.UnaryOperator (n) == UnaryOp::t_not)
+					Line ("xorl $1, %eax");
+				else if (ast.UnaryOperator (n) == UnaryOp::minus && real)
+				{
+					Line ("movq %xmm0, %rax");
+					Line ("btcq $63, %rax");
+					Line ("movq %rax, %xmm0");
+				}
+				else if (ast.UnaryOperator (n) == UnaryOp::minus)
+					Line ("negl %eax");
+				break;
+			case (NodeKind::binary):
+				if (ast.Type (ast.Child (n, 0)) == RT_real)
+					RealBinary (n);
+				else
+					IntBinary (n);
+				break;
+			default: break;
+		}
+	}
+
+	// The right operand of n, after the left is in %eax or %xmm0, as an operand for the
+	// instruction combining them
+	std::string RightOperand (NodeID n, bool real)
+	{
+		NodeID right = ast.Child (n, 1);
+		std::string operand;
+		if (Direct (right, operand)) return operand;
+		if (real)
+		{
+			Line ("subq $8, %rsp");
+			Line ("movsd %xmm0, (%rsp)");
+			Expression (right);
+			Line ("movapd %xmm0, %xmm1");
+			Line ("movsd (%rsp), %xmm0");
+			Line ("addq $8, %rsp");
+			return "%xmm1";
+		}
+		Line ("pushq %rax");
+		Expression (right);
+		Line ("movl %eax, %ecx");
+		Line ("popq %rax");
+		return "%ecx";
+	}
+
+	static char const *IntCondition (BinaryOp op)
+	{
+		switch (op)
+		{
+			case (BinaryOp::equal): return "e";
+			case (BinaryOp::not_equal): return "ne";
+			case (BinaryOp::less_than): return "l";
+			case (BinaryOp::less_than_or_equal): return "le";
+			case (BinaryOp::greater_than): return "g";
+			default: return "ge";
+		}
+	}
+
+	static char const *NegatedIntCondition (BinaryOp op)
+	{
+		switch (op)
+		{
+			case (BinaryOp::equal): return "ne";
+			case (BinaryOp::not_equal): return "e";
+			case (BinaryOp::less_than): return "ge";
+			case (BinaryOp::less_than_or_equal): return "g";
+			case (BinaryOp::greater_than): return "le";
+			default: return "l";
+		}
+	}
+
+	void IntBinary (NodeID n)
+	{
+		BinaryOp op = ast.BinaryOperator (n);
+		Expression (ast.Child (n, 0));
+		std::string right = RightOperand (n, false);
+		line = ast.Line (n);
+		switch (op)
+		{
+			case (BinaryOp::add): Line ("addl {}, %eax", right); break;
+			case (BinaryOp::sub): Line ("subl {}, %eax", right); break;
+			case (BinaryOp::mul): Line ("imull {}, %eax", right); break;
+			case (BinaryOp::t_and): Line ("andl {}, %eax", right); break;
+			case (BinaryOp::t_or): Line ("orl {}, %eax", right); break;
+			case (BinaryOp::div):
+			case (BinaryOp::mod): Divide (ast.Child (n, 1), right, op == BinaryOp::mod); break;
+			default:
+				Line ("cmpl {}, %eax", right);
+				Line ("set{} %al", IntCondition (op));
+				Line ("movzbl %al, %eax");
+		}
+	}
+
+	// Truncating division of %eax, leaving the quotient or remainder in %eax. A zero divisor is a
+	// runtime error and -1 is done apart as idiv traps on INT32_MIN / -1.
+	void Divide (NodeID right_node, std::string const &right, bool mod)
+	{
+		bool literal = ast.Kind (right_node) == NodeKind::int_literal;
+		int32_t divisor = ast.IntValue (right_node);
+		if (right != "%ecx") Line ("movl {}, %ecx", right);
+		std::string divide = NewLabel (), done = NewLabel ();
+		if (!literal || divisor == 0)
+		{
+			std::string ok = NewLabel ();
+			Line ("testl %ecx, %ecx");
+			Line ("jne {}", ok);
+			RuntimeError (".Ldivision_message");
+			Label (ok + ":");
+		}
+		if (!literal || divisor == -1)
+		{
+			Line ("cmpl $-1, %ecx");
+			Line ("jne {}", divide);
+			Line (fmt::runtime (mod ? "xorl %eax, %eax" : "negl %eax"));
+			Line ("jmp {}", done);
+		}
+		Label (divide + ":");
+		Line ("cltd");
+		Line ("idivl %ecx");
+		if (mod) Line ("movl %edx, %eax");
+		Label (done + ":");
+	}
+
+	void RealBinary (NodeID n)
+	{
+		BinaryOp op = ast.BinaryOperator (n);
+		Expression (ast.Child (n, 0));
+		std::string right = RightOperand (n, true);
+		line = ast.Line (n);
+		switch (op)
+		{
+			case (BinaryOp::add): Line ("addsd {}, %xmm0", right); break;
+			case (BinaryOp::sub): Line ("subsd {}, %xmm0", right); break;
+			case (BinaryOp::mul): Line ("mulsd {}, %xmm0", right); break;
+			case (BinaryOp::div): Line ("divsd {}, %xmm0", right); break;
+			default:
+				// ucomisd sets the carry and zero flags as an unsigned compare would, and parity when
+				// either side is NaN, which only != holds for
+				if (right != "%xmm1") Line ("movsd {}, %xmm1", right);
+				if (op == BinaryOp::less_than || op == BinaryOp::less_than_or_equal)
+					Line ("ucomisd %xmm0, %xmm1");
+				else
+					Line ("ucomisd %xmm1, %xmm0");
+				if (op == BinaryOp::equal || op == BinaryOp::not_equal)
+				{
+					bool equal = op == BinaryOp::equal;
+					Line ("set{} %al", equal ? "e" : "ne");
+					Line ("set{} %cl", equal ? "np" : "p");
+					Line ("{} %cl, %al", equal ? "andb" : "orb");
+				}
+				else
+					Line ("set{} %al", op == BinaryOp::less_than || op == BinaryOp::greater_than ? "a" : "ae");
+				Line ("movzbl %al, %eax");
+		}
+	}
+
+	// Jumps to target if cond is when. Int comparisons jump on the flags of their compare.
+	void Branch (NodeID cond, std::string const &target, bool when)
+	{
+		if (ast.Kind (cond) == NodeKind::binary && ast.BinaryOperator (cond) >= BinaryOp::equal
+		    && ast.Type (ast.Child (cond, 0)) == RT_int)
+		{
+			BinaryOp op = ast.BinaryOperator (cond);
+			Expression (ast.Child (cond, 0));
+			std::string right = RightOperand (cond, false);
+			Line ("cmpl {}, %eax", right);
+			Line ("j{} {}", when ? IntCondition (op) : NegatedIntCondition (op), target);
+			return;
+		}
+		Expression (cond);
+		Line ("testl %eax, %eax");
+		Line ("j{} {}", when ? "ne" : "e", target);
+	}
+
+	void Statement (NodeID n)
+	{
+		line = ast.Line (n);
+		switch (ast.Kind (n))
+		{
+			case (NodeKind::compound):
+				for (NodeID child : ast.Children (n))
+					Statement (child);
+				break;
+			case (NodeKind::assign): Assign (ast.Child (n, 0), ast.Child (n, 1)); break;
+			case (NodeKind::if_then):
+			{
+				std::string skip_then = NewLabel ();
+				Branch (ast.Child (n, 0), skip_then, false);
+				Statement (ast.Child (n, 1));
+				if (ast.Children (n).size () == 3)
+				{
+					std::string skip_else = NewLabel ();
+					Line ("jmp {}", skip_else);
+					Label (skip_then + ":");
+					Statement (ast.Child (n, 2));
+					Label (skip_else + ":");
+				}
+				else
+					Label (skip_then + ":");
+				break;
+			}
+			case (NodeKind::while_do):
+			{
+				// the condition goes after the body so each iteration takes one jump
+				std::string body = NewLabel (), condition = NewLabel ();
+				Line ("jmp {}", condition);
+				Label (body + ":");
+				Statement (ast.Child (n, 1));
+				Label (condition + ":");
+				Branch (ast.Child (n, 0), body, true);
+				break;
+			}
+			case (NodeKind::call): Call (n); break;
+			default: break;
+		}
+	}
+
+	void Assign (NodeID target, NodeID value)
+	{
+		bool real = ast.Type (value) == RT_real;
+		if (ast.Kind (target) == NodeKind::index)
+		{
+			// in the order the VM goes: index, value, then the bounds check
+			Expression (ast.Child (target, 1));
+			Line ("pushq %rax");
+			Expression (value);
+			Line ("popq %rcx");
+			CheckIndex (target, "%rcx", "%ecx");
+			Line (fmt::runtime (real ? "movsd %xmm0, {}" : "movl %eax, {}"), Element (target, "%rcx"));
+		}
+		else if (IsArrayType (ast.Type (target)))
+		{
+			// the source is taken first, both may walk out through %r11
+			Line ("leaq {}, %rsi", Place (ast.Declaration (value)));
+			Line ("leaq {}, %rdi", Place (ast.Declaration (target)));
+			Line ("movl ${}, %ecx", ast.Type (target).size ());
+			Line ("rep movsb");
+		}
+		else
+		{
+			Expression (value);
+			Line (fmt::runtime (real ? "movsd %xmm0, {}" : "movl %eax, {}"), Place (ast.Declaration (target)));
+		}
+	}
+
+	// The caller makes room for the callee's params below its own frame, arrays copied in as
+	// they go by value, and passes the static link in %r10
+	void Call (NodeID n)
+	{
+		NodeID callee = ast.Callee (n);
+		auto &frame = frames[frame_of[callee]];
+		uint32_t block = AlignTo16 (frame.params);
+		if (block > 0) Line ("subq ${}, %rsp", block);
+
+		size_t arg = 0;
+		for (NodeID param : ast.Children (callee))
+		{
+			if (ast.Kind (param) != NodeKind::declaration || !ast.IsParam (param)) continue;
+			if (arg >= ast.Children (n).size ()) break;
+			NodeID value = ast.Child (n, arg++);
+			int32_t offset = locations[param].offset - 16;
+			if (IsArrayType (ast.Type (value)))
+			{
+				Line ("leaq {}, %rsi", Place (ast.Declaration (value)));
+				Line ("leaq {}(%rsp), %rdi", offset);
+				Line ("movl ${}, %ecx", ast.Type (value).size ());
+				Line ("rep movsb");
+			}
+			else
+			{
+				Expression (value);
+				Line (fmt::runtime (ast.Type (value) == RT_real ? "movsd %xmm0, {}(%rsp)" : "movl %eax, {}(%rsp)"), offset);
+			}
+		}
+
+		line = ast.Line (n);
+		uint16_t parent = frame.level - 1;
+		if (parent == 0)
+			Line ("xorl %r10d, %r10d");
+		else if (parent == level)
+			Line ("movq %rbp, %r10");
+		else
+			FrameOf (parent, "%r10");
+		Line ("call {}", frame.label);
+		if (block > 0) Line ("addq ${}, %rsp", block);
+	}
+
+	// The language has no output statements, so the program's variables are its result
+	void PrintGlobals ()
+	{
+		for (NodeID decl : globals)
+		{
+			auto &loc = locations[decl];
+			if (loc.type.size () == 0) continue;
+			Line ("leaq .Lname{}(%rip), %rsi", decl);
+			if (IsArrayType (loc.type))
+			{
+				Line ("movq %rsi, %rdi");
+				Line ("leaq pascal_globals+{}(%rip), %rsi", loc.offset);
+				Line ("movl ${}, %edx", ArraySize (loc.type));
+				Line ("call {}", IsArrReal (loc.type) ? "pascal_print_reals" : "pascal_print_ints");
+				continue;
+			}
+			if (loc.type == RT_real)
+			{
+				Line ("leaq .Lreal_format(%rip), %rdi");
+				Line ("movsd pascal_globals+{}(%rip), %xmm0", loc.offset);
+				Line ("movl $1, %eax");
+			}
+			else
+			{
+				Line ("leaq .Lint_format(%rip), %rdi");
+				Line ("movl pascal_globals+{}(%rip), %edx", loc.offset);
+				Line ("xorl %eax, %eax");
+			}
+			Line ("call printf@PLT");
+		}
+	}
+
+	// Printing arrays and reporting runtime errors, called from the generated code
+	void RuntimeSupport ()
+	{
+		Label (R"(
+# pascal_print_ints (name, elements, count) and pascal_print_reals: name = [a, b, ...]
+pascal_print_ints:
+	leaq .Lint_element(%rip), %rax
+	xorl %ecx, %ecx
+	jmp pascal_print_array
+pascal_print_reals:
+	leaq .Lreal_element(%rip), %rax
+	movl $1, %ecx
+pascal_print_array:
+	pushq %rbx
+	pushq %r12
+	pushq %r13
+	pushq %r14
+	pushq %r15
+	movq %rsi, %rbx
+	movl %edx, %r12d
+	xorl %r13d, %r13d
+	movq %rax, %r14
+	movl %ecx, %r15d
+	movq %rdi, %rsi
+	leaq .Larray_open(%rip), %rdi
+	xorl %eax, %eax
+	call printf@PLT
+	jmp 2f
+1:	leaq .Lseparator(%rip), %rdi
+	testl %r13d, %r13d
+	leaq .Lnothing(%rip), %rsi
+	cmovneq %rdi, %rsi
+	movq %r14, %rdi
+	testl %r15d, %r15d
+	jne 3f
+	movl (%rbx,%r13,4), %edx
+	xorl %eax, %eax
+	jmp 4f
+3:	movsd (%rbx,%r13,8), %xmm0
+	movl $1, %eax
+4:	call printf@PLT
+	incl %r13d
+2:	cmpl %r12d, %r13d
+	jl 1b
+	leaq .Larray_close(%rip), %rdi
+	xorl %eax, %eax
+	call printf@PLT
+	popq %r15
+	popq %r14
+	popq %r13
+	popq %r12
+	popq %rbx
+	ret
+
+# pascal_runtime_error (line, message) prints where the program stopped and exits with 1
+pascal_runtime_error:
+	andq $-16, %rsp
+	movq %rsi, %rdx
+	movl %edi, %esi
+	leaq .Lerror_format(%rip), %rdi
+	xorl %eax, %eax
+	call printf@PLT
+	movl $1, %edi
+	call exit@PLT
+
+	.section .rodata
+.Lint_format:
+	.string "%s = %d\n"
+.Lreal_format:
+	.string "%s = %.17g\n"
+.Lint_element:
+	.string "%s%d"
+.Lreal_element:
+	.string "%s%.17g"
+.Larray_open:
+	.string "%s = ["
+.Larray_close:
+	.string "]\n"
+.Lseparator:
+	.string ", "
+.Lnothing:
+	.string ""
+.Lerror_format:
+	.string "Runtime error on line %d: %s\n"
+.Ldivision_message:
+	.string "division by zero"
+.Lindex_message:
+	.string "array index out of range"
+	.text)");
+	}
+
+	Ast const &ast;
+	SymbolTable const &symbols;
+	std::vector<Location> locations; // by declaration node
+	std::vector<int> frame_of;       // by procedure node
+	std::vector<Frame> frames;       // the program first
+	std::vector<NodeID> globals;
+	std::vector<uint64_t> reals; // bits of each .LC constant
+	fmt::memory_buffer out;
+	size_t next_label = 0;
+
+	// the procedure being emitted
+	uint16_t level = 0;
+	int line = 0;
+};
+
+} // namespace
+
+bool EmitX86_64 (Ast const &ast, SymbolTable const &symbols, FILE *fp, std::string &error)
+{
+	X86Emitter emitter (ast, symbols);
+	return emitter.Emit (fp, error);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+#include "ast.h"
+#include "common.h"
+
+// x86-64 System V assembly for GNU as (AT&T syntax) from a checked program, which must have no
+// errors. The result links against the C library with cc into an executable that runs the program
+// and prints its variables, as -run does.
+//
+// Variables sit at the addresses ParserContext::Print lists: the program's in one block of .bss,
+// a procedure's locals at the bottom of its frame and its params in a block the caller fills above
+// the return address. A procedure is passed the frame of its enclosing procedure in %r10, the
+// System V static chain register, and keeps it at -8(%rbp) for nested procedures to follow.
+//
+// Fails, saying why in error, for programs with errors.
+bool EmitX86_64 (Ast const &ast, SymbolTable const &symbols, FILE *fp, std::string &error);